@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/libsquash/squash.h"
+
+#ifndef _WIN32
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Сравнение способов чтения: читает все файлы каталога образа с каждым бэкендом ввода-вывода.
+// Перед каждым прогоном страницы образа вытесняются из кэша (posix_fadvise), чтобы следующий бэкенд
+// не читал из памяти то, что прогрел предыдущий. Там, где это не работает (Windows), запускайте
+// каждый бэкенд отдельным процессом с холодным кэшем: squash_bench <image> <path> <chunk_kib> <backend>.
+// Если path - файл, дополнительно замеряется чтение из разных мест большого файла.
+
+static double now_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, counter;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+typedef struct {
+    uint8_t *buffer;
+    size_t chunk;
+    uint64_t bytes;
+    uint64_t files;
+} bench_state_t;
+
+static squash_error_t read_file_inode(squash_fs_t *fs, squash_reg_inode_t *inode, bench_state_t *state) {
+    uint64_t size;
+    squash_get_file_size(inode, &size);
+    for (uint64_t pos = 0; pos < size; ) {
+        size_t want = size - pos < state->chunk ? (size_t)(size - pos) : state->chunk;
+        size_t got = 0;
+        squash_error_t err = squash_read_file(fs, inode, state->buffer, pos, want, &got);
+        if (err != SQUASH_OK) {
+            return err;
+        }
+        if (got == 0) {
+            break;
+        }
+        pos += got;
+        state->bytes += got;
+    }
+    state->files++;
+    return SQUASH_OK;
+}
+
+static squash_error_t walk(squash_fs_t *fs, squash_off_t inode_ref, bench_state_t *state) {
+    void *inode;
+    squash_error_t err = squash_read_inode(fs, inode_ref, &inode);
+    if (err != SQUASH_OK) {
+        return err;
+    }
+
+    if (squash_is_file(inode)) {
+        err = read_file_inode(fs, (squash_reg_inode_t *)inode, state);
+    } else if (squash_is_directory(inode)) {
+        squash_dir_iterator_t *iterator;
+        err = squash_opendir(fs, (squash_dir_inode_t *)inode, &iterator);
+        if (err == SQUASH_OK) {
+            squash_dir_entry_t *entry;
+            while (err == SQUASH_OK && squash_readdir(iterator, &entry) == SQUASH_OK && entry) {
+                if (strcmp(entry->name, ".") != 0 && strcmp(entry->name, "..") != 0) {
+                    err = walk(fs, entry->inode_ref, state);
+                }
+                squash_free_dir_entry(entry);
+            }
+            squash_closedir(iterator);
+        }
+    }
+
+    squash_free_inode(inode);
+    return err;
+}
+
+// Вытесняет страницы образа из кэша ОС. Грязных страниц у образа нет, поэтому root не нужен
+static void drop_image_cache(const char *image) {
+#ifdef _WIN32
+    (void)image;
+#else
+    int fd = open(image, O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    int ret = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    if (ret != 0) {
+        fprintf(stderr, "posix_fadvise failed: %s; results may come from a warm page cache\n", strerror(ret));
+    }
+    close(fd);
+#endif
+}
+
+static int run(const char *image, const char *path, size_t chunk, squash_io_backend_t backend) {
+    drop_image_cache(image);
+
+    squash_open_options_t options;
+    memset(&options, 0, sizeof(options));
+    options.io_backend = backend;
+
+    double start = now_seconds();
+    squash_fs_t *fs;
+    squash_error_t err = squash_open_ex(image, &options, &fs);
+    if (err != SQUASH_OK) {
+        fprintf(stderr, "Failed to open SquashFS image: %s\n", squash_strerror(err));
+        return 1;
+    }
+
+    squash_off_t inode_ref;
+    err = squash_lookup_path(fs, path, &inode_ref);
+    if (err != SQUASH_OK) {
+        fprintf(stderr, "Failed to find path: %s\n", squash_strerror(err));
+        squash_close(fs);
+        return 1;
+    }
+
+    bench_state_t state;
+    memset(&state, 0, sizeof(state));
+    state.chunk = chunk;
+    state.buffer = malloc(chunk);
+    if (!state.buffer) {
+        squash_close(fs);
+        return 1;
+    }
+
+    err = walk(fs, inode_ref, &state);
+    double elapsed = now_seconds() - start;
+
+    squash_stats_t stats;
+    squash_get_stats(fs, &stats);
+    if (err != SQUASH_OK) {
+        fprintf(stderr, "Read failed: %s\n", squash_strerror(err));
+    } else {
+        printf("%-9s %8llu files %10.1f MiB %8.3f s %9.1f MiB/s  batches=%llu requests=%llu\n",
+               squash_io_backend_name(stats.io_backend),
+               (unsigned long long)state.files, state.bytes / 1048576.0, elapsed,
+               elapsed > 0 ? state.bytes / 1048576.0 / elapsed : 0.0,
+               (unsigned long long)stats.io_batches, (unsigned long long)stats.io_requests);
+    }
+
+    free(state.buffer);
+    squash_close(fs);
+    return err == SQUASH_OK ? 0 : 1;
+}
+
+// Большой файл: читает chunk из 64 точек, равномерно разнесённых по всему файлу (в том числе за 4 ГиБ),
+// через squash_file_t. Показывает стоимость произвольного доступа в многогигабайтных файлах
+#define LARGE_FILE_PROBES 64
+
+static int run_large_file(const char *image, const char *path, size_t chunk) {
+    drop_image_cache(image);
+
+    squash_fs_t *fs;
+    squash_error_t err = squash_open(image, &fs);
+    if (err != SQUASH_OK) {
+        fprintf(stderr, "Failed to open SquashFS image: %s\n", squash_strerror(err));
+        return 1;
+    }
+
+    squash_file_t *file;
+    err = squash_file_open(fs, path, &file);
+    if (err != SQUASH_OK) {
+        squash_close(fs);
+        return err == SQUASH_ERROR_NOT_FILE ? 0 : 1; // Каталог - этот замер не нужен
+    }
+
+    uint8_t *buffer = malloc(chunk);
+    if (!buffer) {
+        squash_file_close(file);
+        squash_close(fs);
+        return 1;
+    }
+
+    uint64_t size = squash_file_size(file);
+    uint64_t bytes = 0;
+    double start = now_seconds();
+    for (uint32_t i = 0; i < LARGE_FILE_PROBES && err == SQUASH_OK; i++) {
+        uint64_t offset = size / LARGE_FILE_PROBES * i;
+        size_t got = 0;
+        err = squash_file_pread(file, buffer, chunk, offset, &got);
+        bytes += got;
+    }
+    double elapsed = now_seconds() - start;
+
+    if (err != SQUASH_OK) {
+        fprintf(stderr, "Read failed: %s\n", squash_strerror(err));
+    } else {
+        printf("%-9s %8.1f GiB file %10.1f MiB %8.3f s %9.1f MiB/s  probes=%u\n", "seek",
+               size / 1073741824.0, bytes / 1048576.0, elapsed,
+               elapsed > 0 ? bytes / 1048576.0 / elapsed : 0.0, LARGE_FILE_PROBES);
+    }
+
+    free(buffer);
+    squash_file_close(file);
+    squash_close(fs);
+    return err == SQUASH_OK ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 5) {
+        fprintf(stderr, "Usage: %s <squashfs_image> [path] [chunk_kib] [sync|threads|io_uring]\n", argv[0]);
+        return 1;
+    }
+
+    const char *path = argc > 2 ? argv[2] : "/";
+    size_t chunk = (argc > 3 ? (size_t)strtoul(argv[3], NULL, 10) : 1024) * 1024;
+    if (chunk == 0) {
+        fprintf(stderr, "Invalid chunk size\n");
+        return 1;
+    }
+
+    // Один бэкенд на процесс: прогоны не делят ни кэш библиотеки, ни прогретые страницы
+    if (argc > 4) {
+        squash_io_backend_t backends[] = {SQUASH_IO_SYNC, SQUASH_IO_THREADS, SQUASH_IO_URING};
+        for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+            if (strcmp(argv[4], squash_io_backend_name(backends[i])) == 0) {
+                return run(argv[1], path, chunk, backends[i]);
+            }
+        }
+        fprintf(stderr, "Unknown I/O backend: %s\n", argv[4]);
+        return 1;
+    }
+
+    int rc = 0;
+    rc |= run(argv[1], path, chunk, SQUASH_IO_SYNC);
+    rc |= run(argv[1], path, chunk, SQUASH_IO_THREADS);
+#ifndef _WIN32
+    rc |= run(argv[1], path, chunk, SQUASH_IO_URING);
+#endif
+    rc |= run_large_file(argv[1], path, chunk);
+    return rc;
+}
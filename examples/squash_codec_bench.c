@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/libsquash/squash.h"
+
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+// Микробенчмарк кодека: собирает сжатые блоки данных файлов образа и распаковывает их в памяти
+// без ввода-вывода. Для образов GZIP сравнивает zlib и libdeflate и проверяет, что результаты совпадают.
+
+#define CODEC_BENCH_MAX_BYTES (256u * 1024 * 1024) // Предел распакованных данных всех собранных блоков
+#define CODEC_BENCH_MIN_SECONDS 1.0                // Каждый распаковщик крутится не меньше
+
+static double now_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, counter;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+typedef struct {
+    uint8_t *data;     // Сжатые блоки подряд
+    size_t size;
+    size_t capacity;
+    uint32_t *lengths; // Длина каждого блока
+    size_t count;
+    size_t max_count;
+    uint32_t block_size;
+    bool full;         // Набрано CODEC_BENCH_MAX_BYTES
+} block_set_t;
+
+static int add_block(block_set_t *set, FILE *image, uint64_t offset, uint32_t length) {
+    if ((set->count + 1) * (uint64_t)set->block_size > CODEC_BENCH_MAX_BYTES) {
+        set->full = true;
+        return 1;
+    }
+    if (set->size + length > set->capacity) {
+        size_t capacity = set->capacity ? set->capacity * 2 : 1024 * 1024;
+        while (capacity < set->size + length) {
+            capacity *= 2;
+        }
+        uint8_t *data = realloc(set->data, capacity);
+        if (!data) {
+            return 1;
+        }
+        set->data = data;
+        set->capacity = capacity;
+    }
+    if (set->count == set->max_count) {
+        size_t max_count = set->max_count ? set->max_count * 2 : 1024;
+        uint32_t *lengths = realloc(set->lengths, max_count * sizeof(uint32_t));
+        if (!lengths) {
+            return 1;
+        }
+        set->lengths = lengths;
+        set->max_count = max_count;
+    }
+    if (squash_fseek(image, offset) != 0 || fread(set->data + set->size, 1, length, image) != length) {
+        return 1;
+    }
+    set->size += length;
+    set->lengths[set->count++] = length;
+    return 0;
+}
+
+static void collect_file(squash_reg_inode_t *inode, FILE *image, block_set_t *set) {
+    uint64_t nblocks = inode->file_size / set->block_size;
+    if (inode->fragment == 0xFFFFFFFF && inode->file_size % set->block_size != 0) {
+        nblocks++;
+    }
+    uint64_t offset = inode->start_block;
+    for (uint64_t i = 0; i < nblocks; i++) {
+        uint32_t length = inode->block_list[i] & ((1u << 24) - 1);
+        bool compressed = !(inode->block_list[i] & (1u << 24));
+        if (compressed && length > 0 && add_block(set, image, offset, length) != 0) {
+            return;
+        }
+        offset += length;
+    }
+}
+
+static squash_error_t walk(squash_fs_t *fs, squash_off_t inode_ref, FILE *image, block_set_t *set) {
+    void *inode;
+    squash_error_t err = squash_read_inode(fs, inode_ref, &inode);
+    if (err != SQUASH_OK) {
+        return err;
+    }
+
+    if (squash_is_file(inode)) {
+        collect_file((squash_reg_inode_t *)inode, image, set);
+    } else if (squash_is_directory(inode)) {
+        squash_dir_iterator_t *iterator;
+        err = squash_opendir(fs, (squash_dir_inode_t *)inode, &iterator);
+        if (err == SQUASH_OK) {
+            squash_dir_entry_t *entry;
+            while (err == SQUASH_OK && !set->full &&
+                   squash_readdir(iterator, &entry) == SQUASH_OK && entry) {
+                if (strcmp(entry->name, ".") != 0 && strcmp(entry->name, "..") != 0) {
+                    err = walk(fs, entry->inode_ref, image, set);
+                }
+                squash_free_dir_entry(entry);
+            }
+            squash_closedir(iterator);
+        }
+    }
+
+    squash_free_inode(inode);
+    return err;
+}
+
+// Распаковывает все блоки по кругу не меньше CODEC_BENCH_MIN_SECONDS; out получает результат последнего прохода
+static int run(const char *name, squash_decompressor_t *dec, const block_set_t *set, uint32_t block_size,
+               uint8_t *out, double *mib_per_second) {
+    uint64_t bytes = 0;
+    uint32_t passes = 0;
+    double start = now_seconds(), elapsed = 0;
+    do {
+        const uint8_t *src = set->data;
+        uint8_t *dst = out;
+        for (size_t i = 0; i < set->count; i++) {
+            size_t size = block_size;
+            squash_error_t err = squash_decompress_block(dec, src, set->lengths[i], dst, &size);
+            if (err != SQUASH_OK) {
+                fprintf(stderr, "%s: block %zu failed: %s\n", name, i, squash_strerror(err));
+                return 1;
+            }
+            src += set->lengths[i];
+            dst += block_size;
+            bytes += size;
+        }
+        passes++;
+        elapsed = now_seconds() - start;
+    } while (elapsed < CODEC_BENCH_MIN_SECONDS);
+
+    *mib_per_second = elapsed > 0 ? bytes / 1048576.0 / elapsed : 0.0;
+    printf("%-11s %8zu blocks %6u passes %8.3f s %9.1f MiB/s %10.0f blocks/s\n", name, set->count, passes,
+           elapsed, *mib_per_second, elapsed > 0 ? set->count * (double)passes / elapsed : 0.0);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s <squashfs_image> [path]\n", argv[0]);
+        return 1;
+    }
+    const char *path = argc > 2 ? argv[2] : "/";
+
+    squash_fs_t *fs;
+    squash_error_t err = squash_open(argv[1], &fs);
+    if (err != SQUASH_OK) {
+        fprintf(stderr, "Failed to open SquashFS image: %s\n", squash_strerror(err));
+        return 1;
+    }
+    squash_super_t super;
+    squash_get_super(fs, &super);
+
+    FILE *image = fopen(argv[1], "rb");
+    squash_off_t inode_ref;
+    block_set_t set;
+    memset(&set, 0, sizeof(set));
+    set.block_size = super.block_size;
+    err = image ? squash_lookup_path(fs, path, &inode_ref) : SQUASH_ERROR_IO;
+    if (err == SQUASH_OK) {
+        err = walk(fs, inode_ref, image, &set);
+    }
+    if (image) {
+        fclose(image);
+    }
+    squash_close(fs);
+    if (err != SQUASH_OK || set.count == 0) {
+        fprintf(stderr, "No compressed data blocks found: %s\n", squash_strerror(err));
+        free(set.data);
+        free(set.lengths);
+        return 1;
+    }
+    printf("%zu compressed blocks, %.1f MiB, block size %u\n", set.count, set.size / 1048576.0, super.block_size);
+
+    uint8_t *out = calloc(set.count, super.block_size);
+    squash_decompressor_t *dec = squash_decompressor_create((squash_compression_t)super.compression);
+    if (!out || !dec) {
+        fprintf(stderr, "Failed to set up compression type %u\n", super.compression);
+        free(out);
+        squash_decompressor_destroy(dec);
+        free(set.data);
+        free(set.lengths);
+        return 1;
+    }
+
+    int rc = 0;
+    double speed = 0;
+    if (super.compression != SQUASH_COMPRESSION_GZIP) {
+        rc = run("codec", dec, &set, super.block_size, out, &speed);
+    } else {
+        double zlib_speed = 0;
+        squash_decompressor_set_gzip_backend(dec, SQUASH_GZIP_ZLIB);
+        rc = run(squash_gzip_backend_name(SQUASH_GZIP_ZLIB), dec, &set, super.block_size, out, &zlib_speed);
+
+        if (rc == 0 && squash_decompressor_set_gzip_backend(dec, SQUASH_GZIP_LIBDEFLATE) == SQUASH_OK) {
+            // Результат libdeflate сверяется с zlib
+            uint8_t *check = calloc(set.count, super.block_size);
+            rc = check ? run(squash_gzip_backend_name(SQUASH_GZIP_LIBDEFLATE), dec, &set, super.block_size,
+                             check, &speed) : 1;
+            if (rc == 0 && memcmp(out, check, (size_t)set.count * super.block_size) != 0) {
+                fprintf(stderr, "libdeflate output differs from zlib\n");
+                rc = 1;
+            }
+            if (rc == 0 && zlib_speed > 0) {
+                printf("libdeflate speedup: %.2fx\n", speed / zlib_speed);
+            }
+            free(check);
+        } else if (rc == 0) {
+            printf("libdeflate: not built (configure with -DSQUASH_WITH_LIBDEFLATE=ON)\n");
+        }
+    }
+
+    squash_decompressor_destroy(dec);
+    free(out);
+    free(set.data);
+    free(set.lengths);
+    return rc;
+}
@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/libsquash/squash.h"
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 4) {
+        fprintf(stderr, "Usage: %s <squashfs_image> [index_file] [path]\n", argv[0]);
+        return 1;
+    }
+
+    // По умолчанию индекс лежит рядом с образом
+    char *index_path;
+    if (argc > 2) {
+        index_path = strdup(argv[2]);
+    } else {
+        index_path = malloc(strlen(argv[1]) + sizeof(".idx"));
+        if (index_path)
+            sprintf(index_path, "%s.idx", argv[1]);
+    }
+    if (!index_path) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    squash_fs_t *fs;
+    squash_error_t err = squash_open(argv[1], &fs);
+    if (err != SQUASH_OK) {
+        fprintf(stderr, "Failed to open SquashFS image: %s\n", squash_strerror(err));
+        free(index_path);
+        return 1;
+    }
+    err = squash_index_build(fs, index_path);
+    squash_close(fs);
+    if (err != SQUASH_OK) {
+        fprintf(stderr, "Failed to build index %s: %s\n", index_path, squash_strerror(err));
+        free(index_path);
+        return 1;
+    }
+    printf("Index written to %s\n", index_path);
+
+    // Проверка: образ открывается с индексом, путь находится без обхода директорий
+    squash_open_options_t options = {0};
+    options.index_path = index_path;
+    err = squash_open_ex(argv[1], &options, &fs);
+    if (err != SQUASH_OK) {
+        fprintf(stderr, "Failed to reopen SquashFS image: %s\n", squash_strerror(err));
+        free(index_path);
+        return 1;
+    }
+
+    const char *path = argc > 3 ? argv[3] : "/";
+    squash_off_t inode_ref;
+    err = squash_lookup_path(fs, path, &inode_ref);
+    if (err == SQUASH_OK)
+        printf("%s -> inode 0x%llx\n", path, (unsigned long long)inode_ref);
+    else
+        printf("%s: %s\n", path, squash_strerror(err));
+
+    squash_stats_t stats;
+    if (squash_get_stats(fs, &stats) == SQUASH_OK) {
+        printf("Index loaded: %s, path hits: %llu, inode hits: %llu\n", stats.index_loaded ? "yes" : "no",
+               (unsigned long long)stats.index_path_hits, (unsigned long long)stats.index_inode_hits);
+    }
+
+    squash_close(fs);
+    free(index_path);
+    return 0;
+}
@@ -29,7 +29,34 @@ int main(int argc, char *argv[]) {
     printf("Block Size: %u\n", super.block_size);
     printf("Compression: %s\n", squash_get_compression_name(super.compression));
     printf("Version: %u.%u\n", super.s_major, super.s_minor);
-    printf("Bytes Used: %llu\n", super.bytes_used);
+    printf("Bytes Used: %llu\n", (unsigned long long)super.bytes_used);
+
+    squash_compressor_options_t options;
+    if (squash_get_compressor_options(fs, &options) == SQUASH_OK) {
+        const char *source = options.present ? "image" : "defaults";
+        switch (super.compression) {
+        case SQUASH_COMPRESSION_GZIP:
+            printf("GZIP Options (%s): level %u, window %u bits, strategies 0x%x\n", source,
+                   options.gzip.level, options.gzip.window_bits, options.gzip.strategies);
+            break;
+        case SQUASH_COMPRESSION_XZ:
+            printf("XZ Options (%s): dictionary %u, filters 0x%x\n", source,
+                   options.xz.dictionary_size, options.xz.filters);
+            break;
+        case SQUASH_COMPRESSION_LZO:
+            printf("LZO Options (%s): algorithm %u, level %u\n", source, options.lzo.algorithm, options.lzo.level);
+            break;
+        case SQUASH_COMPRESSION_LZ4:
+            printf("LZ4 Options (%s): version %u%s\n", source, options.lz4.version,
+                   (options.lz4.flags & SQUASH_LZ4_HC) ? ", HC" : "");
+            break;
+        case SQUASH_COMPRESSION_ZSTD:
+            printf("ZSTD Options (%s): level %u\n", source, options.zstd.level);
+            break;
+        default:
+            break;
+        }
+    }
 
     squash_close(fs);
     return 0;
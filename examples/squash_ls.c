@@ -11,7 +11,7 @@ SQUASH_API squash_error_t list_directory_recursive_by_inode(squash_fs_t *fs, squ
 
     // Проверяем циклы
     if (squash_visited_inodes_contains(visited, inode_ref)) {
-        printf("Cycle detected: inode_ref 0x%llx already visited for path %s\n", inode_ref, display_path);
+        printf("Cycle detected: inode_ref 0x%llx already visited for path %s\n", (unsigned long long)inode_ref, display_path);
         return SQUASH_OK;
     }
 
@@ -69,7 +69,7 @@ SQUASH_API squash_error_t list_directory_recursive_by_inode(squash_fs_t *fs, squ
         for (int i = 0; i < depth + 1; i++) {
             printf("  ");
         }
-        printf("%s%s (inode_ref=0x%llx)\n", entry->name, squash_is_directory(entry_inode) ? "/" : "", entry->inode_ref);
+        printf("%s%s (inode_ref=0x%llx)\n", entry->name, squash_is_directory(entry_inode) ? "/" : "", (unsigned long long)entry->inode_ref);
 
         // Рекурсивный вызов для директорий - ПЕРЕДАЁМ ТОЛЬКО inode_ref!
         if (squash_is_directory(entry_inode)) {
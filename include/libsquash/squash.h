@@ -14,12 +14,49 @@ extern "C" {
 
 // Основные функции для работы с образом
 SQUASH_API squash_error_t squash_open(const char *filename, squash_fs_t **fs);
+SQUASH_API squash_error_t squash_open_ex(const char *filename, const squash_open_options_t *options, squash_fs_t **fs);
 SQUASH_API void squash_close(squash_fs_t *fs);
 SQUASH_API squash_error_t squash_get_super(squash_fs_t *fs, squash_super_t *super);
+SQUASH_API squash_error_t squash_get_stats(squash_fs_t *fs, squash_stats_t *stats);
+SQUASH_API squash_error_t squash_get_compressor_options(squash_fs_t *fs, squash_compressor_options_t *options);
+
+// Общий кэш блоков для нескольких образов (squash_open_options_t.cache); capacity 0 - 64 МиБ.
+// Образы держат кэш открытым: destroy можно вызвать сразу, память освободит последний squash_close
+SQUASH_API squash_error_t squash_cache_create(size_t capacity, squash_cache_t **cache);
+SQUASH_API void squash_cache_destroy(squash_cache_t *cache);
+
+// Индекс-спутник: пути, иноды, таблицы фрагментов и экспорта в файле, который squash_open_ex
+// (options.index_path) отображает в память вместо распаковки таблиц образа
+SQUASH_API squash_error_t squash_index_build(squash_fs_t *fs, const char *index_path);
+
+// Таблица всех путей образа в памяти: таблица директорий распаковывается один раз (параллельно по метаблокам),
+// после чего squash_lookup_path - одна проба хеш-таблицы. Повторный вызов строит таблицу заново
+SQUASH_API squash_error_t squash_build_path_index(squash_fs_t *fs);
+
+// Реестр кодеков: зарегистрированный кодек заменяет встроенный с тем же id и используется образами,
+// открытыми после регистрации. Регистрация и снятие - до открытия образов, вызовы не синхронизированы.
+// Декомпрессор хранит копию таблицы, поэтому снятие кодека не затрагивает уже открытые образы, но его
+// функции должны оставаться доступными, пока эти образы не закрыты
+SQUASH_API squash_error_t squash_register_codec(const squash_codec_t *codec);
+SQUASH_API void squash_unregister_codec(uint16_t id);
+SQUASH_API const squash_codec_t *squash_find_codec(uint16_t id);
 
 // Функции для работы с декомпрессором
 SQUASH_API squash_decompressor_t* squash_decompressor_create(squash_compression_t type);
 SQUASH_API void squash_decompressor_destroy(squash_decompressor_t *dec);
+// Новый декомпрессор с тем же кодеком и параметрами образа
+SQUASH_API squash_decompressor_t *squash_decompressor_clone(squash_decompressor_t *dec);
+// Настраивает декодер под параметры образа (словарь, окно, фильтры) и проверяет их.
+// Без вызова декодер рассчитан на любые параметры
+SQUASH_API squash_error_t squash_decompressor_configure(squash_decompressor_t *dec, const squash_compressor_options_t *options);
+// Выбор распаковщика GZIP. SQUASH_ERROR_COMPRESSION_NOT_SUPPORTED - libdeflate не собран
+// или декомпрессор не GZIP. Вызывается до начала распаковки
+SQUASH_API squash_error_t squash_decompressor_set_gzip_backend(squash_decompressor_t *dec, squash_gzip_backend_t backend);
+SQUASH_API squash_gzip_backend_t squash_decompressor_gzip_backend(squash_decompressor_t *dec);
+SQUASH_API const char *squash_gzip_backend_name(squash_gzip_backend_t backend);
+// Возможности (SQUASH_CODEC_*) и имя кодека, выбранного декомпрессором
+SQUASH_API uint32_t squash_decompressor_flags(squash_decompressor_t *dec);
+SQUASH_API const char *squash_decompressor_codec_name(squash_decompressor_t *dec);
 SQUASH_API squash_error_t squash_decompress_block(
     squash_decompressor_t *dec,
     const void *compressed_data,
@@ -27,23 +64,95 @@ SQUASH_API squash_error_t squash_decompress_block(
     void *uncompressed_data,
     size_t *uncompressed_size
 );
+// Распаковывает начало блока - не меньше needed байт, если кодек умеет останавливаться (gzip, xz, lz4, zstd).
+// *state сохраняет поток кодека: следующий вызов с большим needed продолжает с места остановки, поэтому
+// compressed_data и uncompressed_data до конца распаковки должны оставаться теми же. *complete - блок
+// распакован целиком, *uncompressed_size - сколько байт готово. Поток освобождается сам при завершении
+// и ошибке, иначе - squash_partial_free
+SQUASH_API bool squash_decompressor_supports_partial(squash_decompressor_t *dec);
+SQUASH_API squash_error_t squash_decompress_block_partial(
+    squash_decompressor_t *dec,
+    squash_partial_t **state,
+    const void *compressed_data,
+    size_t compressed_size,
+    void *uncompressed_data,
+    size_t capacity,
+    size_t needed,
+    size_t *uncompressed_size,
+    bool *complete
+);
+SQUASH_API void squash_partial_free(squash_partial_t *state);
 
 // Функции для работы с инодами
 SQUASH_API squash_error_t squash_read_inode(squash_fs_t *fs, squash_off_t inode_ref, void **inode);
 SQUASH_API squash_error_t squash_lookup_path(squash_fs_t *fs, const char *path, squash_off_t *inode_ref);
 SQUASH_API void squash_free_inode(void *inode);
+// Инод выделяется из арены; squash_free_inode для него не вызывается
+SQUASH_API squash_error_t squash_read_inode_arena(squash_fs_t *fs, squash_off_t inode_ref,
+                                                 squash_arena_t *arena, void **inode);
 
 // Функции для работы с файлами
 SQUASH_API squash_error_t squash_read_file(squash_fs_t *fs, squash_reg_inode_t *inode, 
-                                          void *buffer, size_t offset, size_t size, size_t *bytes_read);
+                                          void *buffer, uint64_t offset, size_t size, size_t *bytes_read);
+// flags - SQUASH_READ_*
+SQUASH_API squash_error_t squash_read_file_ex(squash_fs_t *fs, squash_reg_inode_t *inode, void *buffer,
+                                              uint64_t offset, size_t size, size_t *bytes_read, uint32_t flags);
 SQUASH_API squash_error_t squash_get_file_size(squash_reg_inode_t *inode, uint64_t *size);
 
+// Открытый файл: последовательное чтение с позиции (squash_file_read) или с любого смещения (squash_file_pread).
+// Handle используется из одного потока; закрывается до squash_close
+SQUASH_API squash_error_t squash_file_open(squash_fs_t *fs, const char *path, squash_file_t **file);
+SQUASH_API squash_error_t squash_file_open_inode(squash_fs_t *fs, squash_off_t inode_ref, squash_file_t **file);
+SQUASH_API squash_error_t squash_file_read(squash_file_t *file, void *buffer, size_t size, size_t *bytes_read);
+SQUASH_API squash_error_t squash_file_pread(squash_file_t *file, void *buffer, size_t size, uint64_t offset,
+                                           size_t *bytes_read);
+// Флаги SQUASH_READ_* для последующих чтений через handle
+SQUASH_API squash_error_t squash_file_set_flags(squash_file_t *file, uint32_t flags);
+// whence: SEEK_SET, SEEK_CUR или SEEK_END
+SQUASH_API squash_error_t squash_file_seek(squash_file_t *file, int64_t offset, int whence, uint64_t *position);
+SQUASH_API uint64_t squash_file_tell(squash_file_t *file);
+SQUASH_API uint64_t squash_file_size(squash_file_t *file);
+SQUASH_API void squash_file_close(squash_file_t *file);
+
+// Асинхронные запросы: выполняются пулом потоков библиотеки или options.executor.
+// callback вызывается в рабочем потоке; запрос освобождается squash_request_free (в том числе из callback).
+// Блоки файла читаются через fs->io и распаковываются без fs->lock, поэтому чтения файлов идут параллельно
+// (на Windows само чтение с диска остаётся под fs->lock). Хвост из фрагмента и squash_read_inode_async
+// выполняются под fs->lock, как и синхронные вызовы, и друг с другом не перекрываются
+typedef void (*squash_completion_cb)(squash_request_t *request, squash_error_t result, void *user_data);
+SQUASH_API squash_error_t squash_read_file_async(squash_fs_t *fs, squash_reg_inode_t *inode,
+                                                void *buffer, uint64_t offset, size_t size,
+                                                squash_completion_cb callback, void *user_data,
+                                                squash_request_t **request);
+SQUASH_API squash_error_t squash_read_inode_async(squash_fs_t *fs, squash_off_t inode_ref,
+                                                 squash_completion_cb callback, void *user_data,
+                                                 squash_request_t **request);
+// Ждёт завершения (после возврата из callback) и возвращает результат
+SQUASH_API squash_error_t squash_request_wait(squash_request_t *request);
+SQUASH_API bool squash_request_done(squash_request_t *request);
+SQUASH_API size_t squash_request_bytes_read(squash_request_t *request);
+// Прочитанный инод переходит к вызывающему (освобождается squash_free_inode)
+SQUASH_API void *squash_request_take_inode(squash_request_t *request);
+SQUASH_API void squash_request_free(squash_request_t *request);
+
 // Функции для работы с директориями
 SQUASH_API squash_error_t squash_opendir(squash_fs_t *fs, squash_dir_inode_t *dir_inode, 
                                         squash_dir_iterator_t **iterator);
 SQUASH_API squash_error_t squash_readdir(squash_dir_iterator_t *iterator, squash_dir_entry_t **entry);
 SQUASH_API void squash_closedir(squash_dir_iterator_t *iterator);
 SQUASH_API void squash_free_dir_entry(squash_dir_entry_t *entry);
+// Записи и итератор выделяются из арены: squash_readdir возвращает записи без копирования,
+// squash_free_dir_entry для них не вызывается, squash_closedir ничего не освобождает
+SQUASH_API squash_error_t squash_opendir_arena(squash_fs_t *fs, squash_dir_inode_t *dir_inode,
+                                              squash_arena_t *arena, squash_dir_iterator_t **iterator);
+
+// Функции для работы с ареной
+SQUASH_API squash_arena_t *squash_arena_create(size_t chunk_size);
+SQUASH_API void squash_arena_destroy(squash_arena_t *arena);
+SQUASH_API void squash_arena_reset(squash_arena_t *arena);
+SQUASH_API void *squash_arena_alloc(squash_arena_t *arena, size_t size);
+SQUASH_API squash_arena_mark_t squash_arena_mark(squash_arena_t *arena);
+SQUASH_API void squash_arena_rewind(squash_arena_t *arena, squash_arena_mark_t mark);
 
 // Утилитарные функции
 SQUASH_API squash_error_t squash_extract_file(squash_fs_t *fs, const char *path, const char *output_path);
@@ -62,12 +171,177 @@ void squash_visited_inodes_free(squash_visited_inodes_t *visited);
 squash_error_t squash_visited_inodes_add(squash_visited_inodes_t *visited, squash_off_t inode_ref);
 bool squash_visited_inodes_contains(squash_visited_inodes_t *visited, squash_off_t inode_ref);
 
+// Жёсткие ссылки при извлечении
+squash_error_t squash_hardlinks_init(squash_hardlinks_t *links, size_t initial_capacity);
+void squash_hardlinks_free(squash_hardlinks_t *links);
+squash_error_t squash_hardlinks_add(squash_hardlinks_t *links, uint32_t inode_number, const char *path);
+const char *squash_hardlinks_find(squash_hardlinks_t *links, uint32_t inode_number);
+
+// Пул буферов
+squash_error_t squash_buffer_pool_init(squash_buffer_pool_t *pool, size_t buffer_size);
+void squash_buffer_pool_destroy(squash_buffer_pool_t *pool);
+uint8_t *squash_buffer_pool_acquire(squash_buffer_pool_t *pool);
+void squash_buffer_pool_release(squash_buffer_pool_t *pool, uint8_t *buf);
+
+// Кэш блоков. Вызывается под fs->lock; указатель от get действителен до следующего put в тот же кэш
+void squash_block_cache_init(squash_block_cache_t *cache, size_t capacity);
+void squash_block_cache_destroy(squash_block_cache_t *cache);
+const uint8_t *squash_block_cache_get(squash_block_cache_t *cache, uint64_t key, size_t *size, uint32_t *aux);
+void squash_block_cache_put(squash_block_cache_t *cache, uint64_t key, const void *data, size_t size, uint32_t aux,
+                            bool once);
+// Есть ли блок в кэше; в отличие от get не считается обращением и не меняет порядок вытеснения
+bool squash_block_cache_contains(squash_block_cache_t *cache, uint64_t key);
+// Копирует блок из кэша в буфер fs->buffer_pool; false - блока нет (или не хватило памяти)
+bool squash_block_cache_copy(squash_fs_t *fs, squash_block_cache_t *cache, uint64_t key,
+                             uint8_t **data, size_t *size, uint32_t *aux);
+// Кэши образа: свои block_cache и compressed_cache или общий options.cache. Вызываются под fs->lock
+squash_error_t squash_fs_cache_init(squash_fs_t *fs);
+void squash_fs_cache_destroy(squash_fs_t *fs);
+bool squash_fs_cache_copy(squash_fs_t *fs, squash_cache_tier_t tier, uint64_t offset,
+                          uint8_t **data, size_t *size, uint32_t *aux);
+// Данные блока без копирования; для общего кэша - копия в буфере пула *copy, который освобождает вызывающий
+const uint8_t *squash_fs_cache_peek(squash_fs_t *fs, squash_cache_tier_t tier, uint64_t offset,
+                                    size_t *size, uint32_t *aux, uint8_t **copy);
+void squash_fs_cache_put(squash_fs_t *fs, squash_cache_tier_t tier, uint64_t offset, const void *data, size_t size,
+                         uint32_t aux, bool once);
+bool squash_fs_cache_contains(squash_fs_t *fs, squash_cache_tier_t tier, uint64_t offset);
+void squash_fs_cache_stats(squash_fs_t *fs, squash_stats_t *stats);
+
+// Поиск по полной таблице путей (индекс-спутник, squash_build_path_index). find ищет нормализованный путь "/a/b".
+// false - путь разбирается обходом директорий, иначе результат в *err
+typedef bool (*squash_path_find_fn)(void *ctx, const char *path, size_t len, squash_off_t *inode_ref, uint16_t *type);
+uint64_t squash_path_hash(const char *path, size_t len);
+bool squash_path_resolve(squash_path_find_fn find, void *ctx, const char *path, squash_off_t *inode_ref,
+                         squash_error_t *err);
+
+// Таблица путей в памяти (squash_path_index.c). squash_path_table_build вызывается под fs->lock;
+// ту же таблицу записывает в файл squash_index_build
+squash_error_t squash_path_table_build(squash_fs_t *fs, squash_path_index_t *index);
+bool squash_path_index_lookup(squash_fs_t *fs, const char *path, squash_off_t *inode_ref, squash_error_t *err);
+void squash_path_index_free(squash_path_index_t *index);
+
+// Индекс-спутник. lookup: false - путь разбирается обходом директорий, иначе результат в *err
+squash_error_t squash_index_open(const char *path, const squash_super_t *super, squash_index_t **index);
+void squash_index_close(squash_index_t *index);
+bool squash_index_lookup(squash_index_t *index, const char *path, squash_off_t *inode_ref, squash_error_t *err);
+// Инод в формате таблицы инодов; данные живут, пока индекс открыт
+bool squash_index_inode(squash_index_t *index, squash_off_t inode_ref, const uint8_t **data, size_t *size);
+bool squash_index_copy_fragments(squash_index_t *index, uint32_t count, struct squashfs_fragment_entry **table);
+bool squash_index_copy_lookup(squash_index_t *index, uint32_t count, uint64_t **table);
+
+// Упреждающее чтение блоков файла
+squash_error_t squash_readahead_init(squash_readahead_t *ra, uint32_t max_window);
+void squash_readahead_destroy(squash_fs_t *fs, squash_readahead_t *ra);
+// Возвращает распакованный блок из окна (при необходимости заполняя его);
+// SQUASH_ERROR_NOT_FOUND - доступ не последовательный, блок нужно прочитать напрямую
+squash_error_t squash_readahead_get(squash_fs_t *fs, squash_readahead_t *ra, squash_reg_inode_t *inode,
+                                    uint32_t block_idx, uint32_t nblocks, uint64_t disk_offset,
+                                    const uint8_t **data, size_t *size);
+void squash_readahead_skip(squash_readahead_t *ra, squash_reg_inode_t *inode, uint32_t block_idx);
+bool squash_readahead_contains(squash_readahead_t *ra, squash_reg_inode_t *inode, uint32_t block_idx);
+// Отмечает, что блоки до next_block прочитаны напрямую, и сбрасывает окно
+void squash_readahead_advance(squash_fs_t *fs, squash_readahead_t *ra, squash_reg_inode_t *inode, uint32_t next_block);
+
+// Потоки и синхронизация
+squash_error_t squash_thread_create(squash_thread_t *thread, void (*fn)(void *), void *arg);
+void squash_thread_join(squash_thread_t thread);
+void squash_mutex_init(squash_mutex_t *mutex);
+void squash_mutex_destroy(squash_mutex_t *mutex);
+void squash_mutex_lock(squash_mutex_t *mutex);
+void squash_mutex_unlock(squash_mutex_t *mutex);
+bool squash_mutex_trylock(squash_mutex_t *mutex); // false - занята другим потоком
+void squash_cond_init(squash_cond_t *cond);
+void squash_cond_destroy(squash_cond_t *cond);
+void squash_cond_wait(squash_cond_t *cond, squash_mutex_t *mutex);
+void squash_cond_signal(squash_cond_t *cond);
+void squash_cond_broadcast(squash_cond_t *cond);
+void squash_mutex_init_recursive(squash_mutex_t *mutex);
+uint32_t squash_cpu_count(void);
+squash_error_t squash_workers_create(uint32_t threads, squash_workers_t **workers);
+squash_error_t squash_workers_submit(squash_workers_t *workers, void (*fn)(void *), void *arg);
+uint32_t squash_workers_count(squash_workers_t *workers);
+// Выполняет оставшиеся задачи и останавливает потоки
+void squash_workers_destroy(squash_workers_t *workers);
+
+// Дожидается завершения асинхронных запросов образа и останавливает их пул (из squash_close)
+void squash_async_shutdown(squash_fs_t *fs);
+// Число блоков файла в block_list (хвост во фрагменте не считается)
+uint32_t squash_file_block_count(squash_fs_t *fs, squash_reg_inode_t *inode);
+
+// Пул декомпрессоров для рабочих потоков распаковки (squash_decoder_pool.c). Кодек с SQUASH_CODEC_THREAD_SAFE
+// общий - выдаётся fs->decompressor. Иначе поток получает свой декомпрессор: сначала из кэша потока без
+// блокировок, затем из общего списка свободных, затем новый копией fs->decompressor
+void squash_decoder_pool_init(squash_decoder_pool_t *pool);
+void squash_decoder_pool_destroy(squash_decoder_pool_t *pool);
+squash_decompressor_t *squash_decoder_pool_acquire(squash_fs_t *fs, bool *local);
+void squash_decoder_pool_release(squash_fs_t *fs, squash_decompressor_t *dec);
+// Возвращает декомпрессор в общий список, минуя кэш потока: для потоков, которые могут пережить образ
+void squash_decoder_pool_return(squash_fs_t *fs, squash_decompressor_t *dec);
+
+// Распаковывает независимые блоки; от parallel_decode_min_blocks блоков - вместе с пулом потоков.
+// Возвращает первую ошибку, результат каждого блока - в jobs[i].result
+squash_error_t squash_decode_blocks(squash_fs_t *fs, squash_decode_job_t *jobs, uint32_t count);
+
+// Конвейер извлечения больших файлов: чтение, распаковка и запись в разных потоках
+bool squash_extract_pipeline_enabled(squash_fs_t *fs, uint64_t file_size);
+squash_error_t squash_extract_pipeline(squash_fs_t *fs, squash_reg_inode_t *inode, uint64_t file_size,
+                                       squash_writer_t *writer);
+
+// Выходные файлы извлечения. SQUASH_ERROR_NOT_FOUND из squash_writer_open - нет каталога
+squash_error_t squash_writer_open(squash_writer_t *writer, const char *path, uint8_t *buffer, size_t capacity);
+// Место под size байт (не больше буфера) на текущей позиции; данные учитываются после squash_writer_commit
+squash_error_t squash_writer_reserve(squash_writer_t *writer, size_t size, uint8_t **data);
+void squash_writer_commit(squash_writer_t *writer, size_t size);
+squash_error_t squash_writer_write(squash_writer_t *writer, const void *data, size_t size);
+squash_error_t squash_writer_skip(squash_writer_t *writer, uint64_t size); // Дыра на месте sparse-блоков
+squash_error_t squash_writer_flush(squash_writer_t *writer);
+bool squash_writer_preallocate(squash_writer_t *writer, uint64_t size);
+// Копирует size байт образа с disk_offset на текущую позицию средствами ядра (только Linux).
+// false - не удалось, данные нужно записать обычным путём
+bool squash_writer_copy_image(squash_fs_t *fs, squash_writer_t *writer, uint64_t disk_offset, uint64_t size);
+// Сбрасывает буфер, задаёт размер file_size, восстанавливает права и время (attributes может быть NULL)
+squash_error_t squash_writer_close(squash_writer_t *writer, uint64_t file_size, const squash_base_inode_t *attributes);
+squash_error_t squash_restore_attributes(const char *path, const squash_base_inode_t *attributes);
+// Создаёт каталог path[0..len) вместе с родителями; created - уже созданные каталоги
+squash_error_t squash_created_dirs_init(squash_created_dirs_t *set, size_t initial_capacity);
+void squash_created_dirs_free(squash_created_dirs_t *set);
+squash_error_t squash_make_dirs(squash_created_dirs_t *created, const char *path, size_t len, uint64_t *made,
+                                uint64_t *hits);
+
+// Ввод-вывод: пакеты позиционных чтений (синхронно, пул потоков или io_uring)
+squash_error_t squash_io_create(FILE *file, squash_io_backend_t backend, uint32_t threads, uint32_t queue_depth,
+                                squash_io_t **io);
+void squash_io_destroy(squash_io_t *io);
+squash_io_backend_t squash_io_backend(squash_io_t *io);
+void squash_io_counters(squash_io_t *io, uint64_t *batches, uint64_t *requests);
+// Отправляет все заявки пакета; буферы заявок должны жить до завершения squash_io_wait
+squash_error_t squash_io_submit(squash_io_t *io, squash_io_batch_t *batch);
+// Ждёт завершения всех заявок пакета и возвращает первую ошибку
+squash_error_t squash_io_wait(squash_io_t *io, squash_io_batch_t *batch);
+squash_error_t squash_io_read(squash_io_t *io, squash_io_request_t *requests, size_t count);
+squash_error_t squash_pread(FILE *file, uint64_t offset, size_t size, void *buffer);
+SQUASH_API const char *squash_io_backend_name(squash_io_backend_t backend);
+
 //вспомогательные функции чтения данных 
+// (буферы, возвращаемые squash_read_metadata_block/squash_read_data_block, берутся из fs->buffer_pool
+//  и возвращаются через squash_buffer_pool_release)
+int squash_fseek(FILE *file, uint64_t offset); // 64-битное смещение от начала файла, 0 - успех
+int64_t squash_ftell(FILE *file);               // 64-битная позиция, -1 - ошибка
 squash_error_t read_fs_bytes(FILE *file, uint64_t start, size_t bytes, void *buffer);
 squash_error_t squash_read_metadata_block(squash_fs_t *fs, squash_off_t offset, uint8_t **uncompressed_data, size_t *uncompressed_size, size_t *compressed_size);
 squash_error_t squash_read_data_block(squash_fs_t *fs, squash_off_t offset,
                                      uint32_t compressed_size, bool is_compressed,
                                      uint8_t **uncompressed_data, size_t *uncompressed_size);
+// Слот частичной распаковки (squash_partial.c): блок распаковывается только до needed байт,
+// данные принадлежат fs->partial и действительны до следующего вызова
+squash_error_t squash_partial_read(squash_fs_t *fs, uint64_t disk_offset, uint32_t compressed_size,
+                                   size_t expected, size_t needed, const uint8_t **data, size_t *size);
+bool squash_partial_contains(squash_fs_t *fs, uint64_t disk_offset);
+void squash_partial_drop(squash_fs_t *fs);
+// Читает сжатые блоки [first, first + *count) одним запросом в fs->io_buffer (до следующего вызова);
+// *count уменьшается до числа блоков, уместившихся в max_coalesce_bytes
+squash_error_t squash_read_block_run(squash_fs_t *fs, const uint32_t *block_list, uint32_t first,
+                                     uint32_t *count, squash_off_t offset, const uint8_t **raw_data);
 squash_error_t read_n_bytes_from_metablocks(squash_fs_t *fs, uint64_t start_offset, size_t offset_in_block,
                                             size_t n_bytes, uint8_t *out_buf, uint64_t *next_offset);
 
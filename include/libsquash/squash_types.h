@@ -14,6 +14,7 @@
 #else
 #define SQUASH_API
 #include <endian.h>
+#include <pthread.h>
 #define squash_le16toh(x) le16toh(x)
 #define squash_le32toh(x) le32toh(x)
 #define squash_le64toh(x) le64toh(x)
@@ -32,6 +33,7 @@
 
 #define GET_LE16(p) ((uint16_t)(p)[0] | ((uint16_t)(p)[1] << 8))
 #define GET_LE32(p) ((uint32_t)(p)[0] | ((uint32_t)(p)[1] << 8) | ((uint32_t)(p)[2] << 16) | ((uint32_t)(p)[3] << 24))
+#define GET_LE64(p) ((uint64_t)GET_LE32(p) | ((uint64_t)GET_LE32((p) + 4) << 32))
 
 // Типы сжатия
 typedef enum
@@ -47,6 +49,120 @@ typedef enum
 // Структура декомпрессора
 typedef struct squash_decompressor squash_decompressor_t;
 
+// Фильтры BCJ образа XZ (squash_compressor_options_t.xz.filters)
+#define SQUASH_XZ_FILTER_X86 0x01
+#define SQUASH_XZ_FILTER_POWERPC 0x02
+#define SQUASH_XZ_FILTER_IA64 0x04
+#define SQUASH_XZ_FILTER_ARM 0x08
+#define SQUASH_XZ_FILTER_ARMTHUMB 0x10
+#define SQUASH_XZ_FILTER_SPARC 0x20
+#define SQUASH_XZ_FILTER_MASK 0x3F
+
+#define SQUASH_LZ4_LEGACY 1 // Единственная версия формата LZ4 в SquashFS
+#define SQUASH_LZ4_HC 0x1   // Образ сжат LZ4HC (на распаковку не влияет)
+#define SQUASH_LZO_ALGORITHMS 5 // lzo1x_1, lzo1x_1_11, lzo1x_1_12, lzo1x_1_15, lzo1x_999
+
+// Параметры кодека из блока сразу за суперблоком (флаг SQUASHFS_COMPRESSOR_OPTIONS).
+// Если блока нет, поля содержат значения mksquashfs по умолчанию
+typedef struct
+{
+    bool present; // Блок параметров был в образе
+    union
+    {
+        struct
+        {
+            uint32_t level;
+            uint16_t window_bits; // 8..15
+            uint16_t strategies;
+        } gzip;
+        struct
+        {
+            uint32_t dictionary_size;
+            uint32_t filters; // SQUASH_XZ_FILTER_*
+        } xz;
+        struct
+        {
+            uint32_t algorithm; // 0..SQUASH_LZO_ALGORITHMS-1
+            uint32_t level;
+        } lzo;
+        struct
+        {
+            uint32_t version; // SQUASH_LZ4_LEGACY
+            uint32_t flags;   // SQUASH_LZ4_HC
+        } lz4;
+        struct
+        {
+            uint32_t level;
+        } zstd;
+    };
+} squash_compressor_options_t;
+
+// Наибольший id кодека + 1: поле compression суперблока вне [1, SQUASH_MAX_CODEC_ID) не поддерживается
+#define SQUASH_MAX_CODEC_ID 32
+
+// Возможности кодека (squash_codec_t.flags)
+#define SQUASH_CODEC_THREAD_SAFE 0x1 // decompress можно вызывать из нескольких потоков с одним контекстом
+#define SQUASH_CODEC_PARTIAL 0x2     // Есть decompress_partial: распаковка только начала блока
+
+// Кодек блоков (squash_register_codec). Выбирается по полю compression суперблока при открытии образа.
+// Функции возвращают squash_error_t
+typedef struct
+{
+    const char *name;
+    uint16_t id;    // Поле compression суперблока (SQUASH_COMPRESSION_* или своё)
+    uint32_t flags; // SQUASH_CODEC_*
+    // Создаёт контекст под параметры образа; options == NULL - параметры ещё не прочитаны. Может быть NULL
+    int (*init)(const squash_compressor_options_t *options, void **context);
+    // Распаковывает блок целиком: *dst_size - на входе ёмкость dst, на выходе размер данных
+    int (*decompress)(void *context, const void *src, size_t src_size, void *dst, size_t *dst_size);
+    // Распаковывает не меньше target байт (SQUASH_CODEC_PARTIAL). *stream хранит поток между вызовами
+    // с теми же src и dst; если после вызова он NULL, следующий вызов начинает блок заново
+    int (*decompress_partial)(void *context, void **stream, const void *src, size_t src_size, void *dst,
+                              size_t target, size_t capacity, size_t *produced, bool *complete);
+    // Освобождает *stream. Может быть NULL - тогда decompress_partial обязан оставлять *stream == NULL (как lz4)
+    void (*partial_free)(void *stream);
+    void (*destroy)(void *context);
+} squash_codec_t;
+
+// Распаковщик блоков GZIP
+typedef enum
+{
+    SQUASH_GZIP_AUTO = 0,       // libdeflate, если библиотека собрана с ним, иначе zlib
+    SQUASH_GZIP_ZLIB = 1,       // Потоковый inflate из zlib
+    SQUASH_GZIP_LIBDEFLATE = 2  // Однопроходный libdeflate (сборка с SQUASH_WITH_LIBDEFLATE), zlib - запасной
+} squash_gzip_backend_t;
+
+// Поток частичной распаковки блока (squash_decompress_block_partial)
+typedef struct squash_partial squash_partial_t;
+
+// Примитивы потоков (pthreads или Win32)
+#ifdef _WIN32
+typedef HANDLE squash_thread_t;
+typedef CRITICAL_SECTION squash_mutex_t;
+typedef CONDITION_VARIABLE squash_cond_t;
+#else
+typedef pthread_t squash_thread_t;
+typedef pthread_mutex_t squash_mutex_t;
+typedef pthread_cond_t squash_cond_t;
+#endif
+
+// Пул рабочих потоков (squash_thread.c)
+typedef struct squash_workers squash_workers_t;
+
+// Индекс-спутник образа, отображённый в память (squash_index.c)
+typedef struct squash_index squash_index_t;
+
+// Асинхронный запрос (squash_async.c)
+typedef struct squash_request squash_request_t;
+
+// Внешний исполнитель задач для асинхронных запросов (например, пул потоков event loop'а).
+// submit должен когда-нибудь выполнить task(arg) в любом потоке и вернуть 0 при успехе
+typedef struct
+{
+    int (*submit)(void *context, void (*task)(void *), void *arg);
+    void *context;
+} squash_executor_t;
+
 // Основные типы данных SquashFS
 typedef uint64_t squash_off_t;
 typedef uint32_t squash_size_t;
@@ -109,14 +225,17 @@ typedef struct {
 } squash_base_inode_t; // 16 байт
 
 // Структура файла
+// Поля хранятся в 64 битах для обоих типов: у расширенного inode start_block и file_size 64-битные
 typedef struct {
     squash_base_inode_t base; // 16
-    uint32_t start_block;     // 4
+    uint64_t start_block;     // 8
+    uint64_t file_size;       // 8
     uint32_t fragment;        // 4
     uint32_t offset;          // 4
-    uint32_t file_size;       // 4
     uint32_t *block_list;     // 8 (указатель, не на диске)
-} squash_reg_inode_t; // 40 байт в памяти, 16 байт на диске
+    uint64_t sparse;          // 8 Байт в sparse-блоках (есть только у расширенного inode, иначе 0)
+    uint32_t nlink;           // 4 Число жёстких ссылок (у обычного inode всегда 1)
+} squash_reg_inode_t; // 64 байта в памяти, 16 байт на диске
 
 // Структура директории
 typedef struct
@@ -187,11 +306,14 @@ typedef struct squash_dir_entry_t
     char *name;  // Имя файла/папки (ASCIIZ)
 } squash_dir_entry_t;
 
+struct squash_arena_t;
+
 typedef struct
 {
     squash_dir_entry_t **entries;
     size_t count;
     size_t capacity;
+    struct squash_arena_t *arena; // Если не NULL - список и записи выделяются из арены
 } dir_entries_list_t;
 
 struct squashfs_fragment_entry
@@ -201,22 +323,432 @@ struct squashfs_fragment_entry
     uint32_t unused;
 };
 
+// Пул переиспользуемых буферов размером с блок (сжатые и распакованные данные).
+// Один на образ и без своей блокировки: публичные вызовы выполняются под fs->lock, поэтому к пулу
+// одновременно обращается только один поток. Рабочие потоки распаковки и конвейера его не трогают:
+// их буферы выделяет вызывающий
+typedef struct
+{
+    uint8_t **free_list;
+    size_t free_count;
+    size_t free_capacity;
+    size_t buffer_size;
+    size_t allocated;  // Всего выделено буферов
+    size_t in_use;     // Сейчас выдано
+    size_t high_water; // Максимум одновременно выданных
+} squash_buffer_pool_t;
+
+// Кэш блоков с политикой 2Q (squash_cache.c). Ключ - смещение блока в образе.
+// Новый блок попадает во вводную очередь (FIFO); вытесненный из неё оставляет ключ-«призрак», и только
+// повторное обращение к призраку переносит блок в основную очередь (LRU). Однократный проход по образу
+// вытесняет лишь вводную очередь
+typedef enum
+{
+    SQUASH_CACHE_IN = 0,    // Вводная очередь
+    SQUASH_CACHE_MAIN = 1,  // Основная очередь
+    SQUASH_CACHE_GHOST = 2  // Только ключ недавно вытесненного из вводной очереди блока
+} squash_cache_queue_t;
+
+typedef struct squash_cache_entry
+{
+    uint64_t key;
+    size_t size;
+    uint32_t aux;                         // Сведения о блоке для вызывающего (размер на диске, заголовок)
+    uint8_t queue;                        // squash_cache_queue_t
+    bool no_ghost;                        // Прочитан с SQUASH_READ_NOCACHE: вытесняется бесследно
+    struct squash_cache_entry *hash_next; // Цепочка корзины
+    struct squash_cache_entry *prev;      // Список очереди: prev - более свежий
+    struct squash_cache_entry *next;
+    uint8_t data[];
+} squash_cache_entry_t;
+
+typedef struct
+{
+    squash_cache_entry_t *head; // Последний добавленный или использованный
+    squash_cache_entry_t *tail; // Первый кандидат на вытеснение
+    size_t count;
+    size_t bytes;
+} squash_cache_list_t;
+
+typedef struct
+{
+    squash_cache_entry_t **buckets;
+    size_t bucket_count; // Степень двойки
+    squash_cache_list_t queues[3]; // По squash_cache_queue_t
+    size_t capacity;     // Предел байт вместе с заголовками записей (<= 1 - кэш выключен)
+    size_t bytes;        // Вводная и основная очереди
+    size_t entries;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t promotions; // Блоков, перенесённых в основную очередь повторным обращением
+    size_t *owner_bytes; // Общий кэш: байт каждого образа (по ключу >> SQUASH_CACHE_OWNER_SHIFT), иначе NULL
+    uint32_t owner_slots;
+    uint32_t owners;     // Подключено образов
+} squash_block_cache_t;
+
+// Ключ общего кэша: номер образа, уровень и смещение блока в образе.
+// Блоки дальше SQUASH_CACHE_MAX_OFFSET в общем кэше не хранятся
+#define SQUASH_CACHE_OWNER_SHIFT 48
+#define SQUASH_CACHE_TIER_SHIFT 47
+#define SQUASH_CACHE_MAX_OFFSET (1ULL << SQUASH_CACHE_TIER_SHIFT)
+#define SQUASH_CACHE_MAX_OWNERS (1u << (64 - SQUASH_CACHE_OWNER_SHIFT))
+
+// Уровни кэша блоков образа
+typedef enum
+{
+    SQUASH_CACHE_TIER_BLOCKS = 0,    // Распакованные блоки (block_cache)
+    SQUASH_CACHE_TIER_COMPRESSED = 1 // Сжатые байты (compressed_cache)
+} squash_cache_tier_t;
+
+// Общий кэш блоков нескольких образов (squash_cache_create, squash_open_options_t.cache).
+// Один бюджет памяти на все образы и оба уровня; при вытеснении первыми уходят блоки образов,
+// занявших больше равной доли
+typedef struct squash_cache
+{
+    squash_mutex_t lock;
+    squash_block_cache_t blocks;
+    bool *attached; // Занятые номера образов, owner_slots штук
+    uint32_t refs;  // Создатель и подключённые образы: память освобождает последний
+} squash_cache_t;
+
+// Декомпрессоры рабочих потоков распаковки (squash_decoder_pool_acquire)
+typedef struct
+{
+    squash_mutex_t lock;
+    squash_decompressor_t **all;       // Все созданные, освобождаются вместе с пулом
+    size_t count;
+    size_t capacity;
+    squash_decompressor_t **free_list; // Возвращённые мимо кэша потока
+    size_t free_count;
+    uint64_t local_hits;      // Выдано из кэша потока
+    uint64_t shared_acquires; // Выдано через общий список (с блокировкой)
+    uint64_t contended;       // Общий список был занят другим потоком
+} squash_decoder_pool_t;
+
+// Состояние упреждающего чтения (read-ahead) для последовательного чтения файла
+typedef struct
+{
+    uint64_t file_start;     // start_block файла, которому принадлежит окно
+    uint32_t inode_number;
+    uint32_t next_block;     // Ожидаемый индекс блока при последовательном чтении
+    bool next_valid;
+    uint32_t window;         // Текущий размер окна K (адаптивный)
+    uint32_t max_window;
+    uint32_t first_block;    // Индекс первого блока в окне
+    uint32_t count;          // Блоков в окне
+    uint32_t consumed;       // Сколько блоков окна уже отдано читателю
+    uint8_t **blocks;        // Распакованные блоки окна (из пула буферов)
+    size_t *sizes;
+    uint64_t windows_issued; // Статистика
+    uint64_t blocks_prefetched;
+    uint64_t hits;
+    uint64_t wasted;
+} squash_readahead_t;
+
+// Способ чтения образа
+typedef enum
+{
+    SQUASH_IO_SYNC = 0,    // Блокирующее чтение в вызывающем потоке
+    SQUASH_IO_THREADS = 1, // Пул потоков с позиционным чтением (pread)
+    SQUASH_IO_URING = 2,   // io_uring (Linux, сборка с liburing)
+    SQUASH_IO_AUTO = 3     // io_uring, если доступен, иначе пул потоков
+} squash_io_backend_t;
+
+// Контекст ввода-вывода (squash_io.c)
+typedef struct squash_io squash_io_t;
+
+// Одна заявка на чтение
+typedef struct squash_io_request
+{
+    uint64_t offset;
+    size_t size;
+    void *buffer;
+    size_t done;           // Прочитано байт (заявка может выполняться частями)
+    int result;            // squash_error_t
+    struct squash_io_batch *batch;
+    struct squash_io_request *retry_next; // io_uring: повтор ждёт свободного места в кольце
+    bool inflight;         // io_uring: заявка отправлена в кольцо, завершение ещё не забрано
+} squash_io_request_t;
+
+// Пакет заявок: отправляется целиком (squash_io_submit), завершения собираются squash_io_wait
+typedef struct squash_io_batch
+{
+    squash_io_request_t *requests;
+    size_t count;
+    size_t next;      // Первая ещё не отправленная заявка
+    size_t completed; // Завершено заявок
+    struct squash_io_batch *queue_next;
+} squash_io_batch_t;
+
+// Задание распаковки одного блока данных (squash_decode_blocks)
+typedef struct
+{
+    const uint8_t *src;
+    uint32_t src_size;  // 0 - sparse-блок, ничего не делается
+    bool compressed;
+    uint8_t *dst;
+    size_t dst_capacity;
+    size_t out_size;
+    int result;         // squash_error_t
+} squash_decode_job_t;
+
+// Частично распакованный блок данных (squash_partial_read): поток кодека остановлен
+// после нужного префикса и продолжается, если следующее чтение попросит больше
+typedef struct
+{
+    uint64_t disk_offset;    // Смещение сжатого блока на диске (ключ)
+    uint8_t *compressed;     // Сжатые данные (буфер пула), живут вместе с потоком
+    uint32_t compressed_size;
+    uint8_t *data;           // Распакованный префикс (буфер пула) или NULL, если слот пуст
+    size_t size;             // Распаковано байт
+    squash_partial_t *state; // Состояние кодека или NULL, если блок распакован до конца
+    bool complete;
+} squash_partial_block_t;
+
+// Выходной файл извлечения (squash_writer_*): данные копятся в буфере и пишутся по смещению
+typedef struct
+{
+    int fd;
+    const char *path;
+    uint8_t *buffer;    // Общий буфер извлечения, принадлежит вызывающему
+    size_t capacity;
+    size_t used;
+    uint64_t offset;    // Позиция в файле начала буфера
+    uint64_t writes;    // Вызовов записи
+} squash_writer_t;
+
+// Флаги извлечения (squash_open_options_t.extract_flags)
+#define SQUASH_EXTRACT_PREALLOCATE 0x1   // Выделять место под файл заранее (fallocate), кроме файлов с дырами
+#define SQUASH_EXTRACT_NO_ATTRIBUTES 0x2 // Не восстанавливать права и время изменения
+
+// Буфер записи при извлечении по умолчанию
+#define SQUASH_DEFAULT_EXTRACT_BUFFER_SIZE (1024 * 1024)
+
+// Максимальный размер одного объединённого чтения подряд идущих блоков по умолчанию
+#define SQUASH_DEFAULT_MAX_COALESCE_BYTES (4u * 1024 * 1024)
+
+// Размеры кэшей блоков по умолчанию
+#define SQUASH_DEFAULT_BLOCK_CACHE_BYTES (8u * 1024 * 1024)
+#define SQUASH_DEFAULT_COMPRESSED_CACHE_BYTES (4u * 1024 * 1024)
+#define SQUASH_DEFAULT_SHARED_CACHE_BYTES (64u * 1024 * 1024)
+
+// Флаги чтения (squash_read_file_ex, squash_file_set_flags)
+#define SQUASH_READ_NOCACHE 0x1 // Однократное чтение: блоки не вытесняют из кэшей повторно используемые
+
+// Параметры открытия образа (squash_open_ex); нулевые поля означают значения по умолчанию
+typedef struct
+{
+    size_t max_coalesce_bytes;     // Предел одного чтения подряд идущих сжатых блоков
+    uint32_t readahead_max_window; // Максимальное окно read-ahead (блоков)
+    squash_io_backend_t io_backend;
+    uint32_t io_threads;           // Потоков для SQUASH_IO_THREADS (0 - по числу процессоров)
+    uint32_t io_queue_depth;       // Глубина очереди io_uring
+    squash_executor_t executor;    // Исполнитель асинхронных запросов (по умолчанию - свой пул)
+    uint32_t async_threads;        // Потоков собственного пула (0 - по числу процессоров)
+    uint32_t decode_threads;       // Потоков распаковки больших чтений (0 - по числу процессоров, 1 - без пула)
+    uint32_t parallel_decode_min_blocks; // Меньшие серии блоков распаковываются в вызывающем потоке (0 - 4)
+    uint32_t extract_pipeline_slots;  // Сегментов в очередях конвейера извлечения (0 - 4, 1 - без конвейера)
+    size_t extract_buffer_size;    // Буфер записи при извлечении (0 - 1 МиБ, не меньше блока)
+    uint32_t extract_flags;        // SQUASH_EXTRACT_*
+    squash_gzip_backend_t gzip_backend; // Распаковщик образов GZIP
+    size_t block_cache_bytes;      // Кэш распакованных блоков данных и метаданных (0 - 8 МиБ, 1 - выключен)
+    size_t compressed_cache_bytes; // Кэш сжатых байт этих блоков, как они прочитаны с диска (0 - 4 МиБ, 1 - выключен)
+    squash_cache_t *cache;         // Общий кэш вместо двух своих (block_cache_bytes и compressed_cache_bytes не действуют)
+    const char *index_path;        // Индекс-спутник (squash_index_build); построенный для другого образа не используется
+} squash_open_options_t;
+
+// Статистика работы с образом
+typedef struct
+{
+    size_t buffer_size;
+    size_t buffer_pool_allocated;
+    size_t buffer_pool_in_use;
+    size_t buffer_pool_high_water;
+    uint32_t readahead_window;        // Текущий размер окна read-ahead (блоков)
+    uint64_t readahead_windows;       // Сколько раз выполнялось упреждающее чтение
+    uint64_t readahead_blocks;        // Блоков прочитано заранее
+    uint64_t readahead_hits;          // Блоков отдано из окна
+    uint64_t readahead_wasted;        // Блоков прочитано заранее, но не использовано
+    size_t max_coalesce_bytes;        // Предел объединённого чтения
+    uint64_t coalesced_reads;         // Объединённых чтений блоков данных
+    uint64_t coalesced_blocks;        // Блоков прочитано объединёнными чтениями
+    squash_io_backend_t io_backend;   // Фактически используемый способ чтения
+    squash_gzip_backend_t gzip_backend; // Фактически используемый распаковщик GZIP
+    const char *codec_name;           // Кодек блоков образа
+    uint64_t io_batches;              // Отправлено пакетов заявок
+    uint64_t io_requests;             // Выполнено заявок на чтение
+    uint64_t parallel_decodes;        // Серий блоков, распакованных пулом потоков
+    uint64_t parallel_decode_blocks;  // Блоков в этих сериях
+    uint64_t zero_copy_bytes;         // Байт несжатых блоков, скопированных при извлечении в обход буферов
+    uint64_t hardlinks_linked;        // Повторных жёстких ссылок, созданных через link()
+    uint64_t hardlinks_copied;        // Повторных жёстких ссылок, скопированных с первой копии
+    uint64_t pipeline_files;          // Файлов, извлечённых конвейером
+    uint64_t pipeline_segments;       // Сегментов, прошедших через конвейер
+    uint64_t pipeline_read_waits;     // Чтение ждало свободный сегмент (медленнее распаковка или запись)
+    uint64_t pipeline_decode_waits;   // Распаковка ждала прочитанных данных (медленнее чтение)
+    uint64_t pipeline_write_waits;    // Запись ждала распакованных данных (медленнее чтение или распаковка)
+    uint32_t pipeline_max_depth;      // Наибольшее число сегментов в очередях одновременно
+    uint64_t extract_files;           // Извлечено файлов (без повторных жёстких ссылок)
+    uint64_t extract_write_calls;     // Системных вызовов записи при извлечении
+    uint64_t extract_dirs_created;    // Создано каталогов
+    uint64_t extract_dir_cache_hits;  // Проверок каталога, обошедшихся без mkdir
+    uint64_t partial_decodes;         // Блоков, распакованных только до нужного префикса
+    uint64_t partial_resumes;         // Продолжений частичной распаковки более длинным чтением
+    uint32_t decoder_pool_size;       // Декомпрессоров рабочих потоков (0 - кодек потокобезопасен)
+    uint32_t decoder_pool_free;       // Из них в общем списке свободных
+    uint64_t decoder_pool_local_hits; // Выдано из кэша потока без блокировки
+    uint64_t decoder_pool_shared;     // Выдано через общий список
+    uint64_t decoder_pool_contended;  // Общий список был занят другим потоком
+    size_t block_cache_capacity;      // Кэш распакованных блоков: предел, занято байт, блоков
+    size_t block_cache_bytes;
+    size_t block_cache_entries;
+    uint64_t block_cache_hits;
+    uint64_t block_cache_misses;
+    uint64_t block_cache_evictions;
+    uint64_t block_cache_promotions;
+    size_t compressed_cache_capacity; // Кэш сжатых блоков: промах распакованного стоит распаковки, а не чтения
+    size_t compressed_cache_bytes;
+    size_t compressed_cache_entries;
+    uint64_t compressed_cache_hits;
+    uint64_t compressed_cache_misses;
+    uint64_t compressed_cache_evictions;
+    uint64_t compressed_cache_promotions;
+    // Общий кэш (options.cache): hits и misses уровней выше считают обращения этого образа
+    size_t shared_cache_capacity;
+    size_t shared_cache_bytes;        // Все образы
+    size_t shared_cache_entries;
+    size_t shared_cache_image_bytes;  // Блоки этого образа
+    uint32_t shared_cache_images;
+    uint64_t shared_cache_evictions;
+    uint64_t shared_cache_promotions;
+    bool index_loaded;                // Образ открыт с индексом-спутником
+    uint64_t index_path_hits;         // Путей найдено по индексу, без обхода директорий
+    uint64_t index_inode_hits;        // Инодов взято из индекса, без чтения таблицы инодов
+    size_t path_index_entries;        // Путей в таблице squash_build_path_index, 0 - не построена
+    size_t path_index_bytes;
+    uint64_t path_index_hits;         // Путей найдено по ней
+} squash_stats_t;
+
+// Таблица всех путей образа в памяти (squash_build_path_index)
+typedef struct
+{
+    uint64_t hash;
+    squash_off_t inode_ref;
+    size_t name_offset; // Путь "/a/b" в names
+    uint32_t name_size;
+    uint16_t type;
+} squash_path_entry_t;
+
+typedef struct
+{
+    squash_path_entry_t *entries; // В порядке обхода в ширину
+    size_t count;
+    size_t capacity;
+    char *names;
+    size_t names_size;
+    size_t names_capacity;
+    uint32_t *slots;              // Хеш-таблица: номер записи + 1, 0 - пусто; NULL - таблица не построена
+    size_t slot_count;            // Степень двойки
+} squash_path_index_t;
+
 // Основная структура для работы с образом
 typedef struct squash_fs
 {
     FILE *file;
     squash_super_t super;
     squash_decompressor_t *decompressor;
+    squash_compressor_options_t compressor_options;
+    squash_buffer_pool_t buffer_pool;
+    squash_block_cache_t block_cache;      // Распакованные блоки
+    squash_block_cache_t compressed_cache; // Сжатые блоки: второй уровень под block_cache
+    squash_cache_t *shared_cache;          // options.cache, пока образ к нему подключён
+    uint32_t cache_owner;                  // Номер образа в общем кэше
+    uint32_t read_flags;                   // SQUASH_READ_* текущего вызова (под lock)
+    squash_index_t *index;                 // options.index_path, если подошёл к образу
+    uint64_t index_path_hits;
+    uint64_t index_inode_hits;
+    squash_path_index_t path_index;        // squash_build_path_index
+    uint64_t path_index_hits;
+    squash_readahead_t readahead;
+    squash_open_options_t options;
+    squash_mutex_t lock;       // Рекурсивная блокировка образа: публичные вызовы выполняются по одному
+    squash_workers_t *async_workers; // Создаётся при первом асинхронном запросе
+    squash_mutex_t async_lock;
+    squash_cond_t async_idle;
+    uint32_t async_pending;    // Незавершённых асинхронных запросов
+    squash_workers_t *decode_workers; // Пул параллельной распаковки (создаётся при первом большом чтении)
+    squash_decoder_pool_t decoder_pool; // Декомпрессоры его потоков
+    uint64_t parallel_decodes;
+    uint64_t parallel_decode_blocks;
+    squash_io_t *io;
+    uint8_t *io_buffer;        // Буфер объединённого чтения сжатых блоков
+    size_t io_capacity;
+    uint64_t coalesced_reads;
+    uint64_t coalesced_blocks;
+    uint64_t zero_copy_bytes;
+    uint64_t hardlinks_linked;
+    uint64_t hardlinks_copied;
+    uint64_t pipeline_files;
+    uint64_t pipeline_segments;
+    uint64_t pipeline_read_waits;
+    uint64_t pipeline_decode_waits;
+    uint64_t pipeline_write_waits;
+    uint32_t pipeline_max_depth;
+    uint64_t extract_files;
+    uint64_t extract_write_calls;
+    uint64_t extract_dirs_created;
+    uint64_t extract_dir_cache_hits;
+    squash_partial_block_t partial; // Последний частично распакованный блок
+    uint64_t partial_decodes;
+    uint64_t partial_resumes;
     struct squashfs_fragment_entry *fragment_table;
     uint64_t *inode_lookup_table;
     uint32_t *id_table;
     char *filename;
 } squash_fs_t;
 
+// Открытый файл образа (squash_file_open): позиция, таблица смещений блоков на диске,
+// последний распакованный блок, распакованный хвост из фрагмента и своё окно read-ahead
+typedef struct squash_file
+{
+    squash_fs_t *fs;
+    squash_reg_inode_t *inode;
+    uint64_t position;
+    uint32_t nblocks;
+    uint64_t *block_offsets; // Смещение каждого блока на диске (nblocks + 1 элементов)
+    uint32_t last_block;     // Индекс блока в last_data
+    uint8_t *last_data;      // Последний прочитанный напрямую блок (буфер пула) или NULL
+    size_t last_size;
+    uint8_t *fragment_data;  // Блок фрагмента с хвостом файла (буфер пула) или NULL
+    size_t fragment_size;
+    squash_readahead_t readahead;
+    uint32_t read_flags;     // SQUASH_READ_* для всех чтений через handle
+} squash_file_t;
+
+// Арена для множества мелких выделений (записи директорий, иноды).
+// Всё, что выделено из арены, освобождается одним вызовом squash_arena_reset/destroy.
+struct squash_arena_chunk;
+typedef struct squash_arena_t
+{
+    struct squash_arena_chunk *head;  // Текущий chunk
+    struct squash_arena_chunk *spare; // Освобождённые chunk'и для повторного использования
+    size_t chunk_size;
+    size_t bytes_reserved;
+} squash_arena_t;
+
+// Позиция в арене для отката (squash_arena_rewind)
+typedef struct
+{
+    struct squash_arena_chunk *chunk;
+    size_t used;
+} squash_arena_mark_t;
+
 // Структура для итерации по директории
 typedef struct
 {
     squash_fs_t *fs;
+    squash_arena_t *arena; // Если не NULL - записи принадлежат арене
     squash_dir_inode_t *dir_inode;
     uint8_t *uncompressed_data;
     size_t uncompressed_size;
@@ -228,11 +760,41 @@ typedef struct
     bool finished;
 } squash_dir_iterator_t;
 
+// Множество посещённых инодов (хеш-таблица с открытой адресацией)
 typedef struct
 {
-    squash_off_t *inodes;
-    size_t count;
-    size_t capacity;
+    squash_off_t *inodes; // Ячейки таблицы, пустые равны UINT64_MAX
+    size_t count;         // Количество элементов
+    size_t capacity;      // Размер таблицы (степень двойки)
 } squash_visited_inodes_t;
 
+// Уже извлечённые файлы с несколькими жёсткими ссылками: номер inode -> путь первой копии
+typedef struct
+{
+    uint32_t inode_number; // 0 - пустая ячейка (номера inode начинаются с 1)
+    char *path;
+} squash_hardlink_entry_t;
+
+typedef struct
+{
+    squash_hardlink_entry_t *entries; // Хеш-таблица с открытой адресацией
+    size_t count;
+    size_t capacity;                  // Степень двойки
+} squash_hardlinks_t;
+
+// Каталоги, уже созданные при извлечении (squash_make_dirs)
+typedef struct
+{
+    uint64_t hash; // squash_path_hash, 0 - пустая ячейка
+    char *path;
+    size_t len;
+} squash_created_dir_t;
+
+typedef struct
+{
+    squash_created_dir_t *entries; // Хеш-таблица с открытой адресацией
+    size_t count;
+    size_t capacity;               // Степень двойки
+} squash_created_dirs_t;
+
 #endif // SQUASH_TYPES_H
\ No newline at end of file
@@ -0,0 +1,129 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../include/libsquash/squash.h"
+
+#define SQUASH_ARENA_DEFAULT_CHUNK (64 * 1024)
+#define SQUASH_ARENA_ALIGN 16
+
+struct squash_arena_chunk
+{
+    struct squash_arena_chunk *next; // Более старый chunk
+    size_t size;                     // Размер области данных
+    size_t used;
+};
+
+#define CHUNK_HEADER_SIZE ((sizeof(struct squash_arena_chunk) + SQUASH_ARENA_ALIGN - 1) & ~(size_t)(SQUASH_ARENA_ALIGN - 1))
+#define CHUNK_DATA(c) ((uint8_t *)(c) + CHUNK_HEADER_SIZE)
+
+SQUASH_API squash_arena_t *squash_arena_create(size_t chunk_size)
+{
+    squash_arena_t *arena = malloc(sizeof(squash_arena_t));
+    if (!arena)
+        return NULL;
+    memset(arena, 0, sizeof(squash_arena_t));
+    arena->chunk_size = chunk_size ? chunk_size : SQUASH_ARENA_DEFAULT_CHUNK;
+    return arena;
+}
+
+static void free_chunks(struct squash_arena_chunk *chunk)
+{
+    while (chunk)
+    {
+        struct squash_arena_chunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+SQUASH_API void squash_arena_destroy(squash_arena_t *arena)
+{
+    if (!arena)
+        return;
+    free_chunks(arena->head);
+    free_chunks(arena->spare);
+    free(arena);
+}
+
+// Возвращает chunk в список запасных; большие (нестандартные) chunk'и освобождаются сразу
+static void retire_chunk(squash_arena_t *arena, struct squash_arena_chunk *chunk)
+{
+    arena->bytes_reserved -= chunk->size;
+    if (chunk->size != arena->chunk_size)
+    {
+        free(chunk);
+        return;
+    }
+    chunk->used = 0;
+    chunk->next = arena->spare;
+    arena->spare = chunk;
+}
+
+SQUASH_API void squash_arena_reset(squash_arena_t *arena)
+{
+    if (!arena)
+        return;
+    while (arena->head)
+    {
+        struct squash_arena_chunk *next = arena->head->next;
+        retire_chunk(arena, arena->head);
+        arena->head = next;
+    }
+}
+
+SQUASH_API void *squash_arena_alloc(squash_arena_t *arena, size_t size)
+{
+    if (!arena)
+        return NULL;
+
+    size = (size + SQUASH_ARENA_ALIGN - 1) & ~(size_t)(SQUASH_ARENA_ALIGN - 1);
+    struct squash_arena_chunk *chunk = arena->head;
+    if (!chunk || chunk->size - chunk->used < size)
+    {
+        if (size <= arena->chunk_size && arena->spare)
+        {
+            chunk = arena->spare;
+            arena->spare = chunk->next;
+        }
+        else
+        {
+            size_t data_size = size > arena->chunk_size ? size : arena->chunk_size;
+            chunk = malloc(CHUNK_HEADER_SIZE + data_size);
+            if (!chunk)
+                return NULL;
+            chunk->size = data_size;
+            chunk->used = 0;
+        }
+        chunk->next = arena->head;
+        arena->head = chunk;
+        arena->bytes_reserved += chunk->size;
+    }
+
+    void *ptr = CHUNK_DATA(chunk) + chunk->used;
+    chunk->used += size;
+    return ptr;
+}
+
+SQUASH_API squash_arena_mark_t squash_arena_mark(squash_arena_t *arena)
+{
+    squash_arena_mark_t mark = {NULL, 0};
+    if (arena && arena->head)
+    {
+        mark.chunk = arena->head;
+        mark.used = arena->head->used;
+    }
+    return mark;
+}
+
+SQUASH_API void squash_arena_rewind(squash_arena_t *arena, squash_arena_mark_t mark)
+{
+    if (!arena)
+        return;
+    while (arena->head && arena->head != mark.chunk)
+    {
+        struct squash_arena_chunk *next = arena->head->next;
+        retire_chunk(arena, arena->head);
+        arena->head = next;
+    }
+    if (arena->head)
+        arena->head->used = mark.used;
+}
@@ -0,0 +1,518 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/libsquash/squash.h"
+
+typedef enum
+{
+    SQUASH_ASYNC_READ_FILE,
+    SQUASH_ASYNC_READ_INODE
+} squash_async_kind_t;
+
+struct squash_request
+{
+    squash_fs_t *fs;
+    squash_async_kind_t kind;
+    squash_reg_inode_t *file_inode;
+    void *buffer;
+    uint64_t offset;
+    size_t size;
+    squash_off_t inode_ref;
+    squash_completion_cb callback;
+    void *user_data;
+
+    squash_error_t result;
+    size_t bytes_read;
+    void *inode;
+
+    squash_mutex_t lock;
+    squash_cond_t cond;
+    bool done;
+    int refs; // Ссылки вызывающего и исполняющей задачи
+};
+
+static void request_unref(squash_request_t *req)
+{
+    squash_mutex_lock(&req->lock);
+    bool last = --req->refs == 0;
+    squash_mutex_unlock(&req->lock);
+    if (!last)
+        return;
+
+    if (req->inode)
+        squash_free_inode(req->inode);
+    squash_cond_destroy(&req->cond);
+    squash_mutex_destroy(&req->lock);
+    free(req);
+}
+
+static void async_finished(squash_fs_t *fs)
+{
+    squash_mutex_lock(&fs->async_lock);
+    if (--fs->async_pending == 0)
+        squash_cond_broadcast(&fs->async_idle);
+    squash_mutex_unlock(&fs->async_lock);
+}
+
+// Один блок файла в асинхронном чтении
+typedef struct
+{
+    uint64_t disk_offset;
+    uint32_t size;      // Сжатый размер на диске (0 - sparse-блок)
+    bool compressed;
+    bool ready;         // Данные уже в буфере пользователя (из кэша)
+    size_t expected;    // Распакованный размер блока
+    size_t skip;        // Начало нужных данных внутри блока
+    size_t want;        // Сколько байт блока нужно
+    uint8_t *dest;
+    uint8_t *raw;       // Прочитанные с диска байты
+    uint8_t *decoded;   // Распакованный блок целиком: в буфере пользователя или в scratch
+    size_t decoded_size;
+    uint8_t *scratch;   // Блок, нужный не целиком (первый и последний), распаковывается сюда
+} async_block_t;
+
+// Распаковывает прочитанные блоки декомпрессором из пула. Блок, нужный целиком, распаковывается сразу в буфер
+// пользователя, остальные - в свой scratch, который живёт до записи блока в кэш
+static squash_error_t async_decode_blocks(squash_fs_t *fs, async_block_t *blocks, uint32_t count, uint32_t first)
+{
+    uint32_t block_size = fs->super.block_size;
+    squash_decompressor_t *dec = NULL;
+    squash_error_t err = SQUASH_OK;
+
+    for (uint32_t i = 0; i < count && err == SQUASH_OK; i++)
+    {
+        async_block_t *b = &blocks[i];
+        if (b->ready)
+            continue;
+        if (b->size == 0)
+        {
+            memset(b->dest, 0, b->want);
+            continue;
+        }
+
+        bool direct = b->skip == 0 && b->want == b->expected;
+        if (!direct && !(b->scratch = malloc(block_size)))
+        {
+            err = SQUASH_ERROR_MEMORY;
+            break;
+        }
+        uint8_t *dst = direct ? b->dest : b->scratch;
+        size_t out_size = direct ? b->expected : block_size;
+        if (b->compressed)
+        {
+            bool local;
+            if (!dec && !(dec = squash_decoder_pool_acquire(fs, &local)))
+            {
+                err = SQUASH_ERROR_MEMORY;
+                break;
+            }
+            err = squash_decompress_block(dec, b->raw, b->size, dst, &out_size);
+        }
+        else if (b->size <= out_size)
+        {
+            memcpy(dst, b->raw, b->size);
+            out_size = b->size;
+        }
+        else
+        {
+            err = SQUASH_ERROR_INVALID_BLOCK;
+        }
+
+        if (err != SQUASH_OK)
+        {
+            fprintf(stderr, "Failed to unpack block %u at 0x%llx: %s\n", first + i,
+                    (unsigned long long)b->disk_offset, squash_strerror(err));
+        }
+        else if (direct ? out_size != b->expected : out_size < b->skip + b->want)
+        {
+            fprintf(stderr, "Failed to unpack block %u: size %zu, expected %zu\n", first + i, out_size,
+                    direct ? b->expected : b->skip + b->want);
+            err = SQUASH_ERROR_INVALID_FILE;
+        }
+        else
+        {
+            if (!direct)
+                memcpy(b->dest, b->scratch + b->skip, b->want);
+            b->decoded = dst;
+            b->decoded_size = out_size;
+        }
+    }
+
+    squash_decoder_pool_return(fs, dec);
+    return err;
+}
+
+// Прочитанные с диска блоки попадают в оба уровня кэша, как при синхронном чтении: следующее чтение
+// тех же блоков (в том числе синхронное) обойдётся без диска и распаковки
+static void async_cache_blocks(squash_fs_t *fs, async_block_t *blocks, uint32_t count)
+{
+    squash_mutex_lock(&fs->lock);
+    bool once = fs->read_flags & SQUASH_READ_NOCACHE;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        async_block_t *b = &blocks[i];
+        if (b->ready || !b->decoded)
+            continue;
+        if (b->compressed)
+            squash_fs_cache_put(fs, SQUASH_CACHE_TIER_COMPRESSED, b->disk_offset, b->raw, b->size, 0, once);
+        squash_fs_cache_put(fs, SQUASH_CACHE_TIER_BLOCKS, b->disk_offset, b->decoded, b->decoded_size, 0, once);
+    }
+    squash_mutex_unlock(&fs->lock);
+}
+
+// Чтение файла для асинхронного запроса. Под fs->lock - только кэш блоков и хвост из фрагмента: блоки читаются
+// через fs->io и распаковываются декомпрессором из пула, поэтому запросы выполняются параллельно.
+// Прочитанные блоки после распаковки записываются в кэш
+static squash_error_t async_read_file(squash_fs_t *fs, squash_reg_inode_t *inode, uint8_t *dest,
+                                      uint64_t offset, size_t size, size_t *bytes_read)
+{
+    uint32_t block_size = fs->super.block_size;
+    bool regular = inode->base.inode_type == SQUASHFS_REG_TYPE || inode->base.inode_type == SQUASHFS_LREG_TYPE;
+    uint32_t nblocks = regular ? squash_file_block_count(fs, inode) : 0;
+    uint64_t blocks_end = MIN(inode->file_size, (uint64_t)nblocks * block_size);
+    if (!regular || !inode->block_list || offset >= blocks_end || size == 0)
+    {
+        // Проверки, ошибки и файлы из одного фрагмента - обычным путём
+        return squash_read_file(fs, inode, dest, offset, size, bytes_read);
+    }
+
+    *bytes_read = 0;
+    size_t to_read = (size_t)MIN((uint64_t)size, inode->file_size - offset);
+    size_t in_blocks = (size_t)MIN((uint64_t)to_read, blocks_end - offset);
+    uint32_t first = (uint32_t)(offset / block_size);
+    uint32_t count = (uint32_t)((offset + in_blocks - 1) / block_size) - first + 1;
+
+    async_block_t *blocks = calloc(count, sizeof(async_block_t));
+    squash_io_request_t *requests = calloc(count, sizeof(squash_io_request_t));
+    if (!blocks || !requests)
+    {
+        free(blocks);
+        free(requests);
+        return SQUASH_ERROR_MEMORY;
+    }
+
+    // Смещения блоков на диске; inode и суперблок после открытия не меняются
+    uint64_t disk = inode->start_block;
+    for (uint32_t i = 0; i < first; i++)
+    {
+        disk += inode->block_list[i] & ((1 << 24) - 1);
+    }
+    squash_error_t err = SQUASH_OK;
+    size_t out = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        async_block_t *b = &blocks[i];
+        uint32_t block = inode->block_list[first + i];
+        b->disk_offset = disk;
+        b->size = block & ((1 << 24) - 1);
+        b->compressed = !(block & (1 << 24));
+        b->expected = (size_t)MIN((uint64_t)block_size, inode->file_size - (uint64_t)(first + i) * block_size);
+        b->skip = i == 0 ? (size_t)(offset % block_size) : 0;
+        b->want = MIN(b->expected - b->skip, in_blocks - out);
+        b->dest = dest + out;
+        out += b->want;
+        disk += b->size;
+        if (b->size > block_size || (b->size == 0 && !b->compressed) || disk > fs->super.bytes_used)
+        {
+            fprintf(stderr, "Invalid block %u: size %u at 0x%llx\n", first + i, b->size,
+                    (unsigned long long)b->disk_offset);
+            err = SQUASH_ERROR_INVALID_FILE;
+            break;
+        }
+    }
+
+    // Блоки из кэша копируются сразу, остальные читаются одним пакетом: соседние блоки - одной заявкой
+    size_t total = 0;
+    if (err == SQUASH_OK)
+    {
+        squash_mutex_lock(&fs->lock);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            async_block_t *b = &blocks[i];
+            if (b->size == 0)
+                continue;
+            size_t cached_size = 0;
+            uint8_t *copy = NULL;
+            const uint8_t *data = squash_fs_cache_peek(fs, SQUASH_CACHE_TIER_BLOCKS, b->disk_offset, &cached_size,
+                                                       NULL, &copy);
+            if (data && cached_size >= b->skip + b->want)
+            {
+                memcpy(b->dest, data + b->skip, b->want);
+                b->ready = true;
+            }
+            else
+            {
+                total += b->size;
+            }
+            squash_buffer_pool_release(&fs->buffer_pool, copy);
+        }
+        squash_mutex_unlock(&fs->lock);
+    }
+
+    uint8_t *raw = NULL;
+    if (err == SQUASH_OK && total > 0)
+    {
+        raw = malloc(total);
+        if (!raw)
+            err = SQUASH_ERROR_MEMORY;
+    }
+    if (err == SQUASH_OK && total > 0)
+    {
+        size_t nreq = 0;
+        size_t pos = 0;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            async_block_t *b = &blocks[i];
+            if (b->ready || b->size == 0)
+                continue;
+            b->raw = raw + pos;
+            squash_io_request_t *prev = nreq > 0 ? &requests[nreq - 1] : NULL;
+            if (prev && prev->offset + prev->size == b->disk_offset)
+            {
+                prev->size += b->size;
+            }
+            else
+            {
+                requests[nreq].offset = b->disk_offset;
+                requests[nreq].size = b->size;
+                requests[nreq].buffer = b->raw;
+                nreq++;
+            }
+            pos += b->size;
+        }
+#ifdef _WIN32
+        // ReadFile с OVERLAPPED сдвигает позицию файла, с которой читает fread под fs->lock
+        squash_mutex_lock(&fs->lock);
+#endif
+        err = squash_io_read(fs->io, requests, nreq);
+#ifdef _WIN32
+        squash_mutex_unlock(&fs->lock);
+#endif
+    }
+
+    if (err == SQUASH_OK)
+    {
+        err = async_decode_blocks(fs, blocks, count, first);
+    }
+    if (err == SQUASH_OK)
+    {
+        async_cache_blocks(fs, blocks, count);
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        free(blocks[i].scratch);
+    }
+    free(raw);
+    free(requests);
+    free(blocks);
+    if (err != SQUASH_OK)
+    {
+        return err;
+    }
+
+    *bytes_read = in_blocks;
+    if (to_read > in_blocks)
+    {
+        size_t tail = 0;
+        err = squash_read_file(fs, inode, dest + in_blocks, blocks_end, to_read - in_blocks, &tail);
+        *bytes_read += tail;
+    }
+    return err;
+}
+
+static void async_task(void *arg)
+{
+    squash_request_t *req = arg;
+    squash_fs_t *fs = req->fs;
+
+    switch (req->kind)
+    {
+    case SQUASH_ASYNC_READ_FILE:
+        req->result = async_read_file(fs, req->file_inode, req->buffer, req->offset, req->size, &req->bytes_read);
+        break;
+    case SQUASH_ASYNC_READ_INODE:
+        req->result = squash_read_inode(fs, req->inode_ref, &req->inode);
+        break;
+    }
+
+    if (req->callback)
+        req->callback(req, req->result, req->user_data);
+
+    squash_mutex_lock(&req->lock);
+    req->done = true;
+    squash_cond_broadcast(&req->cond);
+    squash_mutex_unlock(&req->lock);
+
+    request_unref(req);
+    async_finished(fs);
+}
+
+static squash_error_t async_submit(squash_fs_t *fs, squash_request_t *req)
+{
+    squash_executor_t *executor = &fs->options.executor;
+
+    squash_mutex_lock(&fs->async_lock);
+    if (!executor->submit && !fs->async_workers)
+    {
+        // Собственный пул создаётся лениво: синхронным пользователям потоки не нужны
+        squash_error_t err = squash_workers_create(fs->options.async_threads, &fs->async_workers);
+        if (err != SQUASH_OK)
+        {
+            squash_mutex_unlock(&fs->async_lock);
+            return err;
+        }
+    }
+    fs->async_pending++;
+    squash_mutex_unlock(&fs->async_lock);
+
+    squash_error_t err = SQUASH_OK;
+    if (executor->submit)
+    {
+        if (executor->submit(executor->context, async_task, req) != 0)
+            err = SQUASH_ERROR_MEMORY;
+    }
+    else
+    {
+        err = squash_workers_submit(fs->async_workers, async_task, req);
+    }
+
+    if (err != SQUASH_OK)
+        async_finished(fs);
+    return err;
+}
+
+static squash_request_t *request_create(squash_fs_t *fs, squash_async_kind_t kind,
+                                        squash_completion_cb callback, void *user_data)
+{
+    squash_request_t *req = calloc(1, sizeof(squash_request_t));
+    if (!req)
+        return NULL;
+    req->fs = fs;
+    req->kind = kind;
+    req->callback = callback;
+    req->user_data = user_data;
+    req->refs = 2;
+    squash_mutex_init(&req->lock);
+    squash_cond_init(&req->cond);
+    return req;
+}
+
+static void request_destroy_unsubmitted(squash_request_t *req)
+{
+    squash_cond_destroy(&req->cond);
+    squash_mutex_destroy(&req->lock);
+    free(req);
+}
+
+SQUASH_API squash_error_t squash_read_file_async(squash_fs_t *fs, squash_reg_inode_t *inode,
+                                                void *buffer, uint64_t offset, size_t size,
+                                                squash_completion_cb callback, void *user_data,
+                                                squash_request_t **request)
+{
+    if (!fs || !inode || !buffer || !request)
+    {
+        return SQUASH_ERROR_INVALID_ARGUMENT;
+    }
+
+    squash_request_t *req = request_create(fs, SQUASH_ASYNC_READ_FILE, callback, user_data);
+    if (!req)
+    {
+        return SQUASH_ERROR_MEMORY;
+    }
+    req->file_inode = inode;
+    req->buffer = buffer;
+    req->offset = offset;
+    req->size = size;
+
+    // До вызова callback задача может уже завершиться, поэтому handle отдаём заранее
+    *request = req;
+    squash_error_t err = async_submit(fs, req);
+    if (err != SQUASH_OK)
+    {
+        request_destroy_unsubmitted(req);
+        *request = NULL;
+    }
+    return err;
+}
+
+SQUASH_API squash_error_t squash_read_inode_async(squash_fs_t *fs, squash_off_t inode_ref,
+                                                 squash_completion_cb callback, void *user_data,
+                                                 squash_request_t **request)
+{
+    if (!fs || !request)
+    {
+        return SQUASH_ERROR_INVALID_ARGUMENT;
+    }
+
+    squash_request_t *req = request_create(fs, SQUASH_ASYNC_READ_INODE, callback, user_data);
+    if (!req)
+    {
+        return SQUASH_ERROR_MEMORY;
+    }
+    req->inode_ref = inode_ref;
+
+    *request = req;
+    squash_error_t err = async_submit(fs, req);
+    if (err != SQUASH_OK)
+    {
+        request_destroy_unsubmitted(req);
+        *request = NULL;
+    }
+    return err;
+}
+
+SQUASH_API squash_error_t squash_request_wait(squash_request_t *request)
+{
+    if (!request)
+    {
+        return SQUASH_ERROR_INVALID_ARGUMENT;
+    }
+    squash_mutex_lock(&request->lock);
+    while (!request->done)
+        squash_cond_wait(&request->cond, &request->lock);
+    squash_mutex_unlock(&request->lock);
+    return request->result;
+}
+
+SQUASH_API bool squash_request_done(squash_request_t *request)
+{
+    if (!request)
+        return false;
+    squash_mutex_lock(&request->lock);
+    bool done = request->done;
+    squash_mutex_unlock(&request->lock);
+    return done;
+}
+
+SQUASH_API size_t squash_request_bytes_read(squash_request_t *request)
+{
+    return request ? request->bytes_read : 0;
+}
+
+SQUASH_API void *squash_request_take_inode(squash_request_t *request)
+{
+    if (!request)
+        return NULL;
+    void *inode = request->inode;
+    request->inode = NULL;
+    return inode;
+}
+
+SQUASH_API void squash_request_free(squash_request_t *request)
+{
+    if (!request)
+        return;
+    request_unref(request);
+}
+
+void squash_async_shutdown(squash_fs_t *fs)
+{
+    // Образ закрывается только после завершения всех запросов, в том числе отданных внешнему исполнителю
+    squash_mutex_lock(&fs->async_lock);
+    while (fs->async_pending > 0)
+        squash_cond_wait(&fs->async_idle, &fs->async_lock);
+    squash_mutex_unlock(&fs->async_lock);
+
+    squash_workers_destroy(fs->async_workers);
+    fs->async_workers = NULL;
+}
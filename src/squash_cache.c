@@ -0,0 +1,517 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/libsquash/squash.h"
+
+#define SQUASH_CACHE_FAIR_SCAN 16 // Сколько записей от хвоста очереди просматривается в поисках блока «жадного» образа
+
+static inline size_t cache_hash(uint64_t key)
+{
+    uint64_t x = key;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return (size_t)x;
+}
+
+static inline size_t entry_cost(size_t size)
+{
+    return sizeof(squash_cache_entry_t) + size;
+}
+
+static inline uint32_t entry_owner(uint64_t key)
+{
+    return (uint32_t)(key >> SQUASH_CACHE_OWNER_SHIFT);
+}
+
+static void owner_account(squash_block_cache_t *cache, uint64_t key, size_t cost, bool add)
+{
+    uint32_t owner = entry_owner(key);
+    if (!cache->owner_bytes || owner >= cache->owner_slots)
+        return;
+    if (add)
+        cache->owner_bytes[owner] += cost;
+    else
+        cache->owner_bytes[owner] -= cost;
+}
+
+void squash_block_cache_init(squash_block_cache_t *cache, size_t capacity)
+{
+    memset(cache, 0, sizeof(*cache));
+    cache->capacity = capacity;
+}
+
+void squash_block_cache_destroy(squash_block_cache_t *cache)
+{
+    for (int q = SQUASH_CACHE_IN; q <= SQUASH_CACHE_GHOST; q++)
+    {
+        squash_cache_entry_t *entry = cache->queues[q].head;
+        while (entry)
+        {
+            squash_cache_entry_t *next = entry->next;
+            free(entry);
+            entry = next;
+        }
+    }
+    free(cache->buckets);
+    free(cache->owner_bytes);
+    memset(cache, 0, sizeof(*cache));
+}
+
+static squash_cache_entry_t **cache_slot(squash_block_cache_t *cache, uint64_t key)
+{
+    squash_cache_entry_t **slot = &cache->buckets[cache_hash(key) & (cache->bucket_count - 1)];
+    while (*slot && (*slot)->key != key)
+        slot = &(*slot)->hash_next;
+    return slot;
+}
+
+static void queue_unlink(squash_block_cache_t *cache, squash_cache_entry_t *entry)
+{
+    squash_cache_list_t *list = &cache->queues[entry->queue];
+    if (entry->prev)
+        entry->prev->next = entry->next;
+    else
+        list->head = entry->next;
+    if (entry->next)
+        entry->next->prev = entry->prev;
+    else
+        list->tail = entry->prev;
+    entry->prev = entry->next = NULL;
+    list->count--;
+    list->bytes -= entry_cost(entry->size);
+}
+
+static void queue_push_front(squash_block_cache_t *cache, squash_cache_entry_t *entry)
+{
+    squash_cache_list_t *list = &cache->queues[entry->queue];
+    entry->prev = NULL;
+    entry->next = list->head;
+    if (list->head)
+        list->head->prev = entry;
+    list->head = entry;
+    if (!list->tail)
+        list->tail = entry;
+    list->count++;
+    list->bytes += entry_cost(entry->size);
+}
+
+static void cache_remove(squash_block_cache_t *cache, squash_cache_entry_t *entry)
+{
+    *cache_slot(cache, entry->key) = entry->hash_next;
+    queue_unlink(cache, entry);
+    if (entry->queue != SQUASH_CACHE_GHOST)
+    {
+        cache->bytes -= entry_cost(entry->size);
+        cache->entries--;
+        owner_account(cache, entry->key, entry_cost(entry->size), false);
+    }
+    free(entry);
+}
+
+// Таблица растёт вместе с числом записей, чтобы цепочки оставались короткими
+static void cache_grow(squash_block_cache_t *cache)
+{
+    size_t bucket_count = cache->bucket_count ? cache->bucket_count * 2 : 64;
+    squash_cache_entry_t **buckets = calloc(bucket_count, sizeof(squash_cache_entry_t *));
+    if (!buckets)
+        return; // Остаёмся со старой таблицей: длиннее цепочки, но кэш работает
+
+    for (size_t i = 0; i < cache->bucket_count; i++)
+    {
+        squash_cache_entry_t *entry = cache->buckets[i];
+        while (entry)
+        {
+            squash_cache_entry_t *next = entry->hash_next;
+            size_t b = cache_hash(entry->key) & (bucket_count - 1);
+            entry->hash_next = buckets[b];
+            buckets[b] = entry;
+            entry = next;
+        }
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->bucket_count = bucket_count;
+}
+
+static squash_cache_entry_t *cache_insert(squash_block_cache_t *cache, uint64_t key, const void *data, size_t size,
+                                          uint32_t aux, squash_cache_queue_t queue)
+{
+    if (cache->entries + cache->queues[SQUASH_CACHE_GHOST].count >= cache->bucket_count)
+    {
+        cache_grow(cache);
+        if (!cache->bucket_count)
+            return NULL;
+    }
+
+    squash_cache_entry_t *entry = malloc(entry_cost(size));
+    if (!entry)
+        return NULL; // Кэш - только ускорение, без записи всё работает
+    entry->key = key;
+    entry->size = size;
+    entry->aux = aux;
+    entry->queue = (uint8_t)queue;
+    entry->no_ghost = false;
+    if (size)
+        memcpy(entry->data, data, size);
+
+    squash_cache_entry_t **slot = &cache->buckets[cache_hash(key) & (cache->bucket_count - 1)];
+    entry->hash_next = *slot;
+    *slot = entry;
+    queue_push_front(cache, entry);
+    if (queue != SQUASH_CACHE_GHOST)
+    {
+        cache->bytes += entry_cost(size);
+        cache->entries++;
+        owner_account(cache, key, entry_cost(size), true);
+    }
+    return entry;
+}
+
+// Призраков держим не больше, чем блоков в кэше: этого хватает, чтобы распознать повторное обращение
+static void cache_add_ghost(squash_block_cache_t *cache, uint64_t key)
+{
+    size_t limit = cache->entries > 32 ? cache->entries : 32;
+    squash_cache_list_t *ghosts = &cache->queues[SQUASH_CACHE_GHOST];
+    while (ghosts->tail && ghosts->count >= limit)
+        cache_remove(cache, ghosts->tail);
+    cache_insert(cache, key, NULL, 0, 0, SQUASH_CACHE_GHOST);
+}
+
+// Блок у хвоста очереди, принадлежащий образу, который занял больше равной доли общего кэша
+// (с учётом блока incoming, для которого освобождается место); NULL - такого нет
+static squash_cache_entry_t *cache_fair_victim(squash_block_cache_t *cache, squash_cache_list_t *list,
+                                               uint64_t incoming, size_t cost)
+{
+    size_t fair = cache->capacity / cache->owners;
+    squash_cache_entry_t *entry = list->tail;
+    for (int i = 0; entry && i < SQUASH_CACHE_FAIR_SCAN; i++, entry = entry->prev)
+    {
+        uint32_t owner = entry_owner(entry->key);
+        size_t pending = owner == entry_owner(incoming) ? cost : 0;
+        if (owner < cache->owner_slots && cache->owner_bytes[owner] + pending > fair)
+            return entry;
+    }
+    return NULL;
+}
+
+// Вводная очередь отдаёт место первой, пока занимает больше четверти кэша или основная пуста.
+// В общем кэше сначала ищется блок «жадного» образа в выбранной очереди, затем в другой
+static void cache_evict_one(squash_block_cache_t *cache, uint64_t incoming, size_t cost)
+{
+    squash_cache_list_t *in = &cache->queues[SQUASH_CACHE_IN];
+    squash_cache_list_t *am = &cache->queues[SQUASH_CACHE_MAIN];
+    squash_cache_list_t *list = in->tail && (in->bytes > cache->capacity / 4 || !am->tail) ? in : am;
+    squash_cache_entry_t *victim = NULL;
+    if (cache->owner_bytes && cache->owners > 1)
+    {
+        victim = cache_fair_victim(cache, list, incoming, cost);
+        if (!victim)
+            victim = cache_fair_victim(cache, list == in ? am : in, incoming, cost);
+    }
+    if (!victim)
+        victim = list->tail;
+
+    uint64_t key = victim->key;
+    bool ghost = victim->queue == SQUASH_CACHE_IN && !victim->no_ghost;
+    cache_remove(cache, victim);
+    if (ghost)
+        cache_add_ghost(cache, key);
+    cache->evictions++;
+}
+
+const uint8_t *squash_block_cache_get(squash_block_cache_t *cache, uint64_t key, size_t *size, uint32_t *aux)
+{
+    if (cache->capacity <= 1)
+        return NULL;
+
+    squash_cache_entry_t *entry = cache->bucket_count ? *cache_slot(cache, key) : NULL;
+    if (!entry || entry->queue == SQUASH_CACHE_GHOST)
+    {
+        cache->misses++;
+        return NULL;
+    }
+
+    cache->hits++;
+    // Вводная очередь - FIFO: попадание в неё не продлевает жизнь блока
+    if (entry->queue == SQUASH_CACHE_MAIN && cache->queues[SQUASH_CACHE_MAIN].head != entry)
+    {
+        queue_unlink(cache, entry);
+        queue_push_front(cache, entry);
+    }
+    *size = entry->size;
+    if (aux)
+        *aux = entry->aux;
+    return entry->data;
+}
+
+void squash_block_cache_put(squash_block_cache_t *cache, uint64_t key, const void *data, size_t size, uint32_t aux,
+                            bool once)
+{
+    size_t cost = entry_cost(size);
+    if (cache->capacity <= 1 || cost > cache->capacity)
+        return;
+
+    squash_cache_queue_t queue = SQUASH_CACHE_IN;
+    if (cache->bucket_count)
+    {
+        squash_cache_entry_t *old = *cache_slot(cache, key);
+        if (old)
+        {
+            if (old->queue == SQUASH_CACHE_MAIN)
+                queue = SQUASH_CACHE_MAIN;
+            else if (old->queue == SQUASH_CACHE_GHOST && !once)
+            {
+                // Блок вернулся вскоре после вытеснения из вводной очереди
+                queue = SQUASH_CACHE_MAIN;
+                cache->promotions++;
+            }
+            cache_remove(cache, old);
+        }
+    }
+    while (cache->entries && cache->bytes + cost > cache->capacity)
+        cache_evict_one(cache, key, cost);
+
+    squash_cache_entry_t *entry = cache_insert(cache, key, data, size, aux, queue);
+    if (entry)
+        entry->no_ghost = once;
+}
+
+bool squash_block_cache_contains(squash_block_cache_t *cache, uint64_t key)
+{
+    if (cache->capacity <= 1 || !cache->bucket_count)
+        return false;
+    squash_cache_entry_t *entry = *cache_slot(cache, key);
+    return entry && entry->queue != SQUASH_CACHE_GHOST;
+}
+
+bool squash_block_cache_copy(squash_fs_t *fs, squash_block_cache_t *cache, uint64_t key,
+                             uint8_t **data, size_t *size, uint32_t *aux)
+{
+    size_t cached_size;
+    const uint8_t *cached = squash_block_cache_get(cache, key, &cached_size, aux);
+    if (!cached || cached_size > fs->buffer_pool.buffer_size)
+        return false;
+
+    uint8_t *buf = squash_buffer_pool_acquire(&fs->buffer_pool);
+    if (!buf)
+        return false;
+    memcpy(buf, cached, cached_size);
+    *data = buf;
+    *size = cached_size;
+    return true;
+}
+
+// Закрытый образ: его блоки и призраки больше никому не нужны, а номер достанется следующему
+static void cache_purge_owner(squash_block_cache_t *cache, uint32_t owner)
+{
+    for (int q = SQUASH_CACHE_IN; q <= SQUASH_CACHE_GHOST; q++)
+    {
+        squash_cache_entry_t *entry = cache->queues[q].head;
+        while (entry)
+        {
+            squash_cache_entry_t *next = entry->next;
+            if (entry_owner(entry->key) == owner)
+                cache_remove(cache, entry);
+            entry = next;
+        }
+    }
+}
+
+static void shared_cache_unref(squash_cache_t *cache)
+{
+    squash_mutex_lock(&cache->lock);
+    bool last = --cache->refs == 0;
+    squash_mutex_unlock(&cache->lock);
+    if (!last)
+        return;
+    squash_block_cache_destroy(&cache->blocks);
+    free(cache->attached);
+    squash_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+SQUASH_API squash_error_t squash_cache_create(size_t capacity, squash_cache_t **cache)
+{
+    if (!cache)
+        return SQUASH_ERROR_INVALID_ARGUMENT;
+
+    squash_cache_t *c = calloc(1, sizeof(squash_cache_t));
+    if (!c)
+        return SQUASH_ERROR_MEMORY;
+    squash_mutex_init(&c->lock);
+    squash_block_cache_init(&c->blocks, capacity ? capacity : SQUASH_DEFAULT_SHARED_CACHE_BYTES);
+    c->refs = 1;
+    *cache = c;
+    return SQUASH_OK;
+}
+
+SQUASH_API void squash_cache_destroy(squash_cache_t *cache)
+{
+    if (cache)
+        shared_cache_unref(cache);
+}
+
+// Номер 0 не выдаётся: ключи своих кэшей образа его не содержат
+static squash_error_t shared_cache_attach(squash_cache_t *cache, uint32_t *owner)
+{
+    squash_block_cache_t *blocks = &cache->blocks;
+    uint32_t id = 1;
+    while (id < blocks->owner_slots && cache->attached[id])
+        id++;
+    if (id >= blocks->owner_slots)
+    {
+        uint32_t slots = blocks->owner_slots ? blocks->owner_slots * 2 : 16;
+        if (slots > SQUASH_CACHE_MAX_OWNERS)
+            slots = SQUASH_CACHE_MAX_OWNERS;
+        if (id >= slots)
+        {
+            fprintf(stderr, "Shared cache already serves %u images\n", blocks->owners);
+            return SQUASH_ERROR_MEMORY;
+        }
+        size_t *owner_bytes = realloc(blocks->owner_bytes, slots * sizeof(size_t));
+        if (owner_bytes)
+            blocks->owner_bytes = owner_bytes;
+        bool *attached = owner_bytes ? realloc(cache->attached, slots * sizeof(bool)) : NULL;
+        if (!attached)
+            return SQUASH_ERROR_MEMORY;
+        cache->attached = attached;
+        memset(owner_bytes + blocks->owner_slots, 0, (slots - blocks->owner_slots) * sizeof(size_t));
+        memset(attached + blocks->owner_slots, 0, (slots - blocks->owner_slots) * sizeof(bool));
+        blocks->owner_slots = slots;
+    }
+    cache->attached[id] = true;
+    blocks->owner_bytes[id] = 0;
+    blocks->owners++;
+    cache->refs++;
+    *owner = id;
+    return SQUASH_OK;
+}
+
+squash_error_t squash_fs_cache_init(squash_fs_t *fs)
+{
+    squash_cache_t *shared = fs->options.cache;
+    if (!shared)
+    {
+        // Память кэши выделяют по мере заполнения
+        squash_block_cache_init(&fs->block_cache, fs->options.block_cache_bytes);
+        squash_block_cache_init(&fs->compressed_cache, fs->options.compressed_cache_bytes);
+        return SQUASH_OK;
+    }
+
+    // Свои кэши выключены и только считают обращения образа к общему
+    squash_block_cache_init(&fs->block_cache, 1);
+    squash_block_cache_init(&fs->compressed_cache, 1);
+    squash_mutex_lock(&shared->lock);
+    squash_error_t err = shared_cache_attach(shared, &fs->cache_owner);
+    squash_mutex_unlock(&shared->lock);
+    if (err == SQUASH_OK)
+        fs->shared_cache = shared;
+    return err;
+}
+
+void squash_fs_cache_destroy(squash_fs_t *fs)
+{
+    squash_block_cache_destroy(&fs->block_cache);
+    squash_block_cache_destroy(&fs->compressed_cache);
+
+    squash_cache_t *shared = fs->shared_cache;
+    if (!shared)
+        return;
+    squash_mutex_lock(&shared->lock);
+    cache_purge_owner(&shared->blocks, fs->cache_owner);
+    shared->attached[fs->cache_owner] = false;
+    shared->blocks.owners--;
+    squash_mutex_unlock(&shared->lock);
+    fs->shared_cache = NULL;
+    shared_cache_unref(shared);
+}
+
+static inline squash_block_cache_t *tier_cache(squash_fs_t *fs, squash_cache_tier_t tier)
+{
+    return tier == SQUASH_CACHE_TIER_COMPRESSED ? &fs->compressed_cache : &fs->block_cache;
+}
+
+static inline uint64_t shared_key(squash_fs_t *fs, squash_cache_tier_t tier, uint64_t offset)
+{
+    return ((uint64_t)fs->cache_owner << SQUASH_CACHE_OWNER_SHIFT) | ((uint64_t)tier << SQUASH_CACHE_TIER_SHIFT) |
+           offset;
+}
+
+bool squash_fs_cache_copy(squash_fs_t *fs, squash_cache_tier_t tier, uint64_t offset,
+                          uint8_t **data, size_t *size, uint32_t *aux)
+{
+    squash_cache_t *shared = fs->shared_cache;
+    if (!shared)
+        return squash_block_cache_copy(fs, tier_cache(fs, tier), offset, data, size, aux);
+    if (offset >= SQUASH_CACHE_MAX_OFFSET)
+        return false;
+
+    squash_mutex_lock(&shared->lock);
+    bool hit = squash_block_cache_copy(fs, &shared->blocks, shared_key(fs, tier, offset), data, size, aux);
+    squash_mutex_unlock(&shared->lock);
+    if (hit)
+        tier_cache(fs, tier)->hits++;
+    else
+        tier_cache(fs, tier)->misses++;
+    return hit;
+}
+
+const uint8_t *squash_fs_cache_peek(squash_fs_t *fs, squash_cache_tier_t tier, uint64_t offset,
+                                    size_t *size, uint32_t *aux, uint8_t **copy)
+{
+    *copy = NULL;
+    if (!fs->shared_cache)
+        return squash_block_cache_get(tier_cache(fs, tier), offset, size, aux);
+    // Запись общего кэша может вытеснить другой образ, поэтому её данные копируются
+    return squash_fs_cache_copy(fs, tier, offset, copy, size, aux) ? *copy : NULL;
+}
+
+void squash_fs_cache_put(squash_fs_t *fs, squash_cache_tier_t tier, uint64_t offset, const void *data, size_t size,
+                         uint32_t aux, bool once)
+{
+    squash_cache_t *shared = fs->shared_cache;
+    if (!shared)
+    {
+        squash_block_cache_put(tier_cache(fs, tier), offset, data, size, aux, once);
+        return;
+    }
+    if (offset >= SQUASH_CACHE_MAX_OFFSET)
+        return;
+
+    squash_mutex_lock(&shared->lock);
+    squash_block_cache_put(&shared->blocks, shared_key(fs, tier, offset), data, size, aux, once);
+    squash_mutex_unlock(&shared->lock);
+}
+
+bool squash_fs_cache_contains(squash_fs_t *fs, squash_cache_tier_t tier, uint64_t offset)
+{
+    squash_cache_t *shared = fs->shared_cache;
+    if (!shared)
+        return squash_block_cache_contains(tier_cache(fs, tier), offset);
+    if (offset >= SQUASH_CACHE_MAX_OFFSET)
+        return false;
+
+    squash_mutex_lock(&shared->lock);
+    bool found = squash_block_cache_contains(&shared->blocks, shared_key(fs, tier, offset));
+    squash_mutex_unlock(&shared->lock);
+    return found;
+}
+
+void squash_fs_cache_stats(squash_fs_t *fs, squash_stats_t *stats)
+{
+    squash_cache_t *shared = fs->shared_cache;
+    if (!shared)
+        return;
+    squash_mutex_lock(&shared->lock);
+    stats->shared_cache_capacity = shared->blocks.capacity;
+    stats->shared_cache_bytes = shared->blocks.bytes;
+    stats->shared_cache_entries = shared->blocks.entries;
+    stats->shared_cache_image_bytes = shared->blocks.owner_bytes[fs->cache_owner];
+    stats->shared_cache_images = shared->blocks.owners;
+    stats->shared_cache_evictions = shared->blocks.evictions;
+    stats->shared_cache_promotions = shared->blocks.promotions;
+    squash_mutex_unlock(&shared->lock);
+}
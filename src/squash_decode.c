@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/libsquash/squash.h"
+
+#define SQUASH_PARALLEL_DECODE_MIN_BLOCKS 4
+
+// Общее состояние одного параллельного разбора: задания берутся по индексу под блокировкой
+typedef struct
+{
+    squash_fs_t *fs;
+    squash_decode_job_t *jobs;
+    uint32_t count;
+    uint32_t next;
+    uint32_t helpers_running;
+    uint64_t local_hits; // Помощников, взявших декомпрессор из кэша своего потока
+    squash_mutex_t lock;
+    squash_cond_t cond;
+} decode_batch_t;
+
+static void decode_one(squash_decompressor_t *dec, squash_decode_job_t *job)
+{
+    job->out_size = 0;
+    job->result = SQUASH_OK;
+    if (job->src_size == 0)
+        return; // Sparse-блок: распаковывать нечего
+
+    if (job->compressed)
+    {
+        job->out_size = job->dst_capacity;
+        job->result = squash_decompress_block(dec, job->src, job->src_size, job->dst, &job->out_size);
+    }
+    else if (job->src_size > job->dst_capacity)
+    {
+        job->result = SQUASH_ERROR_INVALID_BLOCK;
+    }
+    else
+    {
+        memcpy(job->dst, job->src, job->src_size);
+        job->out_size = job->src_size;
+    }
+}
+
+static void decode_drain(decode_batch_t *batch, squash_decompressor_t *dec)
+{
+    for (;;)
+    {
+        squash_mutex_lock(&batch->lock);
+        uint32_t i = batch->next < batch->count ? batch->next++ : batch->count;
+        squash_mutex_unlock(&batch->lock);
+        if (i == batch->count)
+            break;
+        decode_one(dec, &batch->jobs[i]);
+    }
+}
+
+static void decode_helper(void *arg)
+{
+    decode_batch_t *batch = arg;
+    // Декомпрессор берётся один раз на серию; без него задания достаются остальным потокам
+    bool local = false;
+    squash_decompressor_t *dec = squash_decoder_pool_acquire(batch->fs, &local);
+    if (dec)
+    {
+        decode_drain(batch, dec);
+        squash_decoder_pool_release(batch->fs, dec);
+    }
+    squash_mutex_lock(&batch->lock);
+    if (local)
+        batch->local_hits++;
+    if (--batch->helpers_running == 0)
+        squash_cond_signal(&batch->cond);
+    squash_mutex_unlock(&batch->lock);
+}
+
+// Рабочие потоки распаковки создаются при первом большом чтении. Вызывается под fs->lock
+static squash_workers_t *decode_workers(squash_fs_t *fs)
+{
+    if (!fs->decode_workers)
+    {
+        uint32_t threads = fs->options.decode_threads ? fs->options.decode_threads : squash_cpu_count();
+        if (threads <= 1)
+            return NULL;
+        // Вызывающий поток распаковывает вместе с пулом
+        if (squash_workers_create(threads - 1, &fs->decode_workers) != SQUASH_OK)
+            return NULL;
+    }
+    return fs->decode_workers;
+}
+
+squash_error_t squash_decode_blocks(squash_fs_t *fs, squash_decode_job_t *jobs, uint32_t count)
+{
+    uint32_t min_blocks = fs->options.parallel_decode_min_blocks ? fs->options.parallel_decode_min_blocks
+                                                                 : SQUASH_PARALLEL_DECODE_MIN_BLOCKS;
+    squash_workers_t *workers = count >= min_blocks && count > 1 ? decode_workers(fs) : NULL;
+
+    if (!workers)
+    {
+        for (uint32_t i = 0; i < count; i++)
+            decode_one(fs->decompressor, &jobs[i]);
+    }
+    else
+    {
+        decode_batch_t batch;
+        memset(&batch, 0, sizeof(batch));
+        batch.fs = fs;
+        batch.jobs = jobs;
+        batch.count = count;
+        squash_mutex_init(&batch.lock);
+        squash_cond_init(&batch.cond);
+
+        uint32_t helpers = squash_workers_count(workers);
+        if (helpers > count - 1)
+            helpers = count - 1;
+        batch.helpers_running = helpers;
+        for (uint32_t i = 0; i < helpers; i++)
+        {
+            if (squash_workers_submit(workers, decode_helper, &batch) != SQUASH_OK)
+            {
+                squash_mutex_lock(&batch.lock);
+                batch.helpers_running -= helpers - i;
+                squash_mutex_unlock(&batch.lock);
+                break;
+            }
+        }
+
+        // Вызывающий поток держит fs->lock и распаковывает общим декомпрессором образа
+        decode_drain(&batch, fs->decompressor);
+
+        squash_mutex_lock(&batch.lock);
+        while (batch.helpers_running > 0)
+            squash_cond_wait(&batch.cond, &batch.lock);
+        squash_mutex_unlock(&batch.lock);
+        squash_cond_destroy(&batch.cond);
+        squash_mutex_destroy(&batch.lock);
+
+        fs->decoder_pool.local_hits += batch.local_hits;
+        fs->parallel_decodes++;
+        fs->parallel_decode_blocks += count;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (jobs[i].result != SQUASH_OK)
+            return jobs[i].result;
+    }
+    return SQUASH_OK;
+}
@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/libsquash/squash.h"
+
+#ifdef _MSC_VER
+#define SQUASH_THREAD_LOCAL __declspec(thread)
+#else
+#define SQUASH_THREAD_LOCAL _Thread_local
+#endif
+
+// Кэш потока: один декомпрессор, возвращённый последним. Его заполняет squash_decoder_pool_release только в потоках
+// fs->decode_workers, а они останавливаются раньше, чем пул освобождается, поэтому указатель на пул не устаревает.
+// Асинхронные запросы работают в чужих потоках и возвращают декомпрессор через squash_decoder_pool_return
+static SQUASH_THREAD_LOCAL squash_decoder_pool_t *local_pool;
+static SQUASH_THREAD_LOCAL squash_decompressor_t *local_decoder;
+
+void squash_decoder_pool_init(squash_decoder_pool_t *pool)
+{
+    memset(pool, 0, sizeof(*pool));
+    squash_mutex_init(&pool->lock);
+}
+
+void squash_decoder_pool_destroy(squash_decoder_pool_t *pool)
+{
+    for (size_t i = 0; i < pool->count; i++)
+    {
+        squash_decompressor_destroy(pool->all[i]);
+    }
+    free(pool->all);
+    free(pool->free_list);
+    squash_mutex_destroy(&pool->lock);
+    memset(pool, 0, sizeof(*pool));
+}
+
+// Вызывается под pool->lock
+static squash_decompressor_t *pool_create(squash_fs_t *fs, squash_decoder_pool_t *pool)
+{
+    if (pool->count == pool->capacity)
+    {
+        size_t capacity = pool->capacity ? pool->capacity * 2 : 8;
+        squash_decompressor_t **all = realloc(pool->all, capacity * sizeof(squash_decompressor_t *));
+        if (!all)
+            return NULL;
+        pool->all = all;
+        // Каждый декомпрессор лежит в списке свободных не больше одного раза
+        squash_decompressor_t **free_list = realloc(pool->free_list, capacity * sizeof(squash_decompressor_t *));
+        if (!free_list)
+            return NULL;
+        pool->free_list = free_list;
+        pool->capacity = capacity;
+    }
+
+    squash_decompressor_t *dec = squash_decompressor_clone(fs->decompressor);
+    if (!dec)
+    {
+        fprintf(stderr, "Failed to create decompressor for worker thread\n");
+        return NULL;
+    }
+    pool->all[pool->count++] = dec;
+    return dec;
+}
+
+squash_decompressor_t *squash_decoder_pool_acquire(squash_fs_t *fs, bool *local)
+{
+    *local = false;
+    if (squash_decompressor_flags(fs->decompressor) & SQUASH_CODEC_THREAD_SAFE)
+    {
+        return fs->decompressor;
+    }
+
+    squash_decoder_pool_t *pool = &fs->decoder_pool;
+    if (local_pool == pool && local_decoder)
+    {
+        // Быстрый путь: поток распаковывает тем же декомпрессором, что и в прошлый раз
+        squash_decompressor_t *dec = local_decoder;
+        local_decoder = NULL;
+        *local = true;
+        return dec;
+    }
+
+    if (!squash_mutex_trylock(&pool->lock))
+    {
+        squash_mutex_lock(&pool->lock);
+        pool->contended++;
+    }
+    pool->shared_acquires++;
+    squash_decompressor_t *dec = pool->free_count > 0 ? pool->free_list[--pool->free_count]
+                                                      : pool_create(fs, pool);
+    squash_mutex_unlock(&pool->lock);
+    return dec;
+}
+
+void squash_decoder_pool_release(squash_fs_t *fs, squash_decompressor_t *dec)
+{
+    if (!dec || dec == fs->decompressor)
+    {
+        return;
+    }
+
+    squash_decoder_pool_t *pool = &fs->decoder_pool;
+    if (!local_decoder || local_pool != pool)
+    {
+        // Декомпрессор другого пула остаётся в его списке all и освобождается вместе с ним
+        local_pool = pool;
+        local_decoder = dec;
+        return;
+    }
+
+    squash_mutex_lock(&pool->lock);
+    pool->free_list[pool->free_count++] = dec;
+    squash_mutex_unlock(&pool->lock);
+}
+
+void squash_decoder_pool_return(squash_fs_t *fs, squash_decompressor_t *dec)
+{
+    if (!dec || dec == fs->decompressor)
+    {
+        return;
+    }
+
+    squash_decoder_pool_t *pool = &fs->decoder_pool;
+    squash_mutex_lock(&pool->lock);
+    pool->free_list[pool->free_count++] = dec;
+    squash_mutex_unlock(&pool->lock);
+}
@@ -6,6 +6,9 @@
 #ifdef HAVE_ZLIB
 #include <zlib.h>
 #endif
+#ifdef HAVE_LIBDEFLATE
+#include <libdeflate.h>
+#endif
 #ifdef HAVE_LZMA
 #include <lzma.h>
 #endif
@@ -22,267 +25,44 @@
 #include <zstd.h>
 #endif
 
-// Forward declarations
-#ifdef HAVE_ZLIB
-static squash_error_t decompress_gzip(const void *compressed_data, size_t compressed_size,
-                                      void *uncompressed_data, size_t *uncompressed_size);
-#endif
-#ifdef HAVE_LZMA
-static squash_error_t decompress_lzma(const void *compressed_data, size_t compressed_size,
-                                      void *uncompressed_data, size_t *uncompressed_size);
-#endif
-#ifdef HAVE_LZO
-static squash_error_t decompress_lzo(const void *compressed_data, size_t compressed_size,
-                                     void *uncompressed_data, size_t *uncompressed_size);
-#endif
-#ifdef HAVE_XZ
-static squash_error_t decompress_xz(const void *compressed_data, size_t compressed_size,
-                                    void *uncompressed_data, size_t *uncompressed_size);
-#endif
-#ifdef HAVE_LZ4
-static squash_error_t decompress_lz4(const void *compressed_data, size_t compressed_size,
-                                     void *uncompressed_data, size_t *uncompressed_size);
-#endif
-#ifdef HAVE_ZSTD
-static squash_error_t decompress_zstd(const void *compressed_data, size_t compressed_size,
-                                      void *uncompressed_data, size_t *uncompressed_size);
-#endif
+#define SQUASH_XZ_DEFAULT_MEMLIMIT (128 * 1024 * 1024) // Без параметров образа словарь неизвестен
+#define SQUASH_XZ_MEMLIMIT_SLACK (1024 * 1024)          // Поверх словаря: фильтры BCJ и заголовки потока
 
-// Внутренняя структура декомпрессора
+// Внутренняя структура декомпрессора: кодек выбирается один раз при создании,
+// дальше каждый вызов идёт через его таблицу функций. Таблица копируется: squash_unregister_codec
+// и повторная регистрация того же id не трогают уже созданные декомпрессоры
 struct squash_decompressor
 {
     squash_compression_t type;
-    void *internal_state;
+    squash_codec_t codec;
+    void *context;
+    squash_compressor_options_t options; // Параметры образа (squash_decompressor_configure)
+    bool configured;
 };
 
-SQUASH_API squash_decompressor_t *squash_decompressor_create(squash_compression_t type)
+// Частичная распаковка: поток кодека останавливается, как только готово needed байт,
+// и продолжает с того же места при следующем вызове
+struct squash_partial
 {
-    squash_decompressor_t *dec = malloc(sizeof(squash_decompressor_t));
-    if (!dec)
-        return NULL;
-
-    dec->type = type;
-    dec->internal_state = NULL;
-
-    switch (type)
-    {
-    case SQUASH_COMPRESSION_GZIP:
-#ifdef HAVE_ZLIB
-    {
-        z_stream *strm = malloc(sizeof(z_stream));
-        if (!strm)
-        {
-            free(dec);
-            return NULL;
-        }
-        memset(strm, 0, sizeof(z_stream));
-        if (inflateInit2(strm, -15) != Z_OK)
-        {
-            free(strm);
-            free(dec);
-            return NULL;
-        }
-        dec->internal_state = strm;
-    }
-    break;
-#else
-        free(dec);
-        return NULL;
-#endif
-    case SQUASH_COMPRESSION_LZMA:
-#ifdef HAVE_LZMA
-    {
-        lzma_stream *strm = malloc(sizeof(lzma_stream));
-        if (!strm)
-        {
-            free(dec);
-            return NULL;
-        }
-        memset(strm, 0, sizeof(lzma_stream));
-        if (lzma_alone_decoder(strm, UINT64_MAX) != LZMA_OK)
-        {
-            free(strm);
-            free(dec);
-            return NULL;
-        }
-        dec->internal_state = strm;
-    }
-    break;
-#else
-        free(dec);
-        return NULL;
-#endif
-    case SQUASH_COMPRESSION_LZO:
-#ifdef HAVE_LZO
-        if (lzo_init() != LZO_E_OK)
-        {
-            free(dec);
-            return NULL;
-        }
-        dec->internal_state = NULL; // LZO не требует постоянного состояния
-        break;
-#else
-        free(dec);
-        return NULL;
-#endif
-    case SQUASH_COMPRESSION_XZ:
-#ifdef HAVE_XZ
-    {
-        lzma_stream *strm = malloc(sizeof(lzma_stream));
-        if (!strm)
-        {
-            free(dec);
-            return NULL;
-        }
-        memset(strm, 0, sizeof(lzma_stream));
-        if (lzma_stream_decoder(strm, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK)
-        {
-            free(strm);
-            free(dec);
-            return NULL;
-        }
-        dec->internal_state = strm;
-    }
-    break;
-#else
-        free(dec);
-        return NULL;
-#endif
-    case SQUASH_COMPRESSION_LZ4:
-#ifdef HAVE_LZ4
-        dec->internal_state = NULL; // LZ4 не требует постоянного состояния
-        break;
-#else
-        free(dec);
-        return NULL;
-#endif
-    case SQUASH_COMPRESSION_ZSTD:
-#ifdef HAVE_ZSTD
-    {
-        ZSTD_DCtx *ctx = ZSTD_createDCtx();
-        if (!ctx)
-        {
-            free(dec);
-            return NULL;
-        }
-        dec->internal_state = ctx;
-    }
-    break;
-#else
-        free(dec);
-        return NULL;
-#endif
-    default:
-        free(dec);
-        return NULL;
-    }
+    void (*partial_free)(void *stream);
+    void *stream;    // Поток кодека или NULL (кодек не умеет продолжать)
+    size_t produced; // Распаковано байт
+};
 
-    return dec;
-}
+// Зарегистрированные кодеки заменяют встроенные с тем же id
+static squash_codec_t registered_codecs[SQUASH_MAX_CODEC_ID];
+static bool codec_registered[SQUASH_MAX_CODEC_ID];
 
-SQUASH_API void squash_decompressor_destroy(squash_decompressor_t *dec)
-{
-    if (!dec)
-        return;
+// GZIP
 
-    if (dec->internal_state)
-    {
-        switch (dec->type)
-        {
-        case SQUASH_COMPRESSION_GZIP:
 #ifdef HAVE_ZLIB
-            inflateEnd((z_stream *)dec->internal_state);
-            free(dec->internal_state);
-#endif
-            break;
-        case SQUASH_COMPRESSION_LZMA:
-#ifdef HAVE_LZMA
-            lzma_end((lzma_stream *)dec->internal_state);
-            free(dec->internal_state);
-#endif
-            break;
-        case SQUASH_COMPRESSION_XZ:
-#ifdef HAVE_XZ
-            lzma_end((lzma_stream *)dec->internal_state);
-            free(dec->internal_state);
-#endif
-            break;
-        case SQUASH_COMPRESSION_ZSTD:
-#ifdef HAVE_ZSTD
-            ZSTD_freeDCtx((ZSTD_DCtx *)dec->internal_state);
-#endif
-            break;
-        default:
-            break;
-        }
-    }
-
-    free(dec);
-}
-
-SQUASH_API squash_error_t squash_decompress_block(
-    squash_decompressor_t *dec,
-    const void *compressed_data,
-    size_t compressed_size,
-    void *uncompressed_data,
-    size_t *uncompressed_size)
+typedef struct
 {
-    if (!dec || !compressed_data || !uncompressed_data || !uncompressed_size)
-    {
-        return SQUASH_ERROR_INVALID_FILE;
-    }
+    int window_bits;
+} gzip_context_t;
 
-    switch (dec->type)
-    {
-    case SQUASH_COMPRESSION_GZIP:
-#ifdef HAVE_ZLIB
-        return decompress_gzip(compressed_data, compressed_size,
-                               uncompressed_data, uncompressed_size);
-#else
-        return SQUASH_ERROR_COMPRESSION_NOT_SUPPORTED;
-#endif
-    case SQUASH_COMPRESSION_LZMA:
-#ifdef HAVE_LZMA
-        return decompress_lzma(compressed_data, compressed_size,
-                               uncompressed_data, uncompressed_size);
-#else
-        return SQUASH_ERROR_COMPRESSION_NOT_SUPPORTED;
-#endif
-    case SQUASH_COMPRESSION_LZO:
-#ifdef HAVE_LZO
-        return decompress_lzo(compressed_data, compressed_size,
-                              uncompressed_data, uncompressed_size);
-#else
-        return SQUASH_ERROR_COMPRESSION_NOT_SUPPORTED;
-#endif
-    case SQUASH_COMPRESSION_XZ:
-#ifdef HAVE_XZ
-        return decompress_xz(compressed_data, compressed_size,
-                             uncompressed_data, uncompressed_size);
-#else
-        return SQUASH_ERROR_COMPRESSION_NOT_SUPPORTED;
-#endif
-    case SQUASH_COMPRESSION_LZ4:
-#ifdef HAVE_LZ4
-        return decompress_lz4(compressed_data, compressed_size,
-                              uncompressed_data, uncompressed_size);
-#else
-        return SQUASH_ERROR_COMPRESSION_NOT_SUPPORTED;
-#endif
-    case SQUASH_COMPRESSION_ZSTD:
-#ifdef HAVE_ZSTD
-        return decompress_zstd(compressed_data, compressed_size,
-                               uncompressed_data, uncompressed_size);
-#else
-        return SQUASH_ERROR_COMPRESSION_NOT_SUPPORTED;
-#endif
-    default:
-        return SQUASH_ERROR_COMPRESSION_NOT_SUPPORTED;
-    }
-}
-
-#ifdef HAVE_ZLIB
 static squash_error_t decompress_gzip(
+    int window_bits,
     const void *compressed_data,
     size_t compressed_size,
     void *uncompressed_data,
@@ -296,7 +76,7 @@ static squash_error_t decompress_gzip(
     strm.next_out = (Bytef *)uncompressed_data;
     strm.avail_out = *uncompressed_size;
 
-    ret = inflateInit2(&strm, 15 + 32); // +32 для gzip формата
+    ret = inflateInit2(&strm, window_bits + 32); // +32 для gzip формата
     if (ret != Z_OK)
     {
         return SQUASH_ERROR_DECOMPRESSION_FAILED;
@@ -306,6 +86,11 @@ static squash_error_t decompress_gzip(
     if (ret != Z_STREAM_END)
     {
         inflateEnd(&strm);
+        if (window_bits < 15)
+        {
+            // Окно потока больше заявленного в параметрах образа - повторяем с наибольшим
+            return decompress_gzip(15, compressed_data, compressed_size, uncompressed_data, uncompressed_size);
+        }
         return SQUASH_ERROR_DECOMPRESSION_FAILED;
     }
 
@@ -314,7 +99,122 @@ static squash_error_t decompress_gzip(
 
     return SQUASH_OK;
 }
+
+static int gzip_init(const squash_compressor_options_t *options, void **context)
+{
+    gzip_context_t *ctx = malloc(sizeof(gzip_context_t));
+    if (!ctx)
+        return SQUASH_ERROR_MEMORY;
+    // inflate выделяет окно ровно того размера, с которым сжимался образ
+    ctx->window_bits = options ? options->gzip.window_bits : 15;
+    *context = ctx;
+    return SQUASH_OK;
+}
+
+static int gzip_decompress(void *context, const void *src, size_t src_size, void *dst, size_t *dst_size)
+{
+    return decompress_gzip(((gzip_context_t *)context)->window_bits, src, src_size, dst, dst_size);
+}
+
+static int gzip_decompress_partial(void *context, void **stream, const void *src, size_t src_size, void *dst,
+                                   size_t target, size_t capacity, size_t *produced, bool *complete)
+{
+    (void)context;
+    (void)capacity;
+    z_stream *strm = *stream;
+    if (!strm)
+    {
+        strm = calloc(1, sizeof(z_stream));
+        if (!strm)
+            return SQUASH_ERROR_MEMORY;
+        if (inflateInit2(strm, 15 + 32) != Z_OK) // +32 для gzip формата, как в decompress_gzip
+        {
+            free(strm);
+            return SQUASH_ERROR_DECOMPRESSION_FAILED;
+        }
+        strm->next_in = (Bytef *)src;
+        strm->avail_in = (uInt)src_size;
+        strm->next_out = (Bytef *)dst;
+        *stream = strm;
+    }
+
+    int ret = Z_OK;
+    while (strm->total_out < target && ret == Z_OK)
+    {
+        strm->avail_out = (uInt)(target - strm->total_out);
+        ret = inflate(strm, Z_SYNC_FLUSH);
+    }
+    *produced = strm->total_out;
+    *complete = ret == Z_STREAM_END;
+    return ret == Z_OK || ret == Z_STREAM_END ? SQUASH_OK : SQUASH_ERROR_DECOMPRESSION_FAILED;
+}
+
+static void gzip_partial_free(void *stream)
+{
+    inflateEnd((z_stream *)stream);
+    free(stream);
+}
+
+static const squash_codec_t gzip_zlib_codec = {
+    "gzip", SQUASH_COMPRESSION_GZIP, SQUASH_CODEC_THREAD_SAFE | SQUASH_CODEC_PARTIAL,
+    gzip_init, gzip_decompress, gzip_decompress_partial, gzip_partial_free, free};
+
+#ifdef HAVE_LIBDEFLATE
+// Распаковщик libdeflate не потокобезопасен: у каждого контекста свой, рабочие потоки
+// получают отдельные декомпрессоры из squash_decoder_pool
+typedef struct
+{
+    gzip_context_t gzip;
+    struct libdeflate_decompressor *decompressor;
+} deflate_context_t;
+
+static int deflate_init(const squash_compressor_options_t *options, void **context)
+{
+    deflate_context_t *ctx = malloc(sizeof(deflate_context_t));
+    if (!ctx)
+        return SQUASH_ERROR_MEMORY;
+    ctx->gzip.window_bits = options ? options->gzip.window_bits : 15;
+    ctx->decompressor = libdeflate_alloc_decompressor();
+    if (!ctx->decompressor)
+    {
+        free(ctx);
+        return SQUASH_ERROR_MEMORY;
+    }
+    *context = ctx;
+    return SQUASH_OK;
+}
+
+static void deflate_destroy(void *context)
+{
+    deflate_context_t *ctx = context;
+    libdeflate_free_decompressor(ctx->decompressor);
+    free(ctx);
+}
+
+static int deflate_decompress(void *context, const void *src, size_t src_size, void *dst, size_t *dst_size)
+{
+    deflate_context_t *ctx = context;
+
+    // Блок целиком в памяти и его размер ограничен - распаковываем за один проход
+    size_t actual = 0;
+    enum libdeflate_result ret = libdeflate_zlib_decompress(ctx->decompressor, src, src_size, dst, *dst_size, &actual);
+    if (ret != LIBDEFLATE_SUCCESS)
+    {
+        // Не zlib-поток (например, с заголовком gzip) - разбирается потоковым inflate
+        return decompress_gzip(ctx->gzip.window_bits, src, src_size, dst, dst_size);
+    }
+    *dst_size = actual;
+    return SQUASH_OK;
+}
+
+// Частичная распаковка требует потока - её делает zlib
+static const squash_codec_t gzip_libdeflate_codec = {
+    "gzip-libdeflate", SQUASH_COMPRESSION_GZIP, SQUASH_CODEC_PARTIAL,
+    deflate_init, deflate_decompress, gzip_decompress_partial, gzip_partial_free, deflate_destroy};
 #endif
+#endif
+
+// LZMA
 
 #ifdef HAVE_LZMA
 static squash_error_t decompress_lzma(
@@ -411,30 +311,59 @@ static squash_error_t decompress_lzma(
     lzma_end(&strm);
     return SQUASH_OK;
 }
+
+static int lzma_decompress(void *context, const void *src, size_t src_size, void *dst, size_t *dst_size)
+{
+    (void)context;
+    return decompress_lzma(src, src_size, dst, dst_size);
+}
+
+// Параметры LZMA записаны в заголовке каждого блока, контекст не нужен
+static const squash_codec_t lzma_codec = {
+    "lzma", SQUASH_COMPRESSION_LZMA, SQUASH_CODEC_THREAD_SAFE,
+    NULL, lzma_decompress, NULL, NULL, NULL};
 #endif
 
+// LZO
+
 #ifdef HAVE_LZO
-static squash_error_t decompress_lzo(
-    const void *compressed_data,
-    size_t compressed_size,
-    void *uncompressed_data,
-    size_t *uncompressed_size)
+static int lzo_codec_init(const squash_compressor_options_t *options, void **context)
+{
+    (void)options;
+    *context = NULL; // LZO не требует постоянного состояния
+    return lzo_init() == LZO_E_OK ? SQUASH_OK : SQUASH_ERROR_COMPRESSION;
+}
+
+// Все варианты lzo1x распаковываются одним lzo1x_decompress_safe
+static int lzo_decompress(void *context, const void *src, size_t src_size, void *dst, size_t *dst_size)
 {
-    lzo_uint out_len = *uncompressed_size;
-    int ret = lzo1x_decompress_safe(compressed_data, compressed_size,
-                                    uncompressed_data, &out_len, NULL);
+    (void)context;
+    lzo_uint out_len = *dst_size;
+    int ret = lzo1x_decompress_safe(src, src_size, dst, &out_len, NULL);
     if (ret != LZO_E_OK)
     {
         return SQUASH_ERROR_DECOMPRESSION_FAILED;
     }
 
-    *uncompressed_size = out_len;
+    *dst_size = out_len;
     return SQUASH_OK;
 }
+
+static const squash_codec_t lzo_codec = {
+    "lzo", SQUASH_COMPRESSION_LZO, SQUASH_CODEC_THREAD_SAFE,
+    lzo_codec_init, lzo_decompress, NULL, NULL, NULL};
 #endif
 
+// XZ
+
 #ifdef HAVE_XZ
+typedef struct
+{
+    uint64_t memlimit; // Предел памяти декодера по размеру словаря
+} xz_context_t;
+
 static squash_error_t decompress_xz(
+    uint64_t memlimit,
     const void *compressed_data,
     size_t compressed_size,
     void *uncompressed_data,
@@ -445,113 +374,609 @@ static squash_error_t decompress_xz(
         return SQUASH_ERROR_INVALID_ARGUMENT;
     }
 
-    lzma_stream strm = LZMA_STREAM_INIT;
-
-    // Инициализация с более строгими параметрами
-    lzma_ret ret = lzma_auto_decoder(&strm, 128 * 1024 * 1024, 0); // 128MB лимит
-
-    if (ret != LZMA_OK)
+    // Блок - целый поток .xz в памяти (фильтры BCJ записаны в его заголовке):
+    // декодируем одним вызовом, без создания и завершения lzma_stream
+    size_t in_pos = 0;
+    size_t out_pos = 0;
+    lzma_ret ret = lzma_stream_buffer_decode(&memlimit, 0, NULL, compressed_data, &in_pos, compressed_size,
+                                             uncompressed_data, &out_pos, *uncompressed_size);
+    if (ret == LZMA_OK)
     {
-        return (ret == LZMA_MEM_ERROR) ? SQUASH_ERROR_MEMORY : SQUASH_ERROR_DECOMPRESSION_FAILED;
+        *uncompressed_size = out_pos;
+        return SQUASH_OK;
+    }
+    if (ret == LZMA_MEM_ERROR)
+    {
+        return SQUASH_ERROR_MEMORY;
     }
+    if (ret == LZMA_MEMLIMIT_ERROR && memlimit < SQUASH_XZ_DEFAULT_MEMLIMIT)
+    {
+        // Словарь потока больше заявленного в параметрах образа: такие образы встречаются,
+        // распаковываем с прежним общим пределом
+        return decompress_xz(SQUASH_XZ_DEFAULT_MEMLIMIT, compressed_data, compressed_size,
+                             uncompressed_data, uncompressed_size);
+    }
+    return SQUASH_ERROR_DECOMPRESSION_FAILED;
+}
 
-    strm.next_in = (const uint8_t *)compressed_data;
-    strm.avail_in = compressed_size;
-    strm.next_out = (uint8_t *)uncompressed_data;
-    strm.avail_out = *uncompressed_size;
+static int xz_init(const squash_compressor_options_t *options, void **context)
+{
+    xz_context_t *ctx = malloc(sizeof(xz_context_t));
+    if (!ctx)
+        return SQUASH_ERROR_MEMORY;
+    ctx->memlimit = SQUASH_XZ_DEFAULT_MEMLIMIT;
+    if (options)
+    {
+        // Цепочку фильтров BCJ декодер берёт из заголовка каждого потока .xz, а xz.filters только перечисляет их.
+        // Проверяем, что liblzma собрана с этими фильтрами: иначе образ не откроется, а не сломается на первом блоке
+        static const struct
+        {
+            uint32_t flag;
+            lzma_vli id;
+        } bcj[] = {
+            {SQUASH_XZ_FILTER_X86, LZMA_FILTER_X86},
+            {SQUASH_XZ_FILTER_POWERPC, LZMA_FILTER_POWERPC},
+            {SQUASH_XZ_FILTER_IA64, LZMA_FILTER_IA64},
+            {SQUASH_XZ_FILTER_ARM, LZMA_FILTER_ARM},
+            {SQUASH_XZ_FILTER_ARMTHUMB, LZMA_FILTER_ARMTHUMB},
+            {SQUASH_XZ_FILTER_SPARC, LZMA_FILTER_SPARC}};
+        for (size_t i = 0; i < sizeof(bcj) / sizeof(bcj[0]); i++)
+        {
+            if ((options->xz.filters & bcj[i].flag) && !lzma_filter_decoder_is_supported(bcj[i].id))
+            {
+                fprintf(stderr, "XZ filter 0x%x is not supported by liblzma\n", bcj[i].flag);
+                free(ctx);
+                return SQUASH_ERROR_COMPRESSION_NOT_SUPPORTED;
+            }
+        }
 
-    size_t original_out_size = *uncompressed_size;
+        // Декодеру нужен словарь не больше, чем у кодировщика: это и есть предел памяти
+        lzma_options_lzma lzma2;
+        memset(&lzma2, 0, sizeof(lzma2));
+        lzma2.dict_size = options->xz.dictionary_size;
+        lzma_filter filters[] = {
+            {.id = LZMA_FILTER_LZMA2, .options = &lzma2},
+            {.id = LZMA_VLI_UNKNOWN, .options = NULL}};
+        uint64_t usage = lzma_raw_decoder_memusage(filters);
+        if (usage == UINT64_MAX)
+        {
+            free(ctx);
+            return SQUASH_ERROR_COMPRESSION;
+        }
+        ctx->memlimit = usage + SQUASH_XZ_MEMLIMIT_SLACK;
+    }
+    *context = ctx;
+    return SQUASH_OK;
+}
 
-    // Потоковое декодирование с проверкой прогресса
-    lzma_action action = LZMA_RUN;
+static int xz_decompress(void *context, const void *src, size_t src_size, void *dst, size_t *dst_size)
+{
+    return decompress_xz(((xz_context_t *)context)->memlimit, src, src_size, dst, dst_size);
+}
 
-    do
+static int xz_decompress_partial(void *context, void **stream, const void *src, size_t src_size, void *dst,
+                                 size_t target, size_t capacity, size_t *produced, bool *complete)
+{
+    (void)capacity;
+    lzma_stream *strm = *stream;
+    if (!strm)
     {
-        // Если входные данные закончились, переключаемся на финализацию
-        if (strm.avail_in == 0)
+        strm = malloc(sizeof(lzma_stream));
+        if (!strm)
+            return SQUASH_ERROR_MEMORY;
+        lzma_stream init = LZMA_STREAM_INIT;
+        *strm = init;
+        // Тот же предел, что в decompress_xz
+        lzma_ret init_ret = lzma_stream_decoder(strm, ((xz_context_t *)context)->memlimit, 0);
+        if (init_ret != LZMA_OK)
         {
-            action = LZMA_FINISH;
+            free(strm);
+            return init_ret == LZMA_MEM_ERROR ? SQUASH_ERROR_MEMORY : SQUASH_ERROR_DECOMPRESSION_FAILED;
         }
+        strm->next_in = (const uint8_t *)src;
+        strm->avail_in = src_size;
+        strm->next_out = (uint8_t *)dst;
+        *stream = strm;
+    }
+
+    lzma_ret ret = LZMA_OK;
+    while (strm->total_out < target && ret == LZMA_OK)
+    {
+        strm->avail_out = (size_t)(target - strm->total_out);
+        ret = lzma_code(strm, strm->avail_in == 0 ? LZMA_FINISH : LZMA_RUN);
+    }
+    *produced = (size_t)strm->total_out;
+    *complete = ret == LZMA_STREAM_END;
+    if (ret == LZMA_OK || ret == LZMA_STREAM_END)
+        return SQUASH_OK;
+    return ret == LZMA_MEM_ERROR ? SQUASH_ERROR_MEMORY : SQUASH_ERROR_DECOMPRESSION_FAILED;
+}
+
+static void xz_partial_free(void *stream)
+{
+    lzma_end((lzma_stream *)stream);
+    free(stream);
+}
+
+static const squash_codec_t xz_codec = {
+    "xz", SQUASH_COMPRESSION_XZ, SQUASH_CODEC_THREAD_SAFE | SQUASH_CODEC_PARTIAL,
+    xz_init, xz_decompress, xz_decompress_partial, xz_partial_free, free};
+#endif
+
+// LZ4
+
+#ifdef HAVE_LZ4
+// LZ4HC отличается только сжатием, распаковка та же
+static int lz4_decompress(void *context, const void *src, size_t src_size, void *dst, size_t *dst_size)
+{
+    (void)context;
+    int ret = LZ4_decompress_safe(src, dst, (int)src_size, (int)*dst_size);
+    if (ret < 0)
+    {
+        return SQUASH_ERROR_DECOMPRESSION_FAILED;
+    }
 
-        ret = lzma_code(&strm, action);
+    *dst_size = ret;
+    return SQUASH_OK;
+}
 
-        // Проверяем на зацикливание (отсутствие прогресса)
-        if (ret == LZMA_OK && strm.avail_out == *uncompressed_size && action == LZMA_FINISH)
+static int lz4_decompress_partial(void *context, void **stream, const void *src, size_t src_size, void *dst,
+                                  size_t target, size_t capacity, size_t *produced, bool *complete)
+{
+    (void)context;
+    // LZ4 не сохраняет поток: более длинное чтение распаковывает блок заново, но тоже только до target
+    *stream = NULL;
+    int ret = LZ4_decompress_safe_partial(src, dst, (int)src_size, (int)target, (int)capacity);
+    if (ret < 0)
+        return SQUASH_ERROR_DECOMPRESSION_FAILED;
+    *produced = (size_t)ret;
+    *complete = (size_t)ret < target || target == capacity;
+    return SQUASH_OK;
+}
+
+static const squash_codec_t lz4_codec = {
+    "lz4", SQUASH_COMPRESSION_LZ4, SQUASH_CODEC_THREAD_SAFE | SQUASH_CODEC_PARTIAL,
+    NULL, lz4_decompress, lz4_decompress_partial, NULL, NULL};
+#endif
+
+// ZSTD
+
+#ifdef HAVE_ZSTD
+typedef struct
+{
+    ZSTD_DStream *stream;
+    size_t in_pos;  // Потреблено сжатых байт
+    size_t out_pos; // Распаковано байт
+} zstd_partial_t;
+
+static int zstd_decompress(void *context, const void *src, size_t src_size, void *dst, size_t *dst_size)
+{
+    (void)context;
+    size_t ret = ZSTD_decompress(dst, *dst_size, src, src_size);
+    if (ZSTD_isError(ret))
+    {
+        printf("ZSTD decompression failed: %s\n", ZSTD_getErrorName(ret));
+        return SQUASH_ERROR_DECOMPRESSION_FAILED;
+    }
+
+    *dst_size = ret;
+    return SQUASH_OK;
+}
+
+static void zstd_partial_free(void *stream)
+{
+    zstd_partial_t *partial = stream;
+    ZSTD_freeDStream(partial->stream);
+    free(partial);
+}
+
+static int zstd_decompress_partial(void *context, void **stream, const void *src, size_t src_size, void *dst,
+                                   size_t target, size_t capacity, size_t *produced, bool *complete)
+{
+    (void)context;
+    (void)capacity;
+    zstd_partial_t *partial = *stream;
+    if (!partial)
+    {
+        partial = calloc(1, sizeof(zstd_partial_t));
+        if (!partial)
+            return SQUASH_ERROR_MEMORY;
+        partial->stream = ZSTD_createDStream();
+        if (!partial->stream)
         {
-            lzma_end(&strm);
+            free(partial);
+            return SQUASH_ERROR_MEMORY;
+        }
+        if (ZSTD_isError(ZSTD_initDStream(partial->stream)))
+        {
+            zstd_partial_free(partial);
             return SQUASH_ERROR_DECOMPRESSION_FAILED;
         }
+        *stream = partial;
+    }
+
+    ZSTD_inBuffer in = {src, src_size, partial->in_pos};
+    ZSTD_outBuffer out = {dst, target, partial->out_pos};
+    size_t ret = 1;
+    while (out.pos < target && ret != 0)
+    {
+        size_t in_before = in.pos, out_before = out.pos;
+        ret = ZSTD_decompressStream(partial->stream, &out, &in);
+        if (ZSTD_isError(ret))
+            return SQUASH_ERROR_DECOMPRESSION_FAILED;
+        if (ret != 0 && in.pos == in_before && out.pos == out_before)
+            return SQUASH_ERROR_DECOMPRESSION_FAILED; // Сжатые данные кончились раньше блока
+    }
+    partial->in_pos = in.pos;
+    partial->out_pos = out.pos;
+    *produced = out.pos;
+    *complete = ret == 0;
+    return SQUASH_OK;
+}
 
-    } while (ret == LZMA_OK);
+static const squash_codec_t zstd_codec = {
+    "zstd", SQUASH_COMPRESSION_ZSTD, SQUASH_CODEC_THREAD_SAFE | SQUASH_CODEC_PARTIAL,
+    NULL, zstd_decompress, zstd_decompress_partial, zstd_partial_free, NULL};
+#endif
 
-    *uncompressed_size = original_out_size - strm.avail_out;
-    lzma_end(&strm);
+// Реестр кодеков
 
-    // Обработка результатов аналогично предыдущей версии
-    if (ret == LZMA_STREAM_END)
+static const squash_codec_t *builtin_codec(uint16_t id)
+{
+    switch (id)
     {
-        return SQUASH_OK;
+#ifdef HAVE_ZLIB
+    case SQUASH_COMPRESSION_GZIP:
+#ifdef HAVE_LIBDEFLATE
+        return &gzip_libdeflate_codec;
+#else
+        return &gzip_zlib_codec;
+#endif
+#endif
+#ifdef HAVE_LZMA
+    case SQUASH_COMPRESSION_LZMA:
+        return &lzma_codec;
+#endif
+#ifdef HAVE_LZO
+    case SQUASH_COMPRESSION_LZO:
+        return &lzo_codec;
+#endif
+#ifdef HAVE_XZ
+    case SQUASH_COMPRESSION_XZ:
+        return &xz_codec;
+#endif
+#ifdef HAVE_LZ4
+    case SQUASH_COMPRESSION_LZ4:
+        return &lz4_codec;
+#endif
+#ifdef HAVE_ZSTD
+    case SQUASH_COMPRESSION_ZSTD:
+        return &zstd_codec;
+#endif
+    default:
+        return NULL;
     }
-    else if (ret == LZMA_BUF_ERROR)
+}
+
+SQUASH_API squash_error_t squash_register_codec(const squash_codec_t *codec)
+{
+    if (!codec || !codec->name || !codec->decompress || codec->id == 0 || codec->id >= SQUASH_MAX_CODEC_ID)
+        return SQUASH_ERROR_INVALID_ARGUMENT;
+    if ((codec->flags & SQUASH_CODEC_PARTIAL) && !codec->decompress_partial)
     {
-        return SQUASH_ERROR_DECOMPRESSION_FAILED;
+        fprintf(stderr, "Codec %s claims partial decompression without decompress_partial\n", codec->name);
+        return SQUASH_ERROR_INVALID_ARGUMENT;
     }
-    else if (ret == LZMA_DATA_ERROR || ret == LZMA_FORMAT_ERROR)
+
+    // Таблица копируется: структура вызывающего может быть временной, строка name - нет
+    registered_codecs[codec->id] = *codec;
+    codec_registered[codec->id] = true;
+    return SQUASH_OK;
+}
+
+SQUASH_API void squash_unregister_codec(uint16_t id)
+{
+    if (id < SQUASH_MAX_CODEC_ID)
     {
-        return SQUASH_ERROR_DECOMPRESSION_FAILED;
+        codec_registered[id] = false;
+        memset(&registered_codecs[id], 0, sizeof(squash_codec_t));
     }
-    else if (ret == LZMA_MEM_ERROR)
+}
+
+SQUASH_API const squash_codec_t *squash_find_codec(uint16_t id)
+{
+    if (id < SQUASH_MAX_CODEC_ID && codec_registered[id])
+        return &registered_codecs[id];
+    return builtin_codec(id);
+}
+
+// Контекст создаёт init; без init кодек работает с NULL и destroy не вызывается
+static squash_error_t codec_open(const squash_codec_t *codec, const squash_compressor_options_t *options,
+                                 void **context)
+{
+    *context = NULL;
+    return codec->init ? (squash_error_t)codec->init(options, context) : SQUASH_OK;
+}
+
+static void codec_close(const squash_codec_t *codec, void *context)
+{
+    if (codec->init && codec->destroy)
+        codec->destroy(context);
+}
+
+// Декомпрессор
+
+SQUASH_API squash_decompressor_t *squash_decompressor_create(squash_compression_t type)
+{
+    const squash_codec_t *codec = squash_find_codec((uint16_t)type);
+    if (!codec)
+        return NULL;
+
+    squash_decompressor_t *dec = calloc(1, sizeof(squash_decompressor_t));
+    if (!dec)
+        return NULL;
+
+    dec->type = type;
+    dec->codec = *codec;
+    if (codec_open(codec, NULL, &dec->context) != SQUASH_OK)
     {
-        return SQUASH_ERROR_MEMORY;
+        free(dec);
+        return NULL;
     }
-    else
+    return dec;
+}
+
+SQUASH_API void squash_decompressor_destroy(squash_decompressor_t *dec)
+{
+    if (!dec)
+        return;
+
+    codec_close(&dec->codec, dec->context);
+    free(dec);
+}
+
+SQUASH_API squash_decompressor_t *squash_decompressor_clone(squash_decompressor_t *dec)
+{
+    if (!dec)
+        return NULL;
+
+    squash_decompressor_t *copy = malloc(sizeof(squash_decompressor_t));
+    if (!copy)
+        return NULL;
+
+    *copy = *dec;
+    if (codec_open(&dec->codec, dec->configured ? &dec->options : NULL, &copy->context) != SQUASH_OK)
     {
-        return SQUASH_ERROR_DECOMPRESSION_FAILED;
+        free(copy);
+        return NULL;
     }
+    return copy;
+}
+
+// Пересоздаёт контекст кодека: старый остаётся, если новый создать не удалось
+static squash_error_t decompressor_reopen(squash_decompressor_t *dec, const squash_codec_t *codec,
+                                          const squash_compressor_options_t *options)
+{
+    void *context;
+    squash_error_t err = codec_open(codec, options, &context);
+    if (err != SQUASH_OK)
+        return err;
+
+    codec_close(&dec->codec, dec->context);
+    dec->codec = *codec;
+    dec->context = context;
+    return SQUASH_OK;
 }
+
+SQUASH_API squash_error_t squash_decompressor_configure(squash_decompressor_t *dec, const squash_compressor_options_t *options)
+{
+    if (!dec || !options)
+        return SQUASH_ERROR_INVALID_ARGUMENT;
+
+    switch (dec->type)
+    {
+    case SQUASH_COMPRESSION_GZIP:
+        if (options->gzip.window_bits < 8 || options->gzip.window_bits > 15)
+        {
+            fprintf(stderr, "Invalid GZIP window size %u\n", options->gzip.window_bits);
+            return SQUASH_ERROR_COMPRESSION;
+        }
+        break;
+    case SQUASH_COMPRESSION_XZ:
+        if (options->xz.dictionary_size < 8192 || (options->xz.filters & ~SQUASH_XZ_FILTER_MASK))
+        {
+            fprintf(stderr, "Invalid XZ options: dictionary %u, filters 0x%x\n",
+                    options->xz.dictionary_size, options->xz.filters);
+            return SQUASH_ERROR_COMPRESSION;
+        }
+        break;
+    case SQUASH_COMPRESSION_LZO:
+        if (options->lzo.algorithm >= SQUASH_LZO_ALGORITHMS)
+        {
+            fprintf(stderr, "Unsupported LZO algorithm %u\n", options->lzo.algorithm);
+            return SQUASH_ERROR_COMPRESSION_NOT_SUPPORTED;
+        }
+        break;
+    case SQUASH_COMPRESSION_LZ4:
+        // LZ4HC меняет только сжатие; другие флаги означают формат, который этот декодер не знает
+        if (options->lz4.version != SQUASH_LZ4_LEGACY || (options->lz4.flags & ~SQUASH_LZ4_HC))
+        {
+            fprintf(stderr, "Unsupported LZ4 format version %u, flags 0x%x\n", options->lz4.version,
+                    options->lz4.flags);
+            return SQUASH_ERROR_COMPRESSION_NOT_SUPPORTED;
+        }
+        break;
+    case SQUASH_COMPRESSION_ZSTD:
+        if (options->zstd.level < 1 || options->zstd.level > 22)
+        {
+            fprintf(stderr, "Invalid ZSTD level %u\n", options->zstd.level);
+            return SQUASH_ERROR_COMPRESSION;
+        }
+        break;
+    default:
+        break;
+    }
+
+    // Параметры применяются в контексте кодека (окно inflate, предел памяти xz)
+    squash_error_t err = decompressor_reopen(dec, &dec->codec, options);
+    if (err != SQUASH_OK)
+        return err;
+    dec->options = *options;
+    dec->configured = true;
+    return SQUASH_OK;
+}
+
+SQUASH_API squash_error_t squash_decompressor_set_gzip_backend(squash_decompressor_t *dec, squash_gzip_backend_t backend)
+{
+    if (!dec || dec->type != SQUASH_COMPRESSION_GZIP)
+        return SQUASH_ERROR_COMPRESSION_NOT_SUPPORTED;
+
+    const squash_codec_t *codec = NULL;
+    switch (backend)
+    {
+    case SQUASH_GZIP_AUTO:
+        codec = squash_find_codec(SQUASH_COMPRESSION_GZIP);
+        break;
+    case SQUASH_GZIP_ZLIB:
+#ifdef HAVE_ZLIB
+        codec = &gzip_zlib_codec;
 #endif
+        break;
+    case SQUASH_GZIP_LIBDEFLATE:
+#ifdef HAVE_LIBDEFLATE
+        codec = &gzip_libdeflate_codec;
+#endif
+        break;
+    default:
+        return SQUASH_ERROR_INVALID_ARGUMENT;
+    }
+    if (!codec)
+        return SQUASH_ERROR_COMPRESSION_NOT_SUPPORTED;
+    if (codec->decompress == dec->codec.decompress)
+        return SQUASH_OK;
+    return decompressor_reopen(dec, codec, dec->configured ? &dec->options : NULL);
+}
 
-#ifdef HAVE_LZ4
-static squash_error_t decompress_lz4(
+SQUASH_API squash_gzip_backend_t squash_decompressor_gzip_backend(squash_decompressor_t *dec)
+{
+#ifdef HAVE_ZLIB
+    if (dec && dec->codec.decompress == gzip_zlib_codec.decompress)
+        return SQUASH_GZIP_ZLIB;
+#endif
+#ifdef HAVE_LIBDEFLATE
+    if (dec && dec->codec.decompress == gzip_libdeflate_codec.decompress)
+        return SQUASH_GZIP_LIBDEFLATE;
+#endif
+    // Не GZIP или зарегистрированный пользователем кодек
+    return SQUASH_GZIP_AUTO;
+}
+
+SQUASH_API const char *squash_gzip_backend_name(squash_gzip_backend_t backend)
+{
+    switch (backend)
+    {
+    case SQUASH_GZIP_AUTO:
+        return "auto";
+    case SQUASH_GZIP_ZLIB:
+        return "zlib";
+    case SQUASH_GZIP_LIBDEFLATE:
+        return "libdeflate";
+    default:
+        return "unknown";
+    }
+}
+
+SQUASH_API uint32_t squash_decompressor_flags(squash_decompressor_t *dec)
+{
+    return dec ? dec->codec.flags : 0;
+}
+
+SQUASH_API const char *squash_decompressor_codec_name(squash_decompressor_t *dec)
+{
+    return dec ? dec->codec.name : NULL;
+}
+
+SQUASH_API squash_error_t squash_decompress_block(
+    squash_decompressor_t *dec,
     const void *compressed_data,
     size_t compressed_size,
     void *uncompressed_data,
     size_t *uncompressed_size)
 {
-    int ret = LZ4_decompress_safe(compressed_data, uncompressed_data,
-                                  compressed_size, *uncompressed_size);
-    if (ret < 0)
+    if (!dec || !compressed_data || !uncompressed_data || !uncompressed_size)
     {
-        return SQUASH_ERROR_DECOMPRESSION_FAILED;
+        return SQUASH_ERROR_INVALID_FILE;
     }
 
-    *uncompressed_size = ret;
-    return SQUASH_OK;
+    return (squash_error_t)dec->codec.decompress(dec->context, compressed_data, compressed_size, uncompressed_data,
+                                                 uncompressed_size);
 }
-#endif
 
-#ifdef HAVE_ZSTD
-static squash_error_t decompress_zstd(
+SQUASH_API bool squash_decompressor_supports_partial(squash_decompressor_t *dec)
+{
+    return dec && (dec->codec.flags & SQUASH_CODEC_PARTIAL);
+}
+
+SQUASH_API void squash_partial_free(squash_partial_t *state)
+{
+    if (!state)
+        return;
+
+    if (state->stream && state->partial_free)
+        state->partial_free(state->stream);
+    free(state);
+}
+
+SQUASH_API squash_error_t squash_decompress_block_partial(
+    squash_decompressor_t *dec,
+    squash_partial_t **state,
     const void *compressed_data,
     size_t compressed_size,
     void *uncompressed_data,
-    size_t *uncompressed_size)
+    size_t capacity,
+    size_t needed,
+    size_t *uncompressed_size,
+    bool *complete)
 {
-    if (!compressed_data || !uncompressed_data || !uncompressed_size)
+    if (!dec || !state || !compressed_data || !uncompressed_data || !uncompressed_size || !complete)
     {
-        return SQUASH_ERROR_INVALID_ARGUMENT;
+        return SQUASH_ERROR_INVALID_FILE;
     }
 
-    size_t ret = ZSTD_decompress(uncompressed_data, *uncompressed_size,
-                                 compressed_data, compressed_size);
-    
-    if (ZSTD_isError(ret))
+    *complete = false;
+    if (!squash_decompressor_supports_partial(dec))
     {
-        printf("ZSTD decompression failed: %s\n", ZSTD_getErrorName(ret));
-        return SQUASH_ERROR_DECOMPRESSION_FAILED;
+        // Кодек не умеет останавливаться - распаковываем целиком
+        *uncompressed_size = capacity;
+        squash_error_t err = squash_decompress_block(dec, compressed_data, compressed_size, uncompressed_data,
+                                                     uncompressed_size);
+        *complete = err == SQUASH_OK;
+        return err;
     }
 
-    *uncompressed_size = ret;
-    return SQUASH_OK;
+    if (!*state)
+    {
+        *state = calloc(1, sizeof(squash_partial_t));
+        if (!*state)
+            return SQUASH_ERROR_MEMORY;
+        (*state)->partial_free = dec->codec.partial_free;
+    }
+
+    size_t target = MIN(needed, capacity);
+    squash_error_t err = SQUASH_OK;
+    if ((*state)->produced < target)
+    {
+        err = (squash_error_t)dec->codec.decompress_partial(dec->context, &(*state)->stream, compressed_data,
+                                                             compressed_size, uncompressed_data, target, capacity,
+                                                             &(*state)->produced, complete);
+    }
+    *uncompressed_size = (*state)->produced;
+
+    // Кодек без потока (stream == NULL) распаковывает заново при каждом вызове - хранить нечего
+    if (err != SQUASH_OK || *complete || !(*state)->stream)
+    {
+        squash_partial_free(*state);
+        *state = NULL;
+    }
+    return err;
 }
-#endif
\ No newline at end of file
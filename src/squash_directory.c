@@ -4,12 +4,46 @@
 #include <errno.h>
 #include "../include/libsquash/squash.h"
 
+// Выделение памяти под записи: из арены, если она задана, иначе из кучи
+static void *dir_alloc(squash_arena_t *arena, size_t size)
+{
+    return arena ? squash_arena_alloc(arena, size) : malloc(size);
+}
+
+static void dir_free(squash_arena_t *arena, void *ptr)
+{
+    if (!arena)
+        free(ptr);
+}
+
+static void free_entries_list(dir_entries_list_t *list)
+{
+    if (list->arena)
+        return;
+    for (size_t i = 0; i < list->count; i++)
+    {
+        squash_free_dir_entry(list->entries[i]);
+    }
+    free(list->entries);
+}
+
 static squash_error_t add_dir_entry(dir_entries_list_t *list, squash_dir_entry_t *entry)
 {
     if (list->count >= list->capacity)
     {
         size_t new_capacity = list->capacity == 0 ? 16 : list->capacity * 2;
-        squash_dir_entry_t **new_entries = realloc(list->entries, new_capacity * sizeof(squash_dir_entry_t *));
+        squash_dir_entry_t **new_entries;
+        if (list->arena)
+        {
+            // В арене realloc невозможен: старый массив просто остаётся до сброса арены
+            new_entries = squash_arena_alloc(list->arena, new_capacity * sizeof(squash_dir_entry_t *));
+            if (new_entries && list->count)
+                memcpy(new_entries, list->entries, list->count * sizeof(squash_dir_entry_t *));
+        }
+        else
+        {
+            new_entries = realloc(list->entries, new_capacity * sizeof(squash_dir_entry_t *));
+        }
         if (!new_entries)
         {
             return SQUASH_ERROR_MEMORY;
@@ -30,16 +64,16 @@ static squash_error_t squash_read_bytes(squash_fs_t *fs, uint64_t *current_offse
     size_t filled = 0;
 
     printf("Reading %zu bytes at offset 0x%llx, pos=%zu, left_in_dir=%zu\n",
-           size, *current_offset, *pos, *left_in_dir);
+           size, (unsigned long long)*current_offset, *pos, *left_in_dir);
 
     while (filled < size)
     {
         if (!*uncompressed_data || *pos >= *uncompressed_size)
         {
             size_t compressed_size = 0;
-            free(*uncompressed_data);
+            squash_buffer_pool_release(&fs->buffer_pool, *uncompressed_data);
             *uncompressed_data = NULL;
-            printf("Loading new block at offset 0x%llx\n", *current_offset);
+            printf("Loading new block at offset 0x%llx\n", (unsigned long long)*current_offset);
             squash_error_t err = squash_read_metadata_block(fs, *current_offset, uncompressed_data, uncompressed_size, &compressed_size);
             if (err != SQUASH_OK)
             {
@@ -58,7 +92,7 @@ static squash_error_t squash_read_bytes(squash_fs_t *fs, uint64_t *current_offse
         if (to_copy == 0 || *pos + to_copy > *uncompressed_size)
         {
             printf("Invalid copy: pos=%zu, to_copy=%zu, uncompressed_size=%zu\n", *pos, to_copy, *uncompressed_size);
-            free(*uncompressed_data);
+            squash_buffer_pool_release(&fs->buffer_pool, *uncompressed_data);
             *uncompressed_data = NULL;
             return SQUASH_ERROR_INVALID_FILE;
         }
@@ -66,7 +100,7 @@ static squash_error_t squash_read_bytes(squash_fs_t *fs, uint64_t *current_offse
         if (*left_in_dir < to_copy)
         {
             printf("Not enough data in directory: left_in_dir=%zu, need=%zu\n", *left_in_dir, to_copy);
-            free(*uncompressed_data);
+            squash_buffer_pool_release(&fs->buffer_pool, *uncompressed_data);
             *uncompressed_data = NULL;
             return SQUASH_ERROR_INVALID_FILE;
         }
@@ -89,7 +123,8 @@ static squash_error_t squash_read_bytes(squash_fs_t *fs, uint64_t *current_offse
     return SQUASH_OK;
 }
 
-SQUASH_API squash_error_t squash_opendir(squash_fs_t *fs, squash_dir_inode_t *dir_inode, squash_dir_iterator_t **iterator)
+static squash_error_t opendir_internal(squash_fs_t *fs, squash_dir_inode_t *dir_inode, squash_arena_t *arena,
+                                       squash_dir_iterator_t **iterator)
 {
     if (!fs || !dir_inode || !iterator)
     {
@@ -103,17 +138,18 @@ SQUASH_API squash_error_t squash_opendir(squash_fs_t *fs, squash_dir_inode_t *di
 
     printf("Directory inode: start_block=%u, offset=%u, size=%u\n",
            dir_inode->start_block, dir_offset, dir_inode->file_size);
-    printf("Directory table start: 0x%llx\n", fs->super.directory_table_start);
-    printf("Reading directory at: 0x%llx\n", base_offset);
+    printf("Directory table start: 0x%llx\n", (unsigned long long)fs->super.directory_table_start);
+    printf("Reading directory at: 0x%llx\n", (unsigned long long)base_offset);
 
     if (base_offset >= fs->super.bytes_used)
     {
         printf("Invalid directory block offset: 0x%llu >= bytes_used=0x%llu\n",
-               base_offset, fs->super.bytes_used);
+               (unsigned long long)base_offset, (unsigned long long)fs->super.bytes_used);
         return SQUASH_ERROR_INVALID_FILE;
     }
 
     dir_entries_list_t entries_list = {0};
+    entries_list.arena = arena;
     uint8_t *uncompressed_data = NULL;
     size_t uncompressed_size = 0;
     uint64_t current_offset = base_offset;
@@ -127,17 +163,13 @@ SQUASH_API squash_error_t squash_opendir(squash_fs_t *fs, squash_dir_inode_t *di
         if (!uncompressed_data || pos >= uncompressed_size)
         {
             size_t compressed_size = 0;
-            free(uncompressed_data);
+            squash_buffer_pool_release(&fs->buffer_pool, uncompressed_data);
             uncompressed_data = NULL;
-            printf("Loading new block at offset 0x%llx\n", current_offset);
+            printf("Loading new block at offset 0x%llx\n", (unsigned long long)current_offset);
             err = squash_read_metadata_block(fs, current_offset, &uncompressed_data, &uncompressed_size, &compressed_size);
             if (err != SQUASH_OK)
             {
-                for (size_t i = 0; i < entries_list.count; i++)
-                {
-                    squash_free_dir_entry(entries_list.entries[i]);
-                }
-                free(entries_list.entries);
+                free_entries_list(&entries_list);
                 return err;
             }
             current_offset += 2 + compressed_size;
@@ -163,12 +195,8 @@ SQUASH_API squash_error_t squash_opendir(squash_fs_t *fs, squash_dir_inode_t *di
         if (err != SQUASH_OK)
         {
             printf("Failed to read group header: %s\n", squash_strerror(err));
-            free(uncompressed_data);
-            for (size_t i = 0; i < entries_list.count; i++)
-            {
-                squash_free_dir_entry(entries_list.entries[i]);
-            }
-            free(entries_list.entries);
+            squash_buffer_pool_release(&fs->buffer_pool, uncompressed_data);
+            free_entries_list(&entries_list);
             return err;
         }
 
@@ -198,12 +226,8 @@ SQUASH_API squash_error_t squash_opendir(squash_fs_t *fs, squash_dir_inode_t *di
             if (err != SQUASH_OK)
             {
                 printf("Failed to read entry header %u: %s\n", i, squash_strerror(err));
-                free(uncompressed_data);
-                for (size_t j = 0; j < entries_list.count; j++)
-                {
-                    squash_free_dir_entry(entries_list.entries[j]);
-                }
-                free(entries_list.entries);
+                squash_buffer_pool_release(&fs->buffer_pool, uncompressed_data);
+                free_entries_list(&entries_list);
                 return err;
             }
 
@@ -226,12 +250,8 @@ SQUASH_API squash_error_t squash_opendir(squash_fs_t *fs, squash_dir_inode_t *di
             if (type < SQUASHFS_DIR_TYPE || type > SQUASHFS_CHRDEV_TYPE)
             {
                 printf("Invalid entry type: type=%u\n", type);
-                free(uncompressed_data);
-                for (size_t j = 0; j < entries_list.count; j++)
-                {
-                    squash_free_dir_entry(entries_list.entries[j]);
-                }
-                free(entries_list.entries);
+                squash_buffer_pool_release(&fs->buffer_pool, uncompressed_data);
+                free_entries_list(&entries_list);
                 return SQUASH_ERROR_INVALID_FILE;
             }
 
@@ -239,12 +259,8 @@ SQUASH_API squash_error_t squash_opendir(squash_fs_t *fs, squash_dir_inode_t *di
             if (name_size == 0 || name_size > 255)
             {
                 printf("Invalid entry name size: name_size=%u\n", name_size);
-                free(uncompressed_data);
-                for (size_t j = 0; j < entries_list.count; j++)
-                {
-                    squash_free_dir_entry(entries_list.entries[j]);
-                }
-                free(entries_list.entries);
+                squash_buffer_pool_release(&fs->buffer_pool, uncompressed_data);
+                free_entries_list(&entries_list);
                 return SQUASH_ERROR_INVALID_FILE;
             }
 
@@ -257,25 +273,17 @@ SQUASH_API squash_error_t squash_opendir(squash_fs_t *fs, squash_dir_inode_t *di
             if (left_in_dir < name_size + 1) // +1 for null terminator in SquashFS
             {
                 printf("Not enough data for entry name: left_in_dir=%zu, name_size=%u\n", left_in_dir, name_size + 1);
-                free(uncompressed_data);
-                for (size_t j = 0; j < entries_list.count; j++)
-                {
-                    squash_free_dir_entry(entries_list.entries[j]);
-                }
-                free(entries_list.entries);
+                squash_buffer_pool_release(&fs->buffer_pool, uncompressed_data);
+                free_entries_list(&entries_list);
                 return SQUASH_ERROR_INVALID_FILE;
             }
 
-            char *name = malloc(name_size + 1); // только +1 для завершающего нуля
+            char *name = dir_alloc(arena, name_size + 1); // только +1 для завершающего нуля
             if (!name)
             {
                 printf("Memory allocation failed for name\n");
-                free(uncompressed_data);
-                for (size_t j = 0; j < entries_list.count; j++)
-                {
-                    squash_free_dir_entry(entries_list.entries[j]);
-                }
-                free(entries_list.entries);
+                squash_buffer_pool_release(&fs->buffer_pool, uncompressed_data);
+                free_entries_list(&entries_list);
                 return SQUASH_ERROR_MEMORY;
             }
 
@@ -285,13 +293,9 @@ SQUASH_API squash_error_t squash_opendir(squash_fs_t *fs, squash_dir_inode_t *di
             if (err != SQUASH_OK)
             {
                 printf("Failed to read entry name: %s\n", squash_strerror(err));
-                free(name);
-                free(uncompressed_data);
-                for (size_t j = 0; j < entries_list.count; j++)
-                {
-                    squash_free_dir_entry(entries_list.entries[j]);
-                }
-                free(entries_list.entries);
+                dir_free(arena, name);
+                squash_buffer_pool_release(&fs->buffer_pool, uncompressed_data);
+                free_entries_list(&entries_list);
                 return err;
             }
             name[name_size] = '\0';
@@ -301,7 +305,7 @@ SQUASH_API squash_error_t squash_opendir(squash_fs_t *fs, squash_dir_inode_t *di
             // Пропускаем . и ..
             if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
             {
-                free(name);
+                dir_free(arena, name);
                 continue;
             }
 
@@ -310,20 +314,16 @@ SQUASH_API squash_error_t squash_opendir(squash_fs_t *fs, squash_dir_inode_t *di
             uint64_t entry_inode_ref = ((uint64_t)start_block << 16) | ((uint16_t)offset_field);
 
             printf("Creating entry: name='%s', inode_ref=0x%llx, inode_number=%u, type=%u\n",
-                   name, entry_inode_ref, inode_number, type);
+                   name, (unsigned long long)entry_inode_ref, inode_number, type);
 
             // Создаем запись
-            squash_dir_entry_t *entry = malloc(sizeof(squash_dir_entry_t));
+            squash_dir_entry_t *entry = dir_alloc(arena, sizeof(squash_dir_entry_t));
             if (!entry)
             {
                 printf("Memory allocation failed for entry\n");
-                free(name);
-                free(uncompressed_data);
-                for (size_t j = 0; j < entries_list.count; j++)
-                {
-                    squash_free_dir_entry(entries_list.entries[j]);
-                }
-                free(entries_list.entries);
+                dir_free(arena, name);
+                squash_buffer_pool_release(&fs->buffer_pool, uncompressed_data);
+                free_entries_list(&entries_list);
                 return SQUASH_ERROR_MEMORY;
             }
 
@@ -337,31 +337,25 @@ SQUASH_API squash_error_t squash_opendir(squash_fs_t *fs, squash_dir_inode_t *di
             if (err != SQUASH_OK)
             {
                 printf("Failed to add entry %u: %s\n", i, squash_strerror(err));
-                squash_free_dir_entry(entry);
-                free(uncompressed_data);
-                for (size_t j = 0; j < entries_list.count; j++)
-                {
-                    squash_free_dir_entry(entries_list.entries[j]);
-                }
-                free(entries_list.entries);
+                if (!arena)
+                    squash_free_dir_entry(entry);
+                squash_buffer_pool_release(&fs->buffer_pool, uncompressed_data);
+                free_entries_list(&entries_list);
                 return err;
             }
         }
     }
-    free(uncompressed_data);
+    squash_buffer_pool_release(&fs->buffer_pool, uncompressed_data);
 
-    *iterator = malloc(sizeof(squash_dir_iterator_t));
+    *iterator = dir_alloc(arena, sizeof(squash_dir_iterator_t));
     if (!*iterator)
     {
-        for (size_t i = 0; i < entries_list.count; i++)
-        {
-            squash_free_dir_entry(entries_list.entries[i]);
-        }
-        free(entries_list.entries);
+        free_entries_list(&entries_list);
         return SQUASH_ERROR_MEMORY;
     }
 
     (*iterator)->fs = fs;
+    (*iterator)->arena = arena;
     (*iterator)->dir_inode = dir_inode;
     (*iterator)->uncompressed_data = (uint8_t *)entries_list.entries;
     (*iterator)->uncompressed_size = entries_list.count;
@@ -372,6 +366,35 @@ SQUASH_API squash_error_t squash_opendir(squash_fs_t *fs, squash_dir_inode_t *di
     return SQUASH_OK;
 }
 
+SQUASH_API squash_error_t squash_opendir(squash_fs_t *fs, squash_dir_inode_t *dir_inode, squash_dir_iterator_t **iterator)
+{
+    if (!fs)
+    {
+        return SQUASH_ERROR_INVALID_FILE;
+    }
+    squash_mutex_lock(&fs->lock);
+    squash_error_t err = opendir_internal(fs, dir_inode, NULL, iterator);
+    squash_mutex_unlock(&fs->lock);
+    return err;
+}
+
+SQUASH_API squash_error_t squash_opendir_arena(squash_fs_t *fs, squash_dir_inode_t *dir_inode,
+                                              squash_arena_t *arena, squash_dir_iterator_t **iterator)
+{
+    if (!arena)
+    {
+        return SQUASH_ERROR_INVALID_ARGUMENT;
+    }
+    if (!fs)
+    {
+        return SQUASH_ERROR_INVALID_FILE;
+    }
+    squash_mutex_lock(&fs->lock);
+    squash_error_t err = opendir_internal(fs, dir_inode, arena, iterator);
+    squash_mutex_unlock(&fs->lock);
+    return err;
+}
+
 SQUASH_API squash_error_t squash_readdir(squash_dir_iterator_t *iterator, squash_dir_entry_t **entry)
 {
     if (!iterator || !entry || iterator->finished)
@@ -392,6 +415,14 @@ SQUASH_API squash_error_t squash_readdir(squash_dir_iterator_t *iterator, squash
     }
 
     squash_dir_entry_t *src = entries[iterator->current_entry_index];
+    if (iterator->arena)
+    {
+        // Запись живёт в арене - отдаём без копирования
+        *entry = src;
+        iterator->current_entry_index++;
+        return SQUASH_OK;
+    }
+
     *entry = malloc(sizeof(squash_dir_entry_t));
     if (!*entry)
     {
@@ -412,7 +443,7 @@ SQUASH_API squash_error_t squash_readdir(squash_dir_iterator_t *iterator, squash
     memcpy((*entry)->name, src->name, src->size);
 
     printf("Returning directory entry: name=%s, inode_ref=0x%llx, inode_number=%u, type=%u\n",
-           (*entry)->name, (*entry)->inode_ref, (*entry)->inode_number, (*entry)->type);
+           (*entry)->name, (unsigned long long)(*entry)->inode_ref, (*entry)->inode_number, (*entry)->type);
 
     iterator->current_entry_index++;
 
@@ -423,6 +454,8 @@ SQUASH_API void squash_closedir(squash_dir_iterator_t *iterator)
 {
     if (iterator)
     {
+        if (iterator->arena)
+            return; // Итератор и записи освобождаются вместе с ареной
         if (iterator->uncompressed_data)
         {
             squash_dir_entry_t **entries = (squash_dir_entry_t **)iterator->uncompressed_data;
@@ -8,8 +8,173 @@
 #include <string.h>
 #include "../include/libsquash/squash.h"
 
-SQUASH_API squash_error_t squash_read_file(squash_fs_t *fs, squash_reg_inode_t *inode,
-                                           void *buffer, size_t offset, size_t size, size_t *bytes_read)
+// Блок уже в одном из уровней кэша: его отдаёт обычный путь (squash_read_data_block) без чтения с диска
+static bool block_cached(squash_fs_t *fs, uint64_t disk_offset)
+{
+    return squash_fs_cache_contains(fs, SQUASH_CACHE_TIER_BLOCKS, disk_offset) ||
+           squash_fs_cache_contains(fs, SQUASH_CACHE_TIER_COMPRESSED, disk_offset);
+}
+
+// Читает серию блоков файла [idx, idx + *run) одним запросом и распаковывает их сразу в буфер
+// пользователя; блок, который попадает в буфер не целиком, распаковывается через буфер пула.
+// Распакованные блоки попадают в кэш, как и при чтении по одному
+static squash_error_t read_file_block_run(squash_fs_t *fs, squash_reg_inode_t *inode, uint32_t idx, uint32_t *run,
+                                          uint64_t disk_offset, size_t block_offset, uint8_t *dest, size_t remaining,
+                                          size_t *copied, uint64_t *disk_consumed)
+{
+    uint32_t block_size = fs->super.block_size;
+    bool once = fs->read_flags & SQUASH_READ_NOCACHE;
+
+    // Серия обрывается перед первым блоком, который уже есть в кэше
+    uint64_t block_disk = disk_offset;
+    for (uint32_t i = 0; i < *run; i++)
+    {
+        uint32_t size = inode->block_list[idx + i] & ((1 << 24) - 1);
+        if (i > 0 && size != 0 && block_cached(fs, block_disk))
+        {
+            *run = i;
+            break;
+        }
+        block_disk += size;
+    }
+
+    const uint8_t *raw = NULL;
+    squash_error_t err = squash_read_block_run(fs, inode->block_list, idx, run, disk_offset, &raw);
+    if (err != SQUASH_OK)
+    {
+        return err;
+    }
+
+    // Первый проход: раскладываем блоки по непересекающимся участкам буфера пользователя
+    // (или по временным буферам для неполных блоков), затем распаковываем их вместе
+    squash_decode_job_t *jobs = calloc(*run, sizeof(squash_decode_job_t));
+    if (!jobs)
+    {
+        return SQUASH_ERROR_MEMORY;
+    }
+
+    uint32_t count = 0;
+    size_t pos = 0;
+    size_t out = 0;
+    for (; count < *run && out < remaining; count++)
+    {
+        uint32_t block = inode->block_list[idx + count];
+        uint32_t compressed_size = block & ((1 << 24) - 1);
+        size_t expected = (size_t)MIN(block_size, inode->file_size - (uint64_t)(idx + count) * block_size);
+        size_t skip = count == 0 ? block_offset : 0;
+        size_t want = MIN(expected - skip, remaining - out);
+        squash_decode_job_t *job = &jobs[count];
+
+        job->src = raw + pos;
+        job->src_size = compressed_size;
+        job->compressed = !(block & (1 << 24));
+        if (compressed_size != 0 && job->compressed)
+        {
+            // Сжатые байты уже прочитаны в fs->io_buffer - копия идёт в сжатый уровень кэша
+            squash_fs_cache_put(fs, SQUASH_CACHE_TIER_COMPRESSED, disk_offset + pos, job->src, compressed_size, 0,
+                                once);
+        }
+        if (compressed_size == 0)
+        {
+            // Sparse-блок внутри серии
+            memset(dest + out, 0, want);
+        }
+        else if (skip == 0 && want == expected)
+        {
+            // Блок целиком помещается в буфер пользователя - распаковываем без промежуточной копии
+            job->dst = dest + out;
+            job->dst_capacity = expected;
+        }
+        else
+        {
+            job->dst = squash_buffer_pool_acquire(&fs->buffer_pool);
+            job->dst_capacity = block_size;
+            if (!job->dst)
+            {
+                err = SQUASH_ERROR_MEMORY;
+                count++;
+                break;
+            }
+        }
+
+        out += want;
+        pos += compressed_size;
+    }
+
+    if (err == SQUASH_OK)
+    {
+        err = squash_decode_blocks(fs, jobs, count);
+    }
+
+    // Второй проход: проверяем размеры и копируем неполные блоки
+    out = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        squash_decode_job_t *job = &jobs[i];
+        size_t expected = (size_t)MIN(block_size, inode->file_size - (uint64_t)(idx + i) * block_size);
+        size_t skip = i == 0 ? block_offset : 0;
+        size_t want = MIN(expected - skip, remaining - out);
+        bool direct = job->dst == dest + out;
+
+        if (err == SQUASH_OK && job->src_size != 0)
+        {
+            size_t need = direct ? expected : skip + want;
+            if (job->out_size < need || (direct && job->out_size != expected))
+            {
+                fprintf(stderr, "Failed to unpack block %u: size %zu, expected %zu\n", idx + i, job->out_size, need);
+                err = SQUASH_ERROR_INVALID_FILE;
+            }
+            else
+            {
+                squash_fs_cache_put(fs, SQUASH_CACHE_TIER_BLOCKS, disk_offset + (uint64_t)(job->src - raw), job->dst,
+                                    job->out_size, 0, once);
+                if (!direct)
+                {
+                    memcpy(dest + out, job->dst + skip, want);
+                }
+            }
+        }
+        if (job->src_size != 0 && !direct && job->dst)
+        {
+            squash_buffer_pool_release(&fs->buffer_pool, job->dst);
+        }
+        out += want;
+    }
+    free(jobs);
+
+    if (err != SQUASH_OK)
+    {
+        if (err != SQUASH_ERROR_INVALID_FILE)
+        {
+            fprintf(stderr, "Failed to unpack blocks %u..%u: %s\n", idx, idx + count - 1, squash_strerror(err));
+        }
+        return err;
+    }
+
+    *copied = out;
+    *disk_consumed = pos;
+    return SQUASH_OK;
+}
+
+// Число полных блоков файла в block_list (хвост во фрагменте не считается)
+uint32_t squash_file_block_count(squash_fs_t *fs, squash_reg_inode_t *inode)
+{
+    uint32_t block_size = fs->super.block_size;
+    if (inode->fragment != 0xFFFFFFFF && inode->file_size <= block_size)
+        return 0;
+
+    uint32_t nblocks = (uint32_t)((inode->file_size + block_size - 1) / block_size);
+    if (inode->fragment != 0xFFFFFFFF && inode->file_size % block_size != 0)
+    {
+        nblocks--;
+    }
+    return nblocks;
+}
+
+// handle (может быть NULL) даёт готовую таблицу смещений блоков, собственное окно read-ahead
+// и кэш последнего блока и хвоста из фрагмента
+static squash_error_t read_file_internal(squash_fs_t *fs, squash_reg_inode_t *inode, squash_file_t *handle,
+                                        void *buffer, uint64_t offset, size_t size, size_t *bytes_read)
 {
     if (!fs || !fs->file || !inode || !buffer || !bytes_read)
     {
@@ -27,49 +192,31 @@ SQUASH_API squash_error_t squash_read_file(squash_fs_t *fs, squash_reg_inode_t *
     *bytes_read = 0;
     if (offset >= inode->file_size)
     {
-        fprintf(stderr, "Offset %zu exceeds file size %llu\n", offset, inode->file_size);
+        fprintf(stderr, "Offset %llu exceeds file size %llu\n", (unsigned long long)offset,
+                (unsigned long long)inode->file_size);
         return SQUASH_OK;
     }
 
     size_t to_read = size;
-    if (offset + size > inode->file_size)
+    if (size > inode->file_size - offset)
     {
-        to_read = inode->file_size - offset;
+        to_read = (size_t)(inode->file_size - offset);
     }
 
     uint32_t block_size = fs->super.block_size;
     bool file_in_fragment_only = (inode->fragment != 0xFFFFFFFF &&
                                   inode->file_size <= block_size);
 
-    uint32_t nblocks;
-    if (file_in_fragment_only)
-        nblocks = 0;
-    else
-    {
-        nblocks = (inode->file_size + block_size - 1) / block_size;
-        if (inode->fragment != 0xFFFFFFFF && inode->file_size % block_size != 0)
-        {
-            nblocks--;
-        }
-    }
+    uint32_t nblocks = squash_file_block_count(fs, inode);
+    squash_readahead_t *ra = handle ? &handle->readahead : &fs->readahead;
 
-    uint32_t start_block_idx = offset / block_size;
-    size_t block_offset = offset % block_size;
+    uint32_t start_block_idx = (uint32_t)(offset / block_size);
+    size_t block_offset = (size_t)(offset % block_size);
     bool has_fragment = (inode->fragment != 0xFFFFFFFF);
 
-    fprintf(stderr, "Reading file: size=%llu, block_size=%u, nblocks=%u, fragment=%u, offset=%zu, file_in_fragment_only=%d\n",
-            inode->file_size, block_size, nblocks, inode->fragment, offset, file_in_fragment_only);
-
-    fprintf(stderr, "block_list: %p\n", inode->block_list);
-    if (inode->block_list)
-    {
-        fprintf(stderr, "Block_list entries: ");
-        for (uint32_t i = 0; i < nblocks; i++)
-        {
-            fprintf(stderr, "0x%08X ", inode->block_list[i]);
-        }
-        fprintf(stderr, "\n");
-    }
+    fprintf(stderr, "Reading file: size=%llu, block_size=%u, nblocks=%u, fragment=%u, offset=%llu, file_in_fragment_only=%d\n",
+            (unsigned long long)inode->file_size, block_size, nblocks, inode->fragment, (unsigned long long)offset,
+            file_in_fragment_only);
 
     if (!inode->block_list && start_block_idx < nblocks)
     {
@@ -81,12 +228,20 @@ SQUASH_API squash_error_t squash_read_file(squash_fs_t *fs, squash_reg_inode_t *
     uint8_t *dest = (uint8_t *)buffer;
     uint64_t current_file_offset = inode->start_block;
 
-    for (uint32_t i = 0; i < start_block_idx && i < nblocks; i++)
+    if (handle)
     {
-        uint32_t block = inode->block_list[i];
-        uint32_t compressed_size = block & ((1 << 24) - 1);
-        current_file_offset += compressed_size;
-        fprintf(stderr, "block[%u] offset contribution: (size) = 0x%x\n", i, compressed_size);
+        // Смещения блоков посчитаны при открытии файла
+        current_file_offset = handle->block_offsets[MIN(start_block_idx, nblocks)];
+    }
+    else
+    {
+        for (uint32_t i = 0; i < start_block_idx && i < nblocks; i++)
+        {
+            uint32_t block = inode->block_list[i];
+            uint32_t compressed_size = block & ((1 << 24) - 1);
+            current_file_offset += compressed_size;
+            fprintf(stderr, "block[%u] offset contribution: (size) = 0x%x\n", i, compressed_size);
+        }
     }
 
     while (remaining > 0)
@@ -109,12 +264,12 @@ SQUASH_API squash_error_t squash_read_file(squash_fs_t *fs, squash_reg_inode_t *
             uint64_t start_block = frag->start_block;
             uint32_t size = frag->size;
 
-            fprintf(stderr, "Fragment entry %u: start_block=0x%llx, size=%u\n", inode->fragment, start_block, size);
+            fprintf(stderr, "Fragment entry %u: start_block=0x%llx, size=%u\n", inode->fragment, (unsigned long long)start_block, size);
 
             if (start_block >= fs->super.bytes_used)
             {
                 fprintf(stderr, "Fragment start_block 0x%llx exceeds bytes_used 0x%llx\n",
-                        start_block, fs->super.bytes_used);
+                        (unsigned long long)start_block, (unsigned long long)fs->super.bytes_used);
                 return SQUASH_ERROR_INVALID_FILE;
             }
 
@@ -129,36 +284,52 @@ SQUASH_API squash_error_t squash_read_file(squash_fs_t *fs, squash_reg_inode_t *
 
             uint8_t *raw_block_data = NULL;
             size_t uncompressed_size = 0;
-            squash_error_t err = squash_read_data_block(fs, start_block,
-                                                        actual_compressed_size, is_compressed,
-                                                        &raw_block_data, &uncompressed_size);
-            if (err != SQUASH_OK)
+            if (handle && handle->fragment_data)
             {
-                fprintf(stderr, "Failed to read fragment block at 0x%llx\n", start_block);
-                return err;
+                raw_block_data = handle->fragment_data;
+                uncompressed_size = handle->fragment_size;
             }
+            else
+            {
+                squash_error_t err = squash_read_data_block(fs, start_block,
+                                                            actual_compressed_size, is_compressed,
+                                                            &raw_block_data, &uncompressed_size);
+                if (err != SQUASH_OK)
+                {
+                    fprintf(stderr, "Failed to read fragment block at 0x%llx\n", (unsigned long long)start_block);
+                    return err;
+                }
+                if (handle)
+                {
+                    // Хвост файла остаётся распакованным до закрытия handle
+                    handle->fragment_data = raw_block_data;
+                    handle->fragment_size = uncompressed_size;
+                }
+            }
+            uint8_t *release_data = handle ? NULL : raw_block_data;
 
-            size_t fragment_data_offset = inode->offset + (file_in_fragment_only ? block_offset : 0);
+            // block_offset - смещение внутри хвоста файла, который хранится во фрагменте
+            size_t fragment_data_offset = inode->offset + block_offset;
             if (uncompressed_size < fragment_data_offset)
             {
-                free(raw_block_data);
+                squash_buffer_pool_release(&fs->buffer_pool, release_data);
                 fprintf(stderr, "Uncompressed fragment size %zu too small for offset %zu\n",
                         uncompressed_size, fragment_data_offset);
                 return SQUASH_ERROR_INVALID_FILE;
             }
 
-            size_t remaining_file_size = file_in_fragment_only ? inode->file_size : (inode->file_size % block_size);
+            size_t remaining_file_size = (size_t)(file_in_fragment_only ? inode->file_size : (inode->file_size % block_size)) - block_offset;
             size_t copy_size = MIN(uncompressed_size - fragment_data_offset, MIN(remaining, remaining_file_size));
             if (copy_size > remaining_file_size)
             {
-                free(raw_block_data);
+                squash_buffer_pool_release(&fs->buffer_pool, release_data);
                 fprintf(stderr, "Copy size %zu exceeds remaining file size %zu\n",
                         copy_size, remaining_file_size);
                 return SQUASH_ERROR_INVALID_FILE;
             }
 
             memcpy(dest, raw_block_data + fragment_data_offset, copy_size);
-            free(raw_block_data);
+            squash_buffer_pool_release(&fs->buffer_pool, release_data);
 
             *bytes_read += copy_size;
             dest += copy_size;
@@ -167,8 +338,8 @@ SQUASH_API squash_error_t squash_read_file(squash_fs_t *fs, squash_reg_inode_t *
         }
         else if (start_block_idx < nblocks)
         {
-            size_t remaining_file_size = inode->file_size - (start_block_idx * block_size);
-            size_t expected_uncompressed_size = MIN(block_size, remaining_file_size);
+            uint64_t remaining_file_size = inode->file_size - (uint64_t)start_block_idx * block_size;
+            size_t expected_uncompressed_size = (size_t)MIN(block_size, remaining_file_size);
 
             uint32_t block = inode->block_list[start_block_idx];
             bool is_compressed = !(block & (1 << 24));
@@ -180,6 +351,7 @@ SQUASH_API squash_error_t squash_read_file(squash_fs_t *fs, squash_reg_inode_t *
                 size_t to_zero = MIN(remaining, expected_uncompressed_size - block_offset);
                 if (to_zero > 0)
                 {
+                    squash_readahead_skip(ra, inode, start_block_idx);
                     memset(dest, 0, to_zero);
                     *bytes_read += to_zero;
                     dest += to_zero;
@@ -198,29 +370,91 @@ SQUASH_API squash_error_t squash_read_file(squash_fs_t *fs, squash_reg_inode_t *
             }
 
             fprintf(stderr, "Reading block: idx=%u, compressed=%d, compressed_size=%u, file_offset=0x%llx, expected_uncompressed_size=%zu\n",
-                    start_block_idx, is_compressed, compressed_size, current_file_offset, expected_uncompressed_size);
+                    start_block_idx, is_compressed, compressed_size, (unsigned long long)current_file_offset, expected_uncompressed_size);
 
             if (current_file_offset + compressed_size > fs->super.bytes_used)
             {
                 fprintf(stderr, "Block offset 0x%llx + size %u exceeds bytes_used 0x%llx\n",
-                        current_file_offset, compressed_size, fs->super.bytes_used);
+                        (unsigned long long)current_file_offset, compressed_size, (unsigned long long)fs->super.bytes_used);
                 return SQUASH_ERROR_INVALID_FILE;
             }
 
+            // Запрос покрывает несколько блоков, которых нет в окне read-ahead: читаем их одной серией
+            uint64_t request_end = (uint64_t)start_block_idx * block_size + block_offset + remaining;
+            uint32_t last_block_idx = MIN((uint32_t)((request_end - 1) / block_size), nblocks - 1);
+            uint32_t run = last_block_idx - start_block_idx + 1;
+            if (run >= 2 && !squash_readahead_contains(ra, inode, start_block_idx) &&
+                !block_cached(fs, current_file_offset))
+            {
+                size_t copied = 0;
+                uint64_t disk_consumed = 0;
+                squash_error_t err = read_file_block_run(fs, inode, start_block_idx, &run, current_file_offset,
+                                                         block_offset, dest, remaining, &copied, &disk_consumed);
+                if (err != SQUASH_OK)
+                {
+                    fprintf(stderr, "Failed to read block run at 0x%llx\n", (unsigned long long)current_file_offset);
+                    return err;
+                }
+                squash_readahead_advance(fs, ra, inode, start_block_idx + run);
+
+                *bytes_read += copied;
+                dest += copied;
+                remaining -= copied;
+                current_file_offset += disk_consumed;
+                start_block_idx += run;
+                block_offset = 0;
+                continue;
+            }
+
+            // Сначала пробуем окно упреждающего чтения, при случайном доступе читаем блок напрямую
+            const uint8_t *block_data = NULL;
             uint8_t *uncompressed_data = NULL;
             size_t uncompressed_size = 0;
-            squash_error_t err = squash_read_data_block(fs, current_file_offset,
-                                                        compressed_size, is_compressed,
-                                                        &uncompressed_data, &uncompressed_size);
+            squash_error_t err;
+            if (handle && handle->last_data && handle->last_block == start_block_idx)
+            {
+                // Повторное чтение из последнего распакованного блока
+                block_data = handle->last_data;
+                uncompressed_size = handle->last_size;
+                err = SQUASH_OK;
+            }
+            else if (is_compressed && squash_partial_contains(fs, current_file_offset) &&
+                     !squash_readahead_contains(ra, inode, start_block_idx))
+            {
+                // Блок уже частично распакован: отдаём готовый префикс или продолжаем поток
+                err = squash_partial_read(fs, current_file_offset, compressed_size, expected_uncompressed_size,
+                                          block_offset + MIN(remaining, expected_uncompressed_size - block_offset),
+                                          &block_data, &uncompressed_size);
+            }
+            else
+            {
+                err = squash_readahead_get(fs, ra, inode, start_block_idx, nblocks,
+                                           current_file_offset, &block_data, &uncompressed_size);
+                size_t needed = block_offset + MIN(remaining, expected_uncompressed_size - block_offset);
+                if (err == SQUASH_ERROR_NOT_FOUND && is_compressed && needed < expected_uncompressed_size &&
+                    squash_decompressor_supports_partial(fs->decompressor))
+                {
+                    // Нужен только префикс блока: распаковываем до него и сохраняем состояние кодека
+                    err = squash_partial_read(fs, current_file_offset, compressed_size, expected_uncompressed_size,
+                                              needed, &block_data, &uncompressed_size);
+                }
+                else if (err == SQUASH_ERROR_NOT_FOUND)
+                {
+                    err = squash_read_data_block(fs, current_file_offset,
+                                                 compressed_size, is_compressed,
+                                                 &uncompressed_data, &uncompressed_size);
+                    block_data = uncompressed_data;
+                }
+            }
             if (err != SQUASH_OK)
             {
-                fprintf(stderr, "Failed to read block at 0x%llx\n", current_file_offset);
+                fprintf(stderr, "Failed to read block at 0x%llx\n", (unsigned long long)current_file_offset);
                 return err;
             }
 
             if (uncompressed_size < block_offset)
             {
-                free(uncompressed_data);
+                squash_buffer_pool_release(&fs->buffer_pool, uncompressed_data);
                 fprintf(stderr, "Uncompressed block size %zu too small for offset %zu\n",
                         uncompressed_size, block_offset);
                 return SQUASH_ERROR_INVALID_FILE;
@@ -228,8 +462,18 @@ SQUASH_API squash_error_t squash_read_file(squash_fs_t *fs, squash_reg_inode_t *
 
             size_t copy_size = MIN(uncompressed_size - block_offset, MIN(remaining, expected_uncompressed_size));
             fprintf(stderr, "Copying %zu bytes from block %u\n", copy_size, start_block_idx);
-            memcpy(dest, uncompressed_data + block_offset, copy_size);
-            free(uncompressed_data);
+            memcpy(dest, block_data + block_offset, copy_size);
+            if (handle && uncompressed_data)
+            {
+                squash_buffer_pool_release(&fs->buffer_pool, handle->last_data);
+                handle->last_data = uncompressed_data;
+                handle->last_block = start_block_idx;
+                handle->last_size = uncompressed_size;
+            }
+            else
+            {
+                squash_buffer_pool_release(&fs->buffer_pool, uncompressed_data);
+            }
 
             *bytes_read += copy_size;
             dest += copy_size;
@@ -255,6 +499,29 @@ SQUASH_API squash_error_t squash_read_file(squash_fs_t *fs, squash_reg_inode_t *
     return SQUASH_OK;
 }
 
+SQUASH_API squash_error_t squash_read_file(squash_fs_t *fs, squash_reg_inode_t *inode,
+                                           void *buffer, uint64_t offset, size_t size, size_t *bytes_read)
+{
+    return squash_read_file_ex(fs, inode, buffer, offset, size, bytes_read, 0);
+}
+
+SQUASH_API squash_error_t squash_read_file_ex(squash_fs_t *fs, squash_reg_inode_t *inode, void *buffer,
+                                              uint64_t offset, size_t size, size_t *bytes_read, uint32_t flags)
+{
+    if (!fs)
+    {
+        return SQUASH_ERROR_INVALID_FILE;
+    }
+    squash_mutex_lock(&fs->lock);
+    // Флаги складываются с флагами внешнего вызова: чтения внутри извлечения остаются однократными
+    uint32_t saved_flags = fs->read_flags;
+    fs->read_flags |= flags;
+    squash_error_t err = read_file_internal(fs, inode, NULL, buffer, offset, size, bytes_read);
+    fs->read_flags = saved_flags;
+    squash_mutex_unlock(&fs->lock);
+    return err;
+}
+
 SQUASH_API squash_error_t squash_get_file_size(squash_reg_inode_t *inode, uint64_t *size)
 {
     if (!inode || !size)
@@ -269,4 +536,192 @@ SQUASH_API squash_error_t squash_get_file_size(squash_reg_inode_t *inode, uint64
 
     *size = inode->file_size;
     return SQUASH_OK;
-}
\ No newline at end of file
+}
+
+SQUASH_API squash_error_t squash_file_open_inode(squash_fs_t *fs, squash_off_t inode_ref, squash_file_t **file)
+{
+    if (!fs || !file)
+    {
+        return SQUASH_ERROR_INVALID_ARGUMENT;
+    }
+
+    void *inode;
+    squash_error_t err = squash_read_inode(fs, inode_ref, &inode);
+    if (err != SQUASH_OK)
+    {
+        return err;
+    }
+    if (!squash_is_file(inode))
+    {
+        squash_free_inode(inode);
+        return SQUASH_ERROR_NOT_FILE;
+    }
+
+    squash_file_t *f = calloc(1, sizeof(squash_file_t));
+    if (!f)
+    {
+        squash_free_inode(inode);
+        return SQUASH_ERROR_MEMORY;
+    }
+    f->fs = fs;
+    f->inode = (squash_reg_inode_t *)inode;
+    f->nblocks = squash_file_block_count(fs, f->inode);
+
+    // Таблица смещений блоков на диске: чтение с любой позиции без суммирования block_list
+    f->block_offsets = malloc((f->nblocks + 1) * sizeof(uint64_t));
+    if (!f->block_offsets || (f->nblocks > 0 && !f->inode->block_list))
+    {
+        err = f->block_offsets ? SQUASH_ERROR_INVALID_INODE : SQUASH_ERROR_MEMORY;
+        free(f->block_offsets);
+        free(f);
+        squash_free_inode(inode);
+        return err;
+    }
+    uint64_t disk_offset = f->inode->start_block;
+    for (uint32_t i = 0; i < f->nblocks; i++)
+    {
+        f->block_offsets[i] = disk_offset;
+        disk_offset += f->inode->block_list[i] & ((1 << 24) - 1);
+    }
+    f->block_offsets[f->nblocks] = disk_offset;
+
+    err = squash_readahead_init(&f->readahead, fs->options.readahead_max_window);
+    if (err != SQUASH_OK)
+    {
+        free(f->block_offsets);
+        free(f);
+        squash_free_inode(inode);
+        return err;
+    }
+
+    *file = f;
+    return SQUASH_OK;
+}
+
+SQUASH_API squash_error_t squash_file_open(squash_fs_t *fs, const char *path, squash_file_t **file)
+{
+    if (!fs || !path || !file)
+    {
+        return SQUASH_ERROR_INVALID_ARGUMENT;
+    }
+
+    squash_off_t inode_ref;
+    squash_error_t err = squash_lookup_path(fs, path, &inode_ref);
+    if (err != SQUASH_OK)
+    {
+        return err;
+    }
+    return squash_file_open_inode(fs, inode_ref, file);
+}
+
+SQUASH_API squash_error_t squash_file_pread(squash_file_t *file, void *buffer, size_t size, uint64_t offset,
+                                           size_t *bytes_read)
+{
+    if (!file || !buffer || !bytes_read)
+    {
+        return SQUASH_ERROR_INVALID_ARGUMENT;
+    }
+
+    *bytes_read = 0;
+    if (offset >= file->inode->file_size || size == 0)
+    {
+        return SQUASH_OK;
+    }
+
+    squash_fs_t *fs = file->fs;
+    squash_mutex_lock(&fs->lock);
+    uint32_t saved_flags = fs->read_flags;
+    fs->read_flags |= file->read_flags;
+    squash_error_t err = read_file_internal(fs, file->inode, file, buffer, offset, size, bytes_read);
+    fs->read_flags = saved_flags;
+    squash_mutex_unlock(&fs->lock);
+    return err;
+}
+
+SQUASH_API squash_error_t squash_file_set_flags(squash_file_t *file, uint32_t flags)
+{
+    if (!file)
+    {
+        return SQUASH_ERROR_INVALID_ARGUMENT;
+    }
+    file->read_flags = flags;
+    return SQUASH_OK;
+}
+
+SQUASH_API squash_error_t squash_file_read(squash_file_t *file, void *buffer, size_t size, size_t *bytes_read)
+{
+    if (!file)
+    {
+        return SQUASH_ERROR_INVALID_ARGUMENT;
+    }
+
+    squash_error_t err = squash_file_pread(file, buffer, size, file->position, bytes_read);
+    if (err == SQUASH_OK)
+    {
+        file->position += *bytes_read;
+    }
+    return err;
+}
+
+SQUASH_API squash_error_t squash_file_seek(squash_file_t *file, int64_t offset, int whence, uint64_t *position)
+{
+    if (!file)
+    {
+        return SQUASH_ERROR_INVALID_ARGUMENT;
+    }
+
+    int64_t base;
+    switch (whence)
+    {
+    case SEEK_SET:
+        base = 0;
+        break;
+    case SEEK_CUR:
+        base = (int64_t)file->position;
+        break;
+    case SEEK_END:
+        base = (int64_t)file->inode->file_size;
+        break;
+    default:
+        return SQUASH_ERROR_INVALID_ARGUMENT;
+    }
+
+    // Как и lseek, позволяет встать за конец файла (чтение там вернёт 0 байт)
+    if (offset < 0 && base + offset < 0)
+    {
+        return SQUASH_ERROR_INVALID_ARGUMENT;
+    }
+    file->position = (uint64_t)(base + offset);
+    if (position)
+    {
+        *position = file->position;
+    }
+    return SQUASH_OK;
+}
+
+SQUASH_API uint64_t squash_file_tell(squash_file_t *file)
+{
+    return file ? file->position : 0;
+}
+
+SQUASH_API uint64_t squash_file_size(squash_file_t *file)
+{
+    return file ? file->inode->file_size : 0;
+}
+
+SQUASH_API void squash_file_close(squash_file_t *file)
+{
+    if (!file)
+        return;
+
+    squash_fs_t *fs = file->fs;
+    squash_mutex_lock(&fs->lock);
+    squash_buffer_pool_release(&fs->buffer_pool, file->last_data);
+    squash_buffer_pool_release(&fs->buffer_pool, file->fragment_data);
+    squash_readahead_destroy(fs, &file->readahead);
+    squash_mutex_unlock(&fs->lock);
+
+    free(file->block_offsets);
+    squash_free_inode(file->inode);
+    free(file);
+}
@@ -0,0 +1,98 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../include/libsquash/squash.h"
+
+// Та же схема, что и у visited: открытая адресация с линейным пробированием, заполненность до 1/2
+
+static inline size_t hardlink_hash(uint32_t inode_number)
+{
+    uint32_t x = inode_number;
+    x ^= x >> 16;
+    x *= 0x45d9f3bu;
+    x ^= x >> 16;
+    return (size_t)x;
+}
+
+squash_error_t squash_hardlinks_init(squash_hardlinks_t *links, size_t initial_capacity) {
+    size_t capacity = 16;
+    while (capacity < initial_capacity * 2) {
+        capacity *= 2;
+    }
+    links->entries = calloc(capacity, sizeof(squash_hardlink_entry_t));
+    if (!links->entries) {
+        return SQUASH_ERROR_MEMORY;
+    }
+    links->count = 0;
+    links->capacity = capacity;
+    return SQUASH_OK;
+}
+
+void squash_hardlinks_free(squash_hardlinks_t *links) {
+    if (links->entries) {
+        for (size_t i = 0; i < links->capacity; i++) {
+            free(links->entries[i].path);
+        }
+        free(links->entries);
+    }
+    links->entries = NULL;
+    links->count = 0;
+    links->capacity = 0;
+}
+
+static squash_hardlink_entry_t *hardlink_slot(squash_hardlink_entry_t *entries, size_t capacity, uint32_t inode_number) {
+    size_t mask = capacity - 1;
+    size_t i = hardlink_hash(inode_number) & mask;
+    while (entries[i].inode_number != 0 && entries[i].inode_number != inode_number) {
+        i = (i + 1) & mask;
+    }
+    return &entries[i];
+}
+
+static squash_error_t hardlinks_grow(squash_hardlinks_t *links) {
+    size_t new_capacity = links->capacity * 2;
+    squash_hardlink_entry_t *new_entries = calloc(new_capacity, sizeof(squash_hardlink_entry_t));
+    if (!new_entries) {
+        return SQUASH_ERROR_MEMORY;
+    }
+    for (size_t i = 0; i < links->capacity; i++) {
+        if (links->entries[i].inode_number != 0) {
+            *hardlink_slot(new_entries, new_capacity, links->entries[i].inode_number) = links->entries[i];
+        }
+    }
+    free(links->entries);
+    links->entries = new_entries;
+    links->capacity = new_capacity;
+    return SQUASH_OK;
+}
+
+squash_error_t squash_hardlinks_add(squash_hardlinks_t *links, uint32_t inode_number, const char *path) {
+    if (inode_number == 0 || !path) {
+        return SQUASH_ERROR_INVALID_ARGUMENT;
+    }
+    if ((links->count + 1) * 2 > links->capacity) {
+        squash_error_t err = hardlinks_grow(links);
+        if (err != SQUASH_OK) {
+            return err;
+        }
+    }
+
+    squash_hardlink_entry_t *slot = hardlink_slot(links->entries, links->capacity, inode_number);
+    if (slot->inode_number != 0) {
+        return SQUASH_OK; // Первая копия уже записана
+    }
+    slot->path = strdup(path);
+    if (!slot->path) {
+        return SQUASH_ERROR_MEMORY;
+    }
+    slot->inode_number = inode_number;
+    links->count++;
+    return SQUASH_OK;
+}
+
+const char *squash_hardlinks_find(squash_hardlinks_t *links, uint32_t inode_number) {
+    if (!links->entries || inode_number == 0) {
+        return NULL;
+    }
+    squash_hardlink_entry_t *slot = hardlink_slot(links->entries, links->capacity, inode_number);
+    return slot->inode_number != 0 ? slot->path : NULL;
+}
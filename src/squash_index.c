@@ -0,0 +1,596 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/libsquash/squash.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Индекс-спутник образа: файл, который отображается в память как есть.
+// Заголовок, хеш-таблица путей, записи инодов по возрастанию inode_ref, таблицы фрагментов и экспорта,
+// строки путей и сами иноды в формате таблицы инодов, уже распакованные. Секции выровнены на 8 байт
+
+#define SQUASH_INDEX_MAGIC "SQSHIDX1"
+#define SQUASH_INDEX_VERSION 1
+#define SQUASH_INDEX_MAX_PATH 4096
+#define SQUASH_INDEX_RECORD_PAD 8 // Нули после каждого inode
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t bytes_used;  // Образ, по которому построен индекс
+    uint32_t mkfs_time;
+    uint32_t block_size;
+    uint64_t root_inode;
+    uint64_t path_slots;  // Хеш-таблица путей, степень двойки
+    uint64_t paths_offset;
+    uint64_t inode_count;
+    uint64_t inodes_offset;
+    uint64_t fragment_count;
+    uint64_t fragments_offset;
+    uint64_t lookup_count; // Таблица экспорта: номер инода -> inode_ref (0 - её нет в образе)
+    uint64_t lookup_offset;
+    uint64_t names_offset;
+    uint64_t names_size;
+    uint64_t data_offset;
+    uint64_t data_size;
+} index_header_t;
+
+typedef struct
+{
+    uint64_t hash;        // 0 - пустой слот
+    uint64_t inode_ref;
+    uint64_t name_offset; // Полный путь ("/a/b") в области строк
+    uint32_t name_size;
+    uint16_t type;        // Тип записи директории (SQUASHFS_*_TYPE)
+    uint16_t reserved;
+} index_path_t;
+
+typedef struct
+{
+    uint64_t inode_ref;
+    uint64_t data_offset; // Относительно header.data_offset
+    uint32_t data_size;
+    uint32_t reserved;
+} index_inode_t;
+
+struct squash_index
+{
+    const uint8_t *base;
+    size_t size;
+    const index_header_t *header;
+    const index_path_t *paths;
+    const index_inode_t *inodes;
+    const char *names;
+    const uint8_t *data;
+#ifdef _WIN32
+    HANDLE mapping;
+#endif
+};
+
+// FNV-1a с перемешиванием как в squash_visited.c: пути с общим префиксом расходятся по всей таблице
+uint64_t squash_path_hash(const char *path, size_t len)
+{
+    uint64_t x = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++)
+    {
+        x ^= (uint8_t)path[i];
+        x *= 0x100000001b3ULL;
+    }
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return x ? x : 1;
+}
+
+static inline uint64_t align8(uint64_t offset)
+{
+    return (offset + 7) & ~(uint64_t)7;
+}
+
+static bool section_fits(const squash_index_t *index, uint64_t offset, uint64_t count, uint64_t item_size)
+{
+    return offset <= index->size && (offset & 7) == 0 && count <= (index->size - offset) / item_size;
+}
+
+static bool index_valid(squash_index_t *index, const squash_super_t *super)
+{
+    const index_header_t *h = index->header;
+    if (index->size < sizeof(index_header_t) || memcmp(h->magic, SQUASH_INDEX_MAGIC, 8) != 0 ||
+        h->version != SQUASH_INDEX_VERSION || h->header_size != sizeof(index_header_t))
+    {
+        fprintf(stderr, "Not a squash index file\n");
+        return false;
+    }
+    if (h->bytes_used != super->bytes_used || h->mkfs_time != super->mkfs_time ||
+        h->block_size != super->block_size || h->root_inode != super->root_inode)
+    {
+        fprintf(stderr, "Index was built for another image (bytes_used=%llu, mkfs_time=%u)\n",
+                (unsigned long long)h->bytes_used, h->mkfs_time);
+        return false;
+    }
+    if (h->path_slots == 0 || (h->path_slots & (h->path_slots - 1)) != 0 ||
+        !section_fits(index, h->paths_offset, h->path_slots, sizeof(index_path_t)) ||
+        !section_fits(index, h->inodes_offset, h->inode_count, sizeof(index_inode_t)) ||
+        !section_fits(index, h->fragments_offset, h->fragment_count, sizeof(struct squashfs_fragment_entry)) ||
+        !section_fits(index, h->lookup_offset, h->lookup_count, sizeof(uint64_t)) ||
+        !section_fits(index, h->names_offset, h->names_size, 1) ||
+        !section_fits(index, h->data_offset, h->data_size, 1))
+    {
+        fprintf(stderr, "Index file is truncated or corrupted\n");
+        return false;
+    }
+    return true;
+}
+
+squash_error_t squash_index_open(const char *path, const squash_super_t *super, squash_index_t **index)
+{
+    squash_index_t *idx = calloc(1, sizeof(squash_index_t));
+    if (!idx)
+        return SQUASH_ERROR_MEMORY;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    LARGE_INTEGER size;
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        free(idx);
+        return SQUASH_ERROR_IO;
+    }
+    idx->mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file); // Отображение держит файл само
+    idx->base = idx->mapping ? MapViewOfFile(idx->mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (!idx->base)
+    {
+        if (idx->mapping)
+            CloseHandle(idx->mapping);
+        free(idx);
+        return SQUASH_ERROR_IO;
+    }
+    idx->size = (size_t)size.QuadPart;
+#else
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        if (fd >= 0)
+            close(fd);
+        free(idx);
+        return SQUASH_ERROR_IO;
+    }
+    void *base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        free(idx);
+        return SQUASH_ERROR_IO;
+    }
+    idx->base = base;
+    idx->size = (size_t)st.st_size;
+#endif
+
+    idx->header = (const index_header_t *)idx->base;
+    if (!index_valid(idx, super))
+    {
+        squash_index_close(idx);
+        return SQUASH_ERROR_INVALID_INDEX;
+    }
+    idx->paths = (const index_path_t *)(idx->base + idx->header->paths_offset);
+    idx->inodes = (const index_inode_t *)(idx->base + idx->header->inodes_offset);
+    idx->names = (const char *)(idx->base + idx->header->names_offset);
+    idx->data = idx->base + idx->header->data_offset;
+    *index = idx;
+    return SQUASH_OK;
+}
+
+void squash_index_close(squash_index_t *index)
+{
+    if (!index)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(index->base);
+    CloseHandle(index->mapping);
+#else
+    munmap((void *)index->base, index->size);
+#endif
+    free(index);
+}
+
+// Путь в виде "/a/b": без повторных и завершающих '/'. false - путь с "." или "..", слишком длинный путь
+// или имя: такой разбирается обходом директорий, он же возвращает нужную ошибку
+static bool normalize_path(const char *path, char *out, size_t *len)
+{
+    size_t n = 0;
+    const char *cur = path;
+    while (*cur)
+    {
+        while (*cur == '/')
+            cur++;
+        if (!*cur)
+            break;
+        size_t clen = strcspn(cur, "/");
+        if ((clen == 1 && cur[0] == '.') || (clen == 2 && cur[0] == '.' && cur[1] == '.') || clen >= 1023)
+            return false;
+        if (n + 1 + clen >= SQUASH_INDEX_MAX_PATH)
+            return false;
+        out[n++] = '/';
+        memcpy(out + n, cur, clen);
+        n += clen;
+        cur += clen;
+    }
+    if (n == 0)
+        out[n++] = '/';
+    out[n] = '\0';
+    *len = n;
+    return true;
+}
+
+static const index_path_t *find_path(squash_index_t *index, const char *path, size_t len)
+{
+    const index_header_t *h = index->header;
+    uint64_t hash = squash_path_hash(path, len);
+    uint64_t mask = h->path_slots - 1;
+    for (uint64_t i = hash & mask, probes = 0; probes < h->path_slots; i = (i + 1) & mask, probes++)
+    {
+        const index_path_t *slot = &index->paths[i];
+        if (slot->hash == 0)
+            return NULL;
+        if (slot->hash == hash && slot->name_size == len && len <= h->names_size &&
+            slot->name_offset <= h->names_size - len &&
+            memcmp(index->names + slot->name_offset, path, len) == 0)
+            return slot;
+    }
+    return NULL;
+}
+
+static bool find_indexed(void *ctx, const char *path, size_t len, squash_off_t *inode_ref, uint16_t *type)
+{
+    const index_path_t *entry = find_path(ctx, path, len);
+    if (!entry)
+        return false;
+    *inode_ref = entry->inode_ref;
+    *type = entry->type;
+    return true;
+}
+
+bool squash_path_resolve(squash_path_find_fn find, void *ctx, const char *path, squash_off_t *inode_ref,
+                         squash_error_t *err)
+{
+    char normalized[SQUASH_INDEX_MAX_PATH];
+    size_t len;
+    if (!normalize_path(path, normalized, &len))
+        return false;
+
+    uint16_t type;
+    if (find(ctx, normalized, len, inode_ref, &type))
+    {
+        *err = SQUASH_OK;
+        return true;
+    }
+
+    // Таблица содержит все пути образа: промах окончательный. Ошибка - как у обхода: NOT_DIRECTORY,
+    // если на пути встретился не каталог
+    *err = SQUASH_ERROR_NOT_FOUND;
+    while (len > 1)
+    {
+        while (len > 0 && normalized[len - 1] != '/')
+            len--;
+        if (len > 1)
+            len--;
+        squash_off_t parent_ref;
+        if (find(ctx, normalized, len, &parent_ref, &type))
+        {
+            if (type != SQUASHFS_DIR_TYPE && type != SQUASHFS_LDIR_TYPE)
+                *err = SQUASH_ERROR_NOT_DIRECTORY;
+            break;
+        }
+    }
+    return true;
+}
+
+bool squash_index_lookup(squash_index_t *index, const char *path, squash_off_t *inode_ref, squash_error_t *err)
+{
+    return squash_path_resolve(find_indexed, index, path, inode_ref, err);
+}
+
+bool squash_index_inode(squash_index_t *index, squash_off_t inode_ref, const uint8_t **data, size_t *size)
+{
+    const index_header_t *h = index->header;
+    uint64_t lo = 0, hi = h->inode_count;
+    while (lo < hi)
+    {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (index->inodes[mid].inode_ref < inode_ref)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == h->inode_count || index->inodes[lo].inode_ref != inode_ref)
+        return false;
+
+    const index_inode_t *rec = &index->inodes[lo];
+    if (rec->data_offset > h->data_size || rec->data_size > h->data_size - rec->data_offset)
+        return false;
+    *data = index->data + rec->data_offset;
+    *size = rec->data_size;
+    return true;
+}
+
+bool squash_index_copy_fragments(squash_index_t *index, uint32_t count, struct squashfs_fragment_entry **table)
+{
+    if (!index)
+        return false;
+    const index_header_t *h = index->header;
+    if (count == 0 || h->fragment_count != count)
+        return false;
+    *table = malloc(count * sizeof(struct squashfs_fragment_entry));
+    if (!*table)
+        return false;
+    memcpy(*table, index->base + h->fragments_offset, count * sizeof(struct squashfs_fragment_entry));
+    return true;
+}
+
+bool squash_index_copy_lookup(squash_index_t *index, uint32_t count, uint64_t **table)
+{
+    if (!index)
+        return false;
+    const index_header_t *h = index->header;
+    if (count == 0 || h->lookup_count != count)
+        return false;
+    *table = malloc(count * sizeof(uint64_t));
+    if (!*table)
+        return false;
+    memcpy(*table, index->base + h->lookup_offset, count * sizeof(uint64_t));
+    return true;
+}
+
+// Построение индекса
+
+static int compare_refs(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Длина инода в таблице инодов: фиксированная часть типа плюс список блоков или цель ссылки.
+// Индекс директорий у расширенного каталога не сохраняется - разбор инода его не читает
+static squash_error_t inode_record_size(squash_fs_t *fs, void *inode, size_t *size)
+{
+    squash_base_inode_t *base = inode;
+    size_t fixed = 16; // Общая часть на диске
+    switch (base->inode_type)
+    {
+    case SQUASHFS_DIR_TYPE:
+        *size = fixed + 16;
+        return SQUASH_OK;
+    case SQUASHFS_LDIR_TYPE:
+        *size = fixed + 24;
+        return SQUASH_OK;
+    case SQUASHFS_REG_TYPE:
+    case SQUASHFS_LREG_TYPE:
+    {
+        squash_reg_inode_t *reg = inode;
+        uint64_t blocks = 0;
+        if (reg->fragment == 0xFFFFFFFF || reg->file_size > fs->super.block_size)
+        {
+            blocks = (reg->file_size + fs->super.block_size - 1) / fs->super.block_size;
+            if (reg->fragment != 0xFFFFFFFF && reg->file_size % fs->super.block_size != 0)
+                blocks--;
+        }
+        *size = fixed + (base->inode_type == SQUASHFS_REG_TYPE ? 16 : 40) + (size_t)blocks * sizeof(uint32_t);
+        return SQUASH_OK;
+    }
+    case SQUASHFS_SYMLINK_TYPE:
+    case SQUASHFS_LSYMLINK_TYPE:
+        *size = fixed + 8 + ((squash_symlink_inode_t *)inode)->target_size +
+                (base->inode_type == SQUASHFS_LSYMLINK_TYPE ? 4 : 0);
+        return SQUASH_OK;
+    case SQUASHFS_BLKDEV_TYPE:
+    case SQUASHFS_CHRDEV_TYPE:
+        *size = fixed + 8;
+        return SQUASH_OK;
+    case SQUASHFS_LBLKDEV_TYPE:
+    case SQUASHFS_LCHRDEV_TYPE:
+        *size = fixed + 12;
+        return SQUASH_OK;
+    case SQUASHFS_FIFO_TYPE:
+    case SQUASHFS_SOCKET_TYPE:
+        *size = fixed + 4;
+        return SQUASH_OK;
+    case SQUASHFS_LFIFO_TYPE:
+    case SQUASHFS_LSOCKET_TYPE:
+        *size = fixed + 8;
+        return SQUASH_OK;
+    default:
+        return SQUASH_ERROR_INVALID_INODE;
+    }
+}
+
+typedef struct
+{
+    index_inode_t *records;
+    uint8_t *data;
+    size_t data_size;
+    size_t data_capacity;
+} build_inodes_t;
+
+static squash_error_t collect_inodes(squash_fs_t *fs, const uint64_t *refs, size_t count, build_inodes_t *out)
+{
+    out->records = calloc(count ? count : 1, sizeof(index_inode_t));
+    if (!out->records)
+        return SQUASH_ERROR_MEMORY;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        void *inode;
+        squash_error_t err = squash_read_inode(fs, refs[i], &inode);
+        if (err != SQUASH_OK)
+            return err;
+        size_t size;
+        err = inode_record_size(fs, inode, &size);
+        squash_free_inode(inode);
+        if (err != SQUASH_OK)
+            return err;
+
+        // Разбор копирует структуры inode вместе с полем-указателем за концом записи на диске
+        size_t padded = size + SQUASH_INDEX_RECORD_PAD;
+        if (out->data_size + padded > out->data_capacity)
+        {
+            size_t capacity = out->data_capacity ? out->data_capacity * 2 : 64 * 1024;
+            while (capacity < out->data_size + padded)
+                capacity *= 2;
+            uint8_t *grown = realloc(out->data, capacity);
+            if (!grown)
+                return SQUASH_ERROR_MEMORY;
+            out->data = grown;
+            out->data_capacity = capacity;
+        }
+        err = read_n_bytes_from_metablocks(fs, fs->super.inode_table_start + (refs[i] >> 16), refs[i] & 0xFFFF, size,
+                                           out->data + out->data_size, NULL);
+        if (err != SQUASH_OK)
+            return err;
+
+        memset(out->data + out->data_size + size, 0, SQUASH_INDEX_RECORD_PAD);
+
+        out->records[i].inode_ref = refs[i];
+        out->records[i].data_offset = out->data_size;
+        out->records[i].data_size = (uint32_t)padded;
+        out->data_size += padded;
+    }
+    return SQUASH_OK;
+}
+
+static bool write_section(FILE *out, uint64_t *pos, uint64_t offset, const void *data, size_t size)
+{
+    static const uint8_t zeros[8];
+    if (offset > *pos && fwrite(zeros, 1, (size_t)(offset - *pos), out) != offset - *pos)
+        return false;
+    if (size > 0 && fwrite(data, 1, size, out) != size)
+        return false;
+    *pos = offset + size;
+    return true;
+}
+
+static squash_error_t write_index(squash_fs_t *fs, const char *index_path, const squash_path_index_t *paths,
+                                  build_inodes_t *inodes, size_t inode_count)
+{
+    index_header_t h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, SQUASH_INDEX_MAGIC, 8);
+    h.version = SQUASH_INDEX_VERSION;
+    h.header_size = sizeof(index_header_t);
+    h.bytes_used = fs->super.bytes_used;
+    h.mkfs_time = fs->super.mkfs_time;
+    h.block_size = fs->super.block_size;
+    h.root_inode = fs->super.root_inode;
+
+    // Слоты переносятся на те же места: адресация у файла та же, что у таблицы путей в памяти
+    h.path_slots = paths->slot_count;
+    index_path_t *slots = calloc(h.path_slots, sizeof(index_path_t));
+    if (!slots)
+        return SQUASH_ERROR_MEMORY;
+    for (size_t i = 0; i < paths->slot_count; i++)
+    {
+        if (!paths->slots[i])
+            continue;
+        const squash_path_entry_t *entry = &paths->entries[paths->slots[i] - 1];
+        slots[i].hash = entry->hash;
+        slots[i].inode_ref = entry->inode_ref;
+        slots[i].name_offset = entry->name_offset;
+        slots[i].name_size = entry->name_size;
+        slots[i].type = entry->type;
+    }
+
+    h.fragment_count = fs->fragment_table ? fs->super.fragments : 0;
+    h.lookup_count = fs->inode_lookup_table ? fs->super.inodes : 0;
+    h.inode_count = inode_count;
+    h.names_size = paths->names_size;
+    h.data_size = inodes->data_size;
+    h.paths_offset = align8(sizeof(h));
+    h.inodes_offset = align8(h.paths_offset + h.path_slots * sizeof(index_path_t));
+    h.fragments_offset = align8(h.inodes_offset + h.inode_count * sizeof(index_inode_t));
+    h.lookup_offset = align8(h.fragments_offset + h.fragment_count * sizeof(struct squashfs_fragment_entry));
+    h.names_offset = align8(h.lookup_offset + h.lookup_count * sizeof(uint64_t));
+    h.data_offset = align8(h.names_offset + h.names_size);
+
+    squash_error_t err = SQUASH_OK;
+    FILE *out = fopen(index_path, "wb");
+    uint64_t pos = 0;
+    if (!out ||
+        !write_section(out, &pos, 0, &h, sizeof(h)) ||
+        !write_section(out, &pos, h.paths_offset, slots, h.path_slots * sizeof(index_path_t)) ||
+        !write_section(out, &pos, h.inodes_offset, inodes->records, h.inode_count * sizeof(index_inode_t)) ||
+        !write_section(out, &pos, h.fragments_offset, fs->fragment_table,
+                       h.fragment_count * sizeof(struct squashfs_fragment_entry)) ||
+        !write_section(out, &pos, h.lookup_offset, fs->inode_lookup_table, h.lookup_count * sizeof(uint64_t)) ||
+        !write_section(out, &pos, h.names_offset, paths->names, h.names_size) ||
+        !write_section(out, &pos, h.data_offset, inodes->data, h.data_size))
+    {
+        fprintf(stderr, "Failed to write index %s\n", index_path);
+        err = SQUASH_ERROR_IO;
+    }
+    if (out && fclose(out) != 0 && err == SQUASH_OK)
+    {
+        fprintf(stderr, "Failed to write index %s\n", index_path);
+        err = SQUASH_ERROR_IO;
+    }
+    if (err != SQUASH_OK && out)
+        remove(index_path);
+
+    free(slots);
+    return err;
+}
+
+static squash_error_t index_build_internal(squash_fs_t *fs, const char *index_path)
+{
+    squash_path_index_t paths;
+    build_inodes_t inodes;
+    memset(&inodes, 0, sizeof(inodes));
+    uint64_t *refs = NULL;
+    size_t ref_count = 0;
+
+    squash_error_t err = squash_path_table_build(fs, &paths);
+    if (err == SQUASH_OK)
+    {
+        // Жёсткие ссылки дают один inode_ref на несколько путей: запись инода одна
+        refs = malloc(paths.count * sizeof(uint64_t));
+        if (!refs)
+            err = SQUASH_ERROR_MEMORY;
+    }
+    if (err == SQUASH_OK)
+    {
+        for (size_t i = 0; i < paths.count; i++)
+            refs[i] = paths.entries[i].inode_ref;
+        qsort(refs, paths.count, sizeof(uint64_t), compare_refs);
+        for (size_t i = 0; i < paths.count; i++)
+            if (ref_count == 0 || refs[ref_count - 1] != refs[i])
+                refs[ref_count++] = refs[i];
+        err = collect_inodes(fs, refs, ref_count, &inodes);
+    }
+    if (err == SQUASH_OK)
+        err = write_index(fs, index_path, &paths, &inodes, ref_count);
+
+    squash_path_index_free(&paths);
+    free(refs);
+    free(inodes.records);
+    free(inodes.data);
+    return err;
+}
+
+SQUASH_API squash_error_t squash_index_build(squash_fs_t *fs, const char *index_path)
+{
+    if (!fs || !index_path)
+        return SQUASH_ERROR_INVALID_ARGUMENT;
+    squash_mutex_lock(&fs->lock);
+    squash_error_t err = index_build_internal(fs, index_path);
+    squash_mutex_unlock(&fs->lock);
+    return err;
+}
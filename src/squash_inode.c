@@ -3,7 +3,7 @@
 #include <string.h>
 #include "../include/libsquash/squash.h"
 
-SQUASH_API squash_error_t squash_lookup_path(squash_fs_t *fs, const char *path, squash_off_t *inode_ref)
+static squash_error_t lookup_path_internal(squash_fs_t *fs, const char *path, squash_off_t *inode_ref)
 {
     if (!fs || !fs->file || !path || !inode_ref)
         return SQUASH_ERROR_INVALID_FILE;
@@ -13,15 +13,35 @@ SQUASH_API squash_error_t squash_lookup_path(squash_fs_t *fs, const char *path,
     if (path[0] == '\0' || (path[0] == '/' && path[1] == '\0'))
         return SQUASH_OK;
 
+    squash_error_t index_err;
+    if (squash_path_index_lookup(fs, path, inode_ref, &index_err))
+    {
+        fs->path_index_hits++;
+        return index_err;
+    }
+    if (fs->index && squash_index_lookup(fs->index, path, inode_ref, &index_err))
+    {
+        fs->index_path_hits++;
+        return index_err;
+    }
+
     // Защита от избыточных / и выделение под компонент пути
     char component[1024]; // Максимальная длина компоненты имени директории
     const char *cur = path;
     squash_error_t err;
 
+    // Иноды и записи промежуточных директорий живут в арене и откатываются после каждой компоненты
+    squash_arena_t *arena = squash_arena_create(0);
+    if (!arena)
+        return SQUASH_ERROR_MEMORY;
+
     squash_visited_inodes_t visited;
     err = squash_visited_inodes_init(&visited, 16);
     if (err != SQUASH_OK)
+    {
+        squash_arena_destroy(arena);
         return err;
+    }
     err = squash_visited_inodes_add(&visited, *inode_ref);
     if (err != SQUASH_OK)
         goto cleanup_visited;
@@ -46,25 +66,24 @@ SQUASH_API squash_error_t squash_lookup_path(squash_fs_t *fs, const char *path,
         component[clen] = '\0';
         cur += clen;
 
+        squash_arena_mark_t mark = squash_arena_mark(arena);
+
         // Чтение текущего inode
         void *current_inode = NULL;
-        err = squash_read_inode(fs, *inode_ref, &current_inode);
+        err = squash_read_inode_arena(fs, *inode_ref, arena, &current_inode);
         if (err != SQUASH_OK)
             goto cleanup_visited;
 
         if (!squash_is_directory(current_inode)) {
-            squash_free_inode(current_inode);
             err = SQUASH_ERROR_NOT_DIRECTORY;
             goto cleanup_visited;
         }
 
         squash_dir_inode_t *dir_inode = (squash_dir_inode_t *)current_inode;
         squash_dir_iterator_t *iterator = NULL;
-        err = squash_opendir(fs, dir_inode, &iterator);
-        if (err != SQUASH_OK) {
-            squash_free_inode(current_inode);
+        err = squash_opendir_arena(fs, dir_inode, arena, &iterator);
+        if (err != SQUASH_OK)
             goto cleanup_visited;
-        }
 
         bool found = false;
         squash_dir_entry_t *entry = NULL;
@@ -73,14 +92,12 @@ SQUASH_API squash_error_t squash_lookup_path(squash_fs_t *fs, const char *path,
             if (strcmp(entry->name, component) == 0) {
                 // Проверяем на цикл
                 if (squash_visited_inodes_contains(&visited, entry->inode_ref)) {
-                    squash_free_dir_entry(entry);
                     err = SQUASH_ERROR_CYCLE_DETECTED;
                     found = false;
                     break;
                 }
                 *inode_ref = entry->inode_ref;
                 err = squash_visited_inodes_add(&visited, *inode_ref);
-                squash_free_dir_entry(entry);
                 if (err != SQUASH_OK) {
                     found = false;
                     break;
@@ -88,10 +105,8 @@ SQUASH_API squash_error_t squash_lookup_path(squash_fs_t *fs, const char *path,
                 found = true;
                 break;
             }
-            squash_free_dir_entry(entry);
         }
-        squash_closedir(iterator);
-        squash_free_inode(current_inode);
+        squash_arena_rewind(arena, mark);
         if (!found) {
             err = (err == SQUASH_OK) ? SQUASH_ERROR_NOT_FOUND : err;
             goto cleanup_visited;
@@ -103,6 +118,19 @@ SQUASH_API squash_error_t squash_lookup_path(squash_fs_t *fs, const char *path,
 
 cleanup_visited:
     squash_visited_inodes_free(&visited);
+    squash_arena_destroy(arena);
+    return err;
+}
+
+SQUASH_API squash_error_t squash_lookup_path(squash_fs_t *fs, const char *path, squash_off_t *inode_ref)
+{
+    if (!fs)
+    {
+        return SQUASH_ERROR_INVALID_FILE;
+    }
+    squash_mutex_lock(&fs->lock);
+    squash_error_t err = lookup_path_internal(fs, path, inode_ref);
+    squash_mutex_unlock(&fs->lock);
     return err;
 }
 
@@ -145,22 +173,35 @@ static squash_error_t parse_base_inode(
         return SQUASH_ERROR_INVALID_INODE;
     }
     
-    memcpy(base, uncompressed_data + *offset_in_block, sizeof(squash_base_inode_t) - sizeof(uint16_t));
+    // Тип уже прочитан: остальные поля ложатся сразу за ним
     base->inode_type = *inode_type;
+    memcpy(&base->mode, uncompressed_data + *offset_in_block, sizeof(squash_base_inode_t) - sizeof(uint16_t));
     *offset_in_block += sizeof(squash_base_inode_t) - sizeof(uint16_t);
     
    // printf("After parsing base: offset_in_block=%u\n", *offset_in_block);
     return SQUASH_OK;
 }
 
+// Выделение памяти под инод: из арены, если она задана, иначе из кучи
+static void *inode_alloc(squash_arena_t *arena, size_t size)
+{
+    return arena ? squash_arena_alloc(arena, size) : malloc(size);
+}
+
+static void inode_free(squash_arena_t *arena, void *ptr)
+{
+    if (!arena)
+        free(ptr);
+}
+
 // Парсер каталогов inode
 static squash_error_t parse_dir_inode(
     const squash_base_inode_t *base, const uint8_t *uncompressed_data, size_t uncompressed_size,
-    uint32_t *offset_in_block, void **out_inode)
+    uint32_t *offset_in_block, void **out_inode, squash_arena_t *arena)
 {
     if (*offset_in_block + (SQUASHFS_DIR_INODE_SIZE - sizeof(squash_base_inode_t)) > uncompressed_size)
         return SQUASH_ERROR_INVALID_INODE;
-    squash_dir_inode_t *dir_inode = malloc(sizeof(squash_dir_inode_t));
+    squash_dir_inode_t *dir_inode = inode_alloc(arena, sizeof(squash_dir_inode_t));
     if (!dir_inode)
         return SQUASH_ERROR_MEMORY;
     memcpy(&dir_inode->base, base, sizeof(squash_base_inode_t));
@@ -171,10 +212,60 @@ static squash_error_t parse_dir_inode(
     return SQUASH_OK;
 }
 
+// Список размеров блоков файла. У больших файлов он занимает много метаблоков: всё, что не поместилось
+// в уже прочитанные данные inode, дочитывается из таблицы inode начиная с metablock
+static squash_error_t parse_block_list(
+    squash_fs_t *fs, uint64_t metablock, const uint8_t *uncompressed_data, size_t uncompressed_size,
+    uint32_t *offset_in_block, squash_reg_inode_t *reg_inode, squash_arena_t *arena)
+{
+    reg_inode->block_list = NULL;
+    if (reg_inode->fragment != 0xFFFFFFFF && reg_inode->file_size <= fs->super.block_size)
+        return SQUASH_OK; // Файл целиком во фрагменте
+
+    uint64_t block_count = (reg_inode->file_size + fs->super.block_size - 1) / fs->super.block_size;
+    if (reg_inode->fragment != 0xFFFFFFFF && reg_inode->file_size % fs->super.block_size != 0)
+    {
+        block_count--;
+    }
+    if (block_count == 0)
+        return SQUASH_OK;
+    if (block_count > UINT32_MAX || block_count * sizeof(uint32_t) > fs->super.bytes_used)
+    {
+        fprintf(stderr, "Invalid block count %llu for file of %llu bytes\n", (unsigned long long)block_count,
+                (unsigned long long)reg_inode->file_size);
+        return SQUASH_ERROR_INVALID_INODE;
+    }
+
+    size_t blocks_data_size = (size_t)block_count * sizeof(uint32_t);
+    reg_inode->block_list = inode_alloc(arena, blocks_data_size);
+    if (!reg_inode->block_list)
+        return SQUASH_ERROR_MEMORY;
+
+    if (*offset_in_block + blocks_data_size <= uncompressed_size)
+    {
+        memcpy(reg_inode->block_list, uncompressed_data + *offset_in_block, blocks_data_size);
+    }
+    else
+    {
+        squash_error_t err = read_n_bytes_from_metablocks(fs, fs->super.inode_table_start + metablock, *offset_in_block,
+                                                          blocks_data_size, (uint8_t *)reg_inode->block_list, NULL);
+        if (err != SQUASH_OK)
+        {
+            fprintf(stderr, "Failed to read block_list of %llu entries: %s\n", (unsigned long long)block_count,
+                    squash_strerror(err));
+            inode_free(arena, reg_inode->block_list);
+            reg_inode->block_list = NULL;
+            return err;
+        }
+    }
+    *offset_in_block += blocks_data_size;
+    return SQUASH_OK;
+}
+
 // Парсер регулярного файла
 static squash_error_t parse_reg_inode(
-    squash_fs_t *fs, const squash_base_inode_t *base, const uint8_t *uncompressed_data, size_t uncompressed_size,
-    uint32_t *offset_in_block, void **out_inode)
+    squash_fs_t *fs, uint64_t metablock, const squash_base_inode_t *base, const uint8_t *uncompressed_data, size_t uncompressed_size,
+    uint32_t *offset_in_block, void **out_inode, squash_arena_t *arena)
 {
     struct squash_reg_inode_file_t
     {
@@ -185,7 +276,7 @@ static squash_error_t parse_reg_inode(
     memcpy(&file, uncompressed_data + *offset_in_block, sizeof(file));
     *offset_in_block += sizeof(file);
 
-    squash_reg_inode_t *reg_inode = malloc(sizeof(squash_reg_inode_t));
+    squash_reg_inode_t *reg_inode = inode_alloc(arena, sizeof(squash_reg_inode_t));
     if (!reg_inode)
         return SQUASH_ERROR_MEMORY;
     memcpy(&reg_inode->base, base, sizeof(squash_base_inode_t));
@@ -193,61 +284,21 @@ static squash_error_t parse_reg_inode(
     reg_inode->fragment = file.fragment;
     reg_inode->offset = file.offset;
     reg_inode->file_size = file.file_size;
+    reg_inode->sparse = 0;
+    reg_inode->nlink = 1;
 
     if (reg_inode->start_block >= fs->super.bytes_used)
     {
-        free(reg_inode);
+        inode_free(arena, reg_inode);
         return SQUASH_ERROR_INVALID_INODE;
     }
 
-    uint32_t block_count = 0;
-    bool file_in_fragment_only = (reg_inode->fragment != 0xFFFFFFFF &&
-                                  reg_inode->file_size <= fs->super.block_size);
-
-    if (file_in_fragment_only)
-    {
-        reg_inode->block_list = NULL;
-    }
-    else
+    squash_error_t err = parse_block_list(fs, metablock, uncompressed_data, uncompressed_size, offset_in_block,
+                                          reg_inode, arena);
+    if (err != SQUASH_OK)
     {
-        block_count = (reg_inode->file_size + fs->super.block_size - 1) / fs->super.block_size;
-        if (reg_inode->fragment != 0xFFFFFFFF && reg_inode->file_size % fs->super.block_size != 0)
-        {
-            block_count--;
-        }
-
-        if (block_count > 0)
-        {
-            size_t blocks_data_size = block_count * sizeof(uint32_t);
-            if (*offset_in_block + blocks_data_size > uncompressed_size)
-            {
-                fprintf(stderr, "Not enough data for block_list: need %zu bytes, available %zu\n",
-                        blocks_data_size, uncompressed_size - *offset_in_block);
-                free(reg_inode);
-                return SQUASH_ERROR_INVALID_INODE;
-            }
-            reg_inode->block_list = malloc(blocks_data_size);
-            if (!reg_inode->block_list)
-            {
-                free(reg_inode);
-                return SQUASH_ERROR_MEMORY;
-            }
-            memcpy(reg_inode->block_list, uncompressed_data + *offset_in_block, blocks_data_size);
-            *offset_in_block += blocks_data_size;
-
-            fprintf(stderr, "Parsed block_list for inode, block_count=%u:\n", block_count);
-            for (uint32_t i = 0; i < block_count; i++)
-            {
-                uint32_t compressed_size = reg_inode->block_list[i] & ((1 << 24) - 1);
-                bool is_compressed = !(reg_inode->block_list[i] & (1 << 24));
-                fprintf(stderr, "block_list[%u]=0x%08X (compressed_size=%u, compressed=%d)\n",
-                        i, reg_inode->block_list[i], compressed_size, is_compressed);
-            }
-        }
-        else
-        {
-            reg_inode->block_list = NULL;
-        }
+        inode_free(arena, reg_inode);
+        return err;
     }
     *out_inode = reg_inode;
     return SQUASH_OK;
@@ -255,8 +306,8 @@ static squash_error_t parse_reg_inode(
 
 // Парсер расширенного регулярного файла (long regular inode)
 static squash_error_t parse_lreg_inode(
-    squash_fs_t *fs, const squash_base_inode_t *base, const uint8_t *uncompressed_data, size_t uncompressed_size,
-    uint32_t *offset_in_block, void **out_inode)
+    squash_fs_t *fs, uint64_t metablock, const squash_base_inode_t *base, const uint8_t *uncompressed_data, size_t uncompressed_size,
+    uint32_t *offset_in_block, void **out_inode, squash_arena_t *arena)
 {
     struct squash_reg_inode_ext
     {
@@ -273,7 +324,7 @@ static squash_error_t parse_lreg_inode(
     if (file_ext.start_block >= fs->super.bytes_used)
         return SQUASH_ERROR_INVALID_INODE;
 
-    squash_reg_inode_t *reg_inode = malloc(sizeof(squash_reg_inode_t));
+    squash_reg_inode_t *reg_inode = inode_alloc(arena, sizeof(squash_reg_inode_t));
     if (!reg_inode)
         return SQUASH_ERROR_MEMORY;
     memcpy(&reg_inode->base, base, sizeof(squash_base_inode_t));
@@ -281,55 +332,15 @@ static squash_error_t parse_lreg_inode(
     reg_inode->file_size = file_ext.file_size;
     reg_inode->fragment = file_ext.fragment;
     reg_inode->offset = file_ext.offset;
+    reg_inode->sparse = file_ext.sparse;
+    reg_inode->nlink = file_ext.nlink;
 
-    uint32_t block_count = 0;
-    bool file_in_fragment_only = (reg_inode->fragment != 0xFFFFFFFF &&
-                                  reg_inode->file_size <= fs->super.block_size);
-
-    if (file_in_fragment_only)
-    {
-        reg_inode->block_list = NULL;
-    }
-    else
+    squash_error_t err = parse_block_list(fs, metablock, uncompressed_data, uncompressed_size, offset_in_block,
+                                          reg_inode, arena);
+    if (err != SQUASH_OK)
     {
-        block_count = (reg_inode->file_size + fs->super.block_size - 1) / fs->super.block_size;
-        if (reg_inode->fragment != 0xFFFFFFFF && reg_inode->file_size % fs->super.block_size != 0)
-        {
-            block_count--;
-        }
-
-        if (block_count > 0)
-        {
-            size_t blocks_data_size = block_count * sizeof(uint32_t);
-            if (*offset_in_block + blocks_data_size > uncompressed_size)
-            {
-                fprintf(stderr, "Not enough data for block_list: need %zu bytes, available %zu\n",
-                        blocks_data_size, uncompressed_size - *offset_in_block);
-                free(reg_inode);
-                return SQUASH_ERROR_INVALID_INODE;
-            }
-            reg_inode->block_list = malloc(blocks_data_size);
-            if (!reg_inode->block_list)
-            {
-                free(reg_inode);
-                return SQUASH_ERROR_MEMORY;
-            }
-            memcpy(reg_inode->block_list, uncompressed_data + *offset_in_block, blocks_data_size);
-            *offset_in_block += blocks_data_size;
-
-            fprintf(stderr, "Parsed block_list for inode, block_count=%u:\n", block_count);
-            for (uint32_t i = 0; i < block_count; i++)
-            {
-                uint32_t compressed_size = reg_inode->block_list[i] & ((1 << 24) - 1);
-                bool is_compressed = !(reg_inode->block_list[i] & (1 << 24));
-                fprintf(stderr, "block_list[%u]=0x%08X (compressed_size=%u, compressed=%d)\n",
-                        i, reg_inode->block_list[i], compressed_size, is_compressed);
-            }
-        }
-        else
-        {
-            reg_inode->block_list = NULL;
-        }
+        inode_free(arena, reg_inode);
+        return err;
     }
     *out_inode = reg_inode;
     return SQUASH_OK;
@@ -338,12 +349,12 @@ static squash_error_t parse_lreg_inode(
 // Парсер символических ссылок
 static squash_error_t parse_symlink_inode(
     const squash_base_inode_t *base, const uint8_t *uncompressed_data, size_t uncompressed_size,
-    uint32_t *offset_in_block, void **out_inode)
+    uint32_t *offset_in_block, void **out_inode, squash_arena_t *arena)
 {
     if (*offset_in_block + sizeof(squash_symlink_inode_t) - sizeof(squash_base_inode_t) > uncompressed_size)
         return SQUASH_ERROR_INVALID_INODE;
 
-    squash_symlink_inode_t *symlink_inode = malloc(sizeof(squash_symlink_inode_t));
+    squash_symlink_inode_t *symlink_inode = inode_alloc(arena, sizeof(squash_symlink_inode_t));
     if (!symlink_inode)
         return SQUASH_ERROR_MEMORY;
     memcpy(&symlink_inode->base, base, sizeof(squash_base_inode_t));
@@ -354,14 +365,14 @@ static squash_error_t parse_symlink_inode(
 
     if (*offset_in_block + symlink_inode->target_size > uncompressed_size)
     {
-        free(symlink_inode);
+        inode_free(arena, symlink_inode);
         return SQUASH_ERROR_INVALID_INODE;
     }
 
-    symlink_inode->target_path = malloc(symlink_inode->target_size + 1);
+    symlink_inode->target_path = inode_alloc(arena, symlink_inode->target_size + 1);
     if (!symlink_inode->target_path)
     {
-        free(symlink_inode);
+        inode_free(arena, symlink_inode);
         return SQUASH_ERROR_MEMORY;
     }
     memcpy(symlink_inode->target_path, uncompressed_data + *offset_in_block, symlink_inode->target_size);
@@ -374,7 +385,7 @@ static squash_error_t parse_symlink_inode(
 // Парсер блокового устройства
 static squash_error_t parse_blkdev_inode(
     const squash_base_inode_t *base, const uint8_t *uncompressed_data, size_t uncompressed_size,
-    uint32_t *offset_in_block, void **out_inode)
+    uint32_t *offset_in_block, void **out_inode, squash_arena_t *arena)
 {
     struct squash_dev_inode_t
     {
@@ -386,7 +397,7 @@ static squash_error_t parse_blkdev_inode(
     memcpy(&dev, uncompressed_data + *offset_in_block, sizeof(dev));
     *offset_in_block += sizeof(dev);
 
-    squash_dev_inode_t *blkdev_inode = malloc(sizeof(squash_dev_inode_t));
+    squash_dev_inode_t *blkdev_inode = inode_alloc(arena, sizeof(squash_dev_inode_t));
     if (!blkdev_inode)
         return SQUASH_ERROR_MEMORY;
     memcpy(&blkdev_inode->base, base, sizeof(squash_base_inode_t));
@@ -399,7 +410,7 @@ static squash_error_t parse_blkdev_inode(
 // Парсер символьного устройства
 static squash_error_t parse_chrdev_inode(
     const squash_base_inode_t *base, const uint8_t *uncompressed_data, size_t uncompressed_size,
-    uint32_t *offset_in_block, void **out_inode)
+    uint32_t *offset_in_block, void **out_inode, squash_arena_t *arena)
 {
     struct squash_dev_inode_t
     {
@@ -411,7 +422,7 @@ static squash_error_t parse_chrdev_inode(
     memcpy(&dev, uncompressed_data + *offset_in_block, sizeof(dev));
     *offset_in_block += sizeof(dev);
 
-    squash_dev_inode_t *chrdev_inode = malloc(sizeof(squash_dev_inode_t));
+    squash_dev_inode_t *chrdev_inode = inode_alloc(arena, sizeof(squash_dev_inode_t));
     if (!chrdev_inode)
         return SQUASH_ERROR_MEMORY;
     memcpy(&chrdev_inode->base, base, sizeof(squash_base_inode_t));
@@ -424,7 +435,7 @@ static squash_error_t parse_chrdev_inode(
 // Парсер FIFO (именованного канала)
 static squash_error_t parse_fifo_inode(
     const squash_base_inode_t *base, const uint8_t *uncompressed_data, size_t uncompressed_size,
-    uint32_t *offset_in_block, void **out_inode)
+    uint32_t *offset_in_block, void **out_inode, squash_arena_t *arena)
 {
     struct squash_ipc_inode_t
     {
@@ -435,7 +446,7 @@ static squash_error_t parse_fifo_inode(
     memcpy(&ipc, uncompressed_data + *offset_in_block, sizeof(ipc));
     *offset_in_block += sizeof(ipc);
 
-    squash_ipc_inode_t *fifo_inode = malloc(sizeof(squash_ipc_inode_t));
+    squash_ipc_inode_t *fifo_inode = inode_alloc(arena, sizeof(squash_ipc_inode_t));
     if (!fifo_inode)
         return SQUASH_ERROR_MEMORY;
     memcpy(&fifo_inode->base, base, sizeof(squash_base_inode_t));
@@ -447,7 +458,7 @@ static squash_error_t parse_fifo_inode(
 // Парсер сокета
 static squash_error_t parse_socket_inode(
     const squash_base_inode_t *base, const uint8_t *uncompressed_data, size_t uncompressed_size,
-    uint32_t *offset_in_block, void **out_inode)
+    uint32_t *offset_in_block, void **out_inode, squash_arena_t *arena)
 {
     struct squash_ipc_inode_t
     {
@@ -458,7 +469,7 @@ static squash_error_t parse_socket_inode(
     memcpy(&ipc, uncompressed_data + *offset_in_block, sizeof(ipc));
     *offset_in_block += sizeof(ipc);
 
-    squash_ipc_inode_t *socket_inode = malloc(sizeof(squash_ipc_inode_t));
+    squash_ipc_inode_t *socket_inode = inode_alloc(arena, sizeof(squash_ipc_inode_t));
     if (!socket_inode)
         return SQUASH_ERROR_MEMORY;
     memcpy(&socket_inode->base, base, sizeof(squash_base_inode_t));
@@ -470,7 +481,7 @@ static squash_error_t parse_socket_inode(
 // Парсер расширенного блокового устройства
 static squash_error_t parse_lblkdev_inode(
     const squash_base_inode_t *base, const uint8_t *uncompressed_data, size_t uncompressed_size,
-    uint32_t *offset_in_block, void **out_inode)
+    uint32_t *offset_in_block, void **out_inode, squash_arena_t *arena)
 {
     struct squash_ldev_inode_t
     {
@@ -483,7 +494,7 @@ static squash_error_t parse_lblkdev_inode(
     memcpy(&ldev, uncompressed_data + *offset_in_block, sizeof(ldev));
     *offset_in_block += sizeof(ldev);
 
-    squash_dev_inode_t *lblkdev_inode = malloc(sizeof(squash_dev_inode_t));
+    squash_dev_inode_t *lblkdev_inode = inode_alloc(arena, sizeof(squash_dev_inode_t));
     if (!lblkdev_inode)
         return SQUASH_ERROR_MEMORY;
     memcpy(&lblkdev_inode->base, base, sizeof(squash_base_inode_t));
@@ -496,7 +507,7 @@ static squash_error_t parse_lblkdev_inode(
 // Парсер расширенного символьного устройства
 static squash_error_t parse_lchrdev_inode(
     const squash_base_inode_t *base, const uint8_t *uncompressed_data, size_t uncompressed_size,
-    uint32_t *offset_in_block, void **out_inode)
+    uint32_t *offset_in_block, void **out_inode, squash_arena_t *arena)
 {
     struct squash_ldev_inode_t
     {
@@ -509,7 +520,7 @@ static squash_error_t parse_lchrdev_inode(
     memcpy(&ldev, uncompressed_data + *offset_in_block, sizeof(ldev));
     *offset_in_block += sizeof(ldev);
 
-    squash_dev_inode_t *lchrdev_inode = malloc(sizeof(squash_dev_inode_t));
+    squash_dev_inode_t *lchrdev_inode = inode_alloc(arena, sizeof(squash_dev_inode_t));
     if (!lchrdev_inode)
         return SQUASH_ERROR_MEMORY;
     memcpy(&lchrdev_inode->base, base, sizeof(squash_base_inode_t));
@@ -522,7 +533,7 @@ static squash_error_t parse_lchrdev_inode(
 // Парсер расширенного FIFO
 static squash_error_t parse_lfifo_inode(
     const squash_base_inode_t *base, const uint8_t *uncompressed_data, size_t uncompressed_size,
-    uint32_t *offset_in_block, void **out_inode)
+    uint32_t *offset_in_block, void **out_inode, squash_arena_t *arena)
 {
     struct squash_lipc_inode_t
     {
@@ -534,7 +545,7 @@ static squash_error_t parse_lfifo_inode(
     memcpy(&lipc, uncompressed_data + *offset_in_block, sizeof(lipc));
     *offset_in_block += sizeof(lipc);
 
-    squash_ipc_inode_t *lfifo_inode = malloc(sizeof(squash_ipc_inode_t));
+    squash_ipc_inode_t *lfifo_inode = inode_alloc(arena, sizeof(squash_ipc_inode_t));
     if (!lfifo_inode)
         return SQUASH_ERROR_MEMORY;
     memcpy(&lfifo_inode->base, base, sizeof(squash_base_inode_t));
@@ -546,7 +557,7 @@ static squash_error_t parse_lfifo_inode(
 // Парсер расширенного сокета
 static squash_error_t parse_lsocket_inode(
     const squash_base_inode_t *base, const uint8_t *uncompressed_data, size_t uncompressed_size,
-    uint32_t *offset_in_block, void **out_inode)
+    uint32_t *offset_in_block, void **out_inode, squash_arena_t *arena)
 {
     struct squash_lipc_inode_t
     {
@@ -558,7 +569,7 @@ static squash_error_t parse_lsocket_inode(
     memcpy(&lipc, uncompressed_data + *offset_in_block, sizeof(lipc));
     *offset_in_block += sizeof(lipc);
 
-    squash_ipc_inode_t *lsocket_inode = malloc(sizeof(squash_ipc_inode_t));
+    squash_ipc_inode_t *lsocket_inode = inode_alloc(arena, sizeof(squash_ipc_inode_t));
     if (!lsocket_inode)
         return SQUASH_ERROR_MEMORY;
     memcpy(&lsocket_inode->base, base, sizeof(squash_base_inode_t));
@@ -567,8 +578,64 @@ static squash_error_t parse_lsocket_inode(
     return SQUASH_OK;
 }
 
-// Главная публичная функция
-SQUASH_API squash_error_t squash_read_inode(squash_fs_t *fs, squash_off_t inode_ref, void **inode)
+// Разбор inode, лежащего в data с offset_in_block; block_offset - его метаблок для дочитывания списка блоков
+static squash_error_t parse_inode(squash_fs_t *fs, uint64_t block_offset, const uint8_t *data, size_t size,
+                                  uint32_t offset_in_block, squash_arena_t *arena, void **inode)
+{
+    squash_base_inode_t base;
+    uint16_t inode_type;
+    squash_error_t err = parse_base_inode(data, size, &offset_in_block, &base, &inode_type);
+    if (err != SQUASH_OK)
+        return err;
+
+    switch (inode_type)
+    {
+    case SQUASHFS_DIR_TYPE:
+    case SQUASHFS_LDIR_TYPE:
+        err = parse_dir_inode(&base, data, size, &offset_in_block, inode, arena);
+        break;
+    case SQUASHFS_REG_TYPE:
+        err = parse_reg_inode(fs, block_offset, &base, data, size, &offset_in_block, inode, arena);
+        break;
+    case SQUASHFS_LREG_TYPE:
+        err = parse_lreg_inode(fs, block_offset, &base, data, size, &offset_in_block, inode, arena);
+        break;
+    case SQUASHFS_SYMLINK_TYPE:
+    case SQUASHFS_LSYMLINK_TYPE:
+        err = parse_symlink_inode(&base, data, size, &offset_in_block, inode, arena);
+        break;
+    case SQUASHFS_BLKDEV_TYPE:
+        err = parse_blkdev_inode(&base, data, size, &offset_in_block, inode, arena);
+        break;
+    case SQUASHFS_CHRDEV_TYPE:
+        err = parse_chrdev_inode(&base, data, size, &offset_in_block, inode, arena);
+        break;
+    case SQUASHFS_FIFO_TYPE:
+        err = parse_fifo_inode(&base, data, size, &offset_in_block, inode, arena);
+        break;
+    case SQUASHFS_SOCKET_TYPE:
+        err = parse_socket_inode(&base, data, size, &offset_in_block, inode, arena);
+        break;
+    case SQUASHFS_LBLKDEV_TYPE:
+        err = parse_lblkdev_inode(&base, data, size, &offset_in_block, inode, arena);
+        break;
+    case SQUASHFS_LCHRDEV_TYPE:
+        err = parse_lchrdev_inode(&base, data, size, &offset_in_block, inode, arena);
+        break;
+    case SQUASHFS_LFIFO_TYPE:
+        err = parse_lfifo_inode(&base, data, size, &offset_in_block, inode, arena);
+        break;
+    case SQUASHFS_LSOCKET_TYPE:
+        err = parse_lsocket_inode(&base, data, size, &offset_in_block, inode, arena);
+        break;
+    default:
+        err = SQUASH_ERROR_INVALID_INODE;
+    }
+
+    return err;
+}
+
+static squash_error_t read_inode_internal(squash_fs_t *fs, squash_off_t inode_ref, squash_arena_t *arena, void **inode)
 {
     if (!fs || !fs->file || !inode || !fs->decompressor)
     {
@@ -579,6 +646,15 @@ SQUASH_API squash_error_t squash_read_inode(squash_fs_t *fs, squash_off_t inode_
     uint32_t offset_in_block;
     parse_inode_ref(inode_ref, &block_offset, &offset_in_block);
 
+    // Запись индекса - inode целиком вместе со списком блоков
+    const uint8_t *indexed;
+    size_t indexed_size;
+    if (fs->index && squash_index_inode(fs->index, inode_ref, &indexed, &indexed_size))
+    {
+        fs->index_inode_hits++;
+        return parse_inode(fs, block_offset, indexed, indexed_size, 0, arena, inode);
+    }
+
     uint8_t *uncompressed_data = NULL;
     size_t uncompressed_size = 0;
     squash_error_t err = load_inode_metablock(fs, block_offset, &uncompressed_data, &uncompressed_size);
@@ -604,14 +680,14 @@ SQUASH_API squash_error_t squash_read_inode(squash_fs_t *fs, squash_off_t inode_
         uint64_t current_metablock_start = fs->super.inode_table_start + block_offset;
         
         // Переходим к следующему метаблоку (current + header + compressed_size)
-        if (fseek(fs->file, current_metablock_start, SEEK_SET) != 0) {
-            free(uncompressed_data);
+        if (squash_fseek(fs->file, current_metablock_start) != 0) {
+            squash_buffer_pool_release(&fs->buffer_pool, uncompressed_data);
             return SQUASH_ERROR_IO;
         }
         
         uint16_t header;
         if (fread(&header, sizeof(uint16_t), 1, fs->file) != 1) {
-            free(uncompressed_data);
+            squash_buffer_pool_release(&fs->buffer_pool, uncompressed_data);
             return SQUASH_ERROR_IO;
         }
         
@@ -620,86 +696,68 @@ SQUASH_API squash_error_t squash_read_inode(squash_fs_t *fs, squash_off_t inode_
         
         err = load_inode_metablock(fs, next_block_offset, &next_data, &next_size);
         if (err != SQUASH_OK) {
-            free(uncompressed_data);
+            squash_buffer_pool_release(&fs->buffer_pool, uncompressed_data);
             return err;
         }
         
-        // Создаем объединенный буфер
+        // Создаем объединенный буфер (редкий случай, поэтому вне пула)
         final_size = uncompressed_size + next_size;
         final_data = malloc(final_size);
         if (!final_data) {
-            free(uncompressed_data);
-            free(next_data);
+            squash_buffer_pool_release(&fs->buffer_pool, uncompressed_data);
+            squash_buffer_pool_release(&fs->buffer_pool, next_data);
             return SQUASH_ERROR_MEMORY;
         }
         
         memcpy(final_data, uncompressed_data, uncompressed_size);
         memcpy(final_data + uncompressed_size, next_data, next_size);
         
-        free(uncompressed_data);
-        free(next_data);
+        squash_buffer_pool_release(&fs->buffer_pool, uncompressed_data);
+        squash_buffer_pool_release(&fs->buffer_pool, next_data);
         
         //printf("offset_in_block=%u, original_size=%zu, merged_size=%zu\n", 
                //offset_in_block, uncompressed_size, final_size);
     }
 
-    squash_base_inode_t base;
-    uint16_t inode_type;
-    err = parse_base_inode(final_data, final_size, &offset_in_block, &base, &inode_type);
-    if (err != SQUASH_OK)
-    {
+    void *result_inode = NULL;
+    err = parse_inode(fs, block_offset, final_data, final_size, offset_in_block, arena, &result_inode);
+
+    if (need_merge)
         free(final_data);
-        return err;
-    }
+    else
+        squash_buffer_pool_release(&fs->buffer_pool, final_data);
+    if (err == SQUASH_OK)
+        *inode = result_inode;
+    return err;
+}
 
-    void *result_inode = NULL;
-    switch (inode_type)
+// Главная публичная функция
+SQUASH_API squash_error_t squash_read_inode(squash_fs_t *fs, squash_off_t inode_ref, void **inode)
+{
+    if (!fs)
     {
-    case SQUASHFS_DIR_TYPE:
-    case SQUASHFS_LDIR_TYPE:
-        err = parse_dir_inode(&base, final_data, final_size, &offset_in_block, &result_inode);
-        break;
-    case SQUASHFS_REG_TYPE:
-        err = parse_reg_inode(fs, &base, final_data, final_size, &offset_in_block, &result_inode);
-        break;
-    case SQUASHFS_LREG_TYPE:
-        err = parse_lreg_inode(fs, &base, final_data, final_size, &offset_in_block, &result_inode);
-        break;
-    case SQUASHFS_SYMLINK_TYPE:
-    case SQUASHFS_LSYMLINK_TYPE:
-        err = parse_symlink_inode(&base, final_data, final_size, &offset_in_block, &result_inode);
-        break;
-    case SQUASHFS_BLKDEV_TYPE:
-        err = parse_blkdev_inode(&base, final_data, final_size, &offset_in_block, &result_inode);
-        break;
-    case SQUASHFS_CHRDEV_TYPE:
-        err = parse_chrdev_inode(&base, final_data, final_size, &offset_in_block, &result_inode);
-        break;
-    case SQUASHFS_FIFO_TYPE:
-        err = parse_fifo_inode(&base, final_data, final_size, &offset_in_block, &result_inode);
-        break;
-    case SQUASHFS_SOCKET_TYPE:
-        err = parse_socket_inode(&base, final_data, final_size, &offset_in_block, &result_inode);
-        break;
-    case SQUASHFS_LBLKDEV_TYPE:
-        err = parse_lblkdev_inode(&base, final_data, final_size, &offset_in_block, &result_inode);
-        break;
-    case SQUASHFS_LCHRDEV_TYPE:
-        err = parse_lchrdev_inode(&base, final_data, final_size, &offset_in_block, &result_inode);
-        break;
-    case SQUASHFS_LFIFO_TYPE:
-        err = parse_lfifo_inode(&base, final_data, final_size, &offset_in_block, &result_inode);
-        break;
-    case SQUASHFS_LSOCKET_TYPE:
-        err = parse_lsocket_inode(&base, final_data, final_size, &offset_in_block, &result_inode);
-        break;
-    default:
-        err = SQUASH_ERROR_INVALID_INODE;
+        return SQUASH_ERROR_INVALID_FILE;
     }
+    squash_mutex_lock(&fs->lock);
+    squash_error_t err = read_inode_internal(fs, inode_ref, NULL, inode);
+    squash_mutex_unlock(&fs->lock);
+    return err;
+}
 
-    free(final_data);
-    if (err == SQUASH_OK)
-        *inode = result_inode;
+SQUASH_API squash_error_t squash_read_inode_arena(squash_fs_t *fs, squash_off_t inode_ref,
+                                                 squash_arena_t *arena, void **inode)
+{
+    if (!arena)
+    {
+        return SQUASH_ERROR_INVALID_ARGUMENT;
+    }
+    if (!fs)
+    {
+        return SQUASH_ERROR_INVALID_FILE;
+    }
+    squash_mutex_lock(&fs->lock);
+    squash_error_t err = read_inode_internal(fs, inode_ref, arena, inode);
+    squash_mutex_unlock(&fs->lock);
     return err;
 }
 
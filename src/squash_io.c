@@ -0,0 +1,556 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "../include/libsquash/squash.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_URING
+#include <liburing.h>
+#endif
+
+#define SQUASH_IO_MAX_THREADS 16
+#define SQUASH_IO_DEFAULT_QUEUE_DEPTH 64
+
+struct squash_io
+{
+    squash_io_backend_t backend;
+    FILE *file;
+    squash_mutex_t lock;
+    squash_cond_t work_cond; // Появились заявки для пула потоков
+    squash_cond_t done_cond; // Завершилась заявка
+    squash_io_batch_t *queue_head; // Пакеты с неотправленными заявками
+    squash_io_batch_t *queue_tail;
+    squash_thread_t *threads;
+    uint32_t thread_count;
+    bool stop;
+    uint64_t batches;
+    uint64_t requests;
+#ifdef HAVE_URING
+    struct io_uring ring;
+    uint32_t queue_depth;
+    uint32_t inflight;
+    squash_io_request_t *retry_head; // Повторы, которым не хватило места в кольце
+    squash_io_request_t *retry_tail;
+    bool reaping;                    // Один поток ждёт завершений без io->lock, остальные - done_cond
+#endif
+};
+
+squash_error_t squash_pread(FILE *file, uint64_t offset, size_t size, void *buffer)
+{
+    uint8_t *dest = buffer;
+#ifdef _WIN32
+    HANDLE handle = (HANDLE)_get_osfhandle(_fileno(file));
+    while (size > 0)
+    {
+        OVERLAPPED ov;
+        memset(&ov, 0, sizeof(ov));
+        ov.Offset = (DWORD)(offset & 0xFFFFFFFF);
+        ov.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD chunk = size > (1u << 30) ? (1u << 30) : (DWORD)size;
+        DWORD got = 0;
+        if (!ReadFile(handle, dest, chunk, &got, &ov) || got == 0)
+        {
+            fprintf(stderr, "Failed to read %zu bytes at offset 0x%llX: error %lu\n", size, (unsigned long long)offset, GetLastError());
+            return SQUASH_ERROR_IO;
+        }
+        dest += got;
+        offset += got;
+        size -= got;
+    }
+#else
+    int fd = fileno(file);
+    while (size > 0)
+    {
+        ssize_t got = pread(fd, dest, size, (off_t)offset);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+        {
+            fprintf(stderr, "Failed to read %zu bytes at offset 0x%llX: %s\n", size, (unsigned long long)offset,
+                    got < 0 ? strerror(errno) : "unexpected end of file");
+            return SQUASH_ERROR_IO;
+        }
+        dest += got;
+        offset += (uint64_t)got;
+        size -= (size_t)got;
+    }
+#endif
+    return SQUASH_OK;
+}
+
+const char *squash_io_backend_name(squash_io_backend_t backend)
+{
+    switch (backend)
+    {
+    case SQUASH_IO_SYNC:
+        return "sync";
+    case SQUASH_IO_THREADS:
+        return "threads";
+    case SQUASH_IO_URING:
+        return "io_uring";
+    case SQUASH_IO_AUTO:
+        return "auto";
+    default:
+        return "unknown";
+    }
+}
+
+// Вызывается под io->lock
+static void io_complete(squash_io_t *io, squash_io_request_t *req, squash_error_t result)
+{
+    squash_io_batch_t *batch = req->batch;
+    req->result = result;
+    batch->completed++;
+    io->requests++;
+    if (batch->completed == batch->count)
+        squash_cond_broadcast(&io->done_cond);
+}
+
+// Берёт следующую неотправленную заявку (из batch или из любого пакета, если batch == NULL).
+// Вызывается под io->lock
+static squash_io_request_t *io_claim(squash_io_t *io, squash_io_batch_t *batch)
+{
+    squash_io_batch_t *prev = NULL;
+    squash_io_batch_t *cur = io->queue_head;
+    while (cur && batch && cur != batch)
+    {
+        prev = cur;
+        cur = cur->queue_next;
+    }
+    if (!cur)
+        return NULL;
+
+    squash_io_request_t *req = &cur->requests[cur->next++];
+    if (cur->next == cur->count)
+    {
+        // Все заявки пакета отправлены - убираем его из очереди
+        if (prev)
+            prev->queue_next = cur->queue_next;
+        else
+            io->queue_head = cur->queue_next;
+        if (io->queue_tail == cur)
+            io->queue_tail = prev;
+        cur->queue_next = NULL;
+    }
+    return req;
+}
+
+static squash_error_t io_read_request(squash_io_t *io, squash_io_request_t *req)
+{
+    squash_error_t err = squash_pread(io->file, req->offset, req->size, req->buffer);
+    if (err == SQUASH_OK)
+        req->done = req->size;
+    return err;
+}
+
+static void io_worker(void *arg)
+{
+    squash_io_t *io = arg;
+    squash_mutex_lock(&io->lock);
+    for (;;)
+    {
+        squash_io_request_t *req = io_claim(io, NULL);
+        if (!req)
+        {
+            if (io->stop)
+                break;
+            squash_cond_wait(&io->work_cond, &io->lock);
+            continue;
+        }
+        squash_mutex_unlock(&io->lock);
+        squash_error_t err = io_read_request(io, req);
+        squash_mutex_lock(&io->lock);
+        io_complete(io, req, err);
+    }
+    squash_mutex_unlock(&io->lock);
+}
+
+#ifdef HAVE_URING
+// Ставит (остаток) заявки в очередь отправки io_uring. Вызывается под io->lock
+static bool uring_prep(squash_io_t *io, squash_io_request_t *req)
+{
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&io->ring);
+    if (!sqe)
+        return false;
+    io_uring_prep_read(sqe, fileno(io->file), (uint8_t *)req->buffer + req->done,
+                       (unsigned)(req->size - req->done), req->offset + req->done);
+    io_uring_sqe_set_data(sqe, req);
+    req->inflight = true;
+    io->inflight++;
+    return true;
+}
+
+// Повтор (короткое чтение, EAGAIN) ставится в кольцо, а если места нет - в очередь повторов,
+// которую uring_pump разбирает раньше новых заявок. Вызывается под io->lock
+static void uring_retry(squash_io_t *io, squash_io_request_t *req)
+{
+    if (uring_prep(io, req))
+        return;
+    req->retry_next = NULL;
+    if (io->retry_tail)
+        io->retry_tail->retry_next = req;
+    else
+        io->retry_head = req;
+    io->retry_tail = req;
+}
+
+// Заполняет кольцо заявками из очереди и отправляет их одним системным вызовом
+static void uring_pump(squash_io_t *io)
+{
+    while (io->inflight < io->queue_depth && io->retry_head)
+    {
+        squash_io_request_t *req = io->retry_head;
+        if (!uring_prep(io, req))
+            break;
+        io->retry_head = req->retry_next;
+        if (!io->retry_head)
+            io->retry_tail = NULL;
+        req->retry_next = NULL;
+    }
+    while (io->inflight < io->queue_depth && io->queue_head)
+    {
+        squash_io_batch_t *head = io->queue_head;
+        if (!uring_prep(io, &head->requests[head->next]))
+            break;
+        io_claim(io, head);
+    }
+    io_uring_submit(&io->ring);
+}
+
+// Забирает одно завершение; короткое чтение дочитывается повторной заявкой. Вызывается под io->lock,
+// на время ожидания блокировка отпускается, чтобы другие потоки могли отправлять заявки
+static squash_error_t uring_reap(squash_io_t *io)
+{
+    struct io_uring_cqe *cqe;
+    squash_mutex_unlock(&io->lock);
+    int ret = io_uring_wait_cqe(&io->ring, &cqe);
+    squash_mutex_lock(&io->lock);
+    if (ret == -EINTR)
+        return SQUASH_OK;
+    if (ret < 0)
+    {
+        fprintf(stderr, "io_uring_wait_cqe failed: %s\n", strerror(-ret));
+        return SQUASH_ERROR_IO;
+    }
+
+    squash_io_request_t *req = io_uring_cqe_get_data(cqe);
+    int res = cqe->res;
+    io_uring_cqe_seen(&io->ring, cqe);
+    if (!req)
+        return SQUASH_OK; // Завершение заявки отмены (uring_cancel_batch)
+    req->inflight = false;
+    io->inflight--;
+
+    if (res == -EINTR || res == -EAGAIN)
+    {
+        uring_retry(io, req);
+    }
+    else if (res <= 0)
+    {
+        fprintf(stderr, "Failed to read %zu bytes at offset 0x%llX: %s\n", req->size - req->done,
+                (unsigned long long)(req->offset + req->done), res < 0 ? strerror(-res) : "unexpected end of file");
+        io_complete(io, req, SQUASH_ERROR_IO);
+    }
+    else
+    {
+        req->done += (size_t)res;
+        if (req->done < req->size)
+            uring_retry(io, req);
+        else
+            io_complete(io, req, SQUASH_OK);
+    }
+    return SQUASH_OK;
+}
+
+// Снимает с очереди неотправленные заявки пакета и отменяет отправленные. Нужна, когда ожидание
+// завершений сорвалось: пакет и буферы принадлежат вызывающему, и вернуть управление можно только
+// после того, как ядро закончит с каждой заявкой. Вызывается под io->lock
+static void uring_cancel_batch(squash_io_t *io, squash_io_batch_t *batch)
+{
+    // Неотправленные заявки
+    squash_io_batch_t *prev = NULL;
+    for (squash_io_batch_t *cur = io->queue_head; cur; prev = cur, cur = cur->queue_next)
+    {
+        if (cur != batch)
+            continue;
+        if (prev)
+            prev->queue_next = cur->queue_next;
+        else
+            io->queue_head = cur->queue_next;
+        if (io->queue_tail == cur)
+            io->queue_tail = prev;
+        cur->queue_next = NULL;
+        break;
+    }
+    while (batch->next < batch->count)
+        io_complete(io, &batch->requests[batch->next++], SQUASH_ERROR_IO);
+
+    // Повторы, ждущие места в кольце
+    squash_io_request_t **link = &io->retry_head;
+    io->retry_tail = NULL;
+    while (*link)
+    {
+        squash_io_request_t *req = *link;
+        if (req->batch == batch)
+        {
+            *link = req->retry_next;
+            req->retry_next = NULL;
+            io_complete(io, req, SQUASH_ERROR_IO);
+            continue;
+        }
+        io->retry_tail = req;
+        link = &req->retry_next;
+    }
+
+    // Заявки в кольце: отменённые завершатся с -ECANCELED, остальные - как обычно
+    for (size_t i = 0; i < batch->count; i++)
+    {
+        squash_io_request_t *req = &batch->requests[i];
+        if (!req->inflight)
+            continue;
+        struct io_uring_sqe *sqe = io_uring_get_sqe(&io->ring);
+        if (!sqe)
+        {
+            io_uring_submit(&io->ring);
+            sqe = io_uring_get_sqe(&io->ring);
+            if (!sqe)
+                break; // Эти заявки просто дождёмся
+        }
+        io_uring_prep_cancel(sqe, req, 0);
+        io_uring_sqe_set_data(sqe, NULL);
+    }
+    io_uring_submit(&io->ring);
+}
+
+static bool uring_init(squash_io_t *io, uint32_t queue_depth)
+{
+    io->queue_depth = queue_depth ? queue_depth : SQUASH_IO_DEFAULT_QUEUE_DEPTH;
+    int ret = io_uring_queue_init(io->queue_depth, &io->ring, 0);
+    if (ret < 0)
+    {
+        fprintf(stderr, "io_uring unavailable (%s), falling back to thread pool\n", strerror(-ret));
+        return false;
+    }
+    return true;
+}
+#endif
+
+static squash_error_t io_start_threads(squash_io_t *io, uint32_t threads)
+{
+    if (threads == 0)
+        threads = squash_cpu_count();
+    if (threads > SQUASH_IO_MAX_THREADS)
+        threads = SQUASH_IO_MAX_THREADS;
+
+    io->threads = calloc(threads, sizeof(squash_thread_t));
+    if (!io->threads)
+        return SQUASH_ERROR_MEMORY;
+    for (uint32_t i = 0; i < threads; i++)
+    {
+        squash_error_t err = squash_thread_create(&io->threads[i], io_worker, io);
+        if (err != SQUASH_OK)
+            return err;
+        io->thread_count++;
+    }
+    return SQUASH_OK;
+}
+
+squash_error_t squash_io_create(FILE *file, squash_io_backend_t backend, uint32_t threads, uint32_t queue_depth,
+                                squash_io_t **io)
+{
+    *io = calloc(1, sizeof(squash_io_t));
+    if (!*io)
+        return SQUASH_ERROR_MEMORY;
+
+    (*io)->file = file;
+    squash_mutex_init(&(*io)->lock);
+    squash_cond_init(&(*io)->work_cond);
+    squash_cond_init(&(*io)->done_cond);
+
+    if (backend == SQUASH_IO_URING || backend == SQUASH_IO_AUTO)
+    {
+#ifdef HAVE_URING
+        backend = uring_init(*io, queue_depth) ? SQUASH_IO_URING : SQUASH_IO_THREADS;
+#else
+        (void)queue_depth;
+        if (backend == SQUASH_IO_URING)
+            fprintf(stderr, "Built without io_uring support, falling back to thread pool\n");
+        backend = SQUASH_IO_THREADS;
+#endif
+    }
+    (*io)->backend = backend;
+
+    if (backend == SQUASH_IO_THREADS)
+    {
+        squash_error_t err = io_start_threads(*io, threads);
+        if (err != SQUASH_OK)
+        {
+            squash_io_destroy(*io);
+            *io = NULL;
+            return err;
+        }
+    }
+    return SQUASH_OK;
+}
+
+void squash_io_destroy(squash_io_t *io)
+{
+    if (!io)
+        return;
+
+    squash_mutex_lock(&io->lock);
+    io->stop = true;
+    squash_cond_broadcast(&io->work_cond);
+    squash_mutex_unlock(&io->lock);
+    for (uint32_t i = 0; i < io->thread_count; i++)
+        squash_thread_join(io->threads[i]);
+    free(io->threads);
+
+#ifdef HAVE_URING
+    if (io->backend == SQUASH_IO_URING)
+        io_uring_queue_exit(&io->ring);
+#endif
+
+    squash_cond_destroy(&io->done_cond);
+    squash_cond_destroy(&io->work_cond);
+    squash_mutex_destroy(&io->lock);
+    free(io);
+}
+
+squash_io_backend_t squash_io_backend(squash_io_t *io)
+{
+    return io->backend;
+}
+
+void squash_io_counters(squash_io_t *io, uint64_t *batches, uint64_t *requests)
+{
+    squash_mutex_lock(&io->lock);
+    *batches = io->batches;
+    *requests = io->requests;
+    squash_mutex_unlock(&io->lock);
+}
+
+squash_error_t squash_io_submit(squash_io_t *io, squash_io_batch_t *batch)
+{
+    batch->next = 0;
+    batch->completed = 0;
+    batch->queue_next = NULL;
+    for (size_t i = 0; i < batch->count; i++)
+    {
+        batch->requests[i].done = 0;
+        batch->requests[i].result = SQUASH_OK;
+        batch->requests[i].batch = batch;
+        batch->requests[i].retry_next = NULL;
+        batch->requests[i].inflight = false;
+    }
+
+    if (io->backend == SQUASH_IO_SYNC)
+    {
+        // Заявки выполняются сразу, squash_io_wait только собирает результат
+        for (; batch->next < batch->count; batch->next++)
+        {
+            squash_io_request_t *req = &batch->requests[batch->next];
+            squash_error_t err = io_read_request(io, req);
+            squash_mutex_lock(&io->lock);
+            io_complete(io, req, err);
+            squash_mutex_unlock(&io->lock);
+        }
+        squash_mutex_lock(&io->lock);
+        io->batches++;
+        squash_mutex_unlock(&io->lock);
+        return SQUASH_OK;
+    }
+
+    squash_mutex_lock(&io->lock);
+    io->batches++;
+    if (batch->count > 0)
+    {
+        if (io->queue_tail)
+            io->queue_tail->queue_next = batch;
+        else
+            io->queue_head = batch;
+        io->queue_tail = batch;
+    }
+#ifdef HAVE_URING
+    if (io->backend == SQUASH_IO_URING)
+        uring_pump(io);
+#endif
+    if (io->backend == SQUASH_IO_THREADS)
+        squash_cond_broadcast(&io->work_cond);
+    squash_mutex_unlock(&io->lock);
+    return SQUASH_OK;
+}
+
+squash_error_t squash_io_wait(squash_io_t *io, squash_io_batch_t *batch)
+{
+    squash_error_t err = SQUASH_OK;
+    squash_mutex_lock(&io->lock);
+    while (batch->completed < batch->count)
+    {
+#ifdef HAVE_URING
+        if (io->backend == SQUASH_IO_URING)
+        {
+            uring_pump(io);
+            if (io->reaping)
+            {
+                // Завершения забирает другой поток; он будит всех после каждого
+                squash_cond_wait(&io->done_cond, &io->lock);
+                continue;
+            }
+            io->reaping = true;
+            squash_error_t reap_err = uring_reap(io);
+            io->reaping = false;
+            squash_cond_broadcast(&io->done_cond);
+            if (reap_err != SQUASH_OK && err == SQUASH_OK)
+            {
+                // Выйти сразу нельзя: ядро ещё пишет в буферы пакета. Отменяем его заявки
+                // и дожидаемся завершения каждой
+                err = reap_err;
+                uring_cancel_batch(io, batch);
+            }
+            continue;
+        }
+#endif
+        // Пока пакет не разобран рабочими потоками, ожидающий поток помогает им
+        squash_io_request_t *req = io_claim(io, batch);
+        if (req)
+        {
+            squash_mutex_unlock(&io->lock);
+            squash_error_t req_err = io_read_request(io, req);
+            squash_mutex_lock(&io->lock);
+            io_complete(io, req, req_err);
+        }
+        else
+        {
+            squash_cond_wait(&io->done_cond, &io->lock);
+        }
+    }
+    squash_mutex_unlock(&io->lock);
+    if (err != SQUASH_OK)
+        return err;
+
+    for (size_t i = 0; i < batch->count; i++)
+    {
+        if (batch->requests[i].result != SQUASH_OK)
+            return batch->requests[i].result;
+    }
+    return SQUASH_OK;
+}
+
+squash_error_t squash_io_read(squash_io_t *io, squash_io_request_t *requests, size_t count)
+{
+    squash_io_batch_t batch;
+    memset(&batch, 0, sizeof(batch));
+    batch.requests = requests;
+    batch.count = count;
+    squash_error_t err = squash_io_submit(io, &batch);
+    if (err != SQUASH_OK)
+        return err;
+    return squash_io_wait(io, &batch);
+}
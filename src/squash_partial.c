@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/libsquash/squash.h"
+
+void squash_partial_drop(squash_fs_t *fs)
+{
+    squash_partial_block_t *pb = &fs->partial;
+    squash_partial_free(pb->state);
+    squash_buffer_pool_release(&fs->buffer_pool, pb->compressed);
+    squash_buffer_pool_release(&fs->buffer_pool, pb->data);
+    memset(pb, 0, sizeof(*pb));
+}
+
+bool squash_partial_contains(squash_fs_t *fs, uint64_t disk_offset)
+{
+    return fs->partial.data && fs->partial.disk_offset == disk_offset;
+}
+
+squash_error_t squash_partial_read(squash_fs_t *fs, uint64_t disk_offset, uint32_t compressed_size,
+                                   size_t expected, size_t needed, const uint8_t **data, size_t *size)
+{
+    squash_partial_block_t *pb = &fs->partial;
+
+    if (squash_partial_contains(fs, disk_offset))
+    {
+        if (pb->complete || pb->size >= needed)
+        {
+            *data = pb->data;
+            *size = pb->size;
+            return SQUASH_OK;
+        }
+        fs->partial_resumes++;
+    }
+    else
+    {
+        // Слот один: новый блок вытесняет предыдущий
+        squash_partial_drop(fs);
+        if (disk_offset + compressed_size > fs->super.bytes_used || compressed_size > fs->buffer_pool.buffer_size)
+        {
+            fprintf(stderr, "Invalid data block at offset %llu, size %u\n",
+                    (unsigned long long)disk_offset, compressed_size);
+            return SQUASH_ERROR_INVALID_BLOCK;
+        }
+
+        // Блок уже распакован целиком - префикс распаковывать незачем
+        if (squash_fs_cache_copy(fs, SQUASH_CACHE_TIER_BLOCKS, disk_offset, &pb->data, &pb->size, NULL))
+        {
+            pb->disk_offset = disk_offset;
+            pb->complete = true;
+            *data = pb->data;
+            *size = pb->size;
+            return SQUASH_OK;
+        }
+
+        pb->compressed = squash_buffer_pool_acquire(&fs->buffer_pool);
+        pb->data = squash_buffer_pool_acquire(&fs->buffer_pool);
+        if (!pb->compressed || !pb->data)
+        {
+            squash_partial_drop(fs);
+            return SQUASH_ERROR_MEMORY;
+        }
+        // Поток кодека продолжается по тем же сжатым данным, поэтому запись кэша копируется в слот
+        size_t cached_size = 0;
+        uint8_t *copy;
+        const uint8_t *cached = squash_fs_cache_peek(fs, SQUASH_CACHE_TIER_COMPRESSED, disk_offset, &cached_size, NULL,
+                                                     &copy);
+        bool hit = cached && cached_size == compressed_size;
+        if (hit)
+        {
+            memcpy(pb->compressed, cached, compressed_size);
+        }
+        squash_buffer_pool_release(&fs->buffer_pool, copy);
+        if (!hit)
+        {
+            squash_error_t err = read_fs_bytes(fs->file, disk_offset, compressed_size, pb->compressed);
+            if (err != SQUASH_OK)
+            {
+                squash_partial_drop(fs);
+                return err;
+            }
+            squash_fs_cache_put(fs, SQUASH_CACHE_TIER_COMPRESSED, disk_offset, pb->compressed, compressed_size, 0,
+                                fs->read_flags & SQUASH_READ_NOCACHE);
+        }
+        pb->disk_offset = disk_offset;
+        pb->compressed_size = compressed_size;
+        fs->partial_decodes++;
+    }
+
+    // Буферы слота не меняются между вызовами, поэтому поток кодека продолжается с того же места
+    size_t produced = 0;
+    bool complete = false;
+    squash_error_t err = squash_decompress_block_partial(fs->decompressor, &pb->state, pb->compressed,
+                                                         pb->compressed_size, pb->data, expected, needed,
+                                                         &produced, &complete);
+    if (err != SQUASH_OK)
+    {
+        fprintf(stderr, "Partial decompression failed at offset %llu: %s\n",
+                (unsigned long long)disk_offset, squash_strerror(err));
+        squash_partial_drop(fs);
+        return err;
+    }
+    pb->size = produced;
+    pb->complete = complete;
+    if (complete)
+    {
+        squash_fs_cache_put(fs, SQUASH_CACHE_TIER_BLOCKS, disk_offset, pb->data, pb->size, 0,
+                            fs->read_flags & SQUASH_READ_NOCACHE);
+        // Сжатые данные больше не нужны
+        squash_buffer_pool_release(&fs->buffer_pool, pb->compressed);
+        pb->compressed = NULL;
+    }
+
+    *data = pb->data;
+    *size = pb->size;
+    return SQUASH_OK;
+}
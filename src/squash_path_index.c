@@ -0,0 +1,395 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/libsquash/squash.h"
+
+#define SQUASHFS_INVALID_BLK 0xFFFFFFFFFFFFFFFFULL
+
+// Таблица директорий, распакованная целиком: метаблоки подряд в data
+typedef struct
+{
+    uint8_t *data;
+    size_t size;
+    uint64_t *block_offsets; // Смещение метаблока на диске от directory_table_start
+    size_t *block_starts;    // Его начало в data
+    uint32_t blocks;
+} dir_table_t;
+
+static void dir_table_free(dir_table_t *table)
+{
+    free(table->data);
+    free(table->block_offsets);
+    free(table->block_starts);
+    memset(table, 0, sizeof(*table));
+}
+
+// Конец таблицы директорий - начало ближайшей следующей структуры. Таблицы фрагментов, экспорта, id и xattr
+// начинаются с метаблоков, а суперблок указывает на их индекс, поэтому берётся первый адрес из индекса
+static uint64_t directory_table_end(squash_fs_t *fs)
+{
+    const squash_super_t *super = &fs->super;
+    uint64_t end = super->bytes_used;
+    uint64_t starts[4] = {super->fragments ? super->fragment_table_start : SQUASHFS_INVALID_BLK,
+                          super->lookup_table_start, super->id_table_start, super->xattr_id_table_start};
+    for (int i = 0; i < 4; i++)
+    {
+        if (starts[i] <= super->directory_table_start || starts[i] >= end)
+            continue;
+        end = starts[i];
+        uint8_t first[8];
+        if (read_fs_bytes(fs->file, starts[i], sizeof(first), first) == SQUASH_OK &&
+            GET_LE64(first) > super->directory_table_start && GET_LE64(first) < end)
+            end = GET_LE64(first);
+    }
+    return end;
+}
+
+// Таблица читается одним запросом, метаблоки распаковываются пулом потоков распаковки
+static squash_error_t decode_directory_table(squash_fs_t *fs, dir_table_t *table)
+{
+    uint64_t start = fs->super.directory_table_start;
+    uint64_t end = directory_table_end(fs);
+    if (end <= start)
+        return SQUASH_OK; // Пустая таблица: в образе только пустой корень
+
+    size_t raw_size = (size_t)(end - start);
+    uint8_t *raw = malloc(raw_size);
+    if (!raw)
+        return SQUASH_ERROR_MEMORY;
+    squash_error_t err = read_fs_bytes(fs->file, start, raw_size, raw);
+    if (err != SQUASH_OK)
+    {
+        free(raw);
+        return err;
+    }
+
+    uint32_t blocks = 0;
+    for (size_t pos = 0; pos + 2 <= raw_size && blocks < UINT32_MAX;)
+    {
+        size_t size = GET_LE16(raw + pos) & SQUASHFS_COMPRESSED_SIZE_MASK;
+        if (size == 0 || size > SQUASHFS_METADATA_SIZE || pos + 2 + size > raw_size)
+            break;
+        pos += 2 + size;
+        blocks++;
+    }
+
+    squash_decode_job_t *jobs = calloc(blocks ? blocks : 1, sizeof(squash_decode_job_t));
+    table->data = malloc(blocks ? (size_t)blocks * SQUASHFS_METADATA_SIZE : 1);
+    table->block_offsets = malloc((blocks ? blocks : 1) * sizeof(uint64_t));
+    table->block_starts = malloc((blocks ? blocks : 1) * sizeof(size_t));
+    if (!jobs || !table->data || !table->block_offsets || !table->block_starts)
+    {
+        free(jobs);
+        free(raw);
+        dir_table_free(table);
+        return SQUASH_ERROR_MEMORY;
+    }
+
+    size_t pos = 0;
+    for (uint32_t i = 0; i < blocks; i++)
+    {
+        uint16_t header = GET_LE16(raw + pos);
+        table->block_offsets[i] = pos;
+        jobs[i].src = raw + pos + 2;
+        jobs[i].src_size = header & SQUASHFS_COMPRESSED_SIZE_MASK;
+        jobs[i].compressed = !(header & SQUASHFS_COMPRESSED_BIT_BLOCK);
+        jobs[i].dst = table->data + (size_t)i * SQUASHFS_METADATA_SIZE;
+        jobs[i].dst_capacity = SQUASHFS_METADATA_SIZE;
+        pos += 2 + jobs[i].src_size;
+    }
+    squash_decode_blocks(fs, jobs, blocks);
+
+    // Метаблоки, кроме последнего, полные, так что данные обычно уже лежат подряд. Если граница таблицы
+    // определилась с запасом, хвост за ней не распакуется - таблица обрезается по первой ошибке
+    size_t filled = 0;
+    table->blocks = blocks;
+    for (uint32_t i = 0; i < blocks; i++)
+    {
+        if (jobs[i].result != SQUASH_OK)
+        {
+            table->blocks = i;
+            break;
+        }
+        if (filled != (size_t)i * SQUASHFS_METADATA_SIZE)
+            memmove(table->data + filled, jobs[i].dst, jobs[i].out_size);
+        table->block_starts[i] = filled;
+        filled += jobs[i].out_size;
+    }
+    table->size = filled;
+
+    free(jobs);
+    free(raw);
+    if (table->blocks == 0 && blocks > 0)
+    {
+        dir_table_free(table);
+        fprintf(stderr, "Failed to decode directory table at 0x%llx\n", (unsigned long long)start);
+        return SQUASH_ERROR_DECOMPRESSION_FAILED;
+    }
+    return SQUASH_OK;
+}
+
+// Позиция листинга в распакованной таблице
+static bool listing_position(const dir_table_t *table, uint32_t start_block, uint32_t offset, size_t *pos)
+{
+    uint32_t lo = 0, hi = table->blocks;
+    while (lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (table->block_offsets[mid] < start_block)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == table->blocks || table->block_offsets[lo] != start_block)
+        return false;
+    *pos = table->block_starts[lo] + offset;
+    return *pos <= table->size;
+}
+
+// Путь parent/name добавляется в конец таблицы. Родитель сам лежит в names, поэтому передаётся смещением
+static squash_error_t add_entry(squash_path_index_t *index, size_t parent, const char *name, size_t name_len,
+                                squash_off_t inode_ref, uint16_t type)
+{
+    if (index->count == index->capacity)
+    {
+        size_t capacity = index->capacity ? index->capacity * 2 : 256;
+        squash_path_entry_t *grown = realloc(index->entries, capacity * sizeof(squash_path_entry_t));
+        if (!grown)
+            return SQUASH_ERROR_MEMORY;
+        index->entries = grown;
+        index->capacity = capacity;
+    }
+
+    // Корень - "/", остальные - "/a/b"
+    size_t prefix = 0;
+    size_t prefix_offset = 0;
+    if (name && parent < index->count && index->entries[parent].name_size > 1)
+    {
+        prefix = index->entries[parent].name_size;
+        prefix_offset = index->entries[parent].name_offset;
+    }
+    size_t len = name ? prefix + 1 + name_len : 1;
+    if (len > UINT32_MAX)
+        return SQUASH_ERROR_INVALID_FILE;
+    if (index->names_size + len > index->names_capacity)
+    {
+        size_t capacity = index->names_capacity ? index->names_capacity * 2 : 64 * 1024;
+        while (capacity < index->names_size + len)
+            capacity *= 2;
+        char *grown = realloc(index->names, capacity);
+        if (!grown)
+            return SQUASH_ERROR_MEMORY;
+        index->names = grown;
+        index->names_capacity = capacity;
+    }
+    char *path = index->names + index->names_size;
+    memcpy(path, index->names + prefix_offset, prefix);
+    path[prefix] = '/';
+    if (name)
+        memcpy(path + prefix + 1, name, name_len);
+
+    squash_path_entry_t *entry = &index->entries[index->count++];
+    entry->hash = squash_path_hash(path, len);
+    entry->inode_ref = inode_ref;
+    entry->name_offset = index->names_size;
+    entry->name_size = (uint32_t)len;
+    entry->type = type;
+    index->names_size += len;
+    return SQUASH_OK;
+}
+
+// Разбор листинга каталога с теми же проверками, что у squash_opendir, длина - file_size инода
+static squash_error_t add_listing(squash_path_index_t *index, const dir_table_t *table, size_t parent,
+                                  const squash_dir_inode_t *dir, squash_visited_inodes_t *visited)
+{
+    size_t pos;
+    size_t left = dir->file_size;
+    if (left < 12)
+        return SQUASH_OK;
+    if (!listing_position(table, dir->start_block, dir->offset, &pos))
+    {
+        fprintf(stderr, "Directory listing at block %u, offset %u is outside the directory table\n",
+                dir->start_block, dir->offset);
+        return SQUASH_ERROR_INVALID_FILE;
+    }
+
+    // left - по file_size, как у обхода; данные за концом таблицы не читаются
+    const uint8_t *p = table->data + pos;
+    const uint8_t *end = table->data + table->size;
+    while (left >= 12)
+    {
+        if (end - p < 12)
+            return SQUASH_ERROR_INVALID_FILE;
+        uint32_t count = GET_LE32(p) + 1;
+        uint32_t start_block = GET_LE32(p + 4);
+        p += 12;
+        left -= 12;
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (left < 8)
+                return SQUASH_OK;
+            if (end - p < 8)
+                return SQUASH_ERROR_INVALID_FILE;
+            uint16_t offset_field = GET_LE16(p);
+            uint16_t type = GET_LE16(p + 4);
+            size_t name_size = (size_t)GET_LE16(p + 6) + 1;
+            p += 8;
+            left -= 8;
+            if (type < SQUASHFS_DIR_TYPE || type > SQUASHFS_CHRDEV_TYPE || name_size > 255)
+                return SQUASH_ERROR_INVALID_FILE;
+            if (left < name_size + 1)
+                return SQUASH_OK;
+            if ((size_t)(end - p) < name_size)
+                return SQUASH_ERROR_INVALID_FILE;
+            const char *name = (const char *)p;
+            p += name_size;
+            left -= name_size;
+
+            if ((name_size == 1 && name[0] == '.') || (name_size == 2 && name[0] == '.' && name[1] == '.'))
+                continue;
+            // Имя с нулём внутри обход не найдёт: путь обрезался бы на нём
+            if (memchr(name, '\0', name_size))
+                continue;
+            squash_off_t inode_ref = ((uint64_t)start_block << 16) | offset_field;
+            bool is_dir = type == SQUASHFS_DIR_TYPE || type == SQUASHFS_LDIR_TYPE;
+            if (is_dir && squash_visited_inodes_contains(visited, inode_ref))
+                continue; // Цикл или повтор: путь не индексируется
+            squash_error_t err = SQUASH_OK;
+            if (is_dir)
+                err = squash_visited_inodes_add(visited, inode_ref);
+            if (err == SQUASH_OK)
+                err = add_entry(index, parent, name, name_size, inode_ref, type);
+            if (err != SQUASH_OK)
+                return err;
+        }
+    }
+    return SQUASH_OK;
+}
+
+// Все пути в порядке обхода в ширину; иноды каталогов читаются как обычно, листинги - из распакованной таблицы
+static squash_error_t collect_paths(squash_fs_t *fs, const dir_table_t *table, squash_path_index_t *index)
+{
+    squash_error_t err = add_entry(index, 0, NULL, 0, fs->super.root_inode, SQUASHFS_DIR_TYPE);
+    if (err != SQUASH_OK)
+        return err;
+
+    squash_visited_inodes_t visited;
+    err = squash_visited_inodes_init(&visited, 64);
+    if (err != SQUASH_OK)
+        return err;
+    err = squash_visited_inodes_add(&visited, fs->super.root_inode);
+
+    squash_arena_t *arena = squash_arena_create(0);
+    if (!arena)
+        err = SQUASH_ERROR_MEMORY;
+
+    for (size_t next = 0; err == SQUASH_OK && next < index->count; next++)
+    {
+        if (index->entries[next].type != SQUASHFS_DIR_TYPE && index->entries[next].type != SQUASHFS_LDIR_TYPE)
+            continue;
+        squash_arena_mark_t mark = squash_arena_mark(arena);
+        void *inode;
+        err = squash_read_inode_arena(fs, index->entries[next].inode_ref, arena, &inode);
+        if (err == SQUASH_OK)
+            err = add_listing(index, table, next, (squash_dir_inode_t *)inode, &visited);
+        squash_arena_rewind(arena, mark);
+    }
+
+    if (arena)
+        squash_arena_destroy(arena);
+    squash_visited_inodes_free(&visited);
+    return err;
+}
+
+// Таблица заполнена не больше чем наполовину: промах заканчивается на первом пустом слоте
+static squash_error_t build_slots(squash_path_index_t *index)
+{
+    if (index->count >= UINT32_MAX / 2)
+        return SQUASH_ERROR_MEMORY;
+    size_t slots = 16;
+    while (slots < index->count * 2)
+        slots *= 2;
+    index->slots = calloc(slots, sizeof(uint32_t));
+    if (!index->slots)
+        return SQUASH_ERROR_MEMORY;
+    index->slot_count = slots;
+    for (size_t i = 0; i < index->count; i++)
+    {
+        size_t slot = index->entries[i].hash & (slots - 1);
+        while (index->slots[slot])
+            slot = (slot + 1) & (slots - 1);
+        index->slots[slot] = (uint32_t)i + 1;
+    }
+    return SQUASH_OK;
+}
+
+static bool find_entry(void *ctx, const char *path, size_t len, squash_off_t *inode_ref, uint16_t *type)
+{
+    const squash_path_index_t *index = ctx;
+    uint64_t hash = squash_path_hash(path, len);
+    size_t mask = index->slot_count - 1;
+    for (size_t slot = hash & mask; index->slots[slot]; slot = (slot + 1) & mask)
+    {
+        const squash_path_entry_t *entry = &index->entries[index->slots[slot] - 1];
+        if (entry->hash == hash && entry->name_size == len &&
+            memcmp(index->names + entry->name_offset, path, len) == 0)
+        {
+            *inode_ref = entry->inode_ref;
+            *type = entry->type;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool squash_path_index_lookup(squash_fs_t *fs, const char *path, squash_off_t *inode_ref, squash_error_t *err)
+{
+    if (!fs->path_index.slots)
+        return false;
+    return squash_path_resolve(find_entry, &fs->path_index, path, inode_ref, err);
+}
+
+void squash_path_index_free(squash_path_index_t *index)
+{
+    free(index->entries);
+    free(index->names);
+    free(index->slots);
+    memset(index, 0, sizeof(*index));
+}
+
+squash_error_t squash_path_table_build(squash_fs_t *fs, squash_path_index_t *index)
+{
+    memset(index, 0, sizeof(*index));
+    dir_table_t table = {0};
+    squash_error_t err = decode_directory_table(fs, &table);
+    if (err == SQUASH_OK)
+        err = collect_paths(fs, &table, index);
+    if (err == SQUASH_OK)
+        err = build_slots(index);
+    dir_table_free(&table);
+    if (err != SQUASH_OK)
+        squash_path_index_free(index);
+    return err;
+}
+
+SQUASH_API squash_error_t squash_build_path_index(squash_fs_t *fs)
+{
+    if (!fs || !fs->file)
+        return SQUASH_ERROR_INVALID_FILE;
+
+    squash_mutex_lock(&fs->lock);
+    squash_path_index_t index;
+    squash_error_t err = squash_path_table_build(fs, &index);
+    if (err == SQUASH_OK)
+    {
+        squash_path_index_free(&fs->path_index);
+        fs->path_index = index;
+    }
+    else
+    {
+        fprintf(stderr, "Failed to build path index: %s\n", squash_strerror(err));
+    }
+    squash_mutex_unlock(&fs->lock);
+    return err;
+}
@@ -0,0 +1,488 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/libsquash/squash.h"
+
+// Конвейер извлечения: поток чтения -> распаковка (вызывающий поток вместе с пулом squash_decode_blocks)
+// -> поток записи. Сегменты ходят по кольцу из nslots ячеек, каждая стадия продвигает свой счётчик
+
+#define SQUASH_PIPELINE_SLOTS 4
+#define SQUASH_PIPELINE_SEGMENT_BYTES (1024 * 1024)
+#define SQUASH_PIPELINE_MIN_SEGMENTS 4
+
+#define BLOCK_SIZE_MASK ((1u << 24) - 1)
+#define BLOCK_UNCOMPRESSED_BIT (1u << 24)
+
+typedef enum
+{
+    SEGMENT_DATA, // Блоки, которые нужно распаковать
+    SEGMENT_COPY, // Несжатые блоки: копируются из образа напрямую
+    SEGMENT_HOLE, // Sparse-блоки: в выходном файле остаётся дыра
+    SEGMENT_TAIL, // Хвост из фрагмента
+    SEGMENT_END
+} segment_kind_t;
+
+typedef struct
+{
+    segment_kind_t kind;
+    uint64_t offset;      // Позиция в файле
+    uint64_t size;        // Байт файла в сегменте
+    uint32_t first_block;
+    uint32_t nblocks;
+    uint64_t disk_offset;
+    uint8_t *raw;         // Блоки с диска (DATA)
+    uint8_t *out;         // Данные файла (DATA, TAIL и запасной путь COPY)
+} pipeline_slot_t;
+
+typedef struct
+{
+    squash_fs_t *fs;
+    squash_reg_inode_t *inode;
+    uint64_t file_size;
+    squash_writer_t *writer; // Используется только потоком записи
+    uint32_t nblocks;        // Полных блоков, без хвоста из фрагмента
+    uint32_t segment_blocks; // Блоков в сегменте DATA
+    size_t segment_bytes;
+    pipeline_slot_t *slots;
+    uint32_t nslots;
+
+    squash_mutex_t lock;
+    squash_cond_t cond;
+    squash_mutex_t file_lock; // Windows: чтения образа из разных стадий (см. pipeline_file_lock)
+    uint64_t read_pos;       // Сегментов прочитано
+    uint64_t decode_pos;     // Сегментов распаковано
+    uint64_t write_pos;      // Сегментов записано (ячейка снова свободна)
+    bool zero_copy;          // Сбрасывается, если копирование средствами ядра не работает
+    squash_error_t error;
+
+    uint64_t read_waits;
+    uint64_t decode_waits;
+    uint64_t write_waits;
+    uint32_t max_depth;
+    uint64_t copied;
+} pipeline_t;
+
+bool squash_extract_pipeline_enabled(squash_fs_t *fs, uint64_t file_size)
+{
+    if (fs->options.extract_pipeline_slots == 1)
+        return false;
+    return file_size >= (uint64_t)SQUASH_PIPELINE_MIN_SEGMENTS * SQUASH_PIPELINE_SEGMENT_BYTES;
+}
+
+// На Windows позиционное чтение (ReadFile с OVERLAPPED) сдвигает позицию файла, с которой читает fread.
+// fs->lock всё время держит поток распаковки, поэтому чтения образа всех трёх стадий упорядочиваются
+// собственной блокировкой конвейера. На остальных системах pread позицию не трогает
+static void pipeline_file_lock(pipeline_t *p)
+{
+#ifdef _WIN32
+    squash_mutex_lock(&p->file_lock);
+#else
+    (void)p;
+#endif
+}
+
+static void pipeline_file_unlock(pipeline_t *p)
+{
+#ifdef _WIN32
+    squash_mutex_unlock(&p->file_lock);
+#else
+    (void)p;
+#endif
+}
+
+static void pipeline_fail(pipeline_t *p, squash_error_t err)
+{
+    squash_mutex_lock(&p->lock);
+    if (p->error == SQUASH_OK)
+        p->error = err;
+    squash_cond_broadcast(&p->cond);
+    squash_mutex_unlock(&p->lock);
+}
+
+// Описывает следующий сегмент, начиная с блока *block, и читает его блоки с диска
+static squash_error_t pipeline_next_segment(pipeline_t *p, pipeline_slot_t *slot, bool zero_copy,
+                                            uint32_t *block, uint64_t *offset, uint64_t *disk_offset)
+{
+    uint32_t block_size = p->fs->super.block_size;
+    const uint32_t *list = p->inode->block_list;
+
+    slot->offset = *offset;
+    slot->first_block = *block;
+    slot->disk_offset = *disk_offset;
+    slot->nblocks = 0;
+    slot->size = 0;
+
+    if (*offset >= p->file_size)
+    {
+        slot->kind = SEGMENT_END;
+        return SQUASH_OK;
+    }
+    if (*block >= p->nblocks)
+    {
+        slot->kind = SEGMENT_TAIL;
+        slot->size = p->file_size - *offset;
+        *offset = p->file_size;
+        return SQUASH_OK;
+    }
+
+    uint32_t first = list[*block];
+    uint32_t first_size = first & BLOCK_SIZE_MASK;
+    size_t first_expected = (size_t)MIN(block_size, p->file_size - *offset);
+    if (first_size == 0)
+        slot->kind = SEGMENT_HOLE;
+    else if (zero_copy && (first & BLOCK_UNCOMPRESSED_BIT) && first_size == first_expected)
+        slot->kind = SEGMENT_COPY;
+    else
+        slot->kind = SEGMENT_DATA;
+
+    size_t raw_size = 0;
+    while (*block < p->nblocks)
+    {
+        uint32_t entry = list[*block];
+        uint32_t size = entry & BLOCK_SIZE_MASK;
+        size_t expected = (size_t)MIN(block_size, p->file_size - *offset);
+        bool copyable = zero_copy && (entry & BLOCK_UNCOMPRESSED_BIT) && size == expected;
+
+        if (slot->kind == SEGMENT_HOLE && size != 0)
+            break;
+        if (slot->kind == SEGMENT_COPY && !copyable)
+            break;
+        if (slot->kind == SEGMENT_DATA && (size == 0 || copyable || slot->nblocks == p->segment_blocks))
+            break;
+        if (size > block_size)
+        {
+            fprintf(stderr, "Invalid compressed_size %u for block %u\n", size, *block);
+            return SQUASH_ERROR_INVALID_BLOCK;
+        }
+
+        slot->nblocks++;
+        slot->size += expected;
+        raw_size += size;
+        *offset += expected;
+        *disk_offset += size;
+        (*block)++;
+    }
+
+    if (slot->kind != SEGMENT_DATA)
+        return SQUASH_OK;
+
+    if (slot->disk_offset + raw_size > p->fs->super.bytes_used)
+    {
+        fprintf(stderr, "Block run at 0x%llx + %zu exceeds bytes_used\n", (unsigned long long)slot->disk_offset, raw_size);
+        return SQUASH_ERROR_INVALID_FILE;
+    }
+    squash_io_request_t req;
+    memset(&req, 0, sizeof(req));
+    req.offset = slot->disk_offset;
+    req.size = raw_size;
+    req.buffer = slot->raw;
+    pipeline_file_lock(p);
+    squash_error_t err = squash_io_read(p->fs->io, &req, 1);
+    pipeline_file_unlock(p);
+    return err;
+}
+
+static void pipeline_reader(void *arg)
+{
+    pipeline_t *p = arg;
+    uint32_t block = 0;
+    uint64_t offset = 0;
+    uint64_t disk_offset = p->inode->start_block;
+
+    for (;;)
+    {
+        squash_mutex_lock(&p->lock);
+        if (p->read_pos - p->write_pos >= p->nslots && p->error == SQUASH_OK)
+        {
+            p->read_waits++;
+            while (p->read_pos - p->write_pos >= p->nslots && p->error == SQUASH_OK)
+                squash_cond_wait(&p->cond, &p->lock);
+        }
+        bool stop = p->error != SQUASH_OK;
+        bool zero_copy = p->zero_copy;
+        squash_mutex_unlock(&p->lock);
+        if (stop)
+            return;
+
+        pipeline_slot_t *slot = &p->slots[p->read_pos % p->nslots];
+        squash_error_t err = pipeline_next_segment(p, slot, zero_copy, &block, &offset, &disk_offset);
+        if (err != SQUASH_OK)
+        {
+            pipeline_fail(p, err);
+            return;
+        }
+
+        // После публикации ячейку могут забрать следующие стадии, тип сегмента запоминаем заранее
+        segment_kind_t kind = slot->kind;
+        squash_mutex_lock(&p->lock);
+        p->read_pos++;
+        uint32_t depth = (uint32_t)(p->read_pos - p->write_pos);
+        if (depth > p->max_depth)
+            p->max_depth = depth;
+        squash_cond_broadcast(&p->cond);
+        squash_mutex_unlock(&p->lock);
+
+        if (kind == SEGMENT_END)
+            return;
+    }
+}
+
+static squash_error_t pipeline_decode(pipeline_t *p, pipeline_slot_t *slot, squash_decode_job_t *jobs)
+{
+    uint32_t block_size = p->fs->super.block_size;
+
+    if (slot->kind == SEGMENT_TAIL)
+    {
+        size_t bytes_read = 0;
+        pipeline_file_lock(p);
+        squash_error_t err = squash_read_file(p->fs, p->inode, slot->out, slot->offset, (size_t)slot->size, &bytes_read);
+        pipeline_file_unlock(p);
+        if (err == SQUASH_OK && bytes_read != slot->size)
+            err = SQUASH_ERROR_IO;
+        return err;
+    }
+    if (slot->kind != SEGMENT_DATA)
+        return SQUASH_OK;
+
+    // Блоки распаковываются прямо на свои места в буфере сегмента
+    size_t pos = 0;
+    for (uint32_t i = 0; i < slot->nblocks; i++)
+    {
+        uint32_t entry = p->inode->block_list[slot->first_block + i];
+        jobs[i].src = slot->raw + pos;
+        jobs[i].src_size = entry & BLOCK_SIZE_MASK;
+        jobs[i].compressed = !(entry & BLOCK_UNCOMPRESSED_BIT);
+        jobs[i].dst = slot->out + (size_t)i * block_size;
+        jobs[i].dst_capacity = (size_t)MIN(block_size, slot->size - (uint64_t)i * block_size);
+        pos += jobs[i].src_size;
+    }
+    squash_error_t err = squash_decode_blocks(p->fs, jobs, slot->nblocks);
+    for (uint32_t i = 0; err == SQUASH_OK && i < slot->nblocks; i++)
+    {
+        if (jobs[i].out_size != jobs[i].dst_capacity)
+        {
+            fprintf(stderr, "Failed to unpack block %u: size %zu, expected %zu\n", slot->first_block + i,
+                    jobs[i].out_size, jobs[i].dst_capacity);
+            err = SQUASH_ERROR_INVALID_FILE;
+        }
+    }
+    return err;
+}
+
+// Запасной путь для COPY: несжатые блоки совпадают с данными файла, их достаточно прочитать
+static squash_error_t pipeline_copy_buffered(pipeline_t *p, pipeline_slot_t *slot)
+{
+    for (uint64_t done = 0; done < slot->size;)
+    {
+        size_t chunk = (size_t)MIN(p->segment_bytes, slot->size - done);
+        pipeline_file_lock(p);
+        squash_error_t err = squash_pread(p->fs->file, slot->disk_offset + done, chunk, slot->out);
+        pipeline_file_unlock(p);
+        if (err != SQUASH_OK)
+            return err;
+        err = squash_writer_write(p->writer, slot->out, chunk);
+        if (err != SQUASH_OK)
+            return err;
+        done += chunk;
+    }
+    return SQUASH_OK;
+}
+
+static void pipeline_writer(void *arg)
+{
+    pipeline_t *p = arg;
+
+    for (;;)
+    {
+        squash_mutex_lock(&p->lock);
+        if (p->write_pos == p->decode_pos && p->error == SQUASH_OK)
+        {
+            p->write_waits++;
+            while (p->write_pos == p->decode_pos && p->error == SQUASH_OK)
+                squash_cond_wait(&p->cond, &p->lock);
+        }
+        bool stop = p->error != SQUASH_OK;
+        squash_mutex_unlock(&p->lock);
+        if (stop)
+            return;
+
+        pipeline_slot_t *slot = &p->slots[p->write_pos % p->nslots];
+        squash_error_t err = SQUASH_OK;
+        switch (slot->kind)
+        {
+        case SEGMENT_DATA:
+        case SEGMENT_TAIL:
+            err = squash_writer_write(p->writer, slot->out, (size_t)slot->size);
+            break;
+        case SEGMENT_COPY:
+            if (squash_writer_copy_image(p->fs, p->writer, slot->disk_offset, slot->size))
+            {
+                p->copied += slot->size;
+                break;
+            }
+            // Ядро или файловые системы не поддерживают копирование - дальше только обычным путём
+            squash_mutex_lock(&p->lock);
+            p->zero_copy = false;
+            squash_mutex_unlock(&p->lock);
+            err = pipeline_copy_buffered(p, slot);
+            break;
+        case SEGMENT_HOLE:
+            err = squash_writer_skip(p->writer, slot->size);
+            break;
+        case SEGMENT_END:
+            // Размер файла, который заканчивается дырой, задаёт squash_writer_close
+            break;
+        }
+        if (err != SQUASH_OK)
+        {
+            pipeline_fail(p, err);
+            return;
+        }
+        segment_kind_t kind = slot->kind;
+        squash_mutex_lock(&p->lock);
+        p->write_pos++;
+        squash_cond_broadcast(&p->cond);
+        squash_mutex_unlock(&p->lock);
+
+        if (kind == SEGMENT_END)
+            return;
+    }
+}
+
+static void pipeline_free_slots(pipeline_t *p)
+{
+    for (uint32_t i = 0; i < p->nslots; i++)
+    {
+        free(p->slots[i].raw);
+        free(p->slots[i].out);
+    }
+    free(p->slots);
+}
+
+squash_error_t squash_extract_pipeline(squash_fs_t *fs, squash_reg_inode_t *inode, uint64_t file_size,
+                                       squash_writer_t *writer)
+{
+    uint32_t block_size = fs->super.block_size;
+
+    pipeline_t p;
+    memset(&p, 0, sizeof(p));
+    p.fs = fs;
+    p.inode = inode;
+    p.file_size = file_size;
+    p.writer = writer;
+    p.nblocks = (uint32_t)(file_size / block_size);
+    if (inode->fragment == 0xFFFFFFFF && file_size % block_size != 0)
+        p.nblocks++;
+    p.segment_blocks = SQUASH_PIPELINE_SEGMENT_BYTES / block_size;
+    if (p.segment_blocks == 0)
+        p.segment_blocks = 1;
+    p.segment_bytes = (size_t)p.segment_blocks * block_size;
+    p.nslots = fs->options.extract_pipeline_slots ? fs->options.extract_pipeline_slots : SQUASH_PIPELINE_SLOTS;
+    p.zero_copy = true;
+
+    if (p.nblocks > 0 && !inode->block_list)
+        return SQUASH_ERROR_INVALID_INODE;
+
+    p.slots = calloc(p.nslots, sizeof(pipeline_slot_t));
+    squash_decode_job_t *jobs = calloc(p.segment_blocks, sizeof(squash_decode_job_t));
+    if (!p.slots || !jobs)
+    {
+        free(p.slots);
+        free(jobs);
+        return SQUASH_ERROR_MEMORY;
+    }
+    for (uint32_t i = 0; i < p.nslots; i++)
+    {
+        p.slots[i].raw = malloc(p.segment_bytes);
+        p.slots[i].out = malloc(p.segment_bytes);
+        if (!p.slots[i].raw || !p.slots[i].out)
+        {
+            pipeline_free_slots(&p);
+            free(jobs);
+            return SQUASH_ERROR_MEMORY;
+        }
+    }
+
+    squash_mutex_init(&p.lock);
+    squash_cond_init(&p.cond);
+    squash_mutex_init(&p.file_lock);
+
+    squash_thread_t reader_thread, writer_thread;
+    squash_error_t err = squash_thread_create(&reader_thread, pipeline_reader, &p);
+    if (err != SQUASH_OK)
+    {
+        squash_mutex_destroy(&p.file_lock);
+        squash_cond_destroy(&p.cond);
+        squash_mutex_destroy(&p.lock);
+        pipeline_free_slots(&p);
+        free(jobs);
+        return err;
+    }
+    err = squash_thread_create(&writer_thread, pipeline_writer, &p);
+    if (err != SQUASH_OK)
+    {
+        pipeline_fail(&p, err);
+        squash_thread_join(reader_thread);
+        squash_mutex_destroy(&p.file_lock);
+        squash_cond_destroy(&p.cond);
+        squash_mutex_destroy(&p.lock);
+        pipeline_free_slots(&p);
+        free(jobs);
+        return err;
+    }
+
+    // Распаковка идёт в вызывающем потоке: ему принадлежат fs->lock и пул распаковки
+    for (;;)
+    {
+        squash_mutex_lock(&p.lock);
+        if (p.decode_pos == p.read_pos && p.error == SQUASH_OK)
+        {
+            p.decode_waits++;
+            while (p.decode_pos == p.read_pos && p.error == SQUASH_OK)
+                squash_cond_wait(&p.cond, &p.lock);
+        }
+        bool stop = p.error != SQUASH_OK;
+        squash_mutex_unlock(&p.lock);
+        if (stop)
+            break;
+
+        pipeline_slot_t *slot = &p.slots[p.decode_pos % p.nslots];
+        err = pipeline_decode(&p, slot, jobs);
+        if (err != SQUASH_OK)
+        {
+            pipeline_fail(&p, err);
+            break;
+        }
+
+        segment_kind_t kind = slot->kind;
+        squash_mutex_lock(&p.lock);
+        p.decode_pos++;
+        squash_cond_broadcast(&p.cond);
+        squash_mutex_unlock(&p.lock);
+
+        if (kind == SEGMENT_END)
+            break;
+    }
+
+    squash_thread_join(reader_thread);
+    squash_thread_join(writer_thread);
+
+    fs->pipeline_files++;
+    fs->pipeline_segments += p.write_pos;
+    fs->pipeline_read_waits += p.read_waits;
+    fs->pipeline_decode_waits += p.decode_waits;
+    fs->pipeline_write_waits += p.write_waits;
+    if (p.max_depth > fs->pipeline_max_depth)
+        fs->pipeline_max_depth = p.max_depth;
+    fs->zero_copy_bytes += p.copied;
+
+    squash_mutex_destroy(&p.file_lock);
+    squash_cond_destroy(&p.cond);
+    squash_mutex_destroy(&p.lock);
+    pipeline_free_slots(&p);
+    free(jobs);
+
+    if (p.error != SQUASH_OK)
+        fprintf(stderr, "Pipelined extraction of %s failed: %s\n", writer->path, squash_strerror(p.error));
+    return p.error;
+}
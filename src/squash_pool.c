@@ -0,0 +1,72 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../include/libsquash/squash.h"
+
+// Без блокировки: см. squash_buffer_pool_t. Если чтение блоков выйдет из-под fs->lock, пулу понадобятся
+// копии на поток
+
+squash_error_t squash_buffer_pool_init(squash_buffer_pool_t *pool, size_t buffer_size)
+{
+    memset(pool, 0, sizeof(*pool));
+    pool->buffer_size = buffer_size;
+    pool->free_capacity = 8;
+    pool->free_list = malloc(pool->free_capacity * sizeof(uint8_t *));
+    if (!pool->free_list)
+    {
+        pool->free_capacity = 0;
+        return SQUASH_ERROR_MEMORY;
+    }
+    return SQUASH_OK;
+}
+
+void squash_buffer_pool_destroy(squash_buffer_pool_t *pool)
+{
+    if (!pool)
+        return;
+    for (size_t i = 0; i < pool->free_count; i++)
+    {
+        free(pool->free_list[i]);
+    }
+    free(pool->free_list);
+    memset(pool, 0, sizeof(*pool));
+}
+
+uint8_t *squash_buffer_pool_acquire(squash_buffer_pool_t *pool)
+{
+    uint8_t *buf;
+    if (pool->free_count > 0)
+    {
+        buf = pool->free_list[--pool->free_count];
+    }
+    else
+    {
+        // Свободных буферов нет - выделяем новый и заранее резервируем место в free_list,
+        // чтобы release никогда не делал realloc
+        if (pool->allocated >= pool->free_capacity)
+        {
+            size_t new_capacity = pool->free_capacity ? pool->free_capacity * 2 : 8;
+            uint8_t **new_list = realloc(pool->free_list, new_capacity * sizeof(uint8_t *));
+            if (!new_list)
+                return NULL;
+            pool->free_list = new_list;
+            pool->free_capacity = new_capacity;
+        }
+        buf = malloc(pool->buffer_size);
+        if (!buf)
+            return NULL;
+        pool->allocated++;
+    }
+
+    pool->in_use++;
+    if (pool->in_use > pool->high_water)
+        pool->high_water = pool->in_use;
+    return buf;
+}
+
+void squash_buffer_pool_release(squash_buffer_pool_t *pool, uint8_t *buf)
+{
+    if (!buf)
+        return;
+    pool->free_list[pool->free_count++] = buf;
+    pool->in_use--;
+}
@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../include/libsquash/squash.h"
+
+#define SQUASH_READAHEAD_INITIAL_WINDOW 2
+#define SQUASH_READAHEAD_MAX_WINDOW 32
+
+#define BLOCK_SIZE_MASK ((1u << 24) - 1)
+#define BLOCK_UNCOMPRESSED_BIT (1u << 24)
+
+squash_error_t squash_readahead_init(squash_readahead_t *ra, uint32_t max_window)
+{
+    memset(ra, 0, sizeof(*ra));
+    ra->max_window = max_window ? max_window : SQUASH_READAHEAD_MAX_WINDOW;
+    ra->blocks = calloc(ra->max_window, sizeof(uint8_t *));
+    ra->sizes = calloc(ra->max_window, sizeof(size_t));
+    if (!ra->blocks || !ra->sizes)
+    {
+        free(ra->blocks);
+        free(ra->sizes);
+        ra->blocks = NULL;
+        ra->sizes = NULL;
+        return SQUASH_ERROR_MEMORY;
+    }
+    return SQUASH_OK;
+}
+
+// Возвращает блоки окна в пул; непрочитанные блоки учитываются для адаптации окна
+static void readahead_drop(squash_fs_t *fs, squash_readahead_t *ra)
+{
+    for (uint32_t i = 0; i < ra->count; i++)
+    {
+        squash_buffer_pool_release(&fs->buffer_pool, ra->blocks[i]);
+        ra->blocks[i] = NULL;
+        ra->sizes[i] = 0;
+    }
+    ra->count = 0;
+}
+
+void squash_readahead_destroy(squash_fs_t *fs, squash_readahead_t *ra)
+{
+    if (!ra->blocks)
+        return;
+    readahead_drop(fs, ra);
+    free(ra->blocks);
+    free(ra->sizes);
+    memset(ra, 0, sizeof(*ra));
+}
+
+// Читает блоки [first, first + window) одним запросом (блоки файла лежат на диске подряд)
+// и распаковывает их заранее
+static squash_error_t readahead_fill(squash_fs_t *fs, squash_readahead_t *ra, squash_reg_inode_t *inode,
+                                     uint32_t first, uint32_t nblocks, uint64_t disk_offset)
+{
+    uint32_t n = ra->window;
+    if (n > nblocks - first)
+        n = nblocks - first;
+
+    // Окно может сократиться до предела объединённого чтения
+    const uint8_t *raw = NULL;
+    squash_error_t err = squash_read_block_run(fs, inode->block_list, first, &n, disk_offset, &raw);
+    if (err != SQUASH_OK)
+        return err;
+
+    ra->file_start = inode->start_block;
+    ra->inode_number = inode->base.inode_number;
+    ra->first_block = first;
+
+    squash_decode_job_t *jobs = calloc(n, sizeof(squash_decode_job_t));
+    if (!jobs)
+        return SQUASH_ERROR_MEMORY;
+
+    // Буферы окна получаем заранее: при ошибке их освобождает readahead_drop
+    size_t pos = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint32_t entry = inode->block_list[first + i];
+        uint32_t size = entry & BLOCK_SIZE_MASK;
+        ra->blocks[i] = NULL;
+        ra->sizes[i] = 0;
+        ra->count++;
+        if (size == 0)
+            continue; // Sparse-блок обрабатывает вызывающий код, в окне он остаётся пустым
+
+        ra->blocks[i] = squash_buffer_pool_acquire(&fs->buffer_pool);
+        if (!ra->blocks[i])
+        {
+            free(jobs);
+            return SQUASH_ERROR_MEMORY;
+        }
+        jobs[i].src = raw + pos;
+        jobs[i].src_size = size;
+        jobs[i].compressed = !(entry & BLOCK_UNCOMPRESSED_BIT);
+        jobs[i].dst = ra->blocks[i];
+        jobs[i].dst_capacity = fs->super.block_size;
+        pos += size;
+    }
+
+    err = squash_decode_blocks(fs, jobs, n);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        ra->sizes[i] = jobs[i].out_size;
+        if (jobs[i].result != SQUASH_OK)
+            fprintf(stderr, "Read-ahead decompression failed for block %u: %s\n", first + i,
+                    squash_strerror(jobs[i].result));
+    }
+    free(jobs);
+    if (err != SQUASH_OK)
+        return err;
+
+    ra->windows_issued++;
+    ra->blocks_prefetched += n;
+    return SQUASH_OK;
+}
+
+squash_error_t squash_readahead_get(squash_fs_t *fs, squash_readahead_t *ra, squash_reg_inode_t *inode,
+                                    uint32_t block_idx, uint32_t nblocks, uint64_t disk_offset,
+                                    const uint8_t **data, size_t *size)
+{
+    bool same_file = ra->file_start == inode->start_block && ra->inode_number == inode->base.inode_number;
+
+    // Блок уже в окне
+    if (same_file && ra->count > 0 && block_idx >= ra->first_block && block_idx < ra->first_block + ra->count &&
+        ra->blocks[block_idx - ra->first_block])
+    {
+        ra->consumed = block_idx - ra->first_block + 1 > ra->consumed ? block_idx - ra->first_block + 1 : ra->consumed;
+        ra->next_block = block_idx + 1;
+        ra->hits++;
+        *data = ra->blocks[block_idx - ra->first_block];
+        *size = ra->sizes[block_idx - ra->first_block];
+        return SQUASH_OK;
+    }
+
+    // Последовательный доступ: продолжаем с того же блока (частичное чтение) или со следующего
+    bool sequential = same_file && ra->next_valid &&
+                      (block_idx == ra->next_block || block_idx + 1 == ra->next_block);
+
+    if (ra->count > 0)
+    {
+        // Окно использовано полностью - растём, иначе часть работы пропала и окно уменьшается
+        if (ra->consumed >= ra->count)
+        {
+            if (ra->window < ra->max_window)
+                ra->window = ra->window * 2 > ra->max_window ? ra->max_window : ra->window * 2;
+        }
+        else
+        {
+            ra->wasted += ra->count - ra->consumed;
+            ra->window = ra->window / 2 > SQUASH_READAHEAD_INITIAL_WINDOW ? ra->window / 2 : SQUASH_READAHEAD_INITIAL_WINDOW;
+        }
+        readahead_drop(fs, ra);
+        ra->consumed = 0;
+    }
+
+    ra->file_start = inode->start_block;
+    ra->inode_number = inode->base.inode_number;
+    ra->next_block = block_idx + 1;
+    ra->next_valid = true;
+
+    if (!sequential || !inode->block_list || block_idx >= nblocks)
+    {
+        // Случайный доступ: окно не открываем, блок читается напрямую
+        return SQUASH_ERROR_NOT_FOUND;
+    }
+
+    if (ra->window < SQUASH_READAHEAD_INITIAL_WINDOW)
+        ra->window = SQUASH_READAHEAD_INITIAL_WINDOW;
+
+    squash_error_t err = readahead_fill(fs, ra, inode, block_idx, nblocks, disk_offset);
+    if (err != SQUASH_OK)
+    {
+        readahead_drop(fs, ra);
+        ra->next_valid = false;
+        return err;
+    }
+    if (!ra->blocks[0])
+    {
+        return SQUASH_ERROR_NOT_FOUND;
+    }
+
+    ra->consumed = 1;
+    *data = ra->blocks[0];
+    *size = ra->sizes[0];
+    return SQUASH_OK;
+}
+
+void squash_readahead_skip(squash_readahead_t *ra, squash_reg_inode_t *inode, uint32_t block_idx)
+{
+    // Sparse-блок не читается с диска, но последовательность чтения не прерывает
+    if (ra->next_valid && ra->file_start == inode->start_block && ra->inode_number == inode->base.inode_number &&
+        block_idx == ra->next_block)
+    {
+        ra->next_block = block_idx + 1;
+    }
+}
+
+bool squash_readahead_contains(squash_readahead_t *ra, squash_reg_inode_t *inode, uint32_t block_idx)
+{
+    return ra->count > 0 && ra->file_start == inode->start_block && ra->inode_number == inode->base.inode_number &&
+           block_idx >= ra->first_block && block_idx < ra->first_block + ra->count &&
+           ra->blocks[block_idx - ra->first_block] != NULL;
+}
+
+void squash_readahead_advance(squash_fs_t *fs, squash_readahead_t *ra, squash_reg_inode_t *inode, uint32_t next_block)
+{
+    // Блоки прочитаны в обход окна (объединённым чтением): старое окно больше не нужно,
+    // а следующее последовательное чтение продолжит с next_block
+    if (ra->count > 0)
+    {
+        ra->wasted += ra->count - ra->consumed;
+        readahead_drop(fs, ra);
+        ra->consumed = 0;
+    }
+    ra->file_start = inode->start_block;
+    ra->inode_number = inode->base.inode_number;
+    ra->next_block = next_block;
+    ra->next_valid = true;
+}
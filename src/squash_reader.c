@@ -1,15 +1,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include "../include/libsquash/squash.h"
 
 #define SQUASHFS_MAGIC 0x73717368
 #define SQUASHFS_VERSION_MAJOR 4
+#define SQUASHFS_COMPRESSOR_OPTIONS 0x0400 // За суперблоком лежит блок параметров кодека
 #define SQUASHFS_INVALID_BLK 0xFFFFFFFFFFFFFFFF
 
 static squash_error_t read_super_block(FILE *file, squash_super_t *super)
 {
-    if (fseek(file, 0, SEEK_SET) != 0)
+    if (squash_fseek(file, 0) != 0)
     {
         fprintf(stderr, "Error seeking to start of file: %s\n", strerror(errno));
         return SQUASH_ERROR_IO;
@@ -65,16 +67,22 @@ static squash_error_t read_super_block(FILE *file, squash_super_t *super)
     if (super->inode_table_start >= super->bytes_used)
     {
         fprintf(stderr, "Invalid inode_table_start: 0x%llX >= bytes_used: 0x%llX\n",
-               super->inode_table_start, super->bytes_used);
+               (unsigned long long)super->inode_table_start, (unsigned long long)super->bytes_used);
         return SQUASH_ERROR_INVALID_FILE;
     }
 
-    // Проверяем compression
-    if (super->compression < 1 || super->compression > 5)
+    // Проверяем compression: годится любой id, для которого есть встроенный или зарегистрированный кодек
+    if (super->compression < 1 || super->compression >= SQUASH_MAX_CODEC_ID)
     {
-        fprintf(stderr, "Unsupported compression: %u\n", super->compression);
+        fprintf(stderr, "Invalid compression id: %u\n", super->compression);
         return SQUASH_ERROR_COMPRESSION;
     }
+    if (!squash_find_codec(super->compression))
+    {
+        fprintf(stderr, "Unsupported compression: %u (not built in and no codec registered for it)\n",
+                super->compression);
+        return SQUASH_ERROR_COMPRESSION_NOT_SUPPORTED;
+    }
 
     // Проверяем block_size
     if (super->block_size != (1u << super->block_log))
@@ -88,16 +96,16 @@ static squash_error_t read_super_block(FILE *file, squash_super_t *super)
     printf("  Magic: 0x%08X\n", super->s_magic);
     printf("  Version: %u.%u\n", super->s_major, super->s_minor);
     printf("  Inodes: %u\n", super->inodes);
-    printf("  Bytes used: %llu\n", super->bytes_used);
-    printf("  Root inode: 0x%016llX\n", super->root_inode);
+    printf("  Bytes used: %llu\n", (unsigned long long)super->bytes_used);
+    printf("  Root inode: 0x%016llX\n", (unsigned long long)super->root_inode);
     printf("  Compression: %u\n", super->compression);
     printf("  Block size: %u\n", super->block_size);
-    printf("  Inode table start: 0x%016llX\n", super->inode_table_start);
-    printf("DEBUG: root_inode raw = 0x%016llX\n", super->root_inode);
-    printf("DEBUG: root_inode block = %llu\n", super->root_inode >> 16);
+    printf("  Inode table start: 0x%016llX\n", (unsigned long long)super->inode_table_start);
+    printf("DEBUG: root_inode raw = 0x%016llX\n", (unsigned long long)super->root_inode);
+    printf("DEBUG: root_inode block = %llu\n", (unsigned long long)(super->root_inode >> 16));
     printf("DEBUG: root_inode offset = %u\n", (uint16_t)(super->root_inode & 0xFFFF));
-    printf("DEBUG: inode_table_start = 0x%llX\n", super->inode_table_start);
-    printf("DEBUG: directory_table_start = 0x%llX\n", super->directory_table_start);
+    printf("DEBUG: inode_table_start = 0x%llX\n", (unsigned long long)super->inode_table_start);
+    printf("DEBUG: directory_table_start = 0x%llX\n", (unsigned long long)super->directory_table_start);
 
     // Отладочный вывод сырых данных
    /* printf("Raw superblock data:\n");
@@ -173,6 +181,10 @@ static squash_error_t read_inode_lookup_table(squash_fs_t *fs)
     printf("  inode_table_start: 0x%llX (%llu)\n", super->inode_table_start, super->inode_table_start);
     printf("  directory_table_start: 0x%llX (%llu)\n", super->directory_table_start, super->directory_table_start);*/
 
+    // Таблица сохранена в индексе уже распакованной
+    if (squash_index_copy_lookup(fs->index, super->inodes, &fs->inode_lookup_table))
+        return SQUASH_OK;
+
     uint32_t inodes = super->inodes;
     size_t lookup_bytes = SQUASHFS_LOOKUP_BYTES(inodes);
     uint32_t lookup_blocks = SQUASHFS_LOOKUP_BLOCKS(inodes);
@@ -185,7 +197,7 @@ static squash_error_t read_inode_lookup_table(squash_fs_t *fs)
     // Проверка lookup_table_start
     if (super->lookup_table_start >= super->bytes_used) {
         fprintf(stderr, "Invalid lookup_table_start: 0x%llX >= bytes_used: 0x%llX\n",
-               super->lookup_table_start, super->bytes_used);
+               (unsigned long long)super->lookup_table_start, (unsigned long long)super->bytes_used);
         fs->inode_lookup_table = NULL;
         return SQUASH_OK;
     }
@@ -199,7 +211,7 @@ static squash_error_t read_inode_lookup_table(squash_fs_t *fs)
 
     // Читаем индексы блоков
     if (read_fs_bytes(fs->file, super->lookup_table_start, index_bytes, block_index) != SQUASH_OK) {
-        fprintf(stderr, "Failed to read inode lookup table index at 0x%llX\n", super->lookup_table_start);
+        fprintf(stderr, "Failed to read inode lookup table index at 0x%llX\n", (unsigned long long)super->lookup_table_start);
         free(block_index);
         return SQUASH_ERROR_IO;
     }
@@ -216,7 +228,7 @@ static squash_error_t read_inode_lookup_table(squash_fs_t *fs)
     for (uint32_t i = 0; i < lookup_blocks; i++) {
         if (block_index[i] >= super->bytes_used || block_index[i] < super->inode_table_start) {
             fprintf(stderr, "Invalid block index[%u]: 0x%llX (out of range 0x%llX - 0x%llX)\n",
-                   i, block_index[i], super->inode_table_start, super->bytes_used);
+                   i, (unsigned long long)block_index[i], (unsigned long long)super->inode_table_start, (unsigned long long)super->bytes_used);
             valid_indices = false;
             break;
         }
@@ -252,7 +264,7 @@ static squash_error_t read_inode_lookup_table(squash_fs_t *fs)
 
         uint16_t block_header;
         if (read_fs_bytes(fs->file, block_index[i], 2, &block_header) != SQUASH_OK) {
-            fprintf(stderr, "Failed to read block header at 0x%llX\n", block_index[i]);
+            fprintf(stderr, "Failed to read block header at 0x%llX\n", (unsigned long long)block_index[i]);
             free(block_index);
             free(fs->inode_lookup_table);
             fs->inode_lookup_table = NULL;
@@ -266,14 +278,14 @@ static squash_error_t read_inode_lookup_table(squash_fs_t *fs)
                i, block_header, is_compressed ? "yes" : "no", block_size);*/
 
         if (block_size == 0 || block_size > SQUASHFS_METADATA_SIZE) {
-            fprintf(stderr, "Invalid block size %u at offset 0x%llX\n", block_size, block_index[i]);
+            fprintf(stderr, "Invalid block size %u at offset 0x%llX\n", block_size, (unsigned long long)block_index[i]);
             free(block_index);
             free(fs->inode_lookup_table);
             fs->inode_lookup_table = NULL;
             return SQUASH_ERROR_IO;
         }
 
-        uint8_t *compressed_data = malloc(block_size);
+        uint8_t *compressed_data = squash_buffer_pool_acquire(&fs->buffer_pool);
         if (!compressed_data) {
             fprintf(stderr, "Memory allocation failed for compressed data\n");
             free(block_index);
@@ -283,8 +295,8 @@ static squash_error_t read_inode_lookup_table(squash_fs_t *fs)
         }
 
         if (read_fs_bytes(fs->file, block_index[i] + 2, block_size, compressed_data)!=SQUASH_OK) {
-            fprintf(stderr, "Failed to read compressed data at 0x%llX\n", block_index[i] + 2);
-            free(compressed_data);
+            fprintf(stderr, "Failed to read compressed data at 0x%llX\n", (unsigned long long)(block_index[i] + 2));
+            squash_buffer_pool_release(&fs->buffer_pool, compressed_data);
             free(block_index);
             free(fs->inode_lookup_table);
             fs->inode_lookup_table = NULL;
@@ -292,10 +304,10 @@ static squash_error_t read_inode_lookup_table(squash_fs_t *fs)
         }
 
         size_t uncompressed_size = expected;
-        uint8_t *uncompressed_data = malloc(uncompressed_size);
+        uint8_t *uncompressed_data = squash_buffer_pool_acquire(&fs->buffer_pool);
         if (!uncompressed_data) {
             fprintf(stderr, "Memory allocation failed for uncompressed data\n");
-            free(compressed_data);
+            squash_buffer_pool_release(&fs->buffer_pool, compressed_data);
             free(block_index);
             free(fs->inode_lookup_table);
             fs->inode_lookup_table = NULL;
@@ -305,10 +317,10 @@ static squash_error_t read_inode_lookup_table(squash_fs_t *fs)
         if (is_compressed) {
             squash_error_t err = squash_decompress_block(fs->decompressor, compressed_data, block_size,
                                                         uncompressed_data, &uncompressed_size);
-            free(compressed_data);
+            squash_buffer_pool_release(&fs->buffer_pool, compressed_data);
             if (err != SQUASH_OK) {
                 fprintf(stderr, "Failed to decompress lookup block: %s\n", squash_strerror(err));
-                free(uncompressed_data);
+                squash_buffer_pool_release(&fs->buffer_pool, uncompressed_data);
                 free(block_index);
                 free(fs->inode_lookup_table);
                 fs->inode_lookup_table = NULL;
@@ -317,7 +329,7 @@ static squash_error_t read_inode_lookup_table(squash_fs_t *fs)
         } else {
             memcpy(uncompressed_data, compressed_data, block_size);
             uncompressed_size = block_size;
-            free(compressed_data);
+            squash_buffer_pool_release(&fs->buffer_pool, compressed_data);
         }
 
         // Копируем записи
@@ -336,7 +348,7 @@ static squash_error_t read_inode_lookup_table(squash_fs_t *fs)
         }
         printf("\n");*/
 
-        free(uncompressed_data);
+        squash_buffer_pool_release(&fs->buffer_pool, uncompressed_data);
     }
 
     free(block_index);
@@ -367,36 +379,117 @@ static squash_error_t read_inode_lookup_table(squash_fs_t *fs)
 }
 
 
-static squash_error_t init_decompressor(squash_fs_t *fs)
+// Параметры кодека: значения mksquashfs по умолчанию, поверх - блок параметров, если он есть
+static squash_error_t read_compressor_options(squash_fs_t *fs)
 {
+    squash_compressor_options_t *options = &fs->compressor_options;
+    memset(options, 0, sizeof(*options));
+    size_t expected = 0;
     switch (fs->super.compression)
     {
     case SQUASH_COMPRESSION_GZIP:
-        fs->decompressor = squash_decompressor_create(SQUASH_COMPRESSION_GZIP);
-        //printf("GZIP decompressor initialized\n");
+        options->gzip.level = 9;
+        options->gzip.window_bits = 15;
+        expected = 8;
         break;
-    case SQUASH_COMPRESSION_LZMA:
-        fs->decompressor = squash_decompressor_create(SQUASH_COMPRESSION_LZMA);
+    case SQUASH_COMPRESSION_XZ:
+        options->xz.dictionary_size = fs->super.block_size;
+        expected = 8;
         break;
     case SQUASH_COMPRESSION_LZO:
-        fs->decompressor = squash_decompressor_create(SQUASH_COMPRESSION_LZO);
-        break;
-    case SQUASH_COMPRESSION_XZ:
-        fs->decompressor = squash_decompressor_create(SQUASH_COMPRESSION_XZ);
+        options->lzo.algorithm = 4; // lzo1x_999
+        options->lzo.level = 8;
+        expected = 8;
         break;
     case SQUASH_COMPRESSION_LZ4:
-        fs->decompressor = squash_decompressor_create(SQUASH_COMPRESSION_LZ4);
+        options->lz4.version = SQUASH_LZ4_LEGACY;
+        expected = 8;
+        break;
+    case SQUASH_COMPRESSION_ZSTD:
+        options->zstd.level = 15;
+        expected = 4;
         break;
     default:
-        return SQUASH_ERROR_COMPRESSION;
+        break;
+    }
+
+    if ((fs->super.flags & SQUASHFS_COMPRESSOR_OPTIONS) && expected > 0)
+    {
+        uint8_t *data = NULL;
+        size_t size = 0, compressed_size = 0;
+        squash_error_t err = squash_read_metadata_block(fs, 96, &data, &size, &compressed_size);
+        if (err != SQUASH_OK)
+        {
+            fprintf(stderr, "Error reading compressor options: %s\n", squash_strerror(err));
+            return err;
+        }
+        if (size < expected)
+        {
+            fprintf(stderr, "Compressor options block too small: %zu bytes\n", size);
+            squash_buffer_pool_release(&fs->buffer_pool, data);
+            return SQUASH_ERROR_COMPRESSION;
+        }
+
+        // Поля без преобразования порядка байт, как в суперблоке
+        switch (fs->super.compression)
+        {
+        case SQUASH_COMPRESSION_GZIP:
+            options->gzip.level = *(uint32_t *)(data + 0);
+            options->gzip.window_bits = *(uint16_t *)(data + 4);
+            options->gzip.strategies = *(uint16_t *)(data + 6);
+            break;
+        case SQUASH_COMPRESSION_XZ:
+            options->xz.dictionary_size = *(uint32_t *)(data + 0);
+            options->xz.filters = *(uint32_t *)(data + 4);
+            break;
+        case SQUASH_COMPRESSION_LZO:
+            options->lzo.algorithm = *(uint32_t *)(data + 0);
+            options->lzo.level = *(uint32_t *)(data + 4);
+            break;
+        case SQUASH_COMPRESSION_LZ4:
+            options->lz4.version = *(uint32_t *)(data + 0);
+            options->lz4.flags = *(uint32_t *)(data + 4);
+            break;
+        case SQUASH_COMPRESSION_ZSTD:
+            options->zstd.level = *(uint32_t *)(data + 0);
+            break;
+        default:
+            break;
+        }
+        options->present = true;
+        squash_buffer_pool_release(&fs->buffer_pool, data);
     }
 
+    return squash_decompressor_configure(fs->decompressor, options);
+}
+
+static squash_error_t init_decompressor(squash_fs_t *fs)
+{
+    // Кодек берётся из реестра: встроенный или зарегистрированный через squash_register_codec
+    fs->decompressor = squash_decompressor_create((squash_compression_t)fs->super.compression);
+
     if (!fs->decompressor)
     {
         fprintf(stderr, "Error creating decompressor for compression type %u\n", fs->super.compression);
         return SQUASH_ERROR_COMPRESSION;
     }
 
+    if (fs->super.compression == SQUASH_COMPRESSION_GZIP &&
+        squash_decompressor_set_gzip_backend(fs->decompressor, fs->options.gzip_backend) != SQUASH_OK)
+    {
+        fprintf(stderr, "GZIP backend %s is not available, using %s\n",
+                squash_gzip_backend_name(fs->options.gzip_backend),
+                squash_gzip_backend_name(squash_decompressor_gzip_backend(fs->decompressor)));
+    }
+
+    squash_error_t err = read_compressor_options(fs);
+    if (err != SQUASH_OK)
+    {
+        squash_decompressor_destroy(fs->decompressor);
+        fs->decompressor = NULL;
+        return err;
+    }
+
     return SQUASH_OK;
 }
 
@@ -408,7 +501,7 @@ static squash_error_t find_root_inode(squash_fs_t *fs)
     uint32_t root_inode_offset = fs->super.root_inode & 0xFFFF;       // Offset in block
     uint32_t current_block_index = 0;
 
-    if (fseek(fs->file, start, SEEK_SET) != 0)
+    if (squash_fseek(fs->file, start) != 0)
     {
         printf("Failed to seek to inode table start: %s\n", strerror(errno));
         return SQUASH_ERROR_IO;
@@ -416,10 +509,11 @@ static squash_error_t find_root_inode(squash_fs_t *fs)
 
     while (start < end)
     {
-        long current_file_offset = ftell(fs->file);
+        int64_t current_file_offset = squash_ftell(fs->file);
         if (current_file_offset < 0 || (uint64_t)current_file_offset >= fs->super.bytes_used)
         {
-            fprintf(stderr, "Current offset %ld exceeds bytes_used %llu\n", current_file_offset, fs->super.bytes_used);
+            fprintf(stderr, "Current offset %lld exceeds bytes_used %llu\n", (long long)current_file_offset,
+                    (unsigned long long)fs->super.bytes_used);
             return SQUASH_ERROR_IO;
         }
 
@@ -437,11 +531,11 @@ static squash_error_t find_root_inode(squash_fs_t *fs)
 
         if (block_size == 0 || block_size > SQUASHFS_METADATA_SIZE || (uint64_t)current_file_offset + block_size > fs->super.bytes_used)
         {
-            fprintf(stderr, "Invalid block size %u at offset %ld\n", block_size, current_file_offset);
+            fprintf(stderr, "Invalid block size %u at offset %lld\n", block_size, (long long)current_file_offset);
             return SQUASH_ERROR_IO;
         }
 
-        uint8_t *compressed_data = malloc(block_size);
+        uint8_t *compressed_data = squash_buffer_pool_acquire(&fs->buffer_pool);
         if (!compressed_data)
         {
             fprintf(stderr, "Memory allocation failed for block size %u\n", block_size);
@@ -449,16 +543,16 @@ static squash_error_t find_root_inode(squash_fs_t *fs)
         }
         if (fread(compressed_data, 1, block_size, fs->file) != block_size)
         {
-            free(compressed_data);
+            squash_buffer_pool_release(&fs->buffer_pool, compressed_data);
             fprintf(stderr, "Failed to read block data: %s\n", strerror(errno));
             return SQUASH_ERROR_IO;
         }
 
         size_t uncompressed_size = SQUASHFS_METADATA_SIZE;
-        uint8_t *uncompressed_data = malloc(uncompressed_size);
+        uint8_t *uncompressed_data = squash_buffer_pool_acquire(&fs->buffer_pool);
         if (!uncompressed_data)
         {
-            free(compressed_data);
+            squash_buffer_pool_release(&fs->buffer_pool, compressed_data);
             fprintf(stderr, "Memory allocation failed for uncompressed data\n");
             return SQUASH_ERROR_MEMORY;
         }
@@ -467,10 +561,10 @@ static squash_error_t find_root_inode(squash_fs_t *fs)
         {
             squash_error_t err = squash_decompress_block(fs->decompressor, compressed_data, block_size,
                                                          uncompressed_data, &uncompressed_size);
-            free(compressed_data);
+            squash_buffer_pool_release(&fs->buffer_pool, compressed_data);
             if (err != SQUASH_OK)
             {
-                free(uncompressed_data);
+                squash_buffer_pool_release(&fs->buffer_pool, uncompressed_data);
                 fprintf(stderr, "Failed to decompress block: %s\n", squash_strerror(err));
                 return err;
             }
@@ -479,7 +573,7 @@ static squash_error_t find_root_inode(squash_fs_t *fs)
         {
             memcpy(uncompressed_data, compressed_data, block_size);
             uncompressed_size = block_size;
-            free(compressed_data);
+            squash_buffer_pool_release(&fs->buffer_pool, compressed_data);
         }
 
         if ((uint64_t)current_file_offset == root_inode_start)
@@ -493,7 +587,7 @@ static squash_error_t find_root_inode(squash_fs_t *fs)
                     fs->super.root_inode = (block_offset << 16) | root_inode_offset;
                     //"Found valid root directory at offset 0x%llx, type=%u\n",
                            //root_inode_start, inode_type);
-                    free(uncompressed_data);
+                    squash_buffer_pool_release(&fs->buffer_pool, uncompressed_data);
                     return SQUASH_OK;
                 }
                 //printf("Root inode at offset 0x%llx is not a directory (type=%u)\n",
@@ -503,7 +597,7 @@ static squash_error_t find_root_inode(squash_fs_t *fs)
 
         start = current_file_offset + 2 + block_size;
         current_block_index++;
-        free(uncompressed_data);
+        squash_buffer_pool_release(&fs->buffer_pool, uncompressed_data);
     }
 
     fprintf(stderr, "No valid root directory found in inode table\n");
@@ -520,6 +614,9 @@ static squash_error_t read_fragment_table(squash_fs_t *fs)
         return SQUASH_OK;
     }
 
+    if (squash_index_copy_fragments(fs->index, super->fragments, &fs->fragment_table))
+        return SQUASH_OK;
+
     // Сколько entries помещается в один metadata block
     uint32_t entries_per_block = SQUASHFS_METADATA_SIZE / sizeof(struct squashfs_fragment_entry);
     uint32_t fragment_blocks = (super->fragments + entries_per_block - 1) / entries_per_block;
@@ -534,7 +631,7 @@ static squash_error_t read_fragment_table(squash_fs_t *fs)
         fprintf(stderr, "Memory allocation failed for fragment_index\n");
         return SQUASH_ERROR_MEMORY;
     }
-    if (fseek(fs->file, super->fragment_table_start, SEEK_SET) != 0)
+    if (squash_fseek(fs->file, super->fragment_table_start) != 0)
     {
         free(fragment_index);
         fprintf(stderr, "Failed to seek to fragment_table_start\n");
@@ -562,7 +659,7 @@ static squash_error_t read_fragment_table(squash_fs_t *fs)
 
         // Читаем header
         uint16_t block_header;
-        if (fseek(fs->file, block_offset, SEEK_SET) != 0 ||
+        if (squash_fseek(fs->file, block_offset) != 0 ||
             fread(&block_header, sizeof(uint16_t), 1, fs->file) != 1)
         {
             free(fragment_index);
@@ -585,7 +682,7 @@ static squash_error_t read_fragment_table(squash_fs_t *fs)
             return SQUASH_ERROR_INVALID_FILE;
         }
 
-        uint8_t *compressed_data = malloc(compressed_size);
+        uint8_t *compressed_data = squash_buffer_pool_acquire(&fs->buffer_pool);
         if (!compressed_data)
         {
             free(fragment_index);
@@ -596,7 +693,7 @@ static squash_error_t read_fragment_table(squash_fs_t *fs)
         }
         if (fread(compressed_data, 1, compressed_size, fs->file) != compressed_size)
         {
-            free(compressed_data);
+            squash_buffer_pool_release(&fs->buffer_pool, compressed_data);
             free(fragment_index);
             free(fs->fragment_table);
             fs->fragment_table = NULL;
@@ -615,7 +712,7 @@ static squash_error_t read_fragment_table(squash_fs_t *fs)
                                           decompressed_data, &decompressed_size);
             if (err != SQUASH_OK)
             {
-                free(compressed_data);
+                squash_buffer_pool_release(&fs->buffer_pool, compressed_data);
                 free(fragment_index);
                 free(fs->fragment_table);
                 fs->fragment_table = NULL;
@@ -624,7 +721,7 @@ static squash_error_t read_fragment_table(squash_fs_t *fs)
             }
             if (decompressed_size > SQUASHFS_METADATA_SIZE)
             {
-                free(compressed_data);
+                squash_buffer_pool_release(&fs->buffer_pool, compressed_data);
                 free(fragment_index);
                 free(fs->fragment_table);
                 fs->fragment_table = NULL;
@@ -637,7 +734,7 @@ static squash_error_t read_fragment_table(squash_fs_t *fs)
             memcpy(decompressed_data, compressed_data, compressed_size);
             decompressed_size = compressed_size;
         }
-        free(compressed_data);
+        squash_buffer_pool_release(&fs->buffer_pool, compressed_data);
 
         // Копируем fragment entries из этого блока
         uint32_t entries_left = super->fragments - fragments_read;
@@ -671,6 +768,11 @@ static squash_error_t read_fragment_table(squash_fs_t *fs)
 }
 
 SQUASH_API squash_error_t squash_open(const char *filename, squash_fs_t **fs)
+{
+    return squash_open_ex(filename, NULL, fs);
+}
+
+SQUASH_API squash_error_t squash_open_ex(const char *filename, const squash_open_options_t *options, squash_fs_t **fs)
 {
     if (!filename || !fs)
     {
@@ -685,6 +787,22 @@ SQUASH_API squash_error_t squash_open(const char *filename, squash_fs_t **fs)
 
     memset(*fs, 0, sizeof(squash_fs_t));
 
+    if (options)
+    {
+        (*fs)->options = *options;
+    }
+    if ((*fs)->options.max_coalesce_bytes == 0)
+    {
+        (*fs)->options.max_coalesce_bytes = SQUASH_DEFAULT_MAX_COALESCE_BYTES;
+    }
+    if ((*fs)->options.block_cache_bytes == 0)
+    {
+        (*fs)->options.block_cache_bytes = SQUASH_DEFAULT_BLOCK_CACHE_BYTES;
+    }
+    if ((*fs)->options.compressed_cache_bytes == 0)
+    {
+        (*fs)->options.compressed_cache_bytes = SQUASH_DEFAULT_COMPRESSED_CACHE_BYTES;
+    }
     (*fs)->file = fopen(filename, "rb");
     if (!(*fs)->file)
     {
@@ -702,19 +820,80 @@ SQUASH_API squash_error_t squash_open(const char *filename, squash_fs_t **fs)
         return err;
     }
 
+    // Буферы пула должны вмещать как блок данных, так и metadata-блок
+    size_t pool_buffer_size = (*fs)->super.block_size > SQUASHFS_METADATA_SIZE ? (*fs)->super.block_size : SQUASHFS_METADATA_SIZE;
+    err = squash_buffer_pool_init(&(*fs)->buffer_pool, pool_buffer_size);
+    if (err != SQUASH_OK)
+    {
+        fclose((*fs)->file);
+        free(*fs);
+        *fs = NULL;
+        return err;
+    }
+
+    err = squash_fs_cache_init(*fs);
+    if (err != SQUASH_OK)
+    {
+        squash_buffer_pool_destroy(&(*fs)->buffer_pool);
+        fclose((*fs)->file);
+        free(*fs);
+        *fs = NULL;
+        return err;
+    }
+
+    err = squash_readahead_init(&(*fs)->readahead, (*fs)->options.readahead_max_window);
+    if (err != SQUASH_OK)
+    {
+        squash_fs_cache_destroy(*fs);
+        squash_buffer_pool_destroy(&(*fs)->buffer_pool);
+        fclose((*fs)->file);
+        free(*fs);
+        *fs = NULL;
+        return err;
+    }
+
+    err = squash_io_create((*fs)->file, (*fs)->options.io_backend, (*fs)->options.io_threads,
+                           (*fs)->options.io_queue_depth, &(*fs)->io);
+    if (err != SQUASH_OK)
+    {
+        squash_readahead_destroy(*fs, &(*fs)->readahead);
+        squash_fs_cache_destroy(*fs);
+        squash_buffer_pool_destroy(&(*fs)->buffer_pool);
+        fclose((*fs)->file);
+        free(*fs);
+        *fs = NULL;
+        return err;
+    }
+
     err = init_decompressor(*fs);
     if (err != SQUASH_OK)
     {
+        squash_io_destroy((*fs)->io);
+        squash_readahead_destroy(*fs, &(*fs)->readahead);
+        squash_fs_cache_destroy(*fs);
+        squash_buffer_pool_destroy(&(*fs)->buffer_pool);
         fclose((*fs)->file);
         free(*fs);
         *fs = NULL;
         return err;
     }
 
+    // Индекс не подошёл - образ открывается как обычно
+    if ((*fs)->options.index_path &&
+        squash_index_open((*fs)->options.index_path, &(*fs)->super, &(*fs)->index) != SQUASH_OK)
+    {
+        fprintf(stderr, "Index %s not used\n", (*fs)->options.index_path);
+    }
+
     err = read_inode_lookup_table(*fs);
     if (err != SQUASH_OK)
     {
+        squash_index_close((*fs)->index);
         squash_decompressor_destroy((*fs)->decompressor);
+        squash_io_destroy((*fs)->io);
+        squash_readahead_destroy(*fs, &(*fs)->readahead);
+        squash_fs_cache_destroy(*fs);
+        squash_buffer_pool_destroy(&(*fs)->buffer_pool);
         fclose((*fs)->file);
         free(*fs);
         *fs = NULL;
@@ -724,8 +903,13 @@ SQUASH_API squash_error_t squash_open(const char *filename, squash_fs_t **fs)
     err = read_fragment_table(*fs);
     if (err != SQUASH_OK)
     {
+        squash_index_close((*fs)->index);
         free((*fs)->inode_lookup_table);
         squash_decompressor_destroy((*fs)->decompressor);
+        squash_io_destroy((*fs)->io);
+        squash_readahead_destroy(*fs, &(*fs)->readahead);
+        squash_fs_cache_destroy(*fs);
+        squash_buffer_pool_destroy(&(*fs)->buffer_pool);
         fclose((*fs)->file);
         free(*fs);
         *fs = NULL;
@@ -764,9 +948,14 @@ SQUASH_API squash_error_t squash_open(const char *filename, squash_fs_t **fs)
         err = find_root_inode(*fs);
         if (err != SQUASH_OK)
         {
+            squash_index_close((*fs)->index);
             free((*fs)->fragment_table);
             free((*fs)->inode_lookup_table);
             squash_decompressor_destroy((*fs)->decompressor);
+            squash_io_destroy((*fs)->io);
+            squash_readahead_destroy(*fs, &(*fs)->readahead);
+            squash_fs_cache_destroy(*fs);
+            squash_buffer_pool_destroy(&(*fs)->buffer_pool);
             fclose((*fs)->file);
             free(*fs);
             *fs = NULL;
@@ -781,15 +970,24 @@ SQUASH_API squash_error_t squash_open(const char *filename, squash_fs_t **fs)
     }
     else
     {
+        squash_index_close((*fs)->index);
         free((*fs)->fragment_table);
         free((*fs)->inode_lookup_table);
         squash_decompressor_destroy((*fs)->decompressor);
+        squash_io_destroy((*fs)->io);
+        squash_readahead_destroy(*fs, &(*fs)->readahead);
+        squash_fs_cache_destroy(*fs);
+        squash_buffer_pool_destroy(&(*fs)->buffer_pool);
         fclose((*fs)->file);
         free(*fs);
         *fs = NULL;
         return SQUASH_ERROR_MEMORY;
     }
 
+    squash_mutex_init_recursive(&(*fs)->lock);
+    squash_mutex_init(&(*fs)->async_lock);
+    squash_decoder_pool_init(&(*fs)->decoder_pool);
+    squash_cond_init(&(*fs)->async_idle);
     return SQUASH_OK;
 }
 
@@ -798,6 +996,12 @@ SQUASH_API void squash_close(squash_fs_t *fs)
     if (!fs)
         return;
 
+    // Сначала завершаются асинхронные запросы, затем останавливаются потоки ввода-вывода
+    squash_async_shutdown(fs);
+    squash_workers_destroy(fs->decode_workers);
+    squash_decoder_pool_destroy(&fs->decoder_pool);
+    squash_io_destroy(fs->io);
+
     if (fs->file)
     {
         fclose(fs->file);
@@ -813,6 +1017,9 @@ SQUASH_API void squash_close(squash_fs_t *fs)
         free(fs->inode_lookup_table);
     }
 
+    squash_index_close(fs->index);
+    squash_path_index_free(&fs->path_index);
+
     if (fs->id_table)
     {
         free(fs->id_table);
@@ -828,6 +1035,15 @@ SQUASH_API void squash_close(squash_fs_t *fs)
         squash_decompressor_destroy(fs->decompressor);
     }
 
+    squash_readahead_destroy(fs, &fs->readahead);
+    squash_partial_drop(fs);
+    squash_fs_cache_destroy(fs);
+    squash_buffer_pool_destroy(&fs->buffer_pool);
+    free(fs->io_buffer);
+
+    squash_cond_destroy(&fs->async_idle);
+    squash_mutex_destroy(&fs->async_lock);
+    squash_mutex_destroy(&fs->lock);
     free(fs);
 }
 
@@ -840,4 +1056,94 @@ SQUASH_API squash_error_t squash_get_super(squash_fs_t *fs, squash_super_t *supe
 
     memcpy(super, &fs->super, sizeof(squash_super_t));
     return SQUASH_OK;
+}
+
+SQUASH_API squash_error_t squash_get_compressor_options(squash_fs_t *fs, squash_compressor_options_t *options)
+{
+    if (!fs || !options)
+    {
+        return SQUASH_ERROR_INVALID_FILE;
+    }
+
+    memcpy(options, &fs->compressor_options, sizeof(squash_compressor_options_t));
+    return SQUASH_OK;
+}
+
+SQUASH_API squash_error_t squash_get_stats(squash_fs_t *fs, squash_stats_t *stats)
+{
+    if (!fs || !stats)
+    {
+        return SQUASH_ERROR_INVALID_FILE;
+    }
+
+    squash_mutex_lock(&fs->lock);
+    memset(stats, 0, sizeof(squash_stats_t));
+    stats->buffer_size = fs->buffer_pool.buffer_size;
+    stats->buffer_pool_allocated = fs->buffer_pool.allocated;
+    stats->buffer_pool_in_use = fs->buffer_pool.in_use;
+    stats->buffer_pool_high_water = fs->buffer_pool.high_water;
+    stats->readahead_window = fs->readahead.window;
+    stats->readahead_windows = fs->readahead.windows_issued;
+    stats->readahead_blocks = fs->readahead.blocks_prefetched;
+    stats->readahead_hits = fs->readahead.hits;
+    stats->readahead_wasted = fs->readahead.wasted;
+    stats->max_coalesce_bytes = fs->options.max_coalesce_bytes;
+    if (fs->super.compression == SQUASH_COMPRESSION_GZIP)
+        stats->gzip_backend = squash_decompressor_gzip_backend(fs->decompressor);
+    stats->codec_name = squash_decompressor_codec_name(fs->decompressor);
+    stats->coalesced_reads = fs->coalesced_reads;
+    stats->coalesced_blocks = fs->coalesced_blocks;
+    stats->zero_copy_bytes = fs->zero_copy_bytes;
+    stats->hardlinks_linked = fs->hardlinks_linked;
+    stats->hardlinks_copied = fs->hardlinks_copied;
+    stats->pipeline_files = fs->pipeline_files;
+    stats->pipeline_segments = fs->pipeline_segments;
+    stats->pipeline_read_waits = fs->pipeline_read_waits;
+    stats->pipeline_decode_waits = fs->pipeline_decode_waits;
+    stats->pipeline_write_waits = fs->pipeline_write_waits;
+    stats->pipeline_max_depth = fs->pipeline_max_depth;
+    stats->extract_files = fs->extract_files;
+    stats->extract_write_calls = fs->extract_write_calls;
+    stats->extract_dirs_created = fs->extract_dirs_created;
+    stats->extract_dir_cache_hits = fs->extract_dir_cache_hits;
+    stats->partial_decodes = fs->partial_decodes;
+    stats->partial_resumes = fs->partial_resumes;
+    stats->parallel_decodes = fs->parallel_decodes;
+    stats->parallel_decode_blocks = fs->parallel_decode_blocks;
+    stats->block_cache_capacity = fs->block_cache.capacity;
+    stats->block_cache_bytes = fs->block_cache.bytes;
+    stats->block_cache_entries = fs->block_cache.entries;
+    stats->block_cache_hits = fs->block_cache.hits;
+    stats->block_cache_misses = fs->block_cache.misses;
+    stats->block_cache_evictions = fs->block_cache.evictions;
+    stats->block_cache_promotions = fs->block_cache.promotions;
+    stats->compressed_cache_capacity = fs->compressed_cache.capacity;
+    stats->compressed_cache_bytes = fs->compressed_cache.bytes;
+    stats->compressed_cache_entries = fs->compressed_cache.entries;
+    stats->compressed_cache_hits = fs->compressed_cache.hits;
+    stats->compressed_cache_misses = fs->compressed_cache.misses;
+    stats->compressed_cache_evictions = fs->compressed_cache.evictions;
+    stats->compressed_cache_promotions = fs->compressed_cache.promotions;
+    squash_fs_cache_stats(fs, stats);
+    stats->index_loaded = fs->index != NULL;
+    stats->index_path_hits = fs->index_path_hits;
+    stats->index_inode_hits = fs->index_inode_hits;
+    stats->path_index_entries = fs->path_index.count;
+    stats->path_index_bytes = fs->path_index.capacity * sizeof(squash_path_entry_t) + fs->path_index.names_capacity +
+                              fs->path_index.slot_count * sizeof(uint32_t);
+    stats->path_index_hits = fs->path_index_hits;
+    squash_mutex_lock(&fs->decoder_pool.lock);
+    stats->decoder_pool_size = (uint32_t)fs->decoder_pool.count;
+    stats->decoder_pool_free = (uint32_t)fs->decoder_pool.free_count;
+    stats->decoder_pool_local_hits = fs->decoder_pool.local_hits;
+    stats->decoder_pool_shared = fs->decoder_pool.shared_acquires;
+    stats->decoder_pool_contended = fs->decoder_pool.contended;
+    squash_mutex_unlock(&fs->decoder_pool.lock);
+    if (fs->io)
+    {
+        stats->io_backend = squash_io_backend(fs->io);
+        squash_io_counters(fs->io, &stats->io_batches, &stats->io_requests);
+    }
+    squash_mutex_unlock(&fs->lock);
+    return SQUASH_OK;
 }
\ No newline at end of file
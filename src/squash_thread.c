@@ -0,0 +1,248 @@
+#include <stdlib.h>
+#include <string.h>
+#include "../include/libsquash/squash.h"
+
+// Функция потока и её аргумент: сигнатуры потоков Windows и pthreads отличаются от void (*)(void *)
+typedef struct
+{
+    void (*fn)(void *);
+    void *arg;
+} squash_thread_start_t;
+
+#ifdef _WIN32
+
+static DWORD WINAPI thread_trampoline(LPVOID param)
+{
+    squash_thread_start_t start = *(squash_thread_start_t *)param;
+    free(param);
+    start.fn(start.arg);
+    return 0;
+}
+
+squash_error_t squash_thread_create(squash_thread_t *thread, void (*fn)(void *), void *arg)
+{
+    squash_thread_start_t *start = malloc(sizeof(*start));
+    if (!start)
+        return SQUASH_ERROR_MEMORY;
+    start->fn = fn;
+    start->arg = arg;
+    *thread = CreateThread(NULL, 0, thread_trampoline, start, 0, NULL);
+    if (!*thread)
+    {
+        free(start);
+        return SQUASH_ERROR_MEMORY;
+    }
+    return SQUASH_OK;
+}
+
+void squash_thread_join(squash_thread_t thread)
+{
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+void squash_mutex_init(squash_mutex_t *mutex) { InitializeCriticalSection(mutex); }
+void squash_mutex_destroy(squash_mutex_t *mutex) { DeleteCriticalSection(mutex); }
+void squash_mutex_lock(squash_mutex_t *mutex) { EnterCriticalSection(mutex); }
+void squash_mutex_unlock(squash_mutex_t *mutex) { LeaveCriticalSection(mutex); }
+bool squash_mutex_trylock(squash_mutex_t *mutex) { return TryEnterCriticalSection(mutex) != 0; }
+
+void squash_cond_init(squash_cond_t *cond) { InitializeConditionVariable(cond); }
+void squash_cond_destroy(squash_cond_t *cond) { (void)cond; }
+void squash_cond_wait(squash_cond_t *cond, squash_mutex_t *mutex) { SleepConditionVariableCS(cond, mutex, INFINITE); }
+void squash_cond_signal(squash_cond_t *cond) { WakeConditionVariable(cond); }
+void squash_cond_broadcast(squash_cond_t *cond) { WakeAllConditionVariable(cond); }
+
+uint32_t squash_cpu_count(void)
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors ? (uint32_t)info.dwNumberOfProcessors : 1;
+}
+
+#else
+
+#include <unistd.h>
+
+static void *thread_trampoline(void *param)
+{
+    squash_thread_start_t start = *(squash_thread_start_t *)param;
+    free(param);
+    start.fn(start.arg);
+    return NULL;
+}
+
+squash_error_t squash_thread_create(squash_thread_t *thread, void (*fn)(void *), void *arg)
+{
+    squash_thread_start_t *start = malloc(sizeof(*start));
+    if (!start)
+        return SQUASH_ERROR_MEMORY;
+    start->fn = fn;
+    start->arg = arg;
+    if (pthread_create(thread, NULL, thread_trampoline, start) != 0)
+    {
+        free(start);
+        return SQUASH_ERROR_MEMORY;
+    }
+    return SQUASH_OK;
+}
+
+void squash_thread_join(squash_thread_t thread)
+{
+    pthread_join(thread, NULL);
+}
+
+void squash_mutex_init(squash_mutex_t *mutex) { pthread_mutex_init(mutex, NULL); }
+void squash_mutex_destroy(squash_mutex_t *mutex) { pthread_mutex_destroy(mutex); }
+void squash_mutex_lock(squash_mutex_t *mutex) { pthread_mutex_lock(mutex); }
+void squash_mutex_unlock(squash_mutex_t *mutex) { pthread_mutex_unlock(mutex); }
+bool squash_mutex_trylock(squash_mutex_t *mutex) { return pthread_mutex_trylock(mutex) == 0; }
+
+void squash_cond_init(squash_cond_t *cond) { pthread_cond_init(cond, NULL); }
+void squash_cond_destroy(squash_cond_t *cond) { pthread_cond_destroy(cond); }
+void squash_cond_wait(squash_cond_t *cond, squash_mutex_t *mutex) { pthread_cond_wait(cond, mutex); }
+void squash_cond_signal(squash_cond_t *cond) { pthread_cond_signal(cond); }
+void squash_cond_broadcast(squash_cond_t *cond) { pthread_cond_broadcast(cond); }
+
+uint32_t squash_cpu_count(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (uint32_t)n : 1;
+}
+
+#endif
+
+void squash_mutex_init_recursive(squash_mutex_t *mutex)
+{
+#ifdef _WIN32
+    // CRITICAL_SECTION рекурсивна сама по себе
+    InitializeCriticalSection(mutex);
+#else
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+#endif
+}
+
+// Пул рабочих потоков с общей FIFO-очередью задач
+typedef struct squash_task
+{
+    void (*fn)(void *);
+    void *arg;
+    struct squash_task *next;
+} squash_task_t;
+
+struct squash_workers
+{
+    squash_mutex_t lock;
+    squash_cond_t cond;
+    squash_task_t *head;
+    squash_task_t *tail;
+    squash_thread_t *threads;
+    uint32_t thread_count;
+    bool stop;
+};
+
+static void workers_main(void *arg)
+{
+    squash_workers_t *workers = arg;
+    squash_mutex_lock(&workers->lock);
+    for (;;)
+    {
+        squash_task_t *task = workers->head;
+        if (!task)
+        {
+            if (workers->stop)
+                break;
+            squash_cond_wait(&workers->cond, &workers->lock);
+            continue;
+        }
+        workers->head = task->next;
+        if (!workers->head)
+            workers->tail = NULL;
+        squash_mutex_unlock(&workers->lock);
+
+        task->fn(task->arg);
+        free(task);
+
+        squash_mutex_lock(&workers->lock);
+    }
+    squash_mutex_unlock(&workers->lock);
+}
+
+squash_error_t squash_workers_create(uint32_t threads, squash_workers_t **workers)
+{
+    *workers = calloc(1, sizeof(squash_workers_t));
+    if (!*workers)
+        return SQUASH_ERROR_MEMORY;
+    if (threads == 0)
+        threads = squash_cpu_count();
+
+    squash_mutex_init(&(*workers)->lock);
+    squash_cond_init(&(*workers)->cond);
+    (*workers)->threads = calloc(threads, sizeof(squash_thread_t));
+    if (!(*workers)->threads)
+    {
+        squash_workers_destroy(*workers);
+        *workers = NULL;
+        return SQUASH_ERROR_MEMORY;
+    }
+    for (uint32_t i = 0; i < threads; i++)
+    {
+        squash_error_t err = squash_thread_create(&(*workers)->threads[i], workers_main, *workers);
+        if (err != SQUASH_OK)
+        {
+            squash_workers_destroy(*workers);
+            *workers = NULL;
+            return err;
+        }
+        (*workers)->thread_count++;
+    }
+    return SQUASH_OK;
+}
+
+squash_error_t squash_workers_submit(squash_workers_t *workers, void (*fn)(void *), void *arg)
+{
+    squash_task_t *task = malloc(sizeof(squash_task_t));
+    if (!task)
+        return SQUASH_ERROR_MEMORY;
+    task->fn = fn;
+    task->arg = arg;
+    task->next = NULL;
+
+    squash_mutex_lock(&workers->lock);
+    if (workers->tail)
+        workers->tail->next = task;
+    else
+        workers->head = task;
+    workers->tail = task;
+    squash_cond_signal(&workers->cond);
+    squash_mutex_unlock(&workers->lock);
+    return SQUASH_OK;
+}
+
+uint32_t squash_workers_count(squash_workers_t *workers)
+{
+    return workers->thread_count;
+}
+
+void squash_workers_destroy(squash_workers_t *workers)
+{
+    if (!workers)
+        return;
+
+    // Оставшиеся в очереди задачи выполняются до остановки потоков
+    squash_mutex_lock(&workers->lock);
+    workers->stop = true;
+    squash_cond_broadcast(&workers->cond);
+    squash_mutex_unlock(&workers->lock);
+    for (uint32_t i = 0; i < workers->thread_count; i++)
+        squash_thread_join(workers->threads[i]);
+
+    free(workers->threads);
+    squash_cond_destroy(&workers->cond);
+    squash_mutex_destroy(&workers->lock);
+    free(workers);
+}
@@ -1,6 +1,10 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // fseeko
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <sys/stat.h>
 #ifdef _WIN32
 #include <direct.h>
@@ -8,19 +12,39 @@
 #else
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 #endif
 #include "../include/libsquash/squash.h"
 
+int squash_fseek(FILE *file, uint64_t offset)
+{
+    // fseek принимает long, на Windows он 32-битный
+#ifdef _WIN32
+    return _fseeki64(file, (__int64)offset, SEEK_SET);
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET);
+#endif
+}
+
+int64_t squash_ftell(FILE *file)
+{
+#ifdef _WIN32
+    return _ftelli64(file);
+#else
+    return ftello(file);
+#endif
+}
+
 squash_error_t read_fs_bytes(FILE *file, uint64_t start, size_t bytes, void *buffer)
 {
-    if (fseek(file, (long)start, SEEK_SET) != 0)
+    if (squash_fseek(file, start) != 0)
     {
-        fprintf(stderr, "Failed to seek to offset 0x%llX: %s\n", start, strerror(errno));
+        fprintf(stderr, "Failed to seek to offset 0x%llX: %s\n", (unsigned long long)start, strerror(errno));
         return SQUASH_ERROR_IO;
     }
     if (fread(buffer, 1, bytes, file) != bytes)
     {
-        fprintf(stderr, "Failed to read %zu bytes at offset 0x%llX: %s\n", bytes, start, strerror(errno));
+        fprintf(stderr, "Failed to read %zu bytes at offset 0x%llX: %s\n", bytes, (unsigned long long)start, strerror(errno));
         return SQUASH_ERROR_IO;
     }
     return SQUASH_OK;
@@ -30,86 +54,104 @@ squash_error_t squash_read_metadata_block(squash_fs_t *fs, squash_off_t offset,
 {
     if (offset >= fs->super.bytes_used)
     {
-        fprintf(stderr, "Invalid metadata block offset: %llu exceeds bytes_used=%llu\n", offset, fs->super.bytes_used);
+        fprintf(stderr, "Invalid metadata block offset: %llu exceeds bytes_used=%llu\n", (unsigned long long)offset, (unsigned long long)fs->super.bytes_used);
         return SQUASH_ERROR_INVALID_FILE;
     }
-    if (fseek(fs->file, offset, SEEK_SET) != 0)
+
+    // Распакованный блок - из кэша целиком, размер на диске хранится рядом
+    uint32_t aux = 0;
+    if (squash_fs_cache_copy(fs, SQUASH_CACHE_TIER_BLOCKS, offset, uncompressed_data, uncompressed_size, &aux))
     {
-        fprintf(stderr, "Error seeking to offset %llu: %s\n", offset, strerror(errno));
-        return SQUASH_ERROR_IO;
+        *compressed_size = aux;
+        return SQUASH_OK;
     }
+
     uint16_t block_header;
-    if (fread(&block_header, sizeof(uint16_t), 1, fs->file) != 1)
+    uint8_t *compressed_data = NULL;
+    size_t cached_size = 0;
+    const uint8_t *src = squash_fs_cache_peek(fs, SQUASH_CACHE_TIER_COMPRESSED, offset, &cached_size, &aux,
+                                              &compressed_data);
+    if (src)
     {
-        fprintf(stderr, "Error reading block header at offset %llu\n", offset);
-        return SQUASH_ERROR_IO;
+        // Сжатые байты уже в памяти: остаётся только распаковать
+        block_header = (uint16_t)aux;
+    }
+    else
+    {
+        if (squash_fseek(fs->file, offset) != 0)
+        {
+            fprintf(stderr, "Error seeking to offset %llu: %s\n", (unsigned long long)offset, strerror(errno));
+            return SQUASH_ERROR_IO;
+        }
+        if (fread(&block_header, sizeof(uint16_t), 1, fs->file) != 1)
+        {
+            fprintf(stderr, "Error reading block header at offset %llu\n", (unsigned long long)offset);
+            return SQUASH_ERROR_IO;
+        }
     }
     bool is_compressed = !(block_header & SQUASHFS_COMPRESSED_BIT_BLOCK);
     uint16_t block_size = block_header & SQUASHFS_COMPRESSED_SIZE_MASK;
 
-    if (block_size == 0 || block_size > SQUASHFS_METADATA_SIZE || offset + 2 + block_size > fs->super.bytes_used)
+    if (block_size == 0 || block_size > SQUASHFS_METADATA_SIZE || offset + 2 + block_size > fs->super.bytes_used ||
+        (src && cached_size != block_size))
     {
-        fprintf(stderr, "Invalid block size %u at offset %llu, would exceed filesystem bounds\n", block_size, offset);
+        squash_buffer_pool_release(&fs->buffer_pool, compressed_data);
+        fprintf(stderr, "Invalid block size %u at offset %llu, would exceed filesystem bounds\n", block_size, (unsigned long long)offset);
         return SQUASH_ERROR_INVALID_FILE;
     }
 
-    uint8_t *compressed_data = malloc(block_size);
-    if (!compressed_data)
+    if (!src)
     {
-        return SQUASH_ERROR_MEMORY;
-    }
+        compressed_data = squash_buffer_pool_acquire(&fs->buffer_pool);
+        if (!compressed_data)
+        {
+            return SQUASH_ERROR_MEMORY;
+        }
 
-    if (fread(compressed_data, 1, block_size, fs->file) != block_size)
-    {
-        free(compressed_data);
-        fprintf(stderr, "Error reading block data at offset %llu\n", offset);
-        return SQUASH_ERROR_IO;
+        if (fread(compressed_data, 1, block_size, fs->file) != block_size)
+        {
+            squash_buffer_pool_release(&fs->buffer_pool, compressed_data);
+            fprintf(stderr, "Error reading block data at offset %llu\n", (unsigned long long)offset);
+            return SQUASH_ERROR_IO;
+        }
+        if (is_compressed)
+        {
+            squash_fs_cache_put(fs, SQUASH_CACHE_TIER_COMPRESSED, offset, compressed_data, block_size, block_header,
+                                false);
+        }
+        src = compressed_data;
     }
 
-    *uncompressed_data = malloc(SQUASHFS_METADATA_SIZE);
+    *uncompressed_data = squash_buffer_pool_acquire(&fs->buffer_pool);
     if (!*uncompressed_data)
     {
-        free(compressed_data);
+        squash_buffer_pool_release(&fs->buffer_pool, compressed_data);
         return SQUASH_ERROR_MEMORY;
     }
 
     *uncompressed_size = SQUASHFS_METADATA_SIZE;
-    squash_error_t err;
-
     if (is_compressed)
     {
-        /*printf("Decompressing %u bytes, first 16: ", block_size);
-        for (size_t i = 0; i < 16 && i < block_size; i++)
-        {
-            printf("%02x ", compressed_data[i]);
-        }
-        printf("\n");*/
-        err = squash_decompress_block(fs->decompressor, compressed_data, block_size, *uncompressed_data, uncompressed_size);
-        free(compressed_data);
+        squash_error_t err = squash_decompress_block(fs->decompressor, src, block_size, *uncompressed_data, uncompressed_size);
         if (err != SQUASH_OK)
         {
-            free(*uncompressed_data);
+            squash_buffer_pool_release(&fs->buffer_pool, compressed_data);
+            squash_buffer_pool_release(&fs->buffer_pool, *uncompressed_data);
             *uncompressed_data = NULL;
-            fprintf(stderr, "Decompression failed at offset %llu: %s\n", offset, squash_strerror(err));
+            fprintf(stderr, "Decompression failed at offset %llu: %s\n", (unsigned long long)offset, squash_strerror(err));
             return err;
         }
-        /*printf("Decompressed %zu bytes, first 16: ", *uncompressed_size);
-        for (size_t i = 0; i < 16 && i < *uncompressed_size; i++)
-        {
-            printf("%02x ", (*uncompressed_data)[i]);
-        }
-        printf("\n");*/
     }
     else
     {
-        memcpy(*uncompressed_data, compressed_data, block_size);
+        memcpy(*uncompressed_data, src, block_size);
         *uncompressed_size = block_size;
-        free(compressed_data);
     }
+    squash_buffer_pool_release(&fs->buffer_pool, compressed_data);
+    squash_fs_cache_put(fs, SQUASH_CACHE_TIER_BLOCKS, offset, *uncompressed_data, *uncompressed_size, block_size,
+                        false);
 
     *compressed_size = block_size;
-    /*printf("Read metadata block: offset=0x%llx, compressed=%s, compressed_size=%u, uncompressed_size=%zu\n",
-           offset, is_compressed ? "Yes" : "No", block_size, *uncompressed_size);*/
     return SQUASH_OK;
 }
 
@@ -122,103 +164,35 @@ squash_error_t read_n_bytes_from_metablocks(squash_fs_t *fs, uint64_t start_offs
     size_t current_size = 0;
     size_t pos = offset_in_block;
 
-    // fprintf(stderr, "Reading %zu bytes from offset 0x%llx, pos=%zu\n", n_bytes, current_offset, pos);
-
     while (bytes_read < n_bytes)
     {
         if (!current_data || pos >= current_size)
         {
-            free(current_data);
+            // Позиция в следующем блоке: 0 после прочитанного до конца блока, либо остаток смещения,
+            // если начальная позиция лежит за первым метаблоком (inode на границе блоков)
+            if (current_data)
+                pos -= current_size;
+            squash_buffer_pool_release(&fs->buffer_pool, current_data);
             current_data = NULL;
 
-            // Читаем заголовок блока
-            uint16_t block_header;
-            if (read_fs_bytes(fs->file, current_offset, sizeof(block_header), &block_header) != SQUASH_OK)
-            {
-                fprintf(stderr, "Failed to read block header at 0x%llx: %s\n", current_offset, strerror(errno));
-                free(current_data);
-                return SQUASH_ERROR_IO;
-            }
-            block_header = squash_le16toh(block_header);
-
-            bool is_compressed = SQUASHFS_COMPRESSED(block_header);
-            uint16_t block_size = SQUASHFS_COMPRESSED_SIZE(block_header);
-            // fprintf(stderr, "Block: compressed=%s, size=%u\n", is_compressed ? "Yes" : "No", block_size);
-
-            if (block_size == 0 || block_size > SQUASHFS_METADATA_SIZE)
+            // Блок читается через squash_read_metadata_block, чтобы попадать в кэши блоков
+            size_t block_size = 0;
+            squash_error_t err = squash_read_metadata_block(fs, current_offset, &current_data, &current_size, &block_size);
+            if (err != SQUASH_OK)
             {
-                fprintf(stderr, "Invalid block size %u at offset 0x%llx\n", block_size, current_offset);
-                free(current_data);
-                return SQUASH_ERROR_IO;
+                fprintf(stderr, "Failed to read metadata block at 0x%llx: %s\n", (unsigned long long)current_offset, squash_strerror(err));
+                return err;
             }
 
-            // Читаем данные блока
-            uint8_t *compressed_data = malloc(block_size);
-            if (!compressed_data)
-            {
-                fprintf(stderr, "Memory allocation failed for block size %u\n", block_size);
-                free(current_data);
-                return SQUASH_ERROR_MEMORY;
-            }
-
-            if (read_fs_bytes(fs->file, current_offset + 2, block_size, compressed_data) != SQUASH_OK)
-            {
-                free(compressed_data);
-                free(current_data);
-                fprintf(stderr, "Failed to read block data at 0x%llx: %s\n", current_offset + 2, strerror(errno));
-                return SQUASH_ERROR_IO;
-            }
-
-            // Декомпрессия (оставляем без изменений)
-            current_size = SQUASHFS_METADATA_SIZE;
-            current_data = malloc(current_size);
-            if (!current_data)
-            {
-                free(compressed_data);
-                fprintf(stderr, "Memory allocation failed for uncompressed data\n");
-                return SQUASH_ERROR_MEMORY;
-            }
-
-            if (is_compressed)
-            {
-                squash_error_t err = squash_decompress_block(fs->decompressor, compressed_data, block_size,
-                                                             current_data, &current_size);
-                free(compressed_data);
-                if (err != SQUASH_OK)
-                {
-                    free(current_data);
-                    fprintf(stderr, "Failed to decompress block at 0x%llx: %s\n", current_offset, squash_strerror(err));
-                    return err;
-                }
-            }
-            else
-            {
-                memcpy(current_data, compressed_data, block_size);
-                current_size = block_size;
-                free(compressed_data);
-            }
-            // fprintf(stderr, "Uncompressed block size: %zu\n", current_size);
-
-            // Дамп первых 64 байт блока для отладки
-            if (current_offset == 0x251813a)
-            {
-                fprintf(stderr, "Block data at offset 0x%llx (first 64 bytes): ", current_offset);
-                for (size_t i = 0; i < 64 && i < current_size; i++)
-                {
-                    fprintf(stderr, "%02x ", current_data[i]);
-                }
-                fprintf(stderr, "\n");
-            }
-
-            if (pos >= current_size)
+            current_offset += 2 + block_size;
+            if (current_size == 0)
             {
-                fprintf(stderr, "Invalid pos=%zu, exceeds uncompressed_size=%zu\n", pos, current_size);
-                free(current_data);
+                fprintf(stderr, "Empty metadata block before 0x%llx\n", (unsigned long long)current_offset);
+                squash_buffer_pool_release(&fs->buffer_pool, current_data);
                 return SQUASH_ERROR_INVALID_FILE;
             }
-
-            current_offset += 2 + block_size;
-            pos = 0;
+            if (pos >= current_size)
+                continue;
         }
 
         size_t avail = current_size - pos;
@@ -226,26 +200,18 @@ squash_error_t read_n_bytes_from_metablocks(squash_fs_t *fs, uint64_t start_offs
         if (to_copy == 0)
         {
             fprintf(stderr, "Invalid copy: pos=%zu, avail=%zu, uncompressed_size=%zu\n", pos, avail, current_size);
-            free(current_data);
+            squash_buffer_pool_release(&fs->buffer_pool, current_data);
             return SQUASH_ERROR_INVALID_FILE;
         }
 
         memcpy(out_buf + bytes_read, current_data + pos, to_copy);
         bytes_read += to_copy;
         pos += to_copy;
-
-        // fprintf(stderr, "Copied %zu bytes, total_read=%zu, pos=%zu\n", to_copy, bytes_read, pos);
-    }
-
-    // Дамп прочитанных данных
-    /*fprintf(stderr, "Read data: ");
-    for (size_t i = 0; i < n_bytes; i++) {
-        fprintf(stderr, "%02x ", out_buf[i]);
     }
-    fprintf(stderr, "\n");*/
 
-    free(current_data);
-    *next_offset = current_offset;
+    squash_buffer_pool_release(&fs->buffer_pool, current_data);
+    if (next_offset)
+        *next_offset = current_offset;
     return SQUASH_OK;
 }
 
@@ -256,186 +222,456 @@ squash_error_t squash_read_data_block(squash_fs_t *fs, squash_off_t offset,
     if (offset + compressed_size > fs->super.bytes_used)
     {
         fprintf(stderr, "Invalid data block offset: %llu + %u exceeds bytes_used=%llu\n",
-                offset, compressed_size, fs->super.bytes_used);
+                (unsigned long long)offset, compressed_size, (unsigned long long)fs->super.bytes_used);
         return SQUASH_ERROR_INVALID_FILE;
     }
-    if (fseek(fs->file, offset, SEEK_SET) != 0)
+    size_t capacity = fs->super.block_size;
+    if (compressed_size > capacity)
     {
-        fprintf(stderr, "Error seeking to offset %llu: %s\n", offset, strerror(errno));
-        return SQUASH_ERROR_IO;
+        fprintf(stderr, "Invalid data block size %u at offset %llu\n", compressed_size, (unsigned long long)offset);
+        return SQUASH_ERROR_INVALID_BLOCK;
+    }
+    if (squash_fs_cache_copy(fs, SQUASH_CACHE_TIER_BLOCKS, offset, uncompressed_data, uncompressed_size, NULL))
+    {
+        return SQUASH_OK;
     }
-    uint8_t *compressed_data = malloc(compressed_size);
-    if (!compressed_data)
+
+    uint8_t *data = squash_buffer_pool_acquire(&fs->buffer_pool);
+    if (!data)
     {
         return SQUASH_ERROR_MEMORY;
     }
-    if (fread(compressed_data, 1, compressed_size, fs->file) != compressed_size)
+    uint8_t *compressed_data = NULL;
+    size_t size = capacity;
+    size_t cached_size = 0;
+    const uint8_t *src = is_compressed ? squash_fs_cache_peek(fs, SQUASH_CACHE_TIER_COMPRESSED, offset, &cached_size,
+                                                              NULL, &compressed_data) : NULL;
+    squash_error_t err = SQUASH_OK;
+    if (src && cached_size != compressed_size)
     {
-        free(compressed_data);
-        fprintf(stderr, "Error reading block data at offset %llu\n", offset);
-        return SQUASH_ERROR_IO;
+        src = NULL; // Другой размер на диске - запись не от этого блока
+        squash_buffer_pool_release(&fs->buffer_pool, compressed_data);
+        compressed_data = NULL;
     }
-
-    *uncompressed_data = malloc(fs->super.block_size);
-    if (!*uncompressed_data)
+    if (!src)
     {
-        free(compressed_data);
-        return SQUASH_ERROR_MEMORY;
+        // Несжатый блок читается сразу на место, сжатый - в отдельный буфер
+        uint8_t *dst = data;
+        if (is_compressed)
+        {
+            dst = compressed_data = squash_buffer_pool_acquire(&fs->buffer_pool);
+        }
+        if (!dst)
+        {
+            err = SQUASH_ERROR_MEMORY;
+        }
+        else if (squash_fseek(fs->file, offset) != 0 || fread(dst, 1, compressed_size, fs->file) != compressed_size)
+        {
+            fprintf(stderr, "Error reading block data at offset %llu\n", (unsigned long long)offset);
+            err = SQUASH_ERROR_IO;
+        }
+        else if (is_compressed)
+        {
+            // Сжатые байты попадают в свой уровень кэша: повторное чтение обойдётся без диска
+            squash_fs_cache_put(fs, SQUASH_CACHE_TIER_COMPRESSED, offset, dst, compressed_size, 0,
+                                fs->read_flags & SQUASH_READ_NOCACHE);
+        }
+        src = dst;
     }
-    *uncompressed_size = fs->super.block_size;
 
-    squash_error_t err;
-    if (is_compressed)
+    if (err == SQUASH_OK && is_compressed)
     {
-        err = squash_decompress_block(fs->decompressor, compressed_data, compressed_size,
-                                      *uncompressed_data, uncompressed_size);
-        free(compressed_data);
+        err = squash_decompress_block(fs->decompressor, src, compressed_size, data, &size);
         if (err != SQUASH_OK)
         {
-            free(*uncompressed_data);
-            *uncompressed_data = NULL;
-            fprintf(stderr, "Decompression failed at offset %llu: %s\n", offset, squash_strerror(err));
-            return err;
+            fprintf(stderr, "Decompression failed at offset %llu: %s\n", (unsigned long long)offset, squash_strerror(err));
         }
     }
-    else
+    else if (err == SQUASH_OK)
     {
-        memcpy(*uncompressed_data, compressed_data, compressed_size);
-        *uncompressed_size = compressed_size;
-        free(compressed_data);
+        size = compressed_size;
     }
-    /*printf("Read data block: offset=0x%llx, compressed=%s, compressed_size=%u, uncompressed_size=%zu\n",
-           offset, is_compressed ? "Yes" : "No", compressed_size, *uncompressed_size);*/
+    squash_buffer_pool_release(&fs->buffer_pool, compressed_data);
+    if (err != SQUASH_OK)
+    {
+        squash_buffer_pool_release(&fs->buffer_pool, data);
+        return err;
+    }
+
+    squash_fs_cache_put(fs, SQUASH_CACHE_TIER_BLOCKS, offset, data, size, 0, fs->read_flags & SQUASH_READ_NOCACHE);
+    *uncompressed_data = data;
+    *uncompressed_size = size;
     return SQUASH_OK;
 }
 
-SQUASH_API squash_error_t squash_extract_file_by_inode(squash_fs_t *fs, squash_off_t inode_ref, const char *output_path)
+#define SQUASH_IO_RUN_CHUNK_SIZE (128 * 1024)
+#define SQUASH_IO_RUN_MAX_REQUESTS 32
+
+squash_error_t squash_read_block_run(squash_fs_t *fs, const uint32_t *block_list, uint32_t first,
+                                     uint32_t *count, squash_off_t offset, const uint8_t **raw_data)
 {
-    if (!fs || !output_path)
+    // Блоки файла лежат на диске подряд, поэтому их можно прочитать одним запросом.
+    // Серия ограничена max_coalesce_bytes, но хотя бы один блок читается всегда
+    size_t max_bytes = fs->options.max_coalesce_bytes;
+    size_t total = 0;
+    uint32_t n = 0;
+    for (; n < *count; n++)
     {
-        return SQUASH_ERROR_INVALID_FILE;
+        uint32_t size = block_list[first + n] & ((1 << 24) - 1);
+        if (size > fs->super.block_size)
+        {
+            fprintf(stderr, "Invalid data block size %u for block %u\n", size, first + n);
+            return SQUASH_ERROR_INVALID_BLOCK;
+        }
+        if (n > 0 && total + size > max_bytes)
+            break;
+        total += size;
     }
 
-    void *inode;
-    squash_error_t err = squash_read_inode(fs, inode_ref, &inode);
-    if (err != SQUASH_OK)
+    if (offset + total > fs->super.bytes_used)
     {
-        return err;
+        fprintf(stderr, "Invalid data block run: %llu + %zu exceeds bytes_used=%llu\n",
+                (unsigned long long)offset, total, (unsigned long long)fs->super.bytes_used);
+        return SQUASH_ERROR_INVALID_FILE;
     }
 
-    if (!squash_is_file(inode))
+    if (total > fs->io_capacity)
     {
-        squash_free_inode(inode);
-        return SQUASH_ERROR_NOT_FILE;
+        uint8_t *buf = realloc(fs->io_buffer, total);
+        if (!buf)
+        {
+            return SQUASH_ERROR_MEMORY;
+        }
+        fs->io_buffer = buf;
+        fs->io_capacity = total;
     }
-
-    squash_reg_inode_t *reg_inode = (squash_reg_inode_t *)inode;
-    uint64_t file_size;
-    err = squash_get_file_size(reg_inode, &file_size);
-    if (err != SQUASH_OK)
+    if (total > 0)
     {
-        squash_free_inode(inode);
-        fprintf(stderr, "Failed to get file size for inode_ref 0x%llx: %s\n", inode_ref, squash_strerror(err));
-        return err;
+        // Асинхронный бэкенд получает серию частями, чтобы очередь устройства была заполнена
+        squash_io_request_t requests[SQUASH_IO_RUN_MAX_REQUESTS];
+        size_t chunk = total;
+        if (squash_io_backend(fs->io) != SQUASH_IO_SYNC)
+        {
+            chunk = (total + SQUASH_IO_RUN_MAX_REQUESTS - 1) / SQUASH_IO_RUN_MAX_REQUESTS;
+            if (chunk < SQUASH_IO_RUN_CHUNK_SIZE)
+                chunk = SQUASH_IO_RUN_CHUNK_SIZE;
+        }
+        size_t nreq = 0;
+        for (size_t pos = 0; pos < total; pos += chunk)
+        {
+            requests[nreq].offset = offset + pos;
+            requests[nreq].size = total - pos < chunk ? total - pos : chunk;
+            requests[nreq].buffer = fs->io_buffer + pos;
+            nreq++;
+        }
+        squash_error_t err = squash_io_read(fs->io, requests, nreq);
+        if (err != SQUASH_OK)
+        {
+            return err;
+        }
     }
-    fprintf(stderr, "File size: %llu bytes, inode_ref=0x%llx\n", (unsigned long long)file_size, inode_ref);
 
-    // Проверяем и создаём родительскую директорию
-    char *output_dir = strdup(output_path);
-    if (!output_dir)
+    fs->coalesced_reads++;
+    fs->coalesced_blocks += n;
+    *count = n;
+    *raw_data = fs->io_buffer;
+    return SQUASH_OK;
+}
+
+// Контекст одного вызова извлечения: общий буфер записи, уже созданные каталоги и жёсткие ссылки
+typedef struct
+{
+    uint8_t *buffer;
+    size_t buffer_size;
+    squash_created_dirs_t dirs; // Созданные каталоги (squash_make_dirs)
+    squash_hardlinks_t hardlinks;
+} extract_ctx_t;
+
+static void extract_ctx_free(extract_ctx_t *ctx)
+{
+    free(ctx->buffer);
+    squash_created_dirs_free(&ctx->dirs);
+    squash_hardlinks_free(&ctx->hardlinks);
+}
+
+static squash_error_t extract_ctx_init(squash_fs_t *fs, extract_ctx_t *ctx)
+{
+    memset(ctx, 0, sizeof(*ctx));
+    // В буфер распаковываются целые блоки, поэтому он не меньше блока
+    ctx->buffer_size = fs->options.extract_buffer_size ? fs->options.extract_buffer_size
+                                                       : SQUASH_DEFAULT_EXTRACT_BUFFER_SIZE;
+    if (ctx->buffer_size < fs->super.block_size)
     {
-        squash_free_inode(inode);
-        fprintf(stderr, "Memory allocation failed for output_dir\n");
+        ctx->buffer_size = fs->super.block_size;
+    }
+    ctx->buffer = malloc(ctx->buffer_size);
+    if (!ctx->buffer)
+    {
+        fprintf(stderr, "Memory allocation failed for extract buffer (%zu bytes)\n", ctx->buffer_size);
         return SQUASH_ERROR_MEMORY;
     }
-    char *last_slash = strrchr(output_dir, '/');
-#ifdef _WIN32
-    if (!last_slash)
-        last_slash = strrchr(output_dir, '\\');
-#endif
-    if (last_slash)
+    squash_error_t err = squash_created_dirs_init(&ctx->dirs, 16);
+    if (err == SQUASH_OK)
     {
-        *last_slash = '\0';
-#ifdef _WIN32
-        if (_mkdir(output_dir) != 0 && errno != EEXIST)
-        {
-#else
-        if (mkdir(output_dir, 0755) != 0 && errno != EEXIST)
-        {
-#endif
-            fprintf(stderr, "Failed to create parent directory %s: %s\n", output_dir, strerror(errno));
-            free(output_dir);
-            squash_free_inode(inode);
-            return SQUASH_ERROR_IO;
-        }
+        err = squash_hardlinks_init(&ctx->hardlinks, 16);
+    }
+    if (err != SQUASH_OK)
+    {
+        extract_ctx_free(ctx);
     }
-    free(output_dir);
+    return err;
+}
 
-    FILE *out_file = fopen(output_path, "wb");
-    if (!out_file)
+// Записывает содержимое файла. Sparse-блоки не записываются, а пропускаются - в файле остаются дыры.
+// Серии несжатых блоков копируются из образа напрямую (squash_writer_copy_image), остальное читается
+// через squash_read_file сериями, сколько уместится в буфер записи. Большие файлы идут через конвейер
+static squash_error_t extract_write_data(squash_fs_t *fs, squash_reg_inode_t *inode, uint64_t file_size,
+                                         squash_writer_t *writer)
+{
+    if (squash_extract_pipeline_enabled(fs, file_size))
     {
-        squash_free_inode(inode);
-        fprintf(stderr, "Failed to open output file %s: %s\n", output_path, strerror(errno));
-        return SQUASH_ERROR_IO;
+        return squash_extract_pipeline(fs, inode, file_size, writer);
     }
 
-    // Используем буфер размером с блок SquashFS
+    // Полные блоки, хвост из фрагмента читается обычным путём
     uint32_t block_size = fs->super.block_size;
-    uint8_t *buffer = malloc(block_size);
-    if (!buffer)
+    uint32_t nblocks = (uint32_t)(file_size / block_size);
+    if (inode->fragment == 0xFFFFFFFF && file_size % block_size != 0)
     {
-        fclose(out_file);
-        squash_free_inode(inode);
-        fprintf(stderr, "Memory allocation failed for buffer (block_size=%u)\n", block_size);
-        return SQUASH_ERROR_MEMORY;
+        nblocks++;
     }
+    uint64_t disk_offset = inode->start_block;
+    uint32_t block_idx = 0;
+    bool zero_copy = true;
 
     uint64_t offset = 0;
     while (offset < file_size)
     {
-        size_t bytes_to_read = (size_t)MIN(block_size, file_size - offset);
-        size_t bytes_read;
+        if (block_idx < nblocks && (inode->block_list[block_idx] & ((1 << 24) - 1)) == 0)
+        {
+            // Sparse-блок: сдвигаемся за него, размер файла выставит squash_writer_close
+            uint64_t len = MIN(block_size, file_size - offset);
+            squash_error_t err = squash_writer_skip(writer, len);
+            if (err != SQUASH_OK)
+            {
+                return err;
+            }
+            offset += len;
+            block_idx++;
+            continue;
+        }
+
+        // Серия несжатых блоков: на диске они лежат подряд и совпадают с данными файла
+        uint32_t run = 0;
+        uint64_t run_bytes = 0;
+        while (zero_copy && block_idx + run < nblocks)
+        {
+            uint32_t entry = inode->block_list[block_idx + run];
+            uint32_t size = entry & ((1 << 24) - 1);
+            if (!(entry & (1 << 24)) || size == 0 || size != MIN(block_size, file_size - offset - run_bytes))
+            {
+                break;
+            }
+            run_bytes += size;
+            run++;
+        }
+        if (run > 0)
+        {
+            if (squash_writer_copy_image(fs, writer, disk_offset, run_bytes))
+            {
+                offset += run_bytes;
+                disk_offset += run_bytes;
+                block_idx += run;
+                fs->zero_copy_bytes += run_bytes;
+                continue;
+            }
+            // Ядро или файловые системы не поддерживают копирование - дальше только обычным путём
+            zero_copy = false;
+        }
+
+        // Обычные блоки до ближайшего sparse-блока или несжатой серии, вместе с хвостом, одним чтением
+        size_t want = 0;
+        uint64_t run_disk = 0;
+        run = 0;
+        while (offset + want < file_size)
+        {
+            size_t len = (size_t)MIN(block_size, file_size - offset - want);
+            if (want + len > writer->capacity)
+            {
+                break;
+            }
+            if (block_idx + run < nblocks)
+            {
+                uint32_t entry = inode->block_list[block_idx + run];
+                uint32_t size = entry & ((1 << 24) - 1);
+                if (want > 0 && (size == 0 || (zero_copy && (entry & (1 << 24)) && size == len)))
+                {
+                    break;
+                }
+                run_disk += size;
+                run++;
+            }
+            want += len;
+        }
 
-       // fprintf(stderr, "Reading block at offset %llu, bytes: %zu\n", (unsigned long long)offset, bytes_to_read);
-        err = squash_read_file(fs, reg_inode, buffer, offset, bytes_to_read, &bytes_read);
+        uint8_t *data;
+        squash_error_t err = squash_writer_reserve(writer, want, &data);
         if (err != SQUASH_OK)
         {
-            fprintf(stderr, "Failed to read %zu bytes at offset %llu for %llu: %s\n", bytes_to_read, (unsigned long long)offset, inode_ref, squash_strerror(err));
-            free(buffer);
-            fclose(out_file);
-            squash_free_inode(inode);
             return err;
         }
-
-        if (bytes_read != bytes_to_read)
+        size_t bytes_read;
+        err = squash_read_file(fs, inode, data, offset, want, &bytes_read);
+        if (err != SQUASH_OK)
         {
-            fprintf(stderr, "Read %zu bytes, expected %zu at offset %llu for %llu\n", bytes_read, bytes_to_read, (unsigned long long)offset, inode_ref);
-            free(buffer);
-            fclose(out_file);
-            squash_free_inode(inode);
+            fprintf(stderr, "Failed to read %zu bytes at offset %llu for %s: %s\n", want, (unsigned long long)offset, writer->path, squash_strerror(err));
+            return err;
+        }
+        if (bytes_read != want)
+        {
+            fprintf(stderr, "Read %zu bytes, expected %zu at offset %llu for %s\n", bytes_read, want, (unsigned long long)offset, writer->path);
             return SQUASH_ERROR_IO;
         }
+        squash_writer_commit(writer, bytes_read);
 
-        if (fwrite(buffer, 1, bytes_read, out_file) != bytes_read)
+        offset += want;
+        disk_offset += run_disk;
+        block_idx += run;
+    }
+    return SQUASH_OK;
+}
+
+// Файл с дырами нельзя размещать заранее: fallocate занял бы место и под них
+static bool has_sparse_blocks(squash_fs_t *fs, squash_reg_inode_t *inode, uint64_t file_size)
+{
+    if (inode->sparse != 0)
+    {
+        return true;
+    }
+    uint32_t nblocks = (uint32_t)(file_size / fs->super.block_size);
+    if (inode->fragment == 0xFFFFFFFF && file_size % fs->super.block_size != 0)
+    {
+        nblocks++;
+    }
+    for (uint32_t i = 0; i < nblocks; i++)
+    {
+        if ((inode->block_list[i] & ((1 << 24) - 1)) == 0)
         {
-            fprintf(stderr, "Failed to write %zu bytes to %s: %s\n", bytes_read, output_path, strerror(errno));
-            free(buffer);
-            fclose(out_file);
-            squash_free_inode(inode);
-            return SQUASH_ERROR_IO;
+            return true;
         }
+    }
+    return false;
+}
 
-        offset += bytes_read;
+// Извлекает обычный файл: родительский каталог создаётся один раз на всё извлечение, данные
+// копятся в общем буфере, права и время изменения восстанавливаются до закрытия
+static squash_error_t extract_regular_file(squash_fs_t *fs, extract_ctx_t *ctx, squash_reg_inode_t *inode,
+                                           const char *output_path)
+{
+    uint64_t file_size;
+    squash_error_t err = squash_get_file_size(inode, &file_size);
+    if (err != SQUASH_OK)
+    {
+        fprintf(stderr, "Failed to get file size for %s: %s\n", output_path, squash_strerror(err));
+        return err;
     }
 
-    free(buffer);
-    fclose(out_file);
+    const char *last_slash = strrchr(output_path, '/');
+#ifdef _WIN32
+    const char *last_backslash = strrchr(output_path, '\\');
+    if (last_backslash > last_slash)
+        last_slash = last_backslash;
+#endif
+    if (last_slash)
+    {
+        err = squash_make_dirs(&ctx->dirs, output_path, (size_t)(last_slash - output_path),
+                               &fs->extract_dirs_created, &fs->extract_dir_cache_hits);
+        if (err != SQUASH_OK)
+        {
+            return err;
+        }
+    }
+
+    squash_writer_t writer;
+    err = squash_writer_open(&writer, output_path, ctx->buffer, ctx->buffer_size);
+    if (err != SQUASH_OK)
+    {
+        fprintf(stderr, "Failed to open output file %s: %s\n", output_path, strerror(errno));
+        return SQUASH_ERROR_IO;
+    }
+
+    if ((fs->options.extract_flags & SQUASH_EXTRACT_PREALLOCATE) && !has_sparse_blocks(fs, inode, file_size))
+    {
+        squash_writer_preallocate(&writer, file_size);
+    }
+
+    err = extract_write_data(fs, inode, file_size, &writer);
+    const squash_base_inode_t *attributes =
+        (err != SQUASH_OK || (fs->options.extract_flags & SQUASH_EXTRACT_NO_ATTRIBUTES)) ? NULL : &inode->base;
+    squash_error_t close_err = squash_writer_close(&writer, err == SQUASH_OK ? file_size : 0, attributes);
+    fs->extract_write_calls += writer.writes;
+    if (err == SQUASH_OK)
+    {
+        err = close_err;
+    }
+    if (err == SQUASH_OK)
+    {
+        fs->extract_files++;
+    }
+    return err;
+}
 
+static squash_error_t extract_file_by_inode_internal(squash_fs_t *fs, extract_ctx_t *ctx, squash_off_t inode_ref,
+                                                     const char *output_path)
+{
+    void *inode;
+    squash_error_t err = squash_read_inode(fs, inode_ref, &inode);
+    if (err != SQUASH_OK)
+    {
+        return err;
+    }
+
+    if (!squash_is_file(inode))
+    {
+        squash_free_inode(inode);
+        return SQUASH_ERROR_NOT_FILE;
+    }
+
+    err = extract_regular_file(fs, ctx, (squash_reg_inode_t *)inode, output_path);
     squash_free_inode(inode);
-    return SQUASH_OK;
+    return err;
 }
 
-SQUASH_API squash_error_t squash_extract_file(squash_fs_t *fs, const char *path, const char *output_path)
+// Отдельный файл: свой буфер и кэш каталогов на один вызов
+static squash_error_t extract_single_file(squash_fs_t *fs, squash_off_t inode_ref, const char *output_path)
+{
+    extract_ctx_t ctx;
+    squash_error_t err = extract_ctx_init(fs, &ctx);
+    if (err != SQUASH_OK)
+    {
+        return err;
+    }
+    err = extract_file_by_inode_internal(fs, &ctx, inode_ref, output_path);
+    extract_ctx_free(&ctx);
+    return err;
+}
+
+SQUASH_API squash_error_t squash_extract_file_by_inode(squash_fs_t *fs, squash_off_t inode_ref, const char *output_path)
+{
+    if (!fs || !output_path)
+    {
+        return SQUASH_ERROR_INVALID_FILE;
+    }
+    squash_mutex_lock(&fs->lock);
+    uint32_t saved_flags = fs->read_flags;
+    fs->read_flags |= SQUASH_READ_NOCACHE;
+    squash_error_t err = extract_single_file(fs, inode_ref, output_path);
+    fs->read_flags = saved_flags;
+    squash_mutex_unlock(&fs->lock);
+    return err;
+}
+
+static squash_error_t extract_file_internal(squash_fs_t *fs, const char *path, const char *output_path)
 {
     if (!fs || !path || !output_path)
     {
@@ -453,132 +689,129 @@ SQUASH_API squash_error_t squash_extract_file(squash_fs_t *fs, const char *path,
         return err;
     }
 
-    void *inode;
-    err = squash_read_inode(fs, inode_ref, &inode);
+    err = extract_single_file(fs, inode_ref, output_path);
     if (err != SQUASH_OK)
     {
-        fprintf(stderr, "Failed to read inode for %s: %s\n", path, squash_strerror(err));
+        fprintf(stderr, "Failed to extract %s: %s\n", path, squash_strerror(err));
         return err;
     }
+    fprintf(stderr, "Successfully extracted %s\n", output_path);
+    return SQUASH_OK;
+}
 
-    if (!squash_is_file(inode))
+SQUASH_API squash_error_t squash_extract_file(squash_fs_t *fs, const char *path, const char *output_path)
+{
+    if (!fs)
     {
-        squash_free_inode(inode);
-        fprintf(stderr, "%s is not a file (type=%d)\n", path, ((squash_reg_inode_t *)inode)->base.inode_type);
-        return SQUASH_ERROR_NOT_FILE;
+        return SQUASH_ERROR_INVALID_FILE;
     }
+    squash_mutex_lock(&fs->lock);
+    uint32_t saved_flags = fs->read_flags;
+    fs->read_flags |= SQUASH_READ_NOCACHE;
+    squash_error_t err = extract_file_internal(fs, path, output_path);
+    fs->read_flags = saved_flags;
+    squash_mutex_unlock(&fs->lock);
+    return err;
+}
 
-    squash_reg_inode_t *reg_inode = (squash_reg_inode_t *)inode;
-    uint64_t file_size;
-    err = squash_get_file_size(reg_inode, &file_size);
-    if (err != SQUASH_OK)
+// Копия уже извлечённого файла - для жёстких ссылок, которые нельзя создать через link()
+static squash_error_t copy_extracted_file(const char *src_path, const char *dst_path)
+{
+    FILE *src = fopen(src_path, "rb");
+    if (!src)
     {
-        squash_free_inode(inode);
-        fprintf(stderr, "Failed to get file size for %s: %s\n", path, squash_strerror(err));
-        return err;
+        fprintf(stderr, "Failed to open %s: %s\n", src_path, strerror(errno));
+        return SQUASH_ERROR_IO;
+    }
+    FILE *dst = fopen(dst_path, "wb");
+    if (!dst)
+    {
+        fprintf(stderr, "Failed to open output file %s: %s\n", dst_path, strerror(errno));
+        fclose(src);
+        return SQUASH_ERROR_IO;
     }
-    fprintf(stderr, "File size: %llu bytes, inode_ref=0x%llx\n", (unsigned long long)file_size, inode_ref);
 
-    // Проверяем и создаём родительскую директорию
-    char *output_dir = strdup(output_path);
-    if (!output_dir)
+    squash_error_t err = SQUASH_OK;
+    size_t buffer_size = 1024 * 1024;
+    uint8_t *buffer = malloc(buffer_size);
+    if (!buffer)
     {
-        squash_free_inode(inode);
-        fprintf(stderr, "Memory allocation failed for output_dir\n");
-        return SQUASH_ERROR_MEMORY;
+        err = SQUASH_ERROR_MEMORY;
     }
-    char *last_slash = strrchr(output_dir, '/');
-#ifdef _WIN32
-    if (!last_slash)
-        last_slash = strrchr(output_dir, '\\');
-#endif
-    if (last_slash)
+    while (err == SQUASH_OK)
     {
-        *last_slash = '\0';
-#ifdef _WIN32
-        if (_mkdir(output_dir) != 0 && errno != EEXIST)
+        size_t n = fread(buffer, 1, buffer_size, src);
+        if (n > 0 && fwrite(buffer, 1, n, dst) != n)
         {
-#else
-        if (mkdir(output_dir, 0755) != 0 && errno != EEXIST)
+            fprintf(stderr, "Failed to write %zu bytes to %s: %s\n", n, dst_path, strerror(errno));
+            err = SQUASH_ERROR_IO;
+        }
+        if (n < buffer_size)
         {
-#endif
-            fprintf(stderr, "Failed to create parent directory %s: %s\n", output_dir, strerror(errno));
-            free(output_dir);
-            squash_free_inode(inode);
-            return SQUASH_ERROR_IO;
+            if (ferror(src))
+                err = SQUASH_ERROR_IO;
+            break;
         }
     }
-    free(output_dir);
-
-    FILE *out_file = fopen(output_path, "wb");
-    if (!out_file)
+    free(buffer);
+    fclose(src);
+    if (fclose(dst) != 0 && err == SQUASH_OK)
     {
-        squash_free_inode(inode);
-        fprintf(stderr, "Failed to open output file %s: %s\n", output_path, strerror(errno));
-        return SQUASH_ERROR_IO;
+        err = SQUASH_ERROR_IO;
     }
+    return err;
+}
 
-    // Используем буфер размером с блок SquashFS
-    uint32_t block_size = fs->super.block_size;
-    uint8_t *buffer = malloc(block_size);
-    if (!buffer)
+// Извлечение файла с учётом жёстких ссылок: содержимое inode с nlink > 1 пишется один раз,
+// остальные пути становятся ссылками на первую копию (или её копиями, если link() невозможен)
+static squash_error_t extract_file_linked(squash_fs_t *fs, extract_ctx_t *ctx, squash_reg_inode_t *inode,
+                                          const char *output_path)
+{
+    if (inode->nlink <= 1)
     {
-        fclose(out_file);
-        squash_free_inode(inode);
-        fprintf(stderr, "Memory allocation failed for buffer (block_size=%u)\n", block_size);
-        return SQUASH_ERROR_MEMORY;
+        return extract_regular_file(fs, ctx, inode, output_path);
     }
 
-    uint64_t offset = 0;
-    while (offset < file_size)
+    const char *first_path = squash_hardlinks_find(&ctx->hardlinks, inode->base.inode_number);
+    if (!first_path)
     {
-        size_t bytes_to_read = (size_t)MIN(block_size, file_size - offset);
-        size_t bytes_read;
-
-        fprintf(stderr, "Reading block at offset %llu, bytes: %zu\n", (unsigned long long)offset, bytes_to_read);
-        err = squash_read_file(fs, reg_inode, buffer, offset, bytes_to_read, &bytes_read);
+        squash_error_t err = extract_regular_file(fs, ctx, inode, output_path);
         if (err != SQUASH_OK)
         {
-            fprintf(stderr, "Failed to read %zu bytes at offset %llu for %s: %s\n", bytes_to_read, (unsigned long long)offset, path, squash_strerror(err));
-            free(buffer);
-            fclose(out_file);
-            squash_free_inode(inode);
             return err;
         }
+        return squash_hardlinks_add(&ctx->hardlinks, inode->base.inode_number, output_path);
+    }
 
-        if (bytes_read != bytes_to_read)
-        {
-            fprintf(stderr, "Read %zu bytes, expected %zu at offset %llu for %s\n", bytes_read, bytes_to_read, (unsigned long long)offset, path);
-            free(buffer);
-            fclose(out_file);
-            squash_free_inode(inode);
-            return SQUASH_ERROR_IO;
-        }
-
-        if (fwrite(buffer, 1, bytes_read, out_file) != bytes_read)
-        {
-            fprintf(stderr, "Failed to write %zu bytes to %s: %s\n", bytes_read, output_path, strerror(errno));
-            free(buffer);
-            fclose(out_file);
-            squash_free_inode(inode);
-            return SQUASH_ERROR_IO;
-        }
-
-        offset += bytes_read;
+    // Повторное извлечение поверх старых файлов: link() не перезаписывает существующий путь
+    remove(output_path);
+#ifdef _WIN32
+    bool linked = CreateHardLinkA(output_path, first_path, NULL) != 0;
+#else
+    bool linked = link(first_path, output_path) == 0;
+#endif
+    if (linked)
+    {
+        fs->hardlinks_linked++;
+        return SQUASH_OK;
     }
 
-    free(buffer);
-    fclose(out_file);
-    squash_free_inode(inode);
-    fprintf(stderr, "Successfully extracted %s\n", output_path);
-    return SQUASH_OK;
+    fprintf(stderr, "Failed to link %s to %s, copying instead\n", output_path, first_path);
+    squash_error_t err = copy_extracted_file(first_path, output_path);
+    if (err == SQUASH_OK)
+    {
+        fs->hardlinks_copied++;
+    }
+    return err;
 }
 
 static squash_error_t squash_extract_directory_recursive(
     squash_fs_t *fs,
     squash_off_t inode_ref,
     const char *output_dir,
-    squash_visited_inodes_t *visited)
+    squash_visited_inodes_t *visited,
+    extract_ctx_t *ctx,
+    squash_arena_t *arena)
 {
     // Проверяем циклы
     if (squash_visited_inodes_contains(visited, inode_ref))
@@ -594,33 +827,39 @@ static squash_error_t squash_extract_directory_recursive(
         return err;
     }
 
+    // Всё, что выделено для этой директории, откатывается одним вызовом при выходе
+    squash_arena_mark_t dir_mark = squash_arena_mark(arena);
+
     // Читаем inode ОДИН раз
     void *inode;
-    err = squash_read_inode(fs, inode_ref, &inode);
+    err = squash_read_inode_arena(fs, inode_ref, arena, &inode);
     if (err != SQUASH_OK)
     {
+        squash_arena_rewind(arena, dir_mark);
         return err;
     }
 
     if (!squash_is_directory(inode))
     {
-        squash_free_inode(inode);
+        squash_arena_rewind(arena, dir_mark);
         return SQUASH_ERROR_NOT_DIRECTORY;
     }
 
-    // Создаем выходную директорию
-    if (mkdir(output_dir, 0755) != 0 && errno != EEXIST)
+    // Создаем выходную директорию; файлы внутри найдут её в кэше и не будут вызывать mkdir
+    err = squash_make_dirs(&ctx->dirs, output_dir, strlen(output_dir), &fs->extract_dirs_created,
+                           &fs->extract_dir_cache_hits);
+    if (err != SQUASH_OK)
     {
-        squash_free_inode(inode);
-        return SQUASH_ERROR_IO;
+        squash_arena_rewind(arena, dir_mark);
+        return err;
     }
 
     squash_dir_inode_t *dir_inode = (squash_dir_inode_t *)inode;
     squash_dir_iterator_t *iterator;
-    err = squash_opendir(fs, dir_inode, &iterator);
+    err = squash_opendir_arena(fs, dir_inode, arena, &iterator);
     if (err != SQUASH_OK)
     {
-        squash_free_inode(inode);
+        squash_arena_rewind(arena, dir_mark);
         return err;
     }
 
@@ -628,58 +867,59 @@ static squash_error_t squash_extract_directory_recursive(
     while (squash_readdir(iterator, &entry) == SQUASH_OK && entry)
     {
         //printf("Processing entry: name=%s, inode_ref=0x%llx\n", entry->name, entry->inode_ref);
+        squash_arena_mark_t entry_mark = squash_arena_mark(arena);
 
-        char *new_output_path = malloc(strlen(output_dir) + strlen(entry->name) + 2);
+        char *new_output_path = squash_arena_alloc(arena, strlen(output_dir) + strlen(entry->name) + 2);
         if (!new_output_path)
         {
-            squash_free_dir_entry(entry);
-            squash_closedir(iterator);
-            squash_free_inode(inode);
+            squash_arena_rewind(arena, dir_mark);
             return SQUASH_ERROR_MEMORY;
         }
         sprintf(new_output_path, "%s/%s", output_dir, entry->name);
 
         // Читаем inode записи
         void *entry_inode;
-        err = squash_read_inode(fs, entry->inode_ref, &entry_inode);
+        err = squash_read_inode_arena(fs, entry->inode_ref, arena, &entry_inode);
         if (err != SQUASH_OK)
         {
-            free(new_output_path);
-            squash_free_dir_entry(entry);
-            squash_closedir(iterator);
-            squash_free_inode(inode);
+            squash_arena_rewind(arena, dir_mark);
             return err;
         }
 
         if (squash_is_directory(entry_inode))
         {
             // РЕКУРСИЯ БЕЗ LOOKUP! Передаем inode_ref напрямую
-            err = squash_extract_directory_recursive(fs, entry->inode_ref, new_output_path, visited);
+            err = squash_extract_directory_recursive(fs, entry->inode_ref, new_output_path, visited, ctx, arena);
         }
         else if (squash_is_file(entry_inode))
         {
-            err = squash_extract_file_by_inode(fs, entry->inode_ref, new_output_path);
+            err = extract_file_linked(fs, ctx, (squash_reg_inode_t *)entry_inode, new_output_path);
         }
 
-        free(new_output_path);
-        squash_free_inode(entry_inode);
-        squash_free_dir_entry(entry);
+        squash_arena_rewind(arena, entry_mark);
 
         if (err != SQUASH_OK)
         {
-            squash_closedir(iterator);
-            squash_free_inode(inode);
+            squash_arena_rewind(arena, dir_mark);
             return err;
         }
     }
 
-    squash_closedir(iterator);
-    squash_free_inode(inode);
+    // Время изменения каталога сдвигается при создании записей, поэтому атрибуты - после них
+    if (!(fs->options.extract_flags & SQUASH_EXTRACT_NO_ATTRIBUTES) &&
+        squash_restore_attributes(output_dir, &dir_inode->base) != SQUASH_OK)
+    {
+        fprintf(stderr, "Failed to restore attributes of %s: %s\n", output_dir, strerror(errno));
+        squash_arena_rewind(arena, dir_mark);
+        return SQUASH_ERROR_IO;
+    }
+
+    squash_arena_rewind(arena, dir_mark);
     return SQUASH_OK;
 }
 
 // Публичная функция
-SQUASH_API squash_error_t squash_extract_directory(squash_fs_t *fs, const char *path, const char *output_dir)
+static squash_error_t extract_directory_internal(squash_fs_t *fs, const char *path, const char *output_dir)
 {
     if (!fs || !path || !output_dir)
     {
@@ -702,14 +942,49 @@ SQUASH_API squash_error_t squash_extract_directory(squash_fs_t *fs, const char *
         return err;
     }
 
+    // Буфер записи, кэш каталогов и жёсткие ссылки - общие на всё поддерево
+    extract_ctx_t ctx;
+    err = extract_ctx_init(fs, &ctx);
+    if (err != SQUASH_OK)
+    {
+        squash_visited_inodes_free(&visited);
+        return err;
+    }
+
+    // Одна арена на весь обход поддерева
+    squash_arena_t *arena = squash_arena_create(0);
+    if (!arena)
+    {
+        extract_ctx_free(&ctx);
+        squash_visited_inodes_free(&visited);
+        return SQUASH_ERROR_MEMORY;
+    }
+
     // Вызываем рекурсивную функцию
-    err = squash_extract_directory_recursive(fs, inode_ref, output_dir, &visited);
+    err = squash_extract_directory_recursive(fs, inode_ref, output_dir, &visited, &ctx, arena);
 
+    squash_arena_destroy(arena);
+    extract_ctx_free(&ctx);
     squash_visited_inodes_free(&visited);
     return err;
 }
 
-SQUASH_API squash_error_t squash_list_directory(squash_fs_t *fs, const char *path)
+SQUASH_API squash_error_t squash_extract_directory(squash_fs_t *fs, const char *path, const char *output_dir)
+{
+    if (!fs)
+    {
+        return SQUASH_ERROR_INVALID_FILE;
+    }
+    squash_mutex_lock(&fs->lock);
+    uint32_t saved_flags = fs->read_flags;
+    fs->read_flags |= SQUASH_READ_NOCACHE;
+    squash_error_t err = extract_directory_internal(fs, path, output_dir);
+    fs->read_flags = saved_flags;
+    squash_mutex_unlock(&fs->lock);
+    return err;
+}
+
+static squash_error_t list_directory_internal(squash_fs_t *fs, const char *path)
 {
     if (!fs || !path)
     {
@@ -757,6 +1032,18 @@ SQUASH_API squash_error_t squash_list_directory(squash_fs_t *fs, const char *pat
     return SQUASH_OK;
 }
 
+SQUASH_API squash_error_t squash_list_directory(squash_fs_t *fs, const char *path)
+{
+    if (!fs)
+    {
+        return SQUASH_ERROR_INVALID_FILE;
+    }
+    squash_mutex_lock(&fs->lock);
+    squash_error_t err = list_directory_internal(fs, path);
+    squash_mutex_unlock(&fs->lock);
+    return err;
+}
+
 SQUASH_API const char *squash_get_compression_name(uint16_t compression)
 {
     switch (compression)
@@ -771,8 +1058,14 @@ SQUASH_API const char *squash_get_compression_name(uint16_t compression)
         return "XZ";
     case 5:
         return "LZ4";
+    case 6:
+        return "ZSTD";
     default:
-        return "Unknown";
+    {
+        // Свой кодек знает своё имя
+        const squash_codec_t *codec = squash_find_codec(compression);
+        return codec ? codec->name : "Unknown";
+    }
     }
 }
 
@@ -2,13 +2,34 @@
 #include <string.h>
 #include "../include/libsquash/squash.h"
 
+// Открытая адресация с линейным пробированием; пустая ячейка помечается значением,
+// которое не может быть валидной ссылкой на инод (ссылка занимает 48 бит)
+#define VISITED_EMPTY UINT64_MAX
+
+static inline size_t visited_hash(squash_off_t inode_ref)
+{
+    uint64_t x = inode_ref;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return (size_t)x;
+}
+
 squash_error_t squash_visited_inodes_init(squash_visited_inodes_t *visited, size_t initial_capacity) {
-    visited->inodes = malloc(initial_capacity * sizeof(squash_off_t));
+    // Размер таблицы - степень двойки с запасом, чтобы заполненность не превышала 1/2
+    size_t capacity = 16;
+    while (capacity < initial_capacity * 2) {
+        capacity *= 2;
+    }
+    visited->inodes = malloc(capacity * sizeof(squash_off_t));
     if (!visited->inodes) {
         return SQUASH_ERROR_MEMORY;
     }
+    memset(visited->inodes, 0xFF, capacity * sizeof(squash_off_t));
     visited->count = 0;
-    visited->capacity = initial_capacity;
+    visited->capacity = capacity;
     return SQUASH_OK;
 }
 
@@ -21,25 +42,71 @@ void squash_visited_inodes_free(squash_visited_inodes_t *visited) {
     visited->capacity = 0;
 }
 
+static void visited_insert_slot(squash_off_t *slots, size_t capacity, squash_off_t inode_ref) {
+    size_t mask = capacity - 1;
+    size_t i = visited_hash(inode_ref) & mask;
+    while (slots[i] != VISITED_EMPTY) {
+        if (slots[i] == inode_ref) {
+            return;
+        }
+        i = (i + 1) & mask;
+    }
+    slots[i] = inode_ref;
+}
+
+static squash_error_t visited_grow(squash_visited_inodes_t *visited) {
+    size_t new_capacity = visited->capacity * 2;
+    squash_off_t *new_slots = malloc(new_capacity * sizeof(squash_off_t));
+    if (!new_slots) {
+        return SQUASH_ERROR_MEMORY;
+    }
+    memset(new_slots, 0xFF, new_capacity * sizeof(squash_off_t));
+    for (size_t i = 0; i < visited->capacity; i++) {
+        if (visited->inodes[i] != VISITED_EMPTY) {
+            visited_insert_slot(new_slots, new_capacity, visited->inodes[i]);
+        }
+    }
+    free(visited->inodes);
+    visited->inodes = new_slots;
+    visited->capacity = new_capacity;
+    return SQUASH_OK;
+}
+
 squash_error_t squash_visited_inodes_add(squash_visited_inodes_t *visited, squash_off_t inode_ref) {
-    if (visited->count >= visited->capacity) {
-        size_t new_capacity = visited->capacity * 2;
-        squash_off_t *new_inodes = realloc(visited->inodes, new_capacity * sizeof(squash_off_t));
-        if (!new_inodes) {
-            return SQUASH_ERROR_MEMORY;
+    if (inode_ref == VISITED_EMPTY) {
+        return SQUASH_ERROR_INVALID_ARGUMENT;
+    }
+    if ((visited->count + 1) * 2 > visited->capacity) {
+        squash_error_t err = visited_grow(visited);
+        if (err != SQUASH_OK) {
+            return err;
         }
-        visited->inodes = new_inodes;
-        visited->capacity = new_capacity;
     }
-    visited->inodes[visited->count++] = inode_ref;
+
+    size_t mask = visited->capacity - 1;
+    size_t i = visited_hash(inode_ref) & mask;
+    while (visited->inodes[i] != VISITED_EMPTY) {
+        if (visited->inodes[i] == inode_ref) {
+            return SQUASH_OK; // Уже есть
+        }
+        i = (i + 1) & mask;
+    }
+    visited->inodes[i] = inode_ref;
+    visited->count++;
     return SQUASH_OK;
 }
 
 bool squash_visited_inodes_contains(squash_visited_inodes_t *visited, squash_off_t inode_ref) {
-    for (size_t i = 0; i < visited->count; i++) {
+    if (!visited->inodes || inode_ref == VISITED_EMPTY) {
+        return false;
+    }
+    size_t mask = visited->capacity - 1;
+    size_t i = visited_hash(inode_ref) & mask;
+    while (visited->inodes[i] != VISITED_EMPTY) {
         if (visited->inodes[i] == inode_ref) {
             return true;
         }
+        i = (i + 1) & mask;
     }
     return false;
-}
\ No newline at end of file
+}
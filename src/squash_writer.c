@@ -0,0 +1,510 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // copy_file_range, fallocate
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#include <sys/utime.h>
+#define mkdir(path, mode) _mkdir(path)
+#else
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#include "../include/libsquash/squash.h"
+
+// Выходные файлы извлечения. Данные копятся в общем буфере и уходят одной записью по смещению,
+// поэтому мелкий файл стоит open + write + close, а позиция дескриптора нигде не используется
+
+static int writer_open_fd(const char *path)
+{
+#ifdef _WIN32
+    return _open(path, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    return open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+}
+
+// Повторное извлечение в тот же каталог: прошлая распаковка вернула файлу права только на чтение.
+// Владельцу временно добавляется право записи (squash_writer_close затем выставит права из образа);
+// если открыть всё равно не удалось, прежние права возвращаются
+static int writer_open_readonly_fd(const char *path)
+{
+#ifdef _WIN32
+    struct _stat st;
+    if (_stat(path, &st) != 0 || !(st.st_mode & _S_IFREG) || (st.st_mode & _S_IWRITE) ||
+        _chmod(path, _S_IREAD | _S_IWRITE) != 0)
+#else
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode) || (st.st_mode & S_IWUSR) ||
+        chmod(path, (st.st_mode & 07777) | S_IWUSR) != 0)
+#endif
+    {
+        errno = EACCES;
+        return -1;
+    }
+
+    int fd = writer_open_fd(path);
+    if (fd < 0)
+    {
+        int saved = errno;
+#ifdef _WIN32
+        _chmod(path, _S_IREAD);
+#else
+        chmod(path, st.st_mode & 07777);
+#endif
+        errno = saved;
+    }
+    return fd;
+}
+
+static int writer_close_fd(int fd)
+{
+#ifdef _WIN32
+    return _close(fd);
+#else
+    return close(fd);
+#endif
+}
+
+// Пишет size байт с позиции offset, повторяя частичные записи
+static squash_error_t writer_pwrite(squash_writer_t *writer, const uint8_t *data, size_t size, uint64_t offset)
+{
+#ifdef _WIN32
+    if (_lseeki64(writer->fd, (__int64)offset, SEEK_SET) < 0)
+    {
+        fprintf(stderr, "Failed to seek to %llu in %s: %s\n", (unsigned long long)offset, writer->path, strerror(errno));
+        return SQUASH_ERROR_IO;
+    }
+#endif
+    while (size > 0)
+    {
+#ifdef _WIN32
+        int n = _write(writer->fd, data, (unsigned int)MIN(size, 1u << 30));
+#else
+        ssize_t n = pwrite(writer->fd, data, size, (off_t)offset);
+#endif
+        writer->writes++;
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            fprintf(stderr, "Failed to write %zu bytes to %s: %s\n", size, writer->path, strerror(errno));
+            return SQUASH_ERROR_IO;
+        }
+        data += n;
+        size -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return SQUASH_OK;
+}
+
+squash_error_t squash_writer_open(squash_writer_t *writer, const char *path, uint8_t *buffer, size_t capacity)
+{
+    memset(writer, 0, sizeof(*writer));
+    writer->path = path;
+    writer->buffer = buffer;
+    writer->capacity = capacity;
+    // Существующий файл никогда не удаляется; файлу только для чтения добавляется право записи
+    writer->fd = writer_open_fd(path);
+    if (writer->fd < 0 && errno == EACCES)
+    {
+        writer->fd = writer_open_readonly_fd(path);
+    }
+    if (writer->fd < 0)
+    {
+        return errno == ENOENT ? SQUASH_ERROR_NOT_FOUND : SQUASH_ERROR_IO;
+    }
+    return SQUASH_OK;
+}
+
+squash_error_t squash_writer_flush(squash_writer_t *writer)
+{
+    if (writer->used == 0)
+    {
+        return SQUASH_OK;
+    }
+    squash_error_t err = writer_pwrite(writer, writer->buffer, writer->used, writer->offset);
+    writer->offset += writer->used;
+    writer->used = 0;
+    return err;
+}
+
+squash_error_t squash_writer_reserve(squash_writer_t *writer, size_t size, uint8_t **data)
+{
+    if (size > writer->capacity)
+    {
+        return SQUASH_ERROR_INVALID_ARGUMENT;
+    }
+    if (writer->capacity - writer->used < size)
+    {
+        squash_error_t err = squash_writer_flush(writer);
+        if (err != SQUASH_OK)
+        {
+            return err;
+        }
+    }
+    *data = writer->buffer + writer->used;
+    return SQUASH_OK;
+}
+
+void squash_writer_commit(squash_writer_t *writer, size_t size)
+{
+    writer->used += size;
+}
+
+squash_error_t squash_writer_write(squash_writer_t *writer, const void *data, size_t size)
+{
+    const uint8_t *src = data;
+    if (size >= writer->capacity)
+    {
+        // Крупный кусок (сегмент конвейера) пишется сразу, без копирования в буфер
+        squash_error_t err = squash_writer_flush(writer);
+        if (err == SQUASH_OK)
+        {
+            err = writer_pwrite(writer, src, size, writer->offset);
+        }
+        writer->offset += size;
+        return err;
+    }
+    while (size > 0)
+    {
+        uint8_t *dst;
+        size_t chunk = MIN(size, writer->capacity);
+        squash_error_t err = squash_writer_reserve(writer, chunk, &dst);
+        if (err != SQUASH_OK)
+        {
+            return err;
+        }
+        memcpy(dst, src, chunk);
+        squash_writer_commit(writer, chunk);
+        src += chunk;
+        size -= chunk;
+    }
+    return SQUASH_OK;
+}
+
+squash_error_t squash_writer_skip(squash_writer_t *writer, uint64_t size)
+{
+    squash_error_t err = squash_writer_flush(writer);
+    writer->offset += size;
+    return err;
+}
+
+bool squash_writer_preallocate(squash_writer_t *writer, uint64_t size)
+{
+#ifdef __linux__
+    // Не все файловые системы поддерживают fallocate - тогда файл растёт обычным образом
+    return size > 0 && fallocate(writer->fd, 0, 0, (off_t)size) == 0;
+#else
+    (void)writer;
+    (void)size;
+    return false;
+#endif
+}
+
+bool squash_writer_copy_image(squash_fs_t *fs, squash_writer_t *writer, uint64_t disk_offset, uint64_t size)
+{
+#ifdef __linux__
+    // copy_file_range (может использовать reflink), если не поддерживается - sendfile
+    if (squash_writer_flush(writer) != SQUASH_OK)
+    {
+        return false;
+    }
+    int in_fd = fileno(fs->file);
+    loff_t src = (loff_t)disk_offset;
+    loff_t dst = (loff_t)writer->offset;
+    uint64_t done = 0;
+    bool use_sendfile = false;
+    while (done < size)
+    {
+        ssize_t n;
+        if (!use_sendfile)
+        {
+            n = copy_file_range(in_fd, &src, writer->fd, &dst, (size_t)(size - done), 0);
+            if (n < 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP))
+            {
+                // sendfile пишет с текущей позиции дескриптора
+                if (lseek(writer->fd, dst, SEEK_SET) < 0)
+                {
+                    break;
+                }
+                use_sendfile = true;
+                continue;
+            }
+        }
+        else
+        {
+            off_t pos = (off_t)src;
+            n = sendfile(writer->fd, in_fd, &pos, (size_t)(size - done));
+            src = pos;
+        }
+        writer->writes++;
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            break;
+        }
+        done += (uint64_t)n;
+    }
+
+    // Частично скопированное перезапишется обычным путём с той же позиции
+    if (done != size)
+    {
+        return false;
+    }
+    writer->offset += size;
+    return true;
+#else
+    (void)fs;
+    (void)writer;
+    (void)disk_offset;
+    (void)size;
+    return false;
+#endif
+}
+
+squash_error_t squash_restore_attributes(const char *path, const squash_base_inode_t *attributes)
+{
+#ifdef _WIN32
+    struct _utimbuf times = {(time_t)attributes->mtime, (time_t)attributes->mtime};
+    if (_utime(path, &times) != 0)
+    {
+        return SQUASH_ERROR_IO;
+    }
+    return _chmod(path, (attributes->mode & 0200) ? _S_IREAD | _S_IWRITE : _S_IREAD) == 0 ? SQUASH_OK
+                                                                                          : SQUASH_ERROR_IO;
+#else
+    struct timespec times[2] = {{(time_t)attributes->mtime, 0}, {(time_t)attributes->mtime, 0}};
+    if (utimensat(AT_FDCWD, path, times, 0) != 0 || chmod(path, attributes->mode & 07777) != 0)
+    {
+        return SQUASH_ERROR_IO;
+    }
+    return SQUASH_OK;
+#endif
+}
+
+squash_error_t squash_writer_close(squash_writer_t *writer, uint64_t file_size, const squash_base_inode_t *attributes)
+{
+    squash_error_t err = squash_writer_flush(writer);
+
+    // Файл, который заканчивается дырой, получает окончательный размер
+    if (err == SQUASH_OK && writer->offset < file_size)
+    {
+#ifdef _WIN32
+        bool resized = _chsize_s(writer->fd, (__int64)file_size) == 0;
+#else
+        bool resized = ftruncate(writer->fd, (off_t)file_size) == 0;
+#endif
+        if (!resized)
+        {
+            fprintf(stderr, "Failed to set size of %s: %s\n", writer->path, strerror(errno));
+            err = SQUASH_ERROR_IO;
+        }
+    }
+
+#ifndef _WIN32
+    if (err == SQUASH_OK && attributes)
+    {
+        struct timespec times[2] = {{(time_t)attributes->mtime, 0}, {(time_t)attributes->mtime, 0}};
+        if (futimens(writer->fd, times) != 0 || fchmod(writer->fd, attributes->mode & 07777) != 0)
+        {
+            fprintf(stderr, "Failed to restore attributes of %s: %s\n", writer->path, strerror(errno));
+            err = SQUASH_ERROR_IO;
+        }
+    }
+#endif
+
+    if (writer_close_fd(writer->fd) != 0 && err == SQUASH_OK)
+    {
+        fprintf(stderr, "Failed to close %s: %s\n", writer->path, strerror(errno));
+        err = SQUASH_ERROR_IO;
+    }
+    writer->fd = -1;
+
+#ifdef _WIN32
+    // Время изменения на Windows задаётся по пути, уже после закрытия
+    if (err == SQUASH_OK && attributes && squash_restore_attributes(writer->path, attributes) != SQUASH_OK)
+    {
+        fprintf(stderr, "Failed to restore attributes of %s: %s\n", writer->path, strerror(errno));
+        err = SQUASH_ERROR_IO;
+    }
+#endif
+    return err;
+}
+
+// Кэш созданных каталогов: та же открытая адресация, что и у hardlinks. Пути сравниваются целиком,
+// совпадение хэшей не считается попаданием
+squash_error_t squash_created_dirs_init(squash_created_dirs_t *set, size_t initial_capacity)
+{
+    size_t capacity = 16;
+    while (capacity < initial_capacity * 2)
+    {
+        capacity *= 2;
+    }
+    set->entries = calloc(capacity, sizeof(squash_created_dir_t));
+    if (!set->entries)
+    {
+        return SQUASH_ERROR_MEMORY;
+    }
+    set->count = 0;
+    set->capacity = capacity;
+    return SQUASH_OK;
+}
+
+void squash_created_dirs_free(squash_created_dirs_t *set)
+{
+    if (set->entries)
+    {
+        for (size_t i = 0; i < set->capacity; i++)
+        {
+            free(set->entries[i].path);
+        }
+        free(set->entries);
+    }
+    set->entries = NULL;
+    set->count = 0;
+    set->capacity = 0;
+}
+
+static squash_created_dir_t *dir_slot(squash_created_dir_t *entries, size_t capacity, uint64_t hash,
+                                      const char *path, size_t len)
+{
+    size_t mask = capacity - 1;
+    size_t i = (size_t)hash & mask;
+    while (entries[i].hash != 0 &&
+           (entries[i].hash != hash || entries[i].len != len || memcmp(entries[i].path, path, len) != 0))
+    {
+        i = (i + 1) & mask;
+    }
+    return &entries[i];
+}
+
+static bool created_dirs_contains(squash_created_dirs_t *set, const char *path, size_t len)
+{
+    return set->entries && dir_slot(set->entries, set->capacity, squash_path_hash(path, len), path, len)->hash != 0;
+}
+
+static squash_error_t created_dirs_add(squash_created_dirs_t *set, const char *path, size_t len)
+{
+    if ((set->count + 1) * 2 > set->capacity)
+    {
+        size_t new_capacity = set->capacity * 2;
+        squash_created_dir_t *new_entries = calloc(new_capacity, sizeof(squash_created_dir_t));
+        if (!new_entries)
+        {
+            return SQUASH_ERROR_MEMORY;
+        }
+        for (size_t i = 0; i < set->capacity; i++)
+        {
+            squash_created_dir_t *e = &set->entries[i];
+            if (e->hash != 0)
+            {
+                *dir_slot(new_entries, new_capacity, e->hash, e->path, e->len) = *e;
+            }
+        }
+        free(set->entries);
+        set->entries = new_entries;
+        set->capacity = new_capacity;
+    }
+
+    uint64_t hash = squash_path_hash(path, len);
+    squash_created_dir_t *slot = dir_slot(set->entries, set->capacity, hash, path, len);
+    if (slot->hash != 0)
+    {
+        return SQUASH_OK;
+    }
+    slot->path = malloc(len + 1);
+    if (!slot->path)
+    {
+        return SQUASH_ERROR_MEMORY;
+    }
+    memcpy(slot->path, path, len);
+    slot->path[len] = '\0';
+    slot->hash = hash;
+    slot->len = len;
+    set->count++;
+    return SQUASH_OK;
+}
+
+static squash_error_t make_dirs(squash_created_dirs_t *created, char *path, size_t len, uint64_t *made,
+                                uint64_t *hits)
+{
+    if (len == 0)
+    {
+        return SQUASH_OK;
+    }
+    if (created_dirs_contains(created, path, len))
+    {
+        (*hits)++;
+        return SQUASH_OK;
+    }
+
+    char saved = path[len];
+    path[len] = '\0';
+    int rc = mkdir(path, 0755);
+    if (rc != 0 && errno == ENOENT)
+    {
+        // Нет родителя - создаём цепочку
+        size_t parent = len;
+        while (parent > 0 && path[parent - 1] != '/' && path[parent - 1] != '\\')
+            parent--;
+        while (parent > 0 && (path[parent - 1] == '/' || path[parent - 1] == '\\'))
+            parent--;
+        if (parent > 0 && make_dirs(created, path, parent, made, hits) == SQUASH_OK)
+        {
+            rc = mkdir(path, 0755);
+        }
+    }
+    bool ok = rc == 0 || errno == EEXIST;
+    if (!ok)
+    {
+        fprintf(stderr, "Failed to create directory %s: %s\n", path, strerror(errno));
+    }
+    path[len] = saved;
+    if (!ok)
+    {
+        return SQUASH_ERROR_IO;
+    }
+    if (rc == 0)
+    {
+        (*made)++;
+    }
+    return created_dirs_add(created, path, len);
+}
+
+squash_error_t squash_make_dirs(squash_created_dirs_t *created, const char *path, size_t len, uint64_t *made,
+                                uint64_t *hits)
+{
+    while (len > 1 && (path[len - 1] == '/' || path[len - 1] == '\\'))
+        len--;
+    // Обычный случай при извлечении дерева: каталог уже создан, копия пути не нужна
+    if (len == 0 || created_dirs_contains(created, path, len))
+    {
+        (*hits)++;
+        return SQUASH_OK;
+    }
+    char *copy = malloc(len + 1);
+    if (!copy)
+    {
+        return SQUASH_ERROR_MEMORY;
+    }
+    memcpy(copy, path, len);
+    copy[len] = '\0';
+    squash_error_t err = make_dirs(created, copy, len, made, hits);
+    free(copy);
+    return err;
+}